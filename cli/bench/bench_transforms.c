@@ -0,0 +1,283 @@
+/**
+ * @file bench_transforms.c
+ * @author Chris Grams (chrisagrams@gmail.com)
+ * @brief Microbenchmark of the lossy transform kernels of simd.c against the
+ * scalar libm loops they replace. Reports the time per element of both and
+ * the number of values that differ (which must be 0). Also times the vbr and
+ * bitpack transforms of algo.c in both directions, and substring search over
+ * spectrum headers.
+ *
+ * Build with -DBUILD_BENCH=ON and run ./bench_transforms [n_values] [cpu],
+ * cpu being one of the --cpu types of mscompress.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mscompress.h"
+
+#define REPEAT 5
+
+static double random_intensity() {
+   // Intensities span several orders of magnitude, with a share of zeros.
+   if (rand() % 8 == 0)
+      return 0;
+   return exp2((double)rand() / RAND_MAX * 30);
+}
+
+static void report(const char* name, long n, double ref, double kernel,
+                   long mismatches) {
+   printf("%-12s scalar %7.3f ns  %s %7.3f ns  (%.1fx)  mismatches %ld\n",
+          name, ref * 1e9 / n, get_simd_level_name(get_simd_level()),
+          kernel * 1e9 / n, ref / kernel, mismatches);
+}
+
+static void bench_log2(long n, float scale) {
+   float* f32 = malloc(n * sizeof(float));
+   double* f64 = malloc(n * sizeof(double));
+   uint16_t* ref = malloc(n * sizeof(uint16_t));
+   uint16_t* res = malloc(n * sizeof(uint16_t));
+   double start, t_ref, t_kernel;
+   long mismatches;
+
+   for (long i = 0; i < n; i++) {
+      f64[i] = random_intensity();
+      f32[i] = f64[i];
+   }
+
+   t_ref = t_kernel = INFINITY;
+   for (int r = 0; r < REPEAT; r++) {
+      start = get_time();
+      for (long i = 0; i < n; i++) ref[i] = floor(log2(f32[i] + 1) * scale);
+      t_ref = fmin(t_ref, get_time() - start);
+      start = get_time();
+      log2_quantize_32f(f32, n, scale, res);
+      t_kernel = fmin(t_kernel, get_time() - start);
+   }
+   mismatches = 0;
+   for (long i = 0; i < n; i++) mismatches += ref[i] != res[i];
+   report("log2 32f", n, t_ref, t_kernel, mismatches);
+
+   t_ref = t_kernel = INFINITY;
+   for (int r = 0; r < REPEAT; r++) {
+      start = get_time();
+      for (long i = 0; i < n; i++) ref[i] = floor(log2(f64[i] + 1) * scale);
+      t_ref = fmin(t_ref, get_time() - start);
+      start = get_time();
+      log2_quantize_64d(f64, n, scale, res);
+      t_kernel = fmin(t_kernel, get_time() - start);
+   }
+   mismatches = 0;
+   for (long i = 0; i < n; i++) mismatches += ref[i] != res[i];
+   report("log2 64d", n, t_ref, t_kernel, mismatches);
+
+   free(f32);
+   free(f64);
+   free(ref);
+   free(res);
+}
+
+static void bench_exp2(long n, float scale) {
+   uint16_t* q = malloc(n * sizeof(uint16_t));
+   float *ref32 = malloc(n * sizeof(float)), *res32 = malloc(n * sizeof(float));
+   double *ref64 = malloc(n * sizeof(double)),
+          *res64 = malloc(n * sizeof(double));
+   double start, t_ref, t_kernel;
+   long mismatches;
+
+   for (long i = 0; i < n; i++) q[i] = floor(log2(random_intensity() + 1) * scale);
+
+   t_ref = t_kernel = INFINITY;
+   for (int r = 0; r < REPEAT; r++) {
+      start = get_time();
+      for (long i = 0; i < n; i++)
+         ref32[i] = (float)exp2((double)q[i] / scale) - 1;
+      t_ref = fmin(t_ref, get_time() - start);
+      start = get_time();
+      exp2_dequantize_32f(q, n, scale, res32);
+      t_kernel = fmin(t_kernel, get_time() - start);
+   }
+   mismatches = 0;
+   for (long i = 0; i < n; i++)
+      mismatches += memcmp(&ref32[i], &res32[i], sizeof(float)) != 0;
+   report("exp2 32f", n, t_ref, t_kernel, mismatches);
+
+   t_ref = t_kernel = INFINITY;
+   for (int r = 0; r < REPEAT; r++) {
+      start = get_time();
+      for (long i = 0; i < n; i++)
+         ref64[i] = (double)exp2((double)q[i] / scale) - 1;
+      t_ref = fmin(t_ref, get_time() - start);
+      start = get_time();
+      exp2_dequantize_64d(q, n, scale, res64);
+      t_kernel = fmin(t_kernel, get_time() - start);
+   }
+   mismatches = 0;
+   for (long i = 0; i < n; i++)
+      mismatches += memcmp(&ref64[i], &res64[i], sizeof(double)) != 0;
+   report("exp2 64d", n, t_ref, t_kernel, mismatches);
+
+   free(q);
+   free(ref32);
+   free(res32);
+   free(ref64);
+   free(res64);
+}
+
+static const char* find_reference(const char* start, const char* end,
+                                  const char* needle, size_t len) {
+   for (; start + len <= end; start++)
+      if (*start == *needle && memcmp(start, needle, len) == 0)
+         return start;
+   return NULL;
+}
+
+static void bench_find(long n) {
+   // Spectrum headers are searched for a few cvParams, one header at a time.
+   const char* text =
+       "<cvParam cvRef=\"MS\" accession=\"MS:1000285\" name=\"total ion "
+       "current\" value=\"1.0546e07\"/>\n";
+   const char* needles[] = {"accession=\"MS:1000016\"", "\"UO:0000010\"",
+                            "value=\"", ">"};
+   long n_needles = sizeof(needles) / sizeof(needles[0]), window = 4096;
+   long text_len = strlen(text), found_ref = 0, found = 0, mismatches;
+   char* buf = malloc(n);
+   double start, t_ref, t_kernel;
+
+   for (long i = 0; i < n; i++) buf[i] = text[i % text_len];
+
+   t_ref = t_kernel = INFINITY;
+   for (int r = 0; r < REPEAT; r++) {
+      found_ref = found = 0;
+      start = get_time();
+      for (long w = 0; w < n; w += window) {
+         const char* end = buf + (w + window < n ? w + window : n);
+         for (long k = 0; k < n_needles; k++) {
+            const char* p = buf + w;
+            size_t len = strlen(needles[k]);
+            while ((p = find_reference(p, end, needles[k], len)) != NULL)
+               found_ref += p++ - buf;
+         }
+      }
+      t_ref = fmin(t_ref, get_time() - start);
+      start = get_time();
+      for (long w = 0; w < n; w += window) {
+         const char* end = buf + (w + window < n ? w + window : n);
+         for (long k = 0; k < n_needles; k++) {
+            const char* p = buf + w;
+            size_t len = strlen(needles[k]);
+            while ((p = find_substring(p, end, needles[k], len)) != NULL)
+               found += p++ - buf;
+         }
+      }
+      t_kernel = fmin(t_kernel, get_time() - start);
+   }
+   mismatches = found != found_ref;
+   report("find", n * n_needles, t_ref, t_kernel, mismatches);
+
+   free(buf);
+}
+
+static int raw_decode(z_stream* z, char* src, size_t src_len,
+                      data_block_t* dest, size_t* out_len) {
+   (void)z;
+   memcpy(reserve_data_block(dest, src_len), src, src_len);
+   *out_len = src_len;
+   return 0;
+}
+
+static void raw_encode(z_stream* z, char** src, size_t src_len, char* dest,
+                       size_t* out_len) {
+   (void)z;
+   memcpy(dest, *src, src_len);
+   *out_len = src_len;
+   free(*src);
+}
+
+static void bench_bitstream(const char* name, int algo, int accession, long n,
+                            float scale) {
+   size_t width = accession == _64d_ ? sizeof(double) : sizeof(float);
+   char* src = malloc(n * width);
+   char* out = malloc(n * width);
+   char *packed = NULL, *cursor;
+   size_t packed_len = 0, out_len = 0;
+   double start, t_pack = INFINITY, t_unpack = INFINITY;
+   algo_args a_args = {0};
+
+   for (long i = 0; i < n; i++) {
+      if (accession == _64d_)
+         ((double*)src)[i] = random_intensity();
+      else
+         ((float*)src)[i] = random_intensity();
+   }
+
+   a_args.src_len = n * width;
+   a_args.src_format = accession;
+   a_args.dec_fun = raw_decode;
+   a_args.enc_fun = raw_encode;
+   a_args.scale_factor = scale;
+   a_args.tmp = alloc_data_block(n * width + 1);
+   a_args.out = alloc_data_block(n * width + 1);
+
+   for (int r = 0; r < REPEAT; r++) {
+      a_args.out->size = 0;
+      a_args.src = &src;
+      a_args.dest = &packed;
+      a_args.dest_len = &packed_len;
+      start = get_time();
+      set_compress_algo(algo, accession)(&a_args);
+      t_pack = fmin(t_pack, get_time() - start);
+
+      cursor = packed;
+      a_args.src = &cursor;
+      a_args.dest = (char**)out;  // enc_fun writes into the buffer itself.
+      a_args.dest_len = &out_len;
+      start = get_time();
+      set_decompress_algo(algo, accession)(&a_args);
+      t_unpack = fmin(t_unpack, get_time() - start);
+   }
+   printf("%-12s pack %7.3f ns  unpack %7.3f ns  (%.2f bytes/value)\n", name,
+          t_pack * 1e9 / n, t_unpack * 1e9 / n, (double)packed_len / n);
+
+   free(src);
+   free(out);
+   dealloc_data_block(a_args.tmp);
+   dealloc_data_block(a_args.out);
+}
+
+int main(int argc, char* argv[]) {
+   long n = argc > 1 ? atol(argv[1]) : 1 << 22;
+   float scales[] = {72.0f, 1.0f, 1000.0f};
+   Arguments args;
+
+   init_args(&args);
+   if (n <= 0 || (argc > 2 && set_cpu(&args, argv[2]) != 0)) {
+      fprintf(stderr, "usage: %s [n_values] [cpu]\n", argv[0]);
+      return 1;
+   }
+   set_simd_level(args.cpu);
+
+   srand(1);
+   for (int s = 0; s < 3; s++) {
+      printf("scale factor %g, %ld values\n", scales[s], n);
+      bench_log2(n, scales[s]);
+      bench_exp2(n, scales[s]);
+   }
+
+   printf("vbr and bitpack, %ld values\n", n);
+   bench_bitstream("vbr 32f", _vbr_, _32f_, n, 1.0f);
+   bench_bitstream("vbr 64d", _vbr_, _64d_, n, 1.0f);
+   bench_bitstream("bitpack 32f", _bitpack_, _32f_, n, 1e9f);
+   bench_bitstream("bitpack 64d", _bitpack_, _64d_, n, 1e9f);
+
+   printf("substring search, %ld bytes\n", n);
+   bench_find(n);
+   return 0;
+}
@@ -35,6 +35,16 @@ static void print_usage(FILE* stream, int exit_code) {
        stream,
        "  -i, --int-lossy type          Enable int lossy compression (cast, "
        "log, delta(16, 32), vbr). (disabled by default)\n");
+   fprintf(stream,
+           " --chrom-time-lossy type        Enable chromatogram time lossy "
+           "compression (same types as --mz-lossy). (disabled by default)\n");
+   fprintf(stream,
+           " --chrom-int-lossy type         Enable chromatogram int lossy "
+           "compression (same types as --int-lossy). (disabled by default)\n");
+   fprintf(stream,
+           " --metadata columns             Per-spectrum metadata columns to "
+           "store (precursor, charge, tic, basepeak, isolation, all, none). "
+           "(default: all)\n");
    fprintf(stream,
            " --mz-scale-factor factor       Set mz scale factors for delta "
            "transform or threshold for vbr.\n");
@@ -51,6 +61,21 @@ static void print_usage(FILE* stream, int exit_code) {
    fprintf(stream,
            " --ms-level level               Extract specified ms level (1, 2, "
            "n) from mzML or msz file. (disabled by default)\n");
+   fprintf(stream,
+           " --rt-range start-end           Extract spectra by retention time "
+           "in minutes (eg. 30-45) from mzML or msz file. (disabled by "
+           "default)\n");
+   fprintf(stream,
+           " --xic mz[,mz...]               Print the extracted-ion "
+           "chromatogram of each m/z over the MS1 spectra of an msz file in "
+           "CSV format.\n");
+   fprintf(stream,
+           " --ppm tolerance                Half width of XIC windows in ppm. "
+           "(default: 10)\n");
+   fprintf(stream,
+           " --tic                          Print the total ion current and "
+           "base peak chromatograms of an mzML or msz file in CSV format, "
+           "over the MS1 spectra or --ms-level.\n");
    fprintf(stream,
            " --extract                      Enables extraction mode for either "
            "mzML or msz files. (disabled by default)\n");
@@ -67,15 +92,45 @@ static void print_usage(FILE* stream, int exit_code) {
    fprintf(stream,
            " --zstd-compression-level level Set zstd compression level (1-22). "
            "(default: 3)\n");
+   fprintf(stream,
+           " --max-pending num              Max divisions held in memory "
+           "while decompressing. (default: 2 * threads)\n");
+   fprintf(stream,
+           " --target-binary-encoding type  Compression of binary arrays "
+           "written on decompression/extraction (none, zlib, original). "
+           "(default: original)\n");
+   fprintf(stream,
+           " --zlib-engine type             Deflate backend used to "
+           "re-encode zlib arrays (oneshot, stream). (default: oneshot)\n");
+   fprintf(stream,
+           " --zlib-level level             zlib level used to re-encode "
+           "arrays (default, 0-9). Non-default levels are faster/smaller "
+           "but not byte-identical to the original. (default: default)\n");
+   fprintf(stream,
+           " --cpu type                     Instruction set of the vector "
+           "kernels (auto, scalar, sse2, avx2, avx512). (default: auto)\n");
    fprintf(stream,
            "  -b, --blocksize size          Set maximum blocksize (xKB, xMB, "
            "xGB). (default: 100MB)\n");
+   fprintf(stream,
+           " --frame-size size              Split blocks in independently "
+           "decompressed frames (xKB, xMB, none) for faster extraction. "
+           "(default: 256KB)\n");
+   fprintf(stream,
+           " --cache-size size              Decompressed blocks kept in "
+           "memory during extraction (xMB, xGB, none). (default: 1GB)\n");
    fprintf(stream,
            "  -c, --checksum                Enable checksum generation. "
            "(disabled by default)\n");
    fprintf(
        stream,
        "  -d, --describe                Print header/footer in CSV format\n");
+   fprintf(stream,
+           " --describe-metadata            Print per-spectrum metadata "
+           "columns of an msz file in CSV format\n");
+   fprintf(stream,
+           "  -o, --output file             Output file path. Use - to write "
+           "to stdout.\n");
    fprintf(stream, "  -h, --help                    Show this help message.\n");
    fprintf(stream,
            "  -V, --version                 Show version information.\n\n");
@@ -84,7 +139,8 @@ static void print_usage(FILE* stream, int exit_code) {
    fprintf(stream,
            "  output_file                   Output file path. If not "
            "specified, the "
-           "output file name is the input file name with extension .msz.\n\n");
+           "output file name is the input file name with extension .msz. "
+           "Use - to write to stdout.\n\n");
    exit(exit_code);
 }
 
@@ -123,6 +179,60 @@ static int parse_arguments(int argc, char* argv[], Arguments* arguments) {
             return 1;
          }
          set_int_lossy(arguments, argv[++i]);
+      } else if (strcmp(argv[i], "--chrom-time-lossy") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n",
+                    "Invalid chromatogram time lossy compression type.");
+            return 1;
+         }
+         if (set_chrom_time_lossy(arguments, argv[++i]) != 0)
+            return 1;
+      } else if (strcmp(argv[i], "--chrom-int-lossy") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n",
+                    "Invalid chromatogram int lossy compression type.");
+            return 1;
+         }
+         if (set_chrom_int_lossy(arguments, argv[++i]) != 0)
+            return 1;
+      } else if (strcmp(argv[i], "--max-pending") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n", "Missing number of pending divisions.");
+            return 1;
+         }
+         arguments->max_pending = atoi(argv[++i]);
+         if (arguments->max_pending < 1) {
+            fprintf(stderr, "%s\n", "Invalid number of pending divisions.");
+            return 1;
+         }
+      } else if (strcmp(argv[i], "--target-binary-encoding") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n", "Missing target binary encoding.");
+            return 1;
+         }
+         if (set_target_binary_encoding(arguments, argv[++i]) != 0)
+            return 1;
+      } else if (strcmp(argv[i], "--zlib-engine") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n", "Missing zlib engine.");
+            return 1;
+         }
+         if (set_zlib_engine(arguments, argv[++i]) != 0)
+            return 1;
+      } else if (strcmp(argv[i], "--zlib-level") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n", "Missing zlib level.");
+            return 1;
+         }
+         if (set_zlib_level(arguments, argv[++i]) != 0)
+            return 1;
+      } else if (strcmp(argv[i], "--cpu") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n", "Missing cpu type.");
+            return 1;
+         }
+         if (set_cpu(arguments, argv[++i]) != 0)
+            return 1;
       } else if (strcmp(argv[i], "-b") == 0 ||
                  strcmp(argv[i], "--blocksize") == 0) {
          if (i + 1 >= argc) {
@@ -135,12 +245,36 @@ static int parse_arguments(int argc, char* argv[], Arguments* arguments) {
             print_usage(stderr, 1);
          }
          arguments->blocksize = blksize;
+      } else if (strcmp(argv[i], "--frame-size") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n", "Missing frame size.");
+            return 1;
+         }
+         if (set_frame_size(arguments, argv[++i]) != 0)
+            return 1;
+      } else if (strcmp(argv[i], "--cache-size") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n", "Missing cache size.");
+            return 1;
+         }
+         if (set_cache_size(arguments, argv[++i]) != 0)
+            return 1;
       } else if (strcmp(argv[i], "-c") == 0 ||
                  strcmp(argv[i], "--checksum") == 0) {
          // enable checksum generation (not implemented)
       } else if (strcmp(argv[i], "-d") == 0 ||
                  strcmp(argv[i], "--describe") == 0) {
          arguments->describe_only = 1;
+      } else if (strcmp(argv[i], "--describe-metadata") == 0) {
+         arguments->describe_only = 1;
+         arguments->describe_metadata = 1;
+      } else if (strcmp(argv[i], "--metadata") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n", "Missing metadata columns.");
+            return 1;
+         }
+         if (set_metadata_flags(arguments, argv[++i]) != 0)
+            return 1;
       } else if (strcmp(argv[i], "--mz-scale-factor") == 0) {
          if (i + 1 >= argc) {
             fprintf(stderr, "%s\n", "Missing scale factor for mz compression.");
@@ -170,6 +304,29 @@ static int parse_arguments(int argc, char* argv[], Arguments* arguments) {
          }
          arguments->scans =
              string_to_array(argv[++i], &arguments->scans_length);
+      } else if (strcmp(argv[i], "--rt-range") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n", "Missing retention time range.");
+            return 1;
+         }
+         if (set_rt_range(arguments, argv[++i]) != 0)
+            return 1;
+      } else if (strcmp(argv[i], "--xic") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n", "Missing m/z list for XIC.");
+            return 1;
+         }
+         if (set_xic(arguments, argv[++i]) != 0)
+            return 1;
+      } else if (strcmp(argv[i], "--ppm") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n", "Missing ppm tolerance.");
+            return 1;
+         }
+         if (set_xic_ppm(arguments, argv[++i]) != 0)
+            return 1;
+      } else if (strcmp(argv[i], "--tic") == 0) {
+         arguments->tic_only = 1;
       } else if (strcmp(argv[i], "--ms-level") == 0) {
          if (i + 1 >= argc) {
             fprintf(stderr, "%s\n", "Missing ms level for extraction.");
@@ -216,6 +373,13 @@ static int parse_arguments(int argc, char* argv[], Arguments* arguments) {
             str++;
          }
          arguments->zstd_compression_level = num;
+      } else if (strcmp(argv[i], "-o") == 0 ||
+                 strcmp(argv[i], "--output") == 0) {
+         if (i + 1 >= argc) {
+            fprintf(stderr, "%s\n", "Missing output file.");
+            return 1;
+         }
+         arguments->output_file = argv[++i];
       } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
          print_usage(stdout, 0);
       } else if (strcmp(argv[i], "-V") == 0 ||
@@ -262,6 +426,8 @@ int main(int argc, char* argv[]) {
 
    verbose = arguments.verbose;
 
+   set_simd_level(arguments.cpu);
+
    abs_start = get_time();
 
    print("=== %s ===\n", MESSAGE);
@@ -271,7 +437,8 @@ int main(int argc, char* argv[]) {
    prepare_threads(&arguments);  // Populate threads variable if not set.
 
    // Open file descriptors and mmap.
-   if (arguments.describe_only) {
+   if (arguments.describe_only || arguments.xic_mz != NULL ||
+       arguments.tic_only) {
       fds[0] = open_input_file(arguments.input_file);
       input_map = get_mapping(fds[0]);
       input_filesize = get_filesize(arguments.input_file);
@@ -285,6 +452,10 @@ int main(int argc, char* argv[]) {
 
    if (arguments.describe_only)
       operation = DESCRIBE;
+   else if (arguments.xic_mz != NULL)
+      operation = XIC;
+   else if (arguments.tic_only)
+      operation = TIC_BPC;
    if (arguments.extract_only &&
        operation == DECOMPRESS)  // msz detected, extracting
       operation = EXTRACT_MSZ;
@@ -299,7 +470,50 @@ int main(int argc, char* argv[]) {
 
    print("\tOutput file: %s\n", arguments.output_file);
 
+   print("\tVector kernels: %s\n", get_simd_level_name(get_simd_level()));
+
    switch (operation) {
+      case XIC: {
+         msz_reader_t* reader =
+             open_msz_reader(arguments.input_file, arguments.cache_size);
+         if (reader == NULL) {
+            error_status = 1;
+            break;
+         }
+         xic_t* xic = extract_xic(reader, arguments.xic_mz,
+                                  arguments.xic_length, arguments.xic_ppm,
+                                  arguments.threads);
+         if (xic == NULL)
+            error_status = 1;
+         else
+            print_xic_csv(xic);
+         dealloc_xic(xic);
+         close_msz_reader(reader);
+         break;
+      }
+      case TIC_BPC: {
+         uint16_t ms_level = arguments.ms_level > 0 ? arguments.ms_level : 1;
+         msz_reader_t* reader = NULL;
+         tic_t* tic;
+
+         if (is_msz(input_map, input_filesize)) {
+            reader = open_msz_reader(arguments.input_file, arguments.cache_size);
+            if (reader == NULL) {
+               error_status = 1;
+               break;
+            }
+            tic = compute_tic_msz(reader, ms_level, arguments.threads);
+         } else
+            tic = compute_tic_mzml(input_map, input_filesize, ms_level,
+                                   arguments.threads);
+         if (tic == NULL)
+            error_status = 1;
+         else
+            print_tic_csv(tic);
+         dealloc_tic(tic);
+         close_msz_reader(reader);
+         break;
+      }
       case COMPRESS: {
          print("\tDetected .mzML file, starting compression...\n");
 
@@ -322,7 +536,8 @@ int main(int argc, char* argv[]) {
          print("\nDecompression and encoding...\n");
 
          // Start decompress routine.
-         decompress_msz(input_map, input_filesize, &arguments, fds[1]);
+         if (decompress_msz(input_map, input_filesize, &arguments, fds[1]))
+            error_status = 1;
 
          break;
       };
@@ -335,11 +550,18 @@ int main(int argc, char* argv[]) {
                              &divisions);
 
          extract_mzml((char*)input_map, divisions, fds[1]);
+         break;
       };
       case EXTRACT_MSZ: {
-         extract_msz((char*)input_map, input_filesize, arguments.indices,
-                     arguments.indices_length, arguments.scans,
-                     arguments.scans_length, arguments.ms_level, fds[1]);
+         if (extract_msz((char*)input_map, input_filesize, arguments.indices,
+                         arguments.indices_length, arguments.scans,
+                         arguments.scans_length, arguments.ms_level,
+                         arguments.rt_range,
+                         arguments.target_binary_encoding,
+                         arguments.zlib_engine, arguments.zlib_level,
+                         arguments.cache_size, arguments.threads, fds[1]))
+            error_status = 1;
+         break;
       };
       case EXTERNAL: {
          preprocess_external((char*)input_map, input_filesize,
@@ -347,8 +569,20 @@ int main(int argc, char* argv[]) {
                              &divisions);
          compress_mzml((char*)input_map, input_filesize, &arguments, df,
                        divisions, fds[1]);
+         break;
       }
       case DESCRIBE: {
+         if (arguments.describe_metadata) {
+            metadata_t* metadata =
+                read_metadata((char*)input_map, input_filesize);
+            if (!metadata) {
+               warning("No metadata columns found.\n");
+               exit(1);
+            }
+            print_metadata_csv(metadata);
+            dealloc_metadata(metadata);
+            break;
+         }
          footer_t* footer = read_footer((char*)input_map, input_filesize);
          if (!footer)
             exit(1);
@@ -374,7 +608,9 @@ int main(int argc, char* argv[]) {
    print("\n=== Operation finished in %1.4fs ===\n", abs_stop - abs_start);
 
    if (error_status) {
-      remove_file(arguments.output_file);
+      if (arguments.output_file != NULL &&
+          strcmp(arguments.output_file, "-") != 0)
+         remove_file(arguments.output_file);
       exit(1);
    }
 
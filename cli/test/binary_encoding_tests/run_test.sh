@@ -0,0 +1,20 @@
+#!/bin/bash
+
+for i in ../test_files/*.mzML; do
+    tput sgr0;
+    echo "Testing $i..."
+    ../../mscompress --threads 1 "$i" ./test.msz
+    ../../mscompress --threads 1 --target-binary-encoding none ./test.msz ./test_none.mzML
+    python3 ../validate.py --check-encodings ./test_none.mzML
+    r1=$?
+    ../../mscompress --threads 1 ./test_none.mzML ./test_none.msz
+    ../../mscompress --threads 1 --target-binary-encoding zlib ./test_none.msz ./test.mzML
+    python3 ../validate.py "$i" ./test.mzML 0 0
+    r2=$?
+    if [ $r1 -eq 0 ] && [ $r2 -eq 0 ]; then
+        tput setab 2; echo "Binary encoding test $i passed"; tput sgr0;
+    else
+        tput setab 1; echo "Binary encoding test $i failed"; tput sgr0;
+    fi
+    rm -f ./test.msz ./test_none.mzML ./test_none.msz ./test.mzML
+done
@@ -0,0 +1,19 @@
+#!/bin/bash
+
+for i in ../test_files/*.mzML; do
+    tput sgr0;
+    echo "Testing $i..."
+    ../../mscompress --threads 1 "$i" ./test.msz
+    ../../mscompress --threads 1 --extract --rt-range 0.02-0.05 ./test.msz ./test_msz.mzML
+    python3 ../validate.py --check-rt-range ./test_msz.mzML "$i" 0.02 0.05
+    r1=$?
+    ../../mscompress --threads 1 --extract --rt-range 0.02-0.05 "$i" ./test_mzml.mzML
+    python3 ../validate.py ./test_msz.mzML ./test_mzml.mzML 0 0
+    r2=$?
+    if [ $r1 -eq 0 ] && [ $r2 -eq 0 ]; then
+        tput setab 2; echo "Retention time range test $i passed"; tput sgr0;
+    else
+        tput setab 1; echo "Retention time range test $i failed"; tput sgr0;
+    fi
+    rm -f ./test.msz ./test_msz.mzML ./test_mzml.mzML
+done
@@ -0,0 +1,19 @@
+#!/bin/bash
+
+for i in ../test_files/*.mzML; do
+    tput sgr0;
+    echo "Testing $i..."
+    ../../mscompress --threads 1 "$i" ./test.msz
+    ../../mscompress --threads 1 "$i" -o - | cat > ./test_stdout.msz
+    cmp ./test.msz ./test_stdout.msz
+    r1=$?
+    ../../mscompress --threads 1 ./test_stdout.msz -o - | cat > ./test.mzML
+    python3 ../validate.py "$i" ./test.mzML 0 0
+    r2=$?
+    if [ $r1 -eq 0 ] && [ $r2 -eq 0 ]; then
+        tput setab 2; echo "Stdout test $i passed"; tput sgr0;
+    else
+        tput setab 1; echo "Stdout test $i failed"; tput sgr0;
+    fi
+    rm -f ./test.msz ./test_stdout.msz ./test.mzML
+done
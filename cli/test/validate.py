@@ -102,6 +102,87 @@ def traverse_and_compare(test_iterator, org_iterator, namespace, encoding, datat
             org_elem.clear()
 
 
+def check_encodings(mzml):
+    """Checks that the compression cvParam and encodedLength of every binary
+    array match its payload."""
+    context, namespace = get_iterator(mzml)
+    array_tag = f"{{{namespace}}}binaryDataArray"
+
+    for event, elem in context:
+        if event != 'end' or elem.tag != array_tag:
+            continue
+
+        binary = elem.find(f'{{{namespace}}}binary')
+        text = (binary.text or '') if binary is not None else ''
+        accessions = [p.attrib.get('accession')
+                      for p in elem.findall(f'{{{namespace}}}cvParam')]
+
+        if int(elem.attrib.get('encodedLength', -1)) != len(text):
+            print("encodedLength does not match binary data.")
+            return False
+
+        data = base64.b64decode(text)
+        if 'MS:1000574' in accessions:
+            try:
+                zlib.decompress(data)
+            except zlib.error:
+                print("Binary data is not zlib compressed.")
+                return False
+        elif 'MS:1000576' in accessions:
+            try:
+                zlib.decompress(data)
+                print("Binary data marked uncompressed is zlib compressed.")
+                return False
+            except zlib.error:
+                pass
+        else:
+            print("Binary data array has no compression cvParam.")
+            return False
+
+        elem.clear()
+
+    return True
+
+
+def get_ret_times(mzml):
+    """Returns the id and scan start time (in minutes) of every spectrum."""
+    context, namespace = get_iterator(mzml)
+    spectrum_tag = f"{{{namespace}}}spectrum"
+    cv_param_tag = f"{{{namespace}}}cvParam"
+    ret_times = []
+
+    for event, elem in context:
+        if event != 'end' or elem.tag != spectrum_tag:
+            continue
+        rt = None
+        for param in elem.iter(cv_param_tag):
+            if param.attrib.get('accession') == 'MS:1000016':
+                rt = float(param.attrib['value'])
+                if param.attrib.get('unitName') == 'second':
+                    rt /= 60
+                break
+        ret_times.append((elem.attrib.get('id'), rt))
+        elem.clear()
+
+    return ret_times
+
+
+def check_rt_range(test_mzml, org_mzml, start, end):
+    """Checks that test_mzml holds exactly the spectra of org_mzml whose
+    retention time is within [start, end] minutes."""
+    expected = [id_ for id_, rt in get_ret_times(org_mzml)
+                if rt is not None and start <= rt <= end]
+    found = [id_ for id_, rt in get_ret_times(test_mzml)]
+
+    if not expected:
+        print("No spectra in retention time range.")
+        return False
+    if found != expected:
+        print(f"Expected {len(expected)} spectra in retention time range, found {len(found)}.")
+        return False
+    return True
+
+
 def compare_mzml(test_mzml, org_mzml, mz_tolerance, int_tolerance):
     try:
         test_tree, test_namespace = get_iterator(test_mzml)
@@ -162,6 +243,11 @@ def compare_mzml(test_mzml, org_mzml, mz_tolerance, int_tolerance):
 
 
 if __name__ == "__main__":
+    if len(sys.argv) == 3 and sys.argv[1] == "--check-encodings":
+        sys.exit(0 if check_encodings(sys.argv[2]) else 1)
+    if len(sys.argv) == 6 and sys.argv[1] == "--check-rt-range":
+        sys.exit(0 if check_rt_range(sys.argv[2], sys.argv[3], float(sys.argv[4]), float(sys.argv[5])) else 1)
+
     test = sys.argv[1]
     org = sys.argv[2]
     mz_tolerance = float(sys.argv[3])
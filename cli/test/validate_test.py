@@ -1,7 +1,7 @@
 import numpy as np
 import base64
 import zlib
-from validate import compare_mzml, compare_binary_data
+from validate import compare_mzml, compare_binary_data, check_encodings, check_rt_range
 import io
 
 
@@ -50,6 +50,17 @@ def test_missing_spectra():
     assert compare_mzml(test_file, org_file, 0.0, 0.0) == False
 
 
+def test_check_encodings():
+    test_file = "test_files/hek_std2_zlib_subset_missing_spectra.mzML"
+    assert check_encodings(test_file)
+
+
+def test_check_rt_range():
+    test_file = "test_files/hek_std2_zlib_subset_missing_spectra.mzML"
+    assert check_rt_range(test_file, test_file, 0.0, 1000.0)
+    assert check_rt_range(test_file, test_file, 0.02, 0.05) == False
+
+
 def test_compare_binary_data_no_comp_no_delta():
     array_size = 100
     random_floats = np.random.uniform(0.0, 2000.0, array_size)
@@ -0,0 +1,21 @@
+#!/bin/bash
+
+for i in ../test_files/*.mzML; do
+    tput sgr0;
+    echo "Testing $i..."
+    ../../mscompress --threads 1 "$i" ./test.msz
+    ../../mscompress --threads 1 --zlib-level 1 ./test.msz ./test.mzML
+    python3 ../validate.py --check-encodings ./test.mzML
+    r1=$?
+    python3 ../validate.py "$i" ./test.mzML 0 0
+    r2=$?
+    ../../mscompress --threads 1 --zlib-level 1 --extract --extract-indices "[0-4]" ./test.msz ./test_extract.mzML
+    python3 ../validate.py --check-encodings ./test_extract.mzML
+    r3=$?
+    if [ $r1 -eq 0 ] && [ $r2 -eq 0 ] && [ $r3 -eq 0 ]; then
+        tput setab 2; echo "zlib level test $i passed"; tput sgr0;
+    else
+        tput setab 1; echo "zlib level test $i failed"; tput sgr0;
+    fi
+    rm -f ./test.msz ./test.mzML ./test_extract.mzML
+done
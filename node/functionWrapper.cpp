@@ -489,6 +489,10 @@ namespace mscompress {
                     args->scans,
                     args->scans_length,
                     args->ms_level,
+                    args->rt_range,
+                    args->target_binary_encoding,
+                    args->cache_size,
+                    args->threads,
                     fds[1]);
                 break;
             }
@@ -2,8 +2,10 @@ cdef extern from "stdint.h":
     ctypedef unsigned int uint64_t
     ctypedef unsigned int uint32_t
     ctypedef unsigned int uint16_t
+    ctypedef unsigned char uint8_t
 
 cdef extern from "../vendor/zlib/zlib.h":
+    int Z_DEFAULT_COMPRESSION
     ctypedef struct z_stream:
         pass
 
@@ -21,11 +23,25 @@ cdef extern from "../src/mscompress.h":
     int ZLIB_SIZE_OFFSET
     int _32f_
     int _64d_
+    int _mass_
+    int _intensity_
+    int _time_
+    int _TIC_COMPUTED "TIC_COMPUTED"
+    int _METADATA_PRECURSOR_MZ "METADATA_PRECURSOR_MZ"
+    int _METADATA_CHARGE "METADATA_CHARGE"
+    int _METADATA_TIC "METADATA_TIC"
+    int _METADATA_BASE_PEAK_MZ "METADATA_BASE_PEAK_MZ"
+    int _METADATA_BASE_PEAK_INTENSITY "METADATA_BASE_PEAK_INTENSITY"
+    int _METADATA_ISOLATION_TARGET "METADATA_ISOLATION_TARGET"
+    int _METADATA_ISOLATION_LOWER "METADATA_ISOLATION_LOWER"
+    int _METADATA_ISOLATION_UPPER "METADATA_ISOLATION_UPPER"
+    int _BPC_COMPUTED "BPC_COMPUTED"
+    int _DEFLATE_ONESHOT "DEFLATE_ONESHOT"
     
     ctypedef void (*Algo)(void*)
     ctypedef Algo (*Algo_ptr)()
 
-    ctypedef void (*decode_fun)(z_stream *, char *, size_t, char **, size_t *, data_block_t *)
+    ctypedef int (*decode_fun)(z_stream *, char *, size_t, data_block_t *, size_t *)
     ctypedef decode_fun (*decode_fun_ptr)()
 
     ctypedef void (*encode_fun)(z_stream *, char **, size_t, char *, size_t *)
@@ -48,6 +64,9 @@ cdef extern from "../src/mscompress.h":
         int target_mz_format
         int target_inten_format
         int zstd_compression_level
+        long frame_size
+        int zlib_engine
+        int zlib_level
     
     ctypedef struct data_block_t:
         char* mem
@@ -66,11 +85,38 @@ cdef extern from "../src/mscompress.h":
         uint64_t encoded_cache_len
         size_t* encoded_cache_lens
 
+    ctypedef struct block_cache_t:
+        size_t limit
+        size_t used
+        uint64_t hits
+        uint64_t misses
+        uint64_t evictions
+
+    ctypedef struct msz_reader_t:
+        pass
+
+    ctypedef struct xic_t:
+        long n_targets
+        long n_scans
+        double* mz
+        long* indices
+        float* ret_times
+        double* intensities
+
+    ctypedef struct tic_t:
+        long n_spectra
+        long* indices
+        float* ret_times
+        double* tic
+        double* bpc
+        uint8_t* computed
+
     ctypedef struct block_len_queue_t:
         block_len_t* head
         block_len_t* tail
 
         int populated
+        block_cache_t* cache
     
     ctypedef struct data_format_t:
         uint32_t source_mz_fmt
@@ -136,6 +182,7 @@ cdef extern from "../src/mscompress.h":
 
     data_format_t* _pattern_detect "pattern_detect"(char* input_map)
     data_format_t* _get_header_df "get_header_df"(void* input_map)
+    int _check_format_version "check_format_version"(void* input_map)
 
     division_t* _scan_mzml "scan_mzml"(char* input_map, data_format_t* df, long end, int flags)
     long _determine_n_divisions "determine_n_divisions"(long filesize, long blocksize)
@@ -145,7 +192,7 @@ cdef extern from "../src/mscompress.h":
     int _set_decompress_runtime_variables "set_decompress_runtime_variables"(data_format_t* df, footer_t* msz_footer)
     data_block_t* _alloc_data_block "alloc_data_block"(size_t max_size)
     void _dealloc_data_block "dealloc_data_block"(data_block_t* db)
-    z_stream* _alloc_z_stream "alloc_z_stream"()
+    z_stream* _alloc_z_stream "alloc_z_stream"(data_format_t* df)
     ZSTD_CCtx* _alloc_cctx "alloc_cctx"()
     ZSTD_DCtx* _alloc_dctx "alloc_dctx"()
 
@@ -153,10 +200,30 @@ cdef extern from "../src/mscompress.h":
     divisions_t* _read_divisions "read_divisions"(void* input_map, long position, int n_divisions)
     division_t* _flatten_divisions "flatten_divisions"(divisions_t* divisions)
     block_len_queue_t* _read_block_len_queue "read_block_len_queue"(void* input_map, long offset, long end)
+    int _read_frame_index "read_frame_index"(void* input_map, long filesize, block_len_queue_t** queues, int n_queues)
+    int _read_spectrum_index "read_spectrum_index"(void* input_map, long filesize, block_len_queue_t** queues, int n_queues)
+    block_cache_t* _alloc_block_cache "alloc_block_cache"(size_t limit)
+    void _set_block_cache_limit "set_block_cache_limit"(block_cache_t* cache, size_t limit)
 
     char* _extract_spectrum_mz "extract_spectrum_mz"(char* input_map, ZSTD_DCtx* dctx, data_format_t* df, block_len_queue_t* _mz_binary_block_lens, long mz_binary_blk_pos, divisions_t* divisions, long index, size_t* out_len, int encode)
     char* _extract_spectrum_inten "extract_spectrum_inten"(char* input_map, ZSTD_DCtx* dctx, data_format_t* df, block_len_queue_t* _inten_binary_block_lens, long inten_binary_blk_pos, divisions_t* divisions, long index, size_t* out_len, int encode)
     char* _extract_spectra "extract_spectra"(char* input_map, ZSTD_DCtx* dctx, data_format_t* df, block_len_queue_t* _xml_block_lens, block_len_queue_t* _mz_binary_block_lens, block_len_queue_t* _inten_binary_block_lens, long xml_pos, long mz_pos, long inten_pos, int mz_fmt, int inten_fmt, divisions_t* divisions, long index, size_t* out_len)
+    msz_reader_t* _open_msz_reader "open_msz_reader"(char* path, long cache_size)
+    void _close_msz_reader "close_msz_reader"(msz_reader_t* reader)
+    long _msz_reader_num_spectra "msz_reader_num_spectra"(msz_reader_t* reader)
+    block_cache_t* _msz_reader_cache "msz_reader_cache"(msz_reader_t* reader)
+    data_format_t* _msz_reader_df "msz_reader_df"(msz_reader_t* reader)
+    char* _msz_reader_get_spectrum "msz_reader_get_spectrum"(msz_reader_t* reader, long index, size_t* out_len) nogil
+    char* _msz_reader_get_binary "msz_reader_get_binary"(msz_reader_t* reader, int type, long index, size_t* out_len) nogil
+    void* _msz_reader_metadata_column "msz_reader_metadata_column"(msz_reader_t* reader, int column)
+    long _msz_reader_num_chromatograms "msz_reader_num_chromatograms"(msz_reader_t* reader)
+    data_format_t* _msz_reader_chromatogram_df "msz_reader_chromatogram_df"(msz_reader_t* reader)
+    char* _msz_reader_get_chromatogram "msz_reader_get_chromatogram"(msz_reader_t* reader, int type, long index, size_t* out_len) nogil
+    xic_t* _extract_xic "extract_xic"(msz_reader_t* reader, double* mz, long n_targets, double ppm, int threads) nogil
+    void _dealloc_xic "dealloc_xic"(xic_t* xic)
+    tic_t* _compute_tic_msz "compute_tic_msz"(msz_reader_t* reader, uint16_t ms_level, int threads) nogil
+    tic_t* _compute_tic_mzml "compute_tic_mzml"(char* input_map, long input_filesize, uint16_t ms_level, int threads) nogil
+    void _dealloc_tic "dealloc_tic"(tic_t* tic)
     void _compress_mzml "compress_mzml"(char* input_map, size_t input_filesize, Arguments* arguments, data_format_t* df, divisions_t* divisions, int output_fd)
     void _decompress_msz "decompress_msz"(char* input_map, size_t input_filesize, Arguments* arguments, int fd)
 
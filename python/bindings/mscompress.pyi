@@ -1,6 +1,6 @@
 """A versatile compression tool for efficient management of mass-spectrometry data."""
 
-from typing import Union, Iterator, Optional, Dict, Any
+from typing import Union, Iterator, Optional, Dict, Any, Sequence, Tuple
 from xml.etree.ElementTree import Element
 import numpy as np
 import numpy.typing as npt
@@ -10,12 +10,14 @@ class RuntimeArguments:
     
     threads: int
     blocksize: int
+    frame_size: int
     mz_scale_factor: int
     int_scale_factor: int
     target_xml_format: int
     target_mz_format: int
     target_inten_format: int
     zstd_compression_level: int
+    zlib_level: int
     
     def __init__(self) -> None: ...
 
@@ -178,6 +180,26 @@ class MZMLFile(BaseFile):
         """
         ...
 
+    def get_tic(
+        self,
+        ms_level: int = 1,
+        threads: int = 0
+    ) -> Tuple[npt.NDArray[np.int64], npt.NDArray[np.float32], npt.NDArray[np.float64], npt.NDArray[np.float64], npt.NDArray[np.bool_], npt.NDArray[np.bool_]]:
+        """
+        Compute the total ion current and base peak chromatograms. Spectra
+        without TIC or base peak cvParams have their intensities decoded.
+
+        Parameters:
+            ms_level: MS level of the spectra, 0 for every spectrum.
+            threads: Number of threads, 0 for all available threads.
+
+        Returns:
+            Spectrum indices, retention times, TIC, BPC, and whether each
+            TIC and BPC value was computed from the intensity array rather
+            than recorded in the file.
+        """
+        ...
+
 class MSZFile(BaseFile):
     """Handler for MSZ (compressed) format files."""
     
@@ -228,6 +250,155 @@ class MSZFile(BaseFile):
         """
         ...
 
+class MSZReader:
+    """
+    Random access reader of an MSZ file that can be shared by several threads.
+    Extraction releases the GIL, and a block requested by several threads at
+    once is decompressed a single time.
+    """
+
+    def __init__(self, path: Union[str, bytes], cache_size: int = 1000000000) -> None:
+        """
+        Parameters:
+            path: Path to the MSZ file.
+            cache_size: Bytes of decompressed blocks kept by the reader, 0 for no limit.
+        """
+        ...
+
+    def __len__(self) -> int: ...
+
+    def __enter__(self) -> "MSZReader": ...
+
+    def __exit__(self, exc_type: Any, exc_value: Any, traceback: Any) -> None: ...
+
+    def close(self) -> None:
+        """
+        Release the file and its cached blocks. The reader must not be in use
+        by another thread.
+        """
+        ...
+
+    def get_spectrum(self, index: int) -> str:
+        """
+        Extract the <spectrum> element of a spectrum.
+
+        Parameters:
+            index: Spectrum index.
+
+        Returns:
+            The spectrum XML.
+        """
+        ...
+
+    def get_mz(self, index: int) -> npt.NDArray[Union[np.float32, np.float64]]:
+        """
+        Extract the m/z array of a spectrum.
+
+        Parameters:
+            index: Spectrum index.
+
+        Returns:
+            NumPy array of m/z values.
+        """
+        ...
+
+    def get_inten(self, index: int) -> npt.NDArray[Union[np.float32, np.float64]]:
+        """
+        Extract the intensity array of a spectrum.
+
+        Parameters:
+            index: Spectrum index.
+
+        Returns:
+            NumPy array of intensity values.
+        """
+        ...
+
+    def get_metadata(self, name: str) -> Optional[npt.NDArray[Union[np.float32, np.float64, np.uint16]]]:
+        """
+        Get a metadata column without decompressing any XML.
+
+        Parameters:
+            name: One of precursor_mz, charge, tic, base_peak_mz,
+                base_peak_intensity, isolation_target, isolation_lower or
+                isolation_upper.
+
+        Returns:
+            One value per spectrum (NaN, or 0 for charge, where missing), or
+            None if the file does not store the column.
+        """
+        ...
+
+    @property
+    def num_chromatograms(self) -> int:
+        """
+        Number of chromatograms whose arrays can be read with
+        get_chromatogram(), 0 if the file stores chromatograms as XML.
+        """
+        ...
+
+    def get_chromatogram(self, index: int) -> Tuple[npt.NDArray[Union[np.float32, np.float64]], npt.NDArray[Union[np.float32, np.float64]]]:
+        """
+        Extract the arrays of a chromatogram without decompressing any XML.
+
+        Parameters:
+            index: Chromatogram index.
+
+        Returns:
+            Time and intensity arrays.
+        """
+        ...
+
+    def get_xic(
+        self,
+        mz: Sequence[float],
+        ppm: float = 10.0,
+        threads: int = 0
+    ) -> Tuple[npt.NDArray[np.int64], npt.NDArray[np.float32], npt.NDArray[np.float64]]:
+        """
+        Compute the extracted-ion chromatogram of each target m/z over the MS1
+        spectra.
+
+        Parameters:
+            mz: Target m/z values.
+            ppm: Half width of each window in ppm of its m/z.
+            threads: Number of threads, 0 for all available threads.
+
+        Returns:
+            Spectrum indices, retention times and intensities (one row per
+            target, one column per MS1 spectrum).
+        """
+        ...
+
+    def get_tic(
+        self,
+        ms_level: int = 1,
+        threads: int = 0
+    ) -> Tuple[npt.NDArray[np.int64], npt.NDArray[np.float32], npt.NDArray[np.float64], npt.NDArray[np.float64], npt.NDArray[np.bool_], npt.NDArray[np.bool_]]:
+        """
+        Compute the total ion current and base peak chromatograms. TIC and
+        base peak intensities stored as metadata are used without decoding.
+
+        Parameters:
+            ms_level: MS level of the spectra, 0 for every spectrum.
+            threads: Number of threads, 0 for all available threads.
+
+        Returns:
+            Spectrum indices, retention times, TIC, BPC, and whether each
+            TIC and BPC value was computed from the intensity array rather
+            than recorded in the file.
+        """
+        ...
+
+    def get_cache_stats(self) -> Dict[str, int]:
+        """
+        Get the statistics of the reader's block cache.
+
+        Returns:
+            Dictionary with limit, used, hits, misses and evictions.
+        """
+        ...
+
 class Spectrum:
     """Represents a single mass spectrum."""
     
@@ -324,6 +495,25 @@ def get_num_threads() -> int:
     """
     ...
 
+def set_cache_size(size: int) -> None:
+    """
+    Set the amount of decompressed blocks kept in memory across all open MSZ
+    files. Least recently used blocks are released past this size.
+    
+    Parameters:
+        size: Cache size in bytes, 0 for no limit.
+    """
+    ...
+
+def get_cache_stats() -> Dict[str, int]:
+    """
+    Get the decompressed block cache statistics.
+    
+    Returns:
+        Dictionary with limit, used, hits, misses and evictions.
+    """
+    ...
+
 def get_filesize(path: Union[str, bytes]) -> int:
     """
     Get the size of a file in bytes.
@@ -24,12 +24,12 @@ def _install_mscompress_warning_formatter():
     warnings.formatwarning = _mscompress_formatwarning
 
 _install_mscompress_warning_formatter()
-cdef void _python_error_handler(const char* message) noexcept:
+cdef void _python_error_handler(const char* message) noexcept with gil:
     """Callback function to handle C errors in Python"""
     msg = message.decode('utf-8') if isinstance(message, bytes) else message
     warnings.warn(msg.strip(), RuntimeWarning, stacklevel=2)
 
-cdef void _python_warning_handler(const char* message) noexcept:
+cdef void _python_warning_handler(const char* message) noexcept with gil:
     """Callback function to handle C warnings in Python"""
     msg = message.decode('utf-8') if isinstance(message, bytes) else message
     warnings.warn(msg.strip(), RuntimeWarning, stacklevel=2)
@@ -38,6 +38,9 @@ cdef void _python_warning_handler(const char* message) noexcept:
 _set_error_callback(_python_error_handler)
 _set_warning_callback(_python_warning_handler)
 
+# Decompressed blocks shared by all open MSZ files
+cdef block_cache_t* _block_cache = _alloc_block_cache(<size_t>1e+9)
+
 cdef class RuntimeArguments:
     cdef Arguments _arguments
 
@@ -52,6 +55,9 @@ cdef class RuntimeArguments:
         self._arguments.target_mz_format = _ZSTD_compression_
         self._arguments.target_inten_format = _ZSTD_compression_
         self._arguments.zstd_compression_level = 3
+        self._arguments.frame_size = <long>256e+3
+        self._arguments.zlib_engine = _DEFLATE_ONESHOT
+        self._arguments.zlib_level = Z_DEFAULT_COMPRESSION
 
     cdef Arguments* get_ptr(self):
         return &self._arguments
@@ -74,6 +80,12 @@ cdef class RuntimeArguments:
         def __set__(self, value):
             self._arguments.blocksize = value
 
+    property frame_size:
+        def __get__(self):
+            return self._arguments.frame_size
+        def __set__(self, value):
+            self._arguments.frame_size = value
+
     property mz_scale_factor:
         def __get__(self):
             return self._arguments.mz_scale_factor
@@ -110,6 +122,12 @@ cdef class RuntimeArguments:
         def __set__(self, value):
             self._arguments.zstd_compression_level = value
 
+    property zlib_level:
+        def __get__(self):
+            return self._arguments.zlib_level
+        def __set__(self, value):
+            self._arguments.zlib_level = value
+
 
 cdef class DataBlock:
     cdef data_block_t _data_block
@@ -276,6 +294,8 @@ def read(path: Union[str, bytes]) -> Union[MZMLFile, MSZFile]:
     if filetype == 1: # mzML
         ret = MZMLFile(path, filesize, fd)
     elif filetype == 2: # msz
+        if _check_format_version(mapping):
+            raise OSError(f"Unsupported msz format version in {path}")
         ret = MSZFile(path, filesize, fd)
     else:
         raise OSError(f"Error processing file {path}")
@@ -318,7 +338,7 @@ cdef class MZMLFile(BaseFile):
     def get_mz_binary(self, size_t index):
         cdef char* dest = NULL
         cdef size_t out_len = 0
-        cdef data_block_t* tmp = _alloc_data_block(self._arguments.blocksize)
+        cdef data_block_t* tmp
         cdef char* mapping_ptr
         cdef size_t start, end
         cdef object mz_array
@@ -328,23 +348,25 @@ cdef class MZMLFile(BaseFile):
         start = self._positions.mz.start_positions[index]
         end = self._positions.mz.end_positions[index]
 
-        dest = <char*>malloc((end - start) * 2)
-        if not dest:
+        tmp = _alloc_data_block((end - start) * 2 + ZLIB_SIZE_OFFSET)
+        if not tmp:
             raise MemoryError("Failed to allocate memory for dest")
 
         mapping_ptr = <char*>self._mapping
         mapping_ptr += start
 
-        self._df.decode_source_compression_mz_fun(self._z, mapping_ptr, end - start, &dest, &out_len, tmp)
+        if self._df.decode_source_compression_mz_fun(self._z, mapping_ptr, end - start, tmp, &out_len) != 0:
+            _dealloc_data_block(tmp)
+            raise RuntimeError("Failed to decode binary")
 
-        dest += ZLIB_SIZE_OFFSET # Skip zlib header
+        dest = tmp.mem + ZLIB_SIZE_OFFSET # Skip zlib header
 
         if self._df.source_mz_fmt == _64d_:
             count = int((out_len - ZLIB_SIZE_OFFSET) / 8)
             double_ptr = <double*>dest
 
             if out_len > 0:
-                mz_array = np.asarray(<np.float64_t[:count]>double_ptr)
+                mz_array = np.array(<np.float64_t[:count]>double_ptr)
             else:
                 mz_array = np.array([], dtype=np.float64)
         elif self._df.source_mz_fmt == _32f_:
@@ -352,7 +374,7 @@ cdef class MZMLFile(BaseFile):
             float_ptr = <float*>dest
 
             if out_len > 0:
-                mz_array = np.asarray(<np.float32_t[:count]>float_ptr)
+                mz_array = np.array(<np.float32_t[:count]>float_ptr)
             else:
                 mz_array = np.array([], dtype=np.float32)
         else:
@@ -364,7 +386,7 @@ cdef class MZMLFile(BaseFile):
     def get_inten_binary(self, size_t index):
         cdef char* dest = NULL
         cdef size_t out_len = 0
-        cdef data_block_t* tmp = _alloc_data_block(self._arguments.blocksize)
+        cdef data_block_t* tmp
         cdef char* mapping_ptr
         cdef size_t start, end
         cdef object inten_array
@@ -374,23 +396,25 @@ cdef class MZMLFile(BaseFile):
         start = self._positions.inten.start_positions[index]
         end = self._positions.inten.end_positions[index]
 
-        dest = <char*>malloc((end - start) * 2)
-        if not dest:
+        tmp = _alloc_data_block((end - start) * 2 + ZLIB_SIZE_OFFSET)
+        if not tmp:
             raise MemoryError("Failed to allocate memory for dest")
 
         mapping_ptr = <char*>self._mapping
         mapping_ptr += start
 
-        self._df.decode_source_compression_inten_fun(self._z, mapping_ptr, end - start, &dest, &out_len, tmp)
+        if self._df.decode_source_compression_inten_fun(self._z, mapping_ptr, end - start, tmp, &out_len) != 0:
+            _dealloc_data_block(tmp)
+            raise RuntimeError("Failed to decode binary")
 
-        dest += ZLIB_SIZE_OFFSET # Skip zlib header
+        dest = tmp.mem + ZLIB_SIZE_OFFSET # Skip zlib header
 
         if self._df.source_inten_fmt == _64d_:
             count = int((out_len - ZLIB_SIZE_OFFSET) / 8)
             double_ptr = <double*>dest
 
             if out_len > 0:
-                inten_array = np.asarray(<np.float64_t[:count]>double_ptr)
+                inten_array = np.array(<np.float64_t[:count]>double_ptr)
             else:
                 inten_array = np.array([], dtype=np.float64)
         elif self._df.source_inten_fmt == _32f_:
@@ -398,7 +422,7 @@ cdef class MZMLFile(BaseFile):
             float_ptr = <float*>dest
 
             if out_len > 0:
-                inten_array = np.asarray(<np.float32_t[:count]>float_ptr)
+                inten_array = np.array(<np.float32_t[:count]>float_ptr)
             else:
                 inten_array = np.array([], dtype=np.float32)
         else:
@@ -434,6 +458,28 @@ cdef class MZMLFile(BaseFile):
 
         return element
 
+    def get_tic(self, int ms_level=1, int threads=0):
+        """
+        Computes the total ion current and base peak chromatograms of the
+        spectra of an MS level (every spectrum if 0). Intensity arrays of
+        spectra without TIC or base peak cvParams are decoded on `threads`
+        threads (all available threads if 0) with the GIL released.
+
+        Returns:
+        tuple: (indices, retention times, TIC, BPC, TIC computed, BPC
+        computed), where the last two flag the values decoded from the
+        intensity array rather than recorded in the file.
+        """
+        cdef tic_t* tic
+        cdef char* mapping = <char*>self._mapping
+        cdef long filesize = self.filesize
+
+        if threads <= 0:
+            threads = _get_num_threads()
+        with nogil:
+            tic = _compute_tic_mzml(mapping, filesize, ms_level, threads)
+        return _tic_to_numpy(tic)
+
 
 cdef class MSZFile(BaseFile):
     cdef footer_t* _footer
@@ -452,6 +498,15 @@ cdef class MSZFile(BaseFile):
         self._xml_block_lens = _read_block_len_queue(self._mapping, self._footer.xml_blk_pos, self._footer.mz_binary_blk_pos)
         self._mz_binary_block_lens = _read_block_len_queue(self._mapping, self._footer.mz_binary_blk_pos, self._footer.inten_binary_blk_pos)
         self._inten_binary_block_lens = _read_block_len_queue(self._mapping, self._footer.inten_binary_blk_pos, self._footer.divisions_t_pos)
+        cdef block_len_queue_t* frame_queues[3]
+        frame_queues[0] = self._xml_block_lens
+        frame_queues[1] = self._mz_binary_block_lens
+        frame_queues[2] = self._inten_binary_block_lens
+        _read_frame_index(self._mapping, self.filesize, frame_queues, 3)
+        _read_spectrum_index(self._mapping, self.filesize, frame_queues + 1, 2)
+        self._xml_block_lens.cache = _block_cache
+        self._mz_binary_block_lens.cache = _block_cache
+        self._inten_binary_block_lens.cache = _block_cache
         _set_decompress_runtime_variables(self._df, self._footer)
 
     @staticmethod
@@ -547,7 +602,10 @@ cdef class MSZFile(BaseFile):
         if res == NULL:
             raise ValueError(f"Failed to extract XML for index {index}")
 
-        result_str = res.decode('utf-8')
+        try:
+            result_str = res[:out_len].decode('utf-8')
+        finally:
+            free(res)
 
         element = fromstring(result_str)
 
@@ -595,7 +653,7 @@ cdef class BaseFile:
         self._mapping = _get_mapping(self._fd)
         self._spectra = None
         self._arguments = RuntimeArguments()
-        self._z = _alloc_z_stream()
+        self._z = _alloc_z_stream(NULL)
         self.output_fd = -1
 
 
@@ -853,6 +911,270 @@ cdef class Spectrum:
                 raise ValueError(f"Mismatch in array lengths: mz has {len(mz)} elements, intensity has {len(intensity)} elements for spectrum {self.index}")
             return np.column_stack((mz, intensity))
 
+# Metadata columns of an msz file: name -> (column, dtype).
+_METADATA_COLUMNS = {
+    "precursor_mz": (_METADATA_PRECURSOR_MZ, np.float64),
+    "charge": (_METADATA_CHARGE, np.uint16),
+    "tic": (_METADATA_TIC, np.float32),
+    "base_peak_mz": (_METADATA_BASE_PEAK_MZ, np.float64),
+    "base_peak_intensity": (_METADATA_BASE_PEAK_INTENSITY, np.float32),
+    "isolation_target": (_METADATA_ISOLATION_TARGET, np.float64),
+    "isolation_lower": (_METADATA_ISOLATION_LOWER, np.float32),
+    "isolation_upper": (_METADATA_ISOLATION_UPPER, np.float32),
+}
+
+cdef class MSZReader:
+    """
+    Random access reader of an MSZ file that can be shared by several threads.
+    Extraction releases the GIL, and a block requested by several threads at
+    once is decompressed a single time.
+
+    Parameters:
+    path (Union[str, bytes]): Path to the MSZ file.
+    cache_size (int): Bytes of decompressed blocks kept by the reader, 0 for no limit.
+    """
+    cdef msz_reader_t* _reader
+
+    def __init__(self, path: Union[str, bytes], long cache_size=1000000000):
+        if isinstance(path, str):
+            path = path.encode('utf-8')
+        self._reader = _open_msz_reader(path, cache_size)
+        if self._reader == NULL:
+            raise IOError(f"Failed to open {path}")
+
+    def __dealloc__(self):
+        if self._reader != NULL:
+            _close_msz_reader(self._reader)
+            self._reader = NULL
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.close()
+
+    def __len__(self):
+        self._check_open()
+        return _msz_reader_num_spectra(self._reader)
+
+    cdef _check_open(self):
+        if self._reader == NULL:
+            raise ValueError("MSZReader is closed")
+
+    def close(self):
+        """
+        Releases the file and its cached blocks. The reader must not be in use
+        by another thread.
+        """
+        if self._reader != NULL:
+            _close_msz_reader(self._reader)
+            self._reader = NULL
+
+    def get_spectrum(self, long index) -> str:
+        """
+        Returns the <spectrum> element of a spectrum.
+        """
+        cdef char* res
+        cdef size_t out_len = 0
+
+        self._check_open()
+        with nogil:
+            res = _msz_reader_get_spectrum(self._reader, index, &out_len)
+        if res == NULL:
+            raise ValueError(f"Failed to extract spectrum {index}")
+        try:
+            return res[:out_len].decode('utf-8')
+        finally:
+            free(res)
+
+    cdef _get_binary(self, int array_type, long index, uint32_t fmt, bint chromatogram=False):
+        cdef char* res
+        cdef size_t out_len = 0
+        cdef np.ndarray arr
+
+        self._check_open()
+        with nogil:
+            if chromatogram:
+                res = _msz_reader_get_chromatogram(self._reader, array_type, index, &out_len)
+            else:
+                res = _msz_reader_get_binary(self._reader, array_type, index, &out_len)
+        if res == NULL:
+            raise ValueError(f"Failed to extract binary for index {index}")
+
+        dtype = np.float64 if fmt == _64d_ else np.float32
+        arr = np.empty(out_len // np.dtype(dtype).itemsize, dtype=dtype)
+        memcpy(np.PyArray_DATA(arr), res, arr.nbytes)
+        free(res)
+        return arr
+
+    def get_mz(self, long index) -> np.ndarray:
+        """
+        Returns the m/z array of a spectrum.
+        """
+        self._check_open()
+        return self._get_binary(_mass_, index, _msz_reader_df(self._reader).source_mz_fmt)
+
+    def get_inten(self, long index) -> np.ndarray:
+        """
+        Returns the intensity array of a spectrum.
+        """
+        self._check_open()
+        return self._get_binary(_intensity_, index, _msz_reader_df(self._reader).source_inten_fmt)
+
+    def get_metadata(self, str name):
+        """
+        Returns a metadata column, one value per spectrum, without
+        decompressing any XML. Missing values are NaN (0 for charge).
+
+        Parameters:
+        name (str): One of precursor_mz, charge, tic, base_peak_mz,
+        base_peak_intensity, isolation_target, isolation_lower or
+        isolation_upper.
+
+        Returns:
+        np.ndarray: The column, or None if the file does not store it.
+        """
+        cdef void* col
+        cdef np.ndarray arr
+
+        self._check_open()
+        if name not in _METADATA_COLUMNS:
+            raise KeyError(f"Unknown metadata column {name}")
+        column, dtype = _METADATA_COLUMNS[name]
+        col = _msz_reader_metadata_column(self._reader, column)
+        if col == NULL:
+            return None
+        arr = np.empty(_msz_reader_num_spectra(self._reader), dtype=dtype)
+        memcpy(np.PyArray_DATA(arr), col, arr.nbytes)
+        return arr
+
+    @property
+    def num_chromatograms(self) -> int:
+        """
+        Number of chromatograms whose arrays can be read with
+        get_chromatogram(), 0 if the file stores chromatograms as XML.
+        """
+        self._check_open()
+        return _msz_reader_num_chromatograms(self._reader)
+
+    def get_chromatogram(self, long index):
+        """
+        Returns the time and intensity arrays of a chromatogram, decoded
+        without decompressing any XML.
+
+        Returns:
+        tuple: (time, intensity).
+        """
+        cdef data_format_t* df
+
+        self._check_open()
+        df = _msz_reader_chromatogram_df(self._reader)
+        if df == NULL:
+            raise ValueError("File has no chromatogram arrays")
+        return (self._get_binary(_time_, index, df.source_mz_fmt, True),
+                self._get_binary(_intensity_, index, df.source_inten_fmt, True))
+
+    def get_xic(self, mz, double ppm=10.0, int threads=0):
+        """
+        Computes the extracted-ion chromatogram of each target m/z over the
+        MS1 spectra. Spectra are decoded on `threads` threads (all available
+        threads if 0) with the GIL released.
+
+        Parameters:
+        mz (Sequence[float]): Target m/z values.
+        ppm (float): Half width of each window in ppm of its m/z.
+        threads (int): Number of threads.
+
+        Returns:
+        tuple: (indices, retention times, intensities), where intensities has
+        one row per target and one column per MS1 spectrum.
+        """
+        cdef np.ndarray targets = np.ascontiguousarray(mz, dtype=np.float64).ravel()
+        cdef double* targets_ptr = <double*>np.PyArray_DATA(targets)
+        cdef long n_targets = targets.shape[0]
+        cdef xic_t* xic
+        cdef np.ndarray indices, ret_times, intensities
+
+        self._check_open()
+        if threads <= 0:
+            threads = _get_num_threads()
+        with nogil:
+            xic = _extract_xic(self._reader, targets_ptr, n_targets, ppm, threads)
+        if xic == NULL:
+            raise ValueError("Failed to extract XIC")
+
+        indices = np.empty(xic.n_scans, dtype=np.int64)
+        ret_times = np.empty(xic.n_scans, dtype=np.float32)
+        intensities = np.empty((xic.n_targets, xic.n_scans), dtype=np.float64)
+        memcpy(np.PyArray_DATA(indices), xic.indices, indices.nbytes)
+        memcpy(np.PyArray_DATA(ret_times), xic.ret_times, ret_times.nbytes)
+        memcpy(np.PyArray_DATA(intensities), xic.intensities, intensities.nbytes)
+        _dealloc_xic(xic)
+        return indices, ret_times, intensities
+
+    def get_tic(self, int ms_level=1, int threads=0):
+        """
+        Computes the total ion current and base peak chromatograms of the
+        spectra of an MS level (every spectrum if 0). TIC and base peak
+        intensities stored as metadata are used as is, the other spectra are
+        decoded on `threads` threads (all available threads if 0) with the GIL
+        released.
+
+        Returns:
+        tuple: (indices, retention times, TIC, BPC, TIC computed, BPC
+        computed), where the last two flag the values decoded from the
+        intensity array rather than recorded in the file.
+        """
+        cdef tic_t* tic
+
+        self._check_open()
+        if threads <= 0:
+            threads = _get_num_threads()
+        with nogil:
+            tic = _compute_tic_msz(self._reader, ms_level, threads)
+        return _tic_to_numpy(tic)
+
+    def get_cache_stats(self) -> dict:
+        """
+        Returns the statistics of the reader's block cache.
+
+        Returns:
+        dict: limit, used, hits, misses and evictions.
+        """
+        cdef block_cache_t* cache
+
+        self._check_open()
+        cache = _msz_reader_cache(self._reader)
+        return {
+            "limit": cache.limit,
+            "used": cache.used,
+            "hits": cache.hits,
+            "misses": cache.misses,
+            "evictions": cache.evictions,
+        }
+
+
+cdef _tic_to_numpy(tic_t* tic):
+    cdef np.ndarray indices, ret_times, tic_arr, bpc_arr, computed
+
+    if tic == NULL:
+        raise ValueError("Failed to compute TIC")
+
+    indices = np.empty(tic.n_spectra, dtype=np.int64)
+    ret_times = np.empty(tic.n_spectra, dtype=np.float32)
+    tic_arr = np.empty(tic.n_spectra, dtype=np.float64)
+    bpc_arr = np.empty(tic.n_spectra, dtype=np.float64)
+    computed = np.empty(tic.n_spectra, dtype=np.uint8)
+    memcpy(np.PyArray_DATA(indices), tic.indices, indices.nbytes)
+    memcpy(np.PyArray_DATA(ret_times), tic.ret_times, ret_times.nbytes)
+    memcpy(np.PyArray_DATA(tic_arr), tic.tic, tic_arr.nbytes)
+    memcpy(np.PyArray_DATA(bpc_arr), tic.bpc, bpc_arr.nbytes)
+    memcpy(np.PyArray_DATA(computed), tic.computed, computed.nbytes)
+    _dealloc_tic(tic)
+    return (indices, ret_times, tic_arr, bpc_arr,
+            (computed & _TIC_COMPUTED) != 0, (computed & _BPC_COMPUTED) != 0)
+
+
 def get_num_threads() -> int:
     """
     Simple function to return current amount of threads on system.
@@ -862,6 +1184,31 @@ def get_num_threads() -> int:
     """
     return _get_num_threads()
 
+def set_cache_size(size_t size):
+    """
+    Sets the amount of decompressed blocks kept in memory across all open MSZ
+    files. Least recently used blocks are released past this size.
+
+    Parameters:
+    size (int): Cache size in bytes, 0 for no limit.
+    """
+    _set_block_cache_limit(_block_cache, size)
+
+def get_cache_stats() -> dict:
+    """
+    Returns the decompressed block cache statistics.
+
+    Returns:
+    dict: limit, used, hits, misses and evictions.
+    """
+    return {
+        "limit": _block_cache.limit,
+        "used": _block_cache.used,
+        "hits": _block_cache.hits,
+        "misses": _block_cache.misses,
+        "evictions": _block_cache.evictions,
+    }
+
 def get_filesize(path: Union[str, bytes]) -> int:
     """
     Simple function to get filesize of file.
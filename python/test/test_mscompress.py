@@ -4,7 +4,8 @@ import pytest
 import numpy as np
 import time
 from xml.etree.ElementTree import Element
-from mscompress import get_num_threads, get_filesize, MZMLFile, MSZFile, BaseFile, DataFormat, Division, read, Spectra, Spectrum, DataPositions, RuntimeArguments
+from concurrent.futures import ThreadPoolExecutor
+from mscompress import get_num_threads, get_filesize, MZMLFile, MSZFile, BaseFile, DataFormat, Division, read, Spectra, Spectrum, DataPositions, RuntimeArguments, MSZReader, set_cache_size, get_cache_stats
 
 
 test_mzml_data = [
@@ -392,4 +393,123 @@ def test_mzml_arguments_threads(mzml_file):
 def test_mzml_arguments_zstd_level(mzml_file):
     mzml = read(mzml_file)
     mzml.arguments.zstd_compression_level = 1
-    assert mzml.arguments.zstd_compression_level == 1
\ No newline at end of file
+    assert mzml.arguments.zstd_compression_level == 1
+
+
+@pytest.mark.parametrize("msz_file", test_msz_data)
+def test_msz_decompress_zlib_level(msz_file, tmp_path):
+    default_out = tmp_path / "default.mzML"
+    level_out = tmp_path / "level1.mzML"
+    read(msz_file).decompress(str(default_out))
+    msz = read(msz_file)
+    assert msz.arguments.zlib_level == -1
+    msz.arguments.zlib_level = 1
+    msz.decompress(str(level_out))
+    # Settings apply to one file only, the default output is unchanged.
+    read(msz_file).decompress(str(tmp_path / "again.mzML"))
+    assert (tmp_path / "again.mzML").read_bytes() == default_out.read_bytes()
+    assert level_out.read_bytes() != default_out.read_bytes()
+
+
+@pytest.mark.parametrize("msz_file", test_msz_data)
+def test_msz_reader_random_access(msz_file):
+    msz = read(msz_file)
+    with MSZReader(msz_file) as reader:
+        assert len(reader) == len(msz.spectra)
+        indices = np.random.default_rng(0).permutation(len(reader))
+        for i in indices:
+            spectrum = msz.spectra[int(i)]
+            assert np.array_equal(reader.get_mz(int(i)), spectrum.mz)
+            assert np.array_equal(reader.get_inten(int(i)), spectrum.intensity)
+
+
+@pytest.mark.parametrize("msz_file", test_msz_data)
+def test_msz_reader_concurrent(msz_file):
+    with MSZReader(msz_file) as reader:
+        expected = [reader.get_mz(i).sum() + reader.get_inten(i).sum() for i in range(len(reader))]
+
+    # Threads share one reader, and a second reader runs alongside it.
+    with MSZReader(msz_file, cache_size=0) as shared, MSZReader(msz_file) as other:
+        def extract(i):
+            r = shared if i % 2 == 0 else other
+            return r.get_mz(i).sum() + r.get_inten(i).sum()
+
+        indices = list(np.random.default_rng(0).permutation(len(shared))) * 4
+        with ThreadPoolExecutor(max_workers=8) as pool:
+            results = list(pool.map(lambda i: extract(int(i)), indices))
+
+    for i, result in zip(indices, results):
+        assert result == expected[int(i)]
+
+
+@pytest.mark.parametrize("msz_file", test_msz_data)
+def test_msz_reader_cache_stats(msz_file):
+    with MSZReader(msz_file, cache_size=0) as reader:
+        reader.get_mz(0)
+        reader.get_mz(0)
+        stats = reader.get_cache_stats()
+        assert stats["limit"] == 0
+        assert stats["misses"] >= 1
+        assert stats["hits"] >= 1
+        assert stats["used"] > 0
+        assert stats["evictions"] == 0
+
+    with MSZReader(msz_file, cache_size=1) as reader:
+        for i in range(len(reader)):
+            reader.get_mz(i)
+            reader.get_inten(i)
+        stats = reader.get_cache_stats()
+        assert stats["evictions"] > 0
+
+
+@pytest.mark.parametrize("msz_file", test_msz_data)
+def test_set_cache_size(msz_file):
+    set_cache_size(1)
+    try:
+        msz = read(msz_file)
+        for spectrum in msz.spectra:
+            spectrum.mz
+        stats = get_cache_stats()
+        assert stats["limit"] == 1
+        assert stats["evictions"] > 0
+    finally:
+        set_cache_size(0)
+    assert get_cache_stats()["limit"] == 0
+
+
+@pytest.mark.parametrize("msz_file", test_msz_data)
+def test_msz_reader_get_xic(msz_file):
+    msz = read(msz_file)
+    ms1 = [s for s in msz.spectra if s.ms_level == 1]
+    target = float(ms1[0].mz[np.argmax(ms1[0].intensity)])
+    ppm = 10.0
+    lo, hi = target - target * ppm * 1e-6, target + target * ppm * 1e-6
+
+    with MSZReader(msz_file) as reader:
+        indices, ret_times, intensities = reader.get_xic([target], ppm=ppm, threads=2)
+
+    assert list(indices) == [s.index for s in ms1]
+    assert intensities.shape == (1, len(ms1))
+    for column, spectrum in enumerate(ms1):
+        mz, inten = spectrum.mz, spectrum.intensity
+        expected = inten[(mz >= lo) & (mz <= hi)].sum(dtype=np.float64)
+        assert intensities[0, column] == pytest.approx(expected)
+    assert intensities[0, 0] > 0
+
+
+@pytest.mark.parametrize("msz_file", test_msz_data)
+def test_msz_reader_get_tic(msz_file):
+    msz = read(msz_file)
+    ms1 = [s for s in msz.spectra if s.ms_level == 1]
+
+    with MSZReader(msz_file) as reader:
+        indices, ret_times, tic, bpc, tic_computed, bpc_computed = reader.get_tic(ms_level=1, threads=2)
+
+    assert list(indices) == [s.index for s in ms1]
+    for i, spectrum in enumerate(ms1):
+        inten = spectrum.intensity
+        if tic_computed[i]:
+            assert tic[i] == pytest.approx(inten.sum(dtype=np.float64))
+        if bpc_computed[i]:
+            assert bpc[i] == pytest.approx(float(inten.max()) if inten.size else 0.0)
+        assert tic[i] >= bpc[i]
@@ -9,3288 +9,901 @@
 #include "mscompress.h"
 
 /*
-    @section Decoding functions
+    @section Bit streams
 */
 
+/* Bit streams of the vbr and bitpack transforms store fields least
+ * significant bit first, starting at bit 0 of the first byte. Readers and
+ * writers move 32 bits at a time through a 64-bit accumulator. */
 
-/** 
- * @brief Lossless decoding function.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_lossless(void* args)
-{
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_lossless: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, a_args->dest,
-                   a_args->dest_len, a_args->tmp);
-
-   /* Lossless, don't touch anything */
-
-   return;
-}
-
-/**
- * @brief cast 64-bit double to 32-bit float.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_cast32_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_cast32_64d: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_decode_cast32_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   float* res;
-
-   len = decoded_len / sizeof(double);
-   res = malloc(
-       (len + 1) *
-       sizeof(float));  // Allocate space for result and leave room for header
-
-   if (res == NULL) {
-      error("algo_decode_cast32_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   double* f = (double*)(decoded);
-   for (int i = 1; i < len + 1; i++) {
-      res[i] = (float)f[i - 1];
-   }
-
-   // Store length of array in first 4 bytes
-   res[0] = (float)len;
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = (len + 1) * sizeof(float);
-
-   return;
-}
-
-
-/**
- * @brief cast 32-bit float to 16-bit unsigned integer.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_cast16_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_cast16_32f: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_decode_cast16_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint16_t* res;
-
-   len = decoded_len / sizeof(float);
-
-   res = calloc(1, (len * sizeof(uint16_t)) +
-                       sizeof(uint16_t));  // Allocate space for result and
-                                           // leave room for header
-
-   if (res == NULL) {
-      error("algo_decode_cast16_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   uint16_t* tmp = res + 1;  // Skip header
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   float* f = (float*)(decoded);
-
-   uint64_t uint_tmp;
-   for (int i = 0; i < len; i++) {
-      uint_tmp = (uint64_t)(f[i] * a_args->scale_factor);
-      if (uint_tmp > UINT16_MAX)
-         tmp[i] = UINT16_MAX;
-      else
-         tmp[i] = uint_tmp;
-   }
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = (len * sizeof(uint16_t)) + sizeof(uint16_t);
-
-   return;
-}
-
-
-/**
- * @brief cast 64-bit double to 16-bit unsigned integer.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_cast16_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_cast16_64d: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_decode_cast16_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint16_t* res;
-
-   len = decoded_len / sizeof(double);
-
-   res = calloc(1, (len * sizeof(uint16_t)) +
-                       sizeof(uint16_t));  // Allocate space for result and
-                                           // leave room for header
-
-   if (res == NULL) {
-      error("algo_decode_cast16_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-   
-   uint16_t* tmp = res + 1;  // Skip header
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   double* f = (double*)(decoded);
-
-   uint64_t uint_tmp;
-   for (int i = 0; i < len; i++) {
-      uint_tmp = (uint64_t)(f[i] * a_args->scale_factor);
-      if (uint_tmp > UINT16_MAX)
-         tmp[i] = UINT16_MAX;
-      else
-         tmp[i] = uint_tmp;
-   }
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = (len * sizeof(uint16_t)) + sizeof(uint16_t);
-
-   return;
-}
-
-/**
- * @brief Log2 transform decoding function for 32-bit floats.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_log_2_transform_32f(void* args)
-{
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_log_2_transform_32f: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_decode_log_2_transform_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint16_t* res;
-
-   len = decoded_len / sizeof(float);
-
-   size_t res_len = (len + 1) * sizeof(uint16_t);
-
-   // Perform log2 transform
-   res = calloc(1, res_len);  // Allocate space for result and leave room for header
-
-   if (res == NULL) {
-      error("algo_decode_log_2_transform_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   double ltran;
-
-   float* f = (float*)(decoded);
-   uint16_t* tmp = (uint16_t*)(res + 1);  // Ignore header in first 4 bytes
-
-   for (int i = 0; i < len; i++) {
-      ltran = log2(f[i] + 1);  // Add 1 to avoid log2(0) = -inf
-      tmp[i] = floor(ltran * a_args->scale_factor);
-   }
-
-   // Free decoded buffer
-   free(decoded);
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = res_len;
-
-   return;
-}
-
-/**
- * @brief Log2 transform decoding function for 64-bit doubles.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_log_2_transform_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_log_2_transform_64d: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_decode_log_2_transform_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint16_t* res;
-
-   len = decoded_len / sizeof(double);
-
-   // Perform log2 transform
-   res = malloc(
-       (len + 1) *
-       sizeof(
-           uint16_t));  // Allocate space for result and leave room for header
-
-   if (res == NULL) {
-      error("algo_decode_log_2_transform_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   double ltran;
-
-   double* f = (double*)(decoded);
-   uint16_t* tmp = (uint16_t*)(res + 1);  // Ignore header in first 4 bytes
-
-   for (int i = 0; i < len; i++) {
-      ltran = log2(f[i] + 1);  // Add 1 to avoid log2(0) = -inf
-      tmp[i] = floor(ltran * a_args->scale_factor);
-   }
-
-   // Free decoded buffer
-   free(decoded);
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = (len + 1) * sizeof(uint16_t);
-
-   return;
-}
-
-
-/**
- * @brief Delta transform decoding function for 32-bit floats.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_delta16_transform_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_delta16_transform_32f: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_decode_delta16_transform_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint16_t* res;
-
-   len = decoded_len / sizeof(float);
-
-   size_t res_len = (len * sizeof(uint16_t)) + sizeof(uint16_t) + sizeof(float);
-
-   // Perform delta transform
-   res = calloc(1, res_len);  // Allocate space for result and leave room for
-                              // header and first value
-
-   if (res == NULL) {
-      error("algo_decode_delta16_transform_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   float* f = (float*)(decoded);
-   uint16_t* tmp = (uint16_t*)(res + 1);  // Ignore header in first 4 bytes
-
-   // Store first value with full 32-bit precision
-   //  *(float*)&res[0] = f[0];
-   memcpy(tmp, f, sizeof(float));
-
-   tmp += 2;  // Move pointer to next value
-
-   // Perform delta transform
-   float diff;
-   uint16_t uint_diff;
-   for (int i = 1; i < len; i++) {
-      diff = f[i] - f[i - 1];
-      uint_diff =
-          (uint16_t)floor(diff * a_args->scale_factor);  // scale by 2^16 / 10
-      tmp[i - 1] = uint_diff;
-   }
-
-   // Free decoded buffer
-   free(decoded);
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = res_len;
-
-   return;
-}
-
-
-/**
- * @brief Delta transform decoding function for 64-bit doubles.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_delta16_transform_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_delta16_transform_64d: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_decode_delta16_transform_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint16_t* res;
-
-   len = decoded_len / sizeof(double);
-
-   size_t res_len =
-       (len * sizeof(uint16_t)) + sizeof(uint16_t) + sizeof(double);
-
-   // Perform delta transform
-   res = malloc(res_len);  // Allocate space for result and leave room for
-                           // header and first value
-
-   if (res == NULL) {
-      error("algo_decode_delta16_transform_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   double* f = (double*)(decoded);
-   uint16_t* tmp = (uint16_t*)(res + 1);  // Ignore header in first 4 bytes
-
-   // Store first value with full 32-bit precision
-   //  *(float*)&res[0] = f[0];
-   memcpy(tmp, f, sizeof(double));
-
-   tmp += 4;  // Move pointer to next value
-
-   // Perform delta transform
-   float diff;
-   uint16_t uint_diff;
-   for (int i = 1; i < len; i++) {
-      diff = f[i] - f[i - 1];
-      if (diff * a_args->scale_factor > UINT16_MAX) {
-         // print("algo_decode_delta16_transform_64d: CLIPPING. diff: %0.4f,
-         // scale_factor*diff: %0.4f\n", diff, diff*a_args->scale_factor);
-         uint_diff = UINT16_MAX;
-      } else
-         uint_diff = (uint16_t)floor(
-             diff * a_args->scale_factor);  // scale by 2^16 / 10
-      tmp[i - 1] = uint_diff;
-   }
-
-   // Free decoded buffer
-   free(decoded);
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = res_len;
-
-   return;
-}
-
-
-/**
- * @brief Delta transform decoding function for 32-bit floats with 24-bit unsigned integer deltas.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_delta24_transform_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_delta24_transform_32f: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_decode_delta24_transform_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint16_t* res;
-
-   len = decoded_len / sizeof(float);
-
-   size_t res_len =
-       (len * 3 * sizeof(uint8_t)) + sizeof(uint16_t) + sizeof(float);
-
-   // Perform delta transform
-   res = calloc(res_len, 1);  // Allocate space for result and leave room for
-                              // header and first value
-
-   if (res == NULL) {
-      error("algo_decode_delta24_transform_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   float* f = (float*)(decoded);
-   uint16_t* tmp = (uint16_t*)(res + 1);  // Ignore header in first 4 bytes
-
-   // Store first value with full 32-bit precision
-   //  *(float*)&res[0] = f[0];
-   memcpy(tmp, f, sizeof(float));
-
-   tmp += 2;  // Move pointer to next value
-
-   uint8_t* dest = (uint8_t*)tmp;
-
-   // Perform delta transform
-   float diff;
-   uint32_t uint_diff;
-
-   int index = 0;  // index within dest
-
-   for (int i = 1; i < len; i++) {
-      diff = f[i] - f[i - 1];
-      if (floor(diff * a_args->scale_factor) > 16777215)  // UINT24 max
-         uint_diff = 16777215;
-      else
-         uint_diff = (uint32_t)floor(diff * a_args->scale_factor);
-      dest[index * 3] = (uint_diff >> 16) & 0xFF;
-      dest[index * 3 + 1] = (uint_diff >> 8) & 0xFF;
-      dest[index * 3 + 2] = (uint_diff) & 0xFF;
-      index++;
-   }
-
-   // Free decoded buffer
-   free(decoded);
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = res_len;
-
-   return;
-}
-
-
-/**
- * @brief Delta transform decoding function for 64-bit doubles with 24-bit unsigned integer deltas.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_delta24_transform_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_delta24_transform_64d: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_decode_delta24_transform_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint16_t* res;
-
-   len = decoded_len / sizeof(double);
-
-   size_t res_len =
-       (len * 3 * sizeof(uint8_t)) + sizeof(uint16_t) + sizeof(double);
-
-   // Perform delta transform
-   res = calloc(res_len, 1);  // Allocate space for result and leave room for
-                              // header and first value
-
-   if (res == NULL) {
-      error("algo_decode_delta24_transform_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   double* f = (double*)(decoded);
-   uint16_t* tmp = (uint16_t*)(res + 1);  // Ignore header in first 4 bytes
-
-   // Store first value with full 32-bit precision
-   //  *(float*)&res[0] = f[0];
-   memcpy(tmp, f, sizeof(double));
-
-   tmp += 4;  // Move pointer to next value
-
-   uint8_t* dest = (uint8_t*)tmp;
-
-   // Perform delta transform
-   float diff;
-   uint32_t uint_diff;
-
-   int index = 0;  // index within dest
-
-   for (int i = 1; i < len; i++) {
-      diff = f[i] - f[i - 1];
-      if (floor(diff * a_args->scale_factor) > 16777215)  // UINT24 max
-         uint_diff = 16777215;
-      else
-         uint_diff = (uint32_t)floor(diff * a_args->scale_factor);
-      dest[index * 3] = (uint_diff >> 16) & 0xFF;
-      dest[index * 3 + 1] = (uint_diff >> 8) & 0xFF;
-      dest[index * 3 + 2] = (uint_diff) & 0xFF;
-      index++;
-   }
-
-   // Free decoded buffer
-   free(decoded);
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = res_len;
-
-   return;
-}
-
-/**
- * @brief Delta transform decoding function for 32-bit floats with 32-bit unsigned integer deltas.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_delta32_transform_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_delta32_transform_32f: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_decode_delta32_transform_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint32_t* res;
-
-
-   len = decoded_len / sizeof(float);
-
-   size_t res_len = (len * sizeof(uint32_t)) + sizeof(uint16_t) + sizeof(float);
-
-   // Perform delta transform
-   res = calloc(1, res_len);  // Allocate space for result and leave room for
-                              // header and first value
-
-   if (res == NULL) {
-      error("algo_decode_delta32_transform_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   float* f = (float*)(decoded);
-   uint32_t* tmp =
-       (uint32_t*)((uint8_t*)res + 2);  // Ignore header in first 4 bytes
-
-   // Store first value with full 32-bit precision
-   //  *(float*)&res[0] = f[0];
-   memcpy(tmp, f, sizeof(float));
-
-   // Perform delta transform
-   for (int i = 1; i < len; i++) {
-      float diff = f[i] - f[i - 1];
-      // uint16_t uint_diff = (diff > 0) ? (uint16_t)floor(diff) : 0; // clamp
-      // to 0 if diff is negative
-      uint32_t uint_diff =
-          (uint32_t)floor(diff * a_args->scale_factor);  // scale by 2^16 / 10
-      tmp[i] = uint_diff;
-   }
-
-   // Free decoded buffer
-   free(decoded);
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = res_len;
-
-   return;
-}
-
-/**
- * @brief Delta transform decoding function for 64-bit doubles with 32-bit unsigned integer deltas.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_delta32_transform_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_delta32_transform_64d: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_decode_delta32_transform_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint32_t* res;
-
-   len = decoded_len / sizeof(double);
-
-   size_t res_len =
-       (len * sizeof(uint32_t)) + sizeof(uint16_t) + sizeof(double);
-
-   // Perform delta transform
-   res = calloc(1, res_len);  // Allocate space for result and leave room for
-                              // header and first value
-
-   if (res == NULL) {
-      error("algo_decode_delta32_transform_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   double* f = (double*)(decoded);
-   uint32_t* tmp =
-       (uint32_t*)((uint8_t*)res + 2);  // Ignore header in first 4 bytes
-
-   // Store first value with full 32-bit precision
-   //  *(float*)&res[0] = f[0];
-   memcpy(tmp, f, sizeof(double));
-
-   tmp = (uint32_t*)((uint8_t*)tmp + sizeof(double));
-
-   // Perform delta transform
-   for (int i = 1; i < len; i++) {
-      float diff = f[i] - f[i - 1];
-      // uint16_t uint_diff = (diff > 0) ? (uint16_t)floor(diff) : 0; // clamp
-      // to 0 if diff is negative
-      uint32_t uint_diff =
-          (uint32_t)floor(diff * a_args->scale_factor);  // scale by 2^16 / 10
-      tmp[i - 1] = uint_diff;
-   }
-
-   // Free decoded buffer
-   free(decoded);
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = res_len;
-
-   return;
-}
-
-/**
- * @brief Delta transform decoding function for 32-bit floats with 16-bit unsigned integer deltas.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_vdelta16_transform_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_vdelta16_transform_32f: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_decode_vdelta16_transform_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint16_t* res;
-
-   len = decoded_len / sizeof(float);
-
-   size_t res_len = (len * sizeof(uint16_t)) + sizeof(uint16_t) +
-                    sizeof(float) + sizeof(float);
-
-   // Perform delta transform
-   res = calloc(1, res_len);  // Allocate space for result and leave room for
-                              // header and first value
-
-   if (res == NULL) {
-      error("algo_decode_vdelta16_transform_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   float* f = (float*)(decoded);
-   uint16_t* tmp = (uint16_t*)(res + 1);  // Ignore header in first 4 bytes
-
-   float* diff_arr = (float*)malloc(len * sizeof(float));
-   diff_arr[0] = f[0];
-
-   double diff_max = 0;
-
-   for (int i = 1; i < len; i++) {
-      diff_arr[i] = f[i] - f[i - 1];
-      if (diff_arr[i] > diff_max)
-         diff_max = diff_arr[i];
-   }
-
-   float scale_factor = UINT16_MAX / (float)diff_max;
-
-   // Store first value with 32-bit precision
-
-   float starting = (float)f[0];
-   memcpy(tmp, &starting, sizeof(float));
-
-   tmp += 2;  // Move pointer to next value
-
-   // Store scale_factor in next 4 bytes
-   memcpy(tmp, &scale_factor, sizeof(float));
-
-   tmp += 2;  // Move pointer to next value
-
-   // Perform delta transform
-
-   uint16_t uint_diff;
-   for (int i = 1; i < len; i++) {
-      uint_diff = (uint16_t)floor(diff_arr[i] * scale_factor);
-      tmp[i - 1] = uint_diff;
-   }
-
-   // Free decoded buffer
-   free(decoded);
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = res_len;
-
-   return;
-}
-
-/**
- * @brief Delta transform decoding function for 64-bit doubles with 16-bit unsigned integer deltas.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_vdelta16_transform_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_vdelta16_transform_64d: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_decode_vdelta16_transform_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint16_t* res;
-
-   len = decoded_len / sizeof(double);
-
-   size_t res_len = (len * sizeof(uint16_t)) + sizeof(uint16_t) +
-                    sizeof(float) + sizeof(float);
-
-   // Perform delta transform
-   res = calloc(1, res_len);  // Allocate space for result and leave room for
-                              // header and first value
-
-   if (res == NULL) {
-      error("algo_decode_vdelta16_transform_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   double* f = (double*)(decoded);
-   uint16_t* tmp = (uint16_t*)(res + 1);  // Ignore header in first 4 bytes
-
-   double* diff_arr = (double*)malloc(len * sizeof(double));
-   diff_arr[0] = f[0];
-
-   double diff_max = 0;
-
-   for (int i = 1; i < len; i++) {
-      diff_arr[i] = f[i] - f[i - 1];
-      if (diff_arr[i] > diff_max)
-         diff_max = diff_arr[i];
-   }
-
-   float scale_factor = UINT16_MAX / (float)diff_max;
-
-   // Store first value with 32-bit precision
-
-   float starting = (float)f[0];
-   memcpy(tmp, &starting, sizeof(float));
-
-   tmp += 2;  // Move pointer to next value
-
-   // Store scale_factor in next 4 bytes
-   memcpy(tmp, &scale_factor, sizeof(float));
-
-   tmp += 2;  // Move pointer to next value
-
-   // Perform delta transform
-
-   uint16_t uint_diff;
-   for (int i = 1; i < len; i++) {
-      uint_diff = (uint16_t)floor(diff_arr[i] * scale_factor);
-      tmp[i - 1] = uint_diff;
-   }
-
-   // Free decoded buffer
-   free(decoded);
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = res_len;
-
-   return;
-}
-
-
-/**
- * @brief Delta transform decoding function for 32-bit floats with 24-bit unsigned integer deltas.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_vdelta24_transform_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_vdelta24_transform_32f: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_decode_vdelta24_transform_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint16_t* res;
-
-   len = decoded_len / sizeof(float);
-
-   size_t res_len = (len * 3 * sizeof(uint8_t)) + sizeof(uint16_t) +
-                    sizeof(float) + sizeof(float);
-
-   // Perform delta transform
-   res = calloc(1, res_len);  // Allocate space for result and leave room for
-                              // header and first value
-
-   if (res == NULL) {
-      error("algo_decode_vdelta24_transform_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   float* f = (float*)(decoded);
-   uint16_t* tmp = (uint16_t*)(res + 1);  // Ignore header in first 4 bytes
-
-   double* diff_arr = (double*)malloc(len * sizeof(double));
-   diff_arr[0] = f[0];
-
-   double diff_max = 0;
-
-   for (int i = 1; i < len; i++) {
-      diff_arr[i] = f[i] - f[i - 1];
-      if (diff_arr[i] > diff_max)
-         diff_max = diff_arr[i];
-   }
-
-   float scale_factor = 16777215 / (float)diff_max;  // UINT24_MAX
-
-   // Store first value with 32-bit precision
-
-   float starting = (float)f[0];
-   memcpy(tmp, &starting, sizeof(float));
-
-   tmp += 2;  // Move pointer to next value
-
-   // Store scale_factor in next 4 bytes
-   memcpy(tmp, &scale_factor, sizeof(float));
-
-   tmp += 2;  // Move pointer to next value
-
-   // Perform delta transform
-
-   uint8_t* dest = (uint8_t*)tmp;
-
-   int index = 0;  // index within dest
-
-   uint32_t uint_diff;
-   for (int i = 1; i < len; i++) {
-      if (floor(diff_arr[i] * scale_factor) > 16777215)  // UINT24 max
-         uint_diff = 16777215;
-      else
-         uint_diff = (uint32_t)floor(diff_arr[i] * scale_factor);
-      dest[index * 3] = (uint_diff >> 16) & 0xFF;
-      dest[index * 3 + 1] = (uint_diff >> 8) & 0xFF;
-      dest[index * 3 + 2] = (uint_diff) & 0xFF;
-      index++;
-   }
-
-   // Free decoded buffer
-   free(decoded);
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = res_len;
-
-   return;
-}
-
-/**
- * @brief Delta transform decoding function for 64-bit doubles with 24-bit unsigned integer deltas.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_vdelta24_transform_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_vdelta24_transform_64d: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_decode_vdelta24_transform_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint16_t len;
-   uint16_t* res;
-
-   len = decoded_len / sizeof(double);
-
-   size_t res_len = (len * 3 * sizeof(uint8_t)) + sizeof(uint16_t) +
-                    sizeof(float) + sizeof(float);
-
-   // Perform delta transform
-   res = calloc(1, res_len);  // Allocate space for result and leave room for
-                              // header and first value
-
-   if (res == NULL) {
-      error("algo_decode_vdelta24_transform_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   double* f = (double*)(decoded);
-   uint16_t* tmp = (uint16_t*)(res + 1);  // Ignore header in first 4 bytes
-
-   double* diff_arr = (double*)malloc(len * sizeof(double));
-   diff_arr[0] = f[0];
-
-   double diff_max = 0;
-
-   for (int i = 1; i < len; i++) {
-      diff_arr[i] = f[i] - f[i - 1];
-      if (diff_arr[i] > diff_max)
-         diff_max = diff_arr[i];
-   }
-
-   float scale_factor = 16777215 / (float)diff_max;  // UINT24_MAX
-
-   // Store first value with 32-bit precision
-
-   float starting = (float)f[0];
-   memcpy(tmp, &starting, sizeof(float));
-
-   tmp += 2;  // Move pointer to next value
-
-   // Store scale_factor in next 4 bytes
-   memcpy(tmp, &scale_factor, sizeof(float));
-
-   tmp += 2;  // Move pointer to next value
-
-   // Perform delta transform
-
-   uint8_t* dest = (uint8_t*)tmp;
-
-   int index = 0;  // index within dest
-
-   uint32_t uint_diff;
-   for (int i = 1; i < len; i++) {
-      if (floor(diff_arr[i] * scale_factor) > 16777215)  // UINT24 max
-         uint_diff = 16777215;
-      else
-         uint_diff = (uint32_t)floor(diff_arr[i] * scale_factor);
-      dest[index * 3] = (uint_diff >> 16) & 0xFF;
-      dest[index * 3 + 1] = (uint_diff >> 8) & 0xFF;
-      dest[index * 3 + 2] = (uint_diff) & 0xFF;
-      index++;
-   }
-
-   // Free decoded buffer
-   free(decoded);
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint16_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = res_len;
-
-   return;
-}
-
-
-/**
- * @brief Variable bit rate decoding function for 32-bit floats.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_vbr_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args->src == NULL) {
-      error("algo_decode_vbr_32f: src is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_decode_vbr_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint32_t len;
-   unsigned char* res;
-
-   if (decoded_len + sizeof(uint32_t) + sizeof(double) + sizeof(uint32_t) >
-       UINT32_MAX) {
-      error("algo_decode_vbr_32f: decoded_len > UINT32_MAX");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   len = (uint32_t)decoded_len;
-
-   float* f = (float*)(decoded);
-
-   float threshold = a_args->scale_factor;
-
-   float base_peak_intensity = 0;
-   // Get base peak intensity (max)
-   for (int i = 0; i < len / sizeof(float); i++) {
-      if (f[i] > base_peak_intensity)
-         base_peak_intensity = f[i];
-   }
-
-   int num_bits = ceil(
-       log2((base_peak_intensity / threshold) +
-            1));  // number of bits required to represent base peak intensity
-
-   if (num_bits == 1)
-      num_bits = 2;  // 1 bit is not enough
-
-   uint32_t res_len = (int)ceil(len / 4 * num_bits / 8) + sizeof(uint32_t) +
-                      sizeof(float) + sizeof(uint32_t) + 1;
-
-   res =
-       calloc(1,
-              res_len);  // Allocate space for result and leave room for header
-
-   if (res == NULL) {
-      error("algo_decode_vbr_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   unsigned char* tmp_res = res + sizeof(uint32_t) + sizeof(float) +
-                            sizeof(uint32_t);  // Ignore header
-
-   uint32_t bytes_used = 0;
-   int bit_index = 0;
-   int result_index = 0;
-   unsigned char tmp_buff[8];
-   int tmp_index = 0;
-
-   for (int i = 0; i < len; i++) {
-      tmp_buff[tmp_index] = decoded[i];
-      tmp_index++;
-
-      if (tmp_index == sizeof(float)) {
-         float float32;
-         memcpy(&float32, tmp_buff, sizeof(float));
-         uint32_t float_int =
-             (uint32_t)(float32 / base_peak_intensity * (exp2(num_bits) - 1));
-
-         for (int j = 0; j < num_bits; j++) {
-            int bit = (float_int >> j) & 1;
-            tmp_res[bit_index >> 3] |= (bit << (bit_index & 7));
-            bit_index++;
-         }
-
-         result_index++;
-         tmp_index = 0;
-      }
-   }
-
-   if (tmp_index == sizeof(float)) {
-      float float32;
-      memcpy(&float32, tmp_buff, sizeof(float));
-      uint32_t float_int =
-          (uint32_t)(float32 / base_peak_intensity * (exp2(num_bits) - 1));
-
-      for (int j = 0; j < num_bits; j++) {
-         int bit = (float_int >> j) & 1;
-         tmp_res[bit_index >> 3] |= (bit << (bit_index & 7));
-         bit_index++;
-      }
-
-      result_index++;
-      tmp_index = 0;
-   }
-
-   bytes_used = (bit_index + 7) >> 3;
-
-   int padding = (bytes_used * 8) - bit_index;
-   for (int i = bit_index; i < bit_index + padding; i++) {
-      tmp_res[i >> 3] &= ~(1 << (i & 7));
-   }
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint32_t));
-   // Store base peak intensity in next 8 bytes
-   memcpy(res + sizeof(uint32_t), &base_peak_intensity, sizeof(float));
-   // Store number of bytes in next 4 bytes
-   memcpy(res + sizeof(uint32_t) + sizeof(float), &bytes_used,
-          sizeof(uint32_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len =
-       sizeof(uint32_t) + sizeof(float) + sizeof(uint32_t) + bytes_used;
-
-   return;
-}
-
-/**
- * @brief Variable bit rate decoding function for 64-bit doubles.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_vbr_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_decode_vbr_64d: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_decode_vbr_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint32_t len;
-   unsigned char* res;
-
-   if (decoded_len + sizeof(uint32_t) + sizeof(double) + sizeof(uint32_t) >
-       UINT32_MAX) {
-      error("algo_decode_vbr_64d: decoded_len > UINT32_MAX");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   len = (uint32_t)decoded_len;
-
-   double* f = (double*)(decoded);
-
-   double threshold = (double)a_args->scale_factor;
-
-   double base_peak_intensity = 0;
-   // Get base peak intensity (max)
-   for (int i = 0; i < len / sizeof(double); i++) {
-      if (f[i] > base_peak_intensity)
-         base_peak_intensity = f[i];
-   }
-
-   int num_bits = ceil(
-       log2((base_peak_intensity / threshold) +
-            1));  // number of bits required to represent base peak intensity
-
-   if (num_bits == 1)
-      num_bits = 2;  // 1 bit is not enough
-
-   uint32_t res_len = (int)ceil(len / 4 * num_bits / 8) + sizeof(uint32_t) +
-                      sizeof(double) + sizeof(uint32_t);
-
-   res =
-       calloc(1,
-              res_len);  // Allocate space for result and leave room for header
-
-   if (res == NULL) {
-      error("algo_decode_vbr_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   unsigned char* tmp_res = res + sizeof(uint32_t) + sizeof(double) +
-                            sizeof(uint32_t);  // Ignore header
-
-   uint32_t bytes_used = 0;
-   int bit_index = 0;
-   int result_index = 0;
-   unsigned char tmp_buff[8];
-   int tmp_index = 0;
-
-   for (int i = 0; i < len; i++) {
-      tmp_buff[tmp_index] = decoded[i];
-      tmp_index++;
-
-      if (tmp_index == sizeof(double)) {
-         double float64;
-         memcpy(&float64, tmp_buff, sizeof(double));
-         uint64_t float_int =
-             (uint64_t)(float64 / base_peak_intensity * (exp2(num_bits) - 1));
-
-         for (int j = 0; j < num_bits; j++) {
-            int bit = (float_int >> j) & 1;
-            tmp_res[bit_index / 8] |= (bit << (bit_index % 8));
-            bit_index++;
-         }
-
-         result_index++;
-         tmp_index = 0;
-      }
-   }
-
-   if (tmp_index == sizeof(double)) {
-      double float64;
-      memcpy(&float64, tmp_buff, sizeof(double));
-      uint64_t float_int =
-          (uint64_t)(float64 / base_peak_intensity * (exp2(num_bits) - 1));
-
-      for (int j = 0; j < num_bits; j++) {
-         int bit = (float_int >> j) & 1;
-         tmp_res[bit_index / 8] |= (bit << (bit_index % 8));
-         bit_index++;
-      }
-
-      result_index++;
-      tmp_index = 0;
-   }
-
-   bytes_used = (bit_index + 7) / 8;
-
-   int padding = (bytes_used * 8) - bit_index;
-   for (int i = bit_index; i < bit_index + padding; i++) {
-      tmp_res[i / 8] &= ~(1 << (i % 8));
-   }
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint32_t));
-   // Store base peak intensity in next 8 bytes
-   memcpy(res + sizeof(uint32_t), &base_peak_intensity, sizeof(double));
-   // Store number of bytes in next 4 bytes
-   memcpy(res + sizeof(uint32_t) + sizeof(double), &bytes_used,
-          sizeof(uint32_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len =
-       sizeof(uint32_t) + sizeof(double) + sizeof(uint32_t) + bytes_used;
-
-   return;
-}
-
-
-/**
- * @brief Bit packing decoding function for 32-bit floats.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_bitpack_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_decode_bitpack_32f: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_decode_bitpack_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint32_t len;
-   unsigned char* res;
-
-   size_t header_size = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);
-
-   if (decoded_len + header_size > UINT32_MAX) {
-      error("algo_decode_bitpack_32f: decoded_len > UINT32_MAX");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   len = (uint32_t)(decoded_len / sizeof(float));
-
-   float* f = (float*)(decoded);
-
-   uint8_t num_bits = 27;  // TODO: add as argument
-
-   uint32_t expected_bytes =
-       (uint32_t)ceil(len * ((float)num_bits / 8));  // Bytes expected to use
-
-   uint32_t res_len = expected_bytes + header_size;
-
-   res =
-       calloc(1,
-              res_len);  // Allocate space for result and leave room for header
-
-   if (res == NULL) {
-      error("algo_decode_bitpack_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   unsigned char* tmp_res = res + header_size;  // Ignore header
-
-   int bit_index = 0;
-   float scaled = 0;
-
-   for (int i = 0; i < len; i++) {
-      scaled = f[i] / a_args->scale_factor;
-
-      if (scaled > 1.0)
-         scaled = 1.0;  // clipping
-      else if (scaled <= 0)
-         scaled =
-             a_args->scale_factor /
-             (exp2(num_bits) - 1);  // if <= 0, set to smallest possible value
-
-      uint64_t float_int = (uint64_t)(scaled * (exp2(num_bits) - 1));
-
-      for (int j = 0; j < num_bits; j++) {
-         int bit = (float_int >> j) & 1;
-         tmp_res[bit_index >> 3] |= (bit << (bit_index % 8));
-         bit_index++;
-      }
-   }
-
-   // Pad the last byte with 0's
-   uint32_t bytes_used = (bit_index + 7) / 8;
-
-   int padding = (bytes_used * 8) - bit_index;
-   for (int i = bit_index; i < bit_index + padding; i++) {
-      tmp_res[i / 8] &= ~(1 << (i % 8));
-   }
-
-   // Store header
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint32_t));
-   // Store num bits in next byte
-   memcpy(res + sizeof(uint32_t), &num_bits, sizeof(uint8_t));
-   // Store number of bytes in next 4 bytes
-   memcpy(res + sizeof(uint32_t) + sizeof(uint8_t), &bytes_used,
-          sizeof(uint32_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = header_size + bytes_used;
-
-   return;
-}
-
-/**
- * @brief Bit packing decoding function for 64-bit doubles.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_decode_bitpack_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_decode_bitpack_64d: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_decode_bitpack_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   char* decoded = NULL;
-   size_t decoded_len = 0;
-
-   // Decode using specified encoding format
-   a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, &decoded,
-                   &decoded_len, a_args->tmp);
-
-   // Deternmine length of data based on data format
-   uint32_t len;
-   unsigned char* res;
-
-   size_t header_size = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);
-
-   if (decoded_len + header_size > UINT32_MAX) {
-      error("algo_decode_vbr_64d: decoded_len > UINT32_MAX");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   len = (uint32_t)(decoded_len / sizeof(double));
-
-   double* f = (double*)(decoded);
-
-   uint8_t num_bits = 27;  // TODO: add as argument
-
-   uint32_t expected_bytes =
-       (uint32_t)ceil(len * ((double)num_bits / 8));  // Bytes expected to use
-
-   uint32_t res_len = expected_bytes + header_size;
-
-   res =
-       calloc(1,
-              res_len);  // Allocate space for result and leave room for header
-
-   if (res == NULL) {
-      error("algo_decode_bitpack_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   unsigned char* tmp_res = res + header_size;  // Ignore header
-
-   int bit_index = 0;
-   double scaled = 0;
-
-   for (int i = 0; i < len; i++) {
-      scaled = f[i] / a_args->scale_factor;
-
-      if (scaled > 1.0)
-         scaled = 1.0;  // clipping
-      else if (scaled <= 0)
-         scaled =
-             a_args->scale_factor /
-             (exp2(num_bits) - 1);  // if <= 0, set to smallest possible value
-
-      uint64_t float_int = (uint64_t)(scaled * (exp2(num_bits) - 1));
-
-      for (int j = 0; j < num_bits; j++) {
-         int bit = (float_int >> j) & 1;
-         tmp_res[bit_index >> 3] |= (bit << (bit_index % 8));
-         bit_index++;
-      }
-   }
-
-   // Pad the last byte with 0's
-   uint32_t bytes_used = (bit_index + 7) / 8;
-
-   int padding = (bytes_used * 8) - bit_index;
-   for (int i = bit_index; i < bit_index + padding; i++) {
-      tmp_res[i / 8] &= ~(1 << (i % 8));
-   }
-
-   // Store header
-
-   // Store length of array in first 4 bytes
-   memcpy(res, &len, sizeof(uint32_t));
-   // Store num bits in next byte
-   memcpy(res + sizeof(uint32_t), &num_bits, sizeof(uint8_t));
-   // Store number of bytes in next 4 bytes
-   memcpy(res + sizeof(uint32_t) + sizeof(uint8_t), &bytes_used,
-          sizeof(uint32_t));
-
-   // Return result
-   *a_args->dest = res;
-   *a_args->dest_len = header_size + bytes_used;
-
-   return;
-}
-
-/*
-    @section Encoding functions
-*/
-
-/**
- * @brief Lossless encoding function.
- * @param args Pointer to `algo_args` struct containing encoding parameters.
- *
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_lossless(void* args)
-{
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_lossless: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   /* Lossless, don't touch anything */
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, a_args->src, a_args->src_len, a_args->dest,
-                   a_args->dest_len);
-
-   return;
-}
-
-/**
- * @brief Casts 32-bit float array to 64-bit double array.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_cast32_64d(void* args)
-{
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_cast32: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_encode_cast32_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get source array
-   float* arr = (float*)(*a_args->src);
-
-   // Get array length
-   uint16_t len = (uint16_t)arr[0];
-
-   if (len <= 0) {
-      error("algo_encode_cast32_64d: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Allocate buffer
-   void* res = malloc(sizeof(double) * len);
-
-   if (res == NULL) {
-      error("algo_encode_cast32_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   double* res_arr = (double*)res;
-
-   // Cast all
-   for (size_t i = 1; i < len + 1; i++) res_arr[i - 1] = (double)arr[i];
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, &res, len * sizeof(double), a_args->dest,
-                   a_args->dest_len);
-
-   // Move src pointer
-   *a_args->src += (len + 1) * sizeof(float);
-
-   // // Free buffer
-   // free(res);
-   return;
-}
-
-
-/**
- * @brief Casts 16-bit float array to 32-bit float array.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_cast16_32f(void* args)
-{
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_cast16_32f: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_encode_cast16_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Cast 16-bit to 32-bit
-
-   // Get source array
-   uint16_t* arr = (uint16_t*)(*a_args->src);
-
-   // Get array length
-   uint16_t len = (uint16_t)arr[0];
-
-   if (len <= 0) {
-      error("algo_encode_cast16_32f: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Allocate buffer
-   void* res = malloc(sizeof(float) * len);
-
-   if (res == NULL) {
-      error("algo_encode_cast16_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get pointer to the array, ignoring the header
-   uint16_t* tmp = arr + 1;
-
-   float* res_arr = (float*)res;
-
-   int i;
-
-   for (i = 0; i < len; i++)
-      res_arr[i] = (float)(tmp[i] / a_args->scale_factor);
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, &res, len * sizeof(float), a_args->dest,
-                   a_args->dest_len);
-
-   // Move src pointer
-   *a_args->src += (len * sizeof(uint16_t)) + sizeof(uint16_t);
-
-   // // Free buffer
-   // free(res);
-   return;
-}
-
-/**
- * @brief Casts 16-bit float array to 64-bit double array.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_cast16_64d(void* args)
-{
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_cast16_64d: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_encode_cast16_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get source array
-   uint16_t* arr = (uint16_t*)(*a_args->src);
-
-   // Get array length
-   uint16_t len = (uint16_t)arr[0];
-
-   if (len <= 0) {
-      error("algo_encode_cast16_64d: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Allocate buffer
-   void* res = malloc(sizeof(double) * len);
-
-   if (res == NULL) {
-      error("algo_encode_cast16_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   uint16_t* tmp = arr + 1;  // Ignore header
-
-   double* res_arr = (double*)res;
-
-   int i;
-
-   for (i = 0; i < len; i++)
-      res_arr[i] = (double)(tmp[i] / a_args->scale_factor);
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, &res, len * sizeof(double), a_args->dest,
-                   a_args->dest_len);
-
-   // Move src pointer
-   *a_args->src += (len * sizeof(uint16_t)) + sizeof(uint16_t);
-
-   // // Free buffer
-   // free(res);
-   return;
-}
-
-/**
- * @brief Logarithmic base 2 transform via exp2 to 32-bit floats.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_log_2_transform_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_log_2_transform: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_encode_log_2_transform: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get array length
-   uint16_t len = *(uint16_t*)(*a_args->src);
-
-   if (len <= 0) {
-      error("algo_encode_log_2_transform: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get source array
-   uint16_t* arr = (uint16_t*)((uint8_t*)(*a_args->src) + sizeof(uint16_t));
-
-   // Allocate buffer
-   size_t res_len = len * sizeof(float);
-   float* res = malloc(res_len);
-
-   if (res == NULL) {
-      error("algo_encode_log_2_transform: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Perform log2 transform
-   for (size_t i = 0; i < len; i++)
-      res[i] = (float)exp2((double)arr[i] / a_args->scale_factor) - 1;
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, (char**)(&res), res_len, a_args->dest,
-                   a_args->dest_len);
-
-   // Move to next array
-   *a_args->src += ((len + 1) * sizeof(uint16_t));
-
-   return;
-}
-
-/**
- * @brief Logarithmic base 2 transform via exp2 to 64-bit doubles.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_log_2_transform_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_log_2_transform: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_encode_log_2_transform: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get array length
-   uint16_t len = *(uint16_t*)(*a_args->src);
-
-   if (len <= 0) {
-      error("algo_encode_log_2_transform: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get source array
-   uint16_t* arr = (uint16_t*)((uint8_t*)(*a_args->src) + sizeof(uint16_t));
-
-   // Allocate buffer
-   size_t res_len = len * sizeof(double);
-   double* res = malloc(res_len);
-   if (res == NULL)
-      error("algo_encode_log_2_transform: malloc failed");
-   // Perform log2 transform
-   for (size_t i = 0; i < len; i++)
-      res[i] = (double)exp2((double)arr[i] / a_args->scale_factor) - 1;
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, (char**)(&res), res_len, a_args->dest,
-                   a_args->dest_len);
-
-   // Move to next array
-   *a_args->src += ((len + 1) * sizeof(uint16_t));
-
-   return;
-}
-
-/**
- * @brief Delta transform encoding function for 16-bit integers to 32-bit floats.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_delta16_transform_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_delta_transform: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_encode_delta_transform: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get array length
-   uint16_t len = *(uint16_t*)(*a_args->src);
-
-   if (len <= 0) {
-      error("algo_encode_delta_transform: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get starting value
-   float start = *(float*)((uint8_t*)(*a_args->src) + sizeof(uint16_t));
-
-   // Get source array
-   uint16_t* arr =
-       (uint16_t*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) + sizeof(float));
-
-   // Allocate buffer
-   size_t res_len = len * sizeof(float);
-   float* res = malloc(res_len);
-
-   if (res == NULL) {
-      error("algo_encode_delta_transform: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Perform delta transform
-   res[0] = start;
-   for (size_t i = 1; i < len; i++)
-      res[i] = res[i - 1] + ((float)arr[i - 1] / a_args->scale_factor);
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, (char**)(&res), res_len, a_args->dest,
-                   a_args->dest_len);
-
-   // Move to next array
-   *a_args->src += (len * sizeof(uint16_t)) + sizeof(uint16_t) + sizeof(float);
-
-   return;
-}
-
-/**
- * @brief Delta transform encoding function for 16-bit integers to 64-bit doubles.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_delta16_transform_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_delta_transform: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_encode_delta_transform: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get array length
-   uint16_t len = *(uint16_t*)(*a_args->src);
-
-   if (len <= 0) {
-      error("algo_encode_delta_transform: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get starting value
-   double start = *(double*)((uint8_t*)(*a_args->src) + sizeof(uint16_t));
-
-   // Get source array
-   uint16_t* arr = (uint16_t*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) +
-                               sizeof(double));
-
-   // Allocate buffer
-   size_t res_len = len * sizeof(double);
-   double* res = malloc(res_len);
-
-   if (res == NULL) {
-      error("algo_encode_delta_transform: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Perform delta transform
-   res[0] = start;
-   for (size_t i = 1; i < len; i++)
-      res[i] = res[i - 1] + ((double)arr[i - 1] / a_args->scale_factor);
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, (char**)(&res), res_len, a_args->dest,
-                   a_args->dest_len);
-
-   // Move to next array
-   *a_args->src += (len * sizeof(uint16_t)) + sizeof(uint16_t) + sizeof(double);
-
-   return;
-}
-
-/**
- * @brief Variable delta transform encoding function for 16-bit integers to 32-bit floats.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_vdelta16_transform_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_vdelta16_transform_32f: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_encode_vdelta16_transform_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get array length
-   uint16_t len = *(uint16_t*)(*a_args->src);
-
-   if (len <= 0) {
-      error("algo_encode_vdelta16_transform_32f: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get starting value
-   float start = *(float*)((uint8_t*)(*a_args->src) + sizeof(uint16_t));
-
-   // Get scale factor
-
-   float scale_factor =
-       *(float*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) + sizeof(float));
-
-   // Get source array
-   uint16_t* arr = (uint16_t*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) +
-                               sizeof(float) + sizeof(float));
-
-   // Allocate buffer
-   size_t res_len = len * sizeof(float);
-   float* res = malloc(res_len);
-
-   if (res == NULL) {
-      error("algo_encode_vdelta16_transform_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Perform delta transform
-   res[0] = start;
-   for (size_t i = 1; i < len; i++)
-      res[i] = res[i - 1] + ((float)arr[i - 1] / scale_factor);
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, (char**)(&res), res_len, a_args->dest,
-                   a_args->dest_len);
-
-   // Move to next array
-   *a_args->src += (len * sizeof(uint16_t)) + sizeof(uint16_t) + sizeof(float) +
-                   sizeof(float);
-
-   return;
-}
-
-/**
- * @brief Variable delta transform encoding function for 16-bit integers to 64-bit doubles.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_vdelta16_transform_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_vdelta16_transform_64d: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_encode_vdelta16_transform_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-
-   // Get array length
-   uint16_t len = *(uint16_t*)(*a_args->src);
-
-   if (len <= 0) {
-      error("algo_encode_vdelta16_transform_64d: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get starting value
-   float start = *(float*)((uint8_t*)(*a_args->src) + sizeof(uint16_t));
-
-   // Get scale factor
-
-   float scale_factor =
-       *(float*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) + sizeof(float));
-
-   // Get source array
-   uint16_t* arr = (uint16_t*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) +
-                               sizeof(float) + sizeof(float));
-
-   // Allocate buffer
-   size_t res_len = len * sizeof(double);
-   double* res = malloc(res_len);
-
-   if (res == NULL) {
-      error("algo_encode_vdelta16_transform_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Perform delta transform
-   res[0] = start;
-   for (size_t i = 1; i < len; i++)
-      res[i] = res[i - 1] + ((double)arr[i - 1] / scale_factor);
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, (char**)(&res), res_len, a_args->dest,
-                   a_args->dest_len);
-
-   // Move to next array
-   *a_args->src += (len * sizeof(uint16_t)) + sizeof(uint16_t) + sizeof(float) +
-                   sizeof(float);
-
-   return;
-}
-
-/**
- * @brief Variable delta transform encoding function for 24-bit integers to 32-bit floats.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_vdelta24_transform_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_vdelta24_transform_32f: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_encode_vdelta24_transform_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get array length
-   uint16_t len = *(uint16_t*)(*a_args->src);
-
-   if (len <= 0) {
-      error("algo_encode_vdelta24_transform_32f: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get starting value
-   float start = *(float*)((uint8_t*)(*a_args->src) + sizeof(uint16_t));
-
-   // Get scale factor
-
-   float scale_factor =
-       *(float*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) + sizeof(float));
-
-   // Get source array
-   uint8_t* arr = (uint8_t*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) +
-                             sizeof(float) + sizeof(float));
-
-   // Allocate buffer
-   size_t res_len = len * sizeof(float);
-   float* res = malloc(res_len);
-
-   if (res == NULL) {
-      error("algo_encode_vdelta24_transform_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Perform delta transform
-   res[0] = start;
-
-   int index = 0;  // index within arr
-
-   uint32_t value;
-   float diff;
-
-   for (size_t i = 1; i < len; i++) {
-      value = (arr[index * 3] << 16) | (arr[index * 3 + 1] << 8) |
-              (arr[index * 3 + 2]);
-      diff = (float)value / scale_factor;
-      res[i] = res[i - 1] + diff;
-      index++;
-   }
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, (char**)(&res), res_len, a_args->dest,
-                   a_args->dest_len);
-
-   // Move to next array
-   *a_args->src += (len * 3 * sizeof(uint8_t)) + sizeof(uint16_t) +
-                   sizeof(float) + sizeof(float);
-
-   return;
-}
-
-/**
- * @brief Variable delta transform encoding function for 24-bit integers to 64-bit doubles.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_vdelta24_transform_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_vdelta24_transform_64d: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_encode_vdelta24_transform_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get array length
-   uint16_t len = *(uint16_t*)(*a_args->src);
-
-   if (len <= 0) {
-      error("algo_encode_vdelta24_transform_64d: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get starting value
-   float start = *(float*)((uint8_t*)(*a_args->src) + sizeof(uint16_t));
-
-   // Get scale factor
-
-   float scale_factor =
-       *(float*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) + sizeof(float));
-
-   // Get source array
-   uint8_t* arr = (uint8_t*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) +
-                             sizeof(float) + sizeof(float));
-
-   // Allocate buffer
-   size_t res_len = len * sizeof(double);
-   double* res = malloc(res_len);
-
-   if (res == NULL) {
-      error("algo_encode_vdelta24_transform_64d: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Perform delta transform
-   res[0] = start;
-
-   int index = 0;  // index within arr
-
-   uint32_t value;
-   float diff;
-
-   for (size_t i = 1; i < len; i++) {
-      value = (arr[index * 3] << 16) | (arr[index * 3 + 1] << 8) |
-              (arr[index * 3 + 2]);
-      diff = (float)value / scale_factor;
-      res[i] = res[i - 1] + diff;
-      index++;
-   }
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, (char**)(&res), res_len, a_args->dest,
-                   a_args->dest_len);
-
-   // Move to next array
-   *a_args->src += (len * 3 * sizeof(uint8_t)) + sizeof(uint16_t) +
-                   sizeof(float) + sizeof(float);
-
-   return;
-}
-
-/**
- * @brief Delta transform encoding function for 24-bit integers to 32-bit floats.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_delta24_transform_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_delta_transform: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_encode_delta_transform: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-   
-   // Get array length
-   uint16_t len = *(uint16_t*)(*a_args->src);
-
-   if (len <= 0) {
-      error("algo_encode_delta_transform: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get starting value
-   float start = *(float*)((uint8_t*)(*a_args->src) + sizeof(uint16_t));
-
-   // Get source array
-   uint8_t* arr =
-       (uint8_t*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) + sizeof(float));
-
-   // Allocate buffer
-   size_t res_len = len * sizeof(float);
-   float* res = malloc(res_len);
-
-   if (res == NULL) {
-      error("algo_encode_delta_transform: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Perform delta transform
-   res[0] = start;
-
-   int index = 0;  // index within arr
-
-   uint32_t value;
-   float diff;
-
-   for (size_t i = 1; i < len; i++) {
-      value = (arr[index * 3] << 16) | (arr[index * 3 + 1] << 8) |
-              (arr[index * 3 + 2]);
-      diff = (float)value / a_args->scale_factor;
-      res[i] = res[i - 1] + diff;
-      index++;
-   }
+typedef struct {
+   unsigned char* dst;
+   uint64_t acc;  // Pending bits, in the low `filled` bits.
+   int filled;
+} bit_writer_t;
 
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, (char**)(&res), res_len, a_args->dest,
-                   a_args->dest_len);
+typedef struct {
+   const unsigned char* src;
+   const unsigned char* end;
+   uint64_t acc;  // Unread bits, in the low `filled` bits.
+   int filled;
+} bit_reader_t;
 
-   // Move to next array
-   *a_args->src +=
-       (len * 3 * sizeof(uint8_t)) + sizeof(uint16_t) + sizeof(float);
+static void store_le32(unsigned char* dst, uint32_t v) {
+   dst[0] = v & 0xFF;
+   dst[1] = (v >> 8) & 0xFF;
+   dst[2] = (v >> 16) & 0xFF;
+   dst[3] = (v >> 24) & 0xFF;
+}
 
-   return;
+static uint32_t load_le32(const unsigned char* src) {
+   return (uint32_t)src[0] | ((uint32_t)src[1] << 8) |
+          ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
 }
 
 /**
- * @brief Delta transform encoding function for 24-bit integers to 64-bit doubles.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
+ * @brief Appends the n (at most 32) low bits of v to a bit stream.
  */
-void algo_encode_delta24_transform_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_delta_transform: args is NULL");
-      a_args->ret_code = -1;
-      return;
+static inline void bits_put(bit_writer_t* w, uint64_t v, int n) {
+   w->acc |= (v & ((1ULL << n) - 1)) << w->filled;
+   w->filled += n;
+   if (w->filled >= 32) {
+      store_le32(w->dst, (uint32_t)w->acc);
+      w->dst += 4;
+      w->acc >>= 32;
+      w->filled -= 32;
    }
+}
 
-   if (a_args->src_format != _64d_) {
-      error("algo_encode_delta_transform: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
+/**
+ * @brief Appends the n low bits of v to a bit stream, bits past the 64th
+ * being 0.
+ */
+static inline void bits_put_wide(bit_writer_t* w, uint64_t v, int n) {
+   while (n > 32) {
+      bits_put(w, v, 32);
+      v >>= 32;  // 0 once all 64 bits are out.
+      n -= 32;
    }
+   bits_put(w, v, n);
+}
 
-   // Get array length
-   uint16_t len = *(uint16_t*)(*a_args->src);
-
-   if (len <= 0) {
-      error("algo_encode_delta_transform: len is <= 0");
-      a_args->ret_code = -1;
-      return;
+/**
+ * @brief Writes the bits still pending, the last byte padded with 0's.
+ */
+static void bits_flush(bit_writer_t* w) {
+   for (; w->filled > 0; w->filled -= 8) {
+      *w->dst++ = w->acc & 0xFF;
+      w->acc >>= 8;
    }
+   w->filled = 0;
+}
 
-   // Get starting value
-   double start = *(double*)((uint8_t*)(*a_args->src) + sizeof(uint16_t));
-
-   // Get source array
-   uint8_t* arr =
-       (uint8_t*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) + sizeof(double));
-
-   // Allocate buffer
-   size_t res_len = len * sizeof(double);
-   double* res = malloc(res_len);
+/**
+ * @brief Reads the next n (at most 32) bits of a bit stream. Bits past the
+ * end of the stream read as 0.
+ */
+static inline uint64_t bits_get(bit_reader_t* r, int n) {
+   uint64_t v;
 
-   if (res == NULL) {
-      error("algo_encode_delta_transform: malloc failed");
-      a_args->ret_code = -1;
-      return;
+   if (r->filled < n) {
+      if (r->end - r->src >= 4) {
+         r->acc |= (uint64_t)load_le32(r->src) << r->filled;
+         r->src += 4;
+         r->filled += 32;
+      } else {
+         for (; r->filled < n; r->filled += 8)
+            if (r->src < r->end)
+               r->acc |= (uint64_t)*r->src++ << r->filled;
+      }
    }
+   v = r->acc & ((1ULL << n) - 1);
+   r->acc >>= n;
+   r->filled -= n;
+   return v;
+}
 
-   // Perform delta transform
-   res[0] = start;
-
-   int index = 0;  // index within arr
-
-   uint32_t value;
-   float diff;
+/**
+ * @brief Reads the next n bits of a bit stream, keeping the first 64.
+ */
+static inline uint64_t bits_get_wide(bit_reader_t* r, int n) {
+   uint64_t v = 0;
+   int shift = 0;
 
-   for (size_t i = 1; i < len; i++) {
-      value = (arr[index * 3] << 16) | (arr[index * 3 + 1] << 8) |
-              (arr[index * 3 + 2]);
-      diff = (float)value / a_args->scale_factor;
-      res[i] = res[i - 1] + diff;
-      index++;
+   while (n > 32) {
+      uint64_t part = bits_get(r, 32);
+      if (shift < 64)
+         v |= part << shift;
+      shift += 32;
+      n -= 32;
    }
+   if (shift < 64)
+      v |= bits_get(r, n) << shift;
+   else
+      bits_get(r, n);
+   return v;
+}
 
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, (char**)(&res), res_len, a_args->dest,
-                   a_args->dest_len);
-
-   // Move to next array
-   *a_args->src +=
-       (len * 3 * sizeof(uint8_t)) + sizeof(uint16_t) + sizeof(double);
-
-   return;
+static long bits_field_count(uint32_t num_bytes, int num_bits, long max) {
+   // Number of whole fields in a stream (a stream of 0-bit fields holds one).
+   long n = num_bits > 0 ? (long)num_bytes * 8 / num_bits : 1;
+   return n < max ? n : max;
 }
 
-/**
- * @brief Delta transform encoding function for 32-bit integers to 32-bit floats.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_delta32_transform_32f(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
+/*
+    @section Transform templates
+*/
 
-   if (a_args == NULL) {
-      error("algo_encode_delta_transform: args is NULL");
+/* Each lossy transform is written once below as a type-generic macro that
+ * defines both its compression (`algo_decode_*`) and decompression
+ * (`algo_encode_*`) functions for one element type. DEFINE_TRANSFORMS()
+ * instantiates every transform for a type, and the table in the "Algo
+ * switch" section maps (algorithm, accession) to the instances. */
+
+/**
+ * @brief Checks the arguments of a compression transform and decodes its
+ * source array.
+ * @param a_args Pointer to `algo_args` struct.
+ * @param fmt Data format the transform expects.
+ * @param fmt_name Name of the data format, for error messages.
+ * @param name Name of the transform, for error messages.
+ * @param decoded Set to the decoded array, held in `a_args->tmp` until the
+ * next call.
+ * @param decoded_len Set to the length of the decoded array in bytes.
+ * @return 0 on success, -1 on error (`a_args->ret_code` is then set to -1).
+ */
+static int algo_decode_source(algo_args* a_args, int fmt, const char* fmt_name,
+                              const char* name, char** decoded,
+                              size_t* decoded_len) {
+   if (a_args->src == NULL) {
+      error("%s: src is NULL", name);
       a_args->ret_code = -1;
-      return;
+      return -1;
    }
 
-   if (a_args->src_format != _32f_) {
-      error("algo_encode_delta_transform: Unknown data format. Expected _32f_, got %d", a_args->src_format);
+   if (a_args->src_format != fmt) {
+      error("%s: Unknown data format. Expected _%s_, got %d", name, fmt_name,
+            a_args->src_format);
       a_args->ret_code = -1;
-      return;
+      return -1;
    }
 
-   // Get array length
-   uint16_t len = *(uint16_t*)(*a_args->src);
+   *decoded_len = 0;
 
-   if (len <= 0) {
-      error("algo_encode_delta_transform: len is <= 0");
+   // Decode using specified encoding format
+   a_args->tmp->size = 0;
+   if (a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, a_args->tmp,
+                       decoded_len)) {
       a_args->ret_code = -1;
-      return;
+      return -1;
    }
 
-   // Get starting value
-   float start = *(float*)((uint8_t*)(*a_args->src) + sizeof(uint16_t));
+   *decoded = a_args->tmp->mem;
 
-   // Get source array
-   uint32_t* arr =
-       (uint32_t*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) + sizeof(float));
+   return 0;
+}
 
-   // Allocate buffer
-   size_t res_len = len * sizeof(float);
-   float* res = malloc(res_len);
+/**
+ * @brief Reserves the result of a compression transform at the end of the
+ * staging block, so the transform writes it in place.
+ * @param a_args Pointer to `algo_args` struct.
+ * @param size Size of the result in bytes, at most.
+ * @param name Name of the transform, for error messages.
+ * @return A zeroed buffer, or NULL on error (`a_args->ret_code` is then set
+ * to -1).
+ */
+static void* algo_decode_alloc(algo_args* a_args, size_t size,
+                               const char* name) {
+   char* res = reserve_data_block(a_args->out, size);
 
    if (res == NULL) {
-      error("algo_encode_delta_transform: malloc failed");
+      error("%s: failed to reserve %zu bytes", name, size);
       a_args->ret_code = -1;
-      return;
+      return NULL;
    }
 
-   // Perform delta transform
-   res[0] = start;
-   for (size_t i = 1; i < len; i++)
-      res[i] = res[i - 1] + ((float)arr[i - 1] / a_args->scale_factor);
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, (char**)(&res), res_len, a_args->dest,
-                   a_args->dest_len);
-
-   // Move to next array
-   *a_args->src += (len * sizeof(uint32_t)) + sizeof(uint16_t) + sizeof(float);
+   memset(res, 0, size);
 
-   return;
+   return res;
 }
 
 /**
- * @brief Delta transform encoding function for 32-bit integers to 64-bit doubles.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
+ * @brief Appends the result of a compression transform to the staging block.
+ * @param a_args Pointer to `algo_args` struct.
+ * @param res Result, as returned by algo_decode_alloc().
+ * @param res_len Length of the result in bytes.
  */
-void algo_encode_delta32_transform_64d(void* args) {
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
+static void algo_decode_commit(algo_args* a_args, void* res, size_t res_len) {
+   a_args->out->size += res_len;
+   *a_args->dest = (char*)res;
+   *a_args->dest_len = res_len;
+}
 
-   if (a_args == NULL) {
-      error("algo_encode_delta_transform: args is NULL");
+/**
+ * @brief Checks the arguments of a decompression transform.
+ * @param a_args Pointer to `algo_args` struct.
+ * @param fmt Data format the transform produces.
+ * @param fmt_name Name of the data format, for error messages.
+ * @param name Name of the transform, for error messages.
+ * @return 0 on success, -1 on error (`a_args->ret_code` is then set to -1).
+ */
+static int algo_encode_check(algo_args* a_args, int fmt, const char* fmt_name,
+                             const char* name) {
+   if (a_args->src == NULL || *a_args->src == NULL) {
+      error("%s: src is NULL", name);
       a_args->ret_code = -1;
-      return;
+      return -1;
    }
 
-   if (a_args->src_format != _64d_) {
-      error("algo_encode_delta_transform: Unknown data format. Expected _64d_, got %d", a_args->src_format);
+   if (a_args->src_format != fmt) {
+      error("%s: Unknown data format. Expected _%s_, got %d", name, fmt_name,
+            a_args->src_format);
       a_args->ret_code = -1;
-      return;
+      return -1;
    }
 
-   // Get array length
-   uint16_t len = *(uint16_t*)(*a_args->src);
+   return 0;
+}
 
-   if (len <= 0) {
-      error("algo_encode_delta_transform: len is <= 0");
+/**
+ * @brief Allocates the array restored by a decompression transform.
+ * @param a_args Pointer to `algo_args` struct.
+ * @param len Number of elements, as read from the header of the source.
+ * @param size Size of an element in bytes.
+ * @param name Name of the transform, for error messages.
+ * @return A zeroed buffer, or NULL on error (`a_args->ret_code` is then set
+ * to -1).
+ */
+static void* algo_encode_alloc(algo_args* a_args, long len, size_t size,
+                               const char* name) {
+   if (len < 0) {
+      error("%s: len is < 0", name);
       a_args->ret_code = -1;
-      return;
+      return NULL;
    }
 
-   // Get starting value
-   double start = *(double*)((uint8_t*)(*a_args->src) + sizeof(uint16_t));
-
-   // Get source array
-   uint32_t* arr = (uint32_t*)((uint8_t*)(*a_args->src) + sizeof(uint16_t) +
-                               sizeof(double));
-
-   // Allocate buffer
-   size_t res_len = len * sizeof(double);
-   double* res = malloc(res_len);
+   // An empty array still gets one element, as transforms that store the
+   // first value read it whatever the length.
+   void* res = calloc(len > 0 ? len : 1, size);
 
    if (res == NULL) {
-      error("algo_encode_delta_transform: malloc failed");
+      error("%s: malloc failed", name);
       a_args->ret_code = -1;
-      return;
    }
 
-   // Perform delta transform
-   res[0] = start;
-   for (size_t i = 1; i < len; i++)
-      res[i] = res[i - 1] + ((double)arr[i - 1] / a_args->scale_factor);
+   return res;
+}
 
+/**
+ * @brief Encodes the array restored by a decompression transform and moves
+ * the source pointer past the array it was restored from.
+ * @param a_args Pointer to `algo_args` struct.
+ * @param res Restored array.
+ * @param res_len Length of the restored array in bytes.
+ * @param consumed Number of bytes of the source the array was restored from.
+ */
+static void algo_encode_result(algo_args* a_args, void* res, size_t res_len,
+                               size_t consumed) {
    // Encode using specified encoding format
    a_args->enc_fun(a_args->z, (char**)(&res), res_len, a_args->dest,
                    a_args->dest_len);
 
    // Move to next array
-   *a_args->src += (len * sizeof(uint32_t)) + sizeof(uint16_t) + sizeof(double);
-
-   return;
+   *a_args->src += consumed;
 }
 
-/**
- * @brief Variable Bit Rate (VBR) encoding function for 32-bit floats.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_vbr_32f(void* args)
-{
-   // Parse args
-   algo_args* a_args = (algo_args*)args;
-
-   if (a_args == NULL) {
-      error("algo_encode_vbr_32f: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_encode_vbr_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get source array
-   unsigned char* arr = (unsigned char*)(*a_args->src);
-
-   unsigned char* tmp_arr =
-       arr + sizeof(uint32_t) + sizeof(float) + sizeof(uint32_t);
-
-   // Get array length
-   uint32_t len = *(uint32_t*)(*a_args->src);
-
-   if (len <= 0) {
-      error("algo_encode_vbr_32f: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Allocate buffer
-   void* res = calloc(1, len);
-
-   if (res == NULL) {
-      error("algo_encode_vbr_32f: malloc failed");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   float* res_arr = (float*)res;
-
-   float base_peak_intensity =
-       *(float*)((uint8_t*)(*a_args->src) + sizeof(uint32_t));
-
-   uint32_t num_bytes = *(uint32_t*)((uint8_t*)(*a_args->src) +
-                                     sizeof(uint32_t) + sizeof(float));
+/* Fixed-width deltas of the delta and vdelta transforms: the i-th field of p
+ * rescaled by sf. 24-bit fields are rescaled in single precision whatever
+ * the element type. */
+#define DELTA_FIELD16(T, p, i, sf) ((T)((const uint16_t*)(p))[i] / (sf))
+#define DELTA_FIELD24(T, p, i, sf)                                     \
+   ((float)(uint32_t)(((p)[(i) * 3] << 16) | ((p)[(i) * 3 + 1] << 8) | \
+                      (p)[(i) * 3 + 2]) /                              \
+    (sf))
+#define DELTA_FIELD32(T, p, i, sf) ((T)((const uint32_t*)(p))[i] / (sf))
 
-   double threshold = (double)a_args->scale_factor;
+/* Type the vdelta transforms compute differences in, and the largest field. */
+#define VDELTA_DIFF16(T) T
+#define VDELTA_DIFF24(T) double
+#define VDELTA_MAX16 UINT16_MAX
+#define VDELTA_MAX24 16777215  // UINT24_MAX
 
-   int num_bits = ceil(log2((base_peak_intensity / threshold) + 1));
-
-   if (num_bits == 1)
-      num_bits = 2;  // 1 bit is not enough
-
-   int b = 0;
-
-   int result_index = 0;
-
-   uint64_t tmp_int = 0;
-
-   int tmp_int_bit_index = 0;
-
-   int res_len = (int)ceil(num_bytes * 8);  // in bits
-
-   for (int i = 0; i < res_len; i++) {
-      int value = (tmp_arr[b >> 3] & (1 << (b & 7))) != 0;
-      if (tmp_int_bit_index == num_bits && result_index * 4 < len) {
-         res_arr[result_index] =
-             (float)(tmp_int * base_peak_intensity) / (exp2(num_bits) - 1);
-         result_index++;
-         tmp_int_bit_index = 0;
-      }
-      if (value)
-         tmp_int |= 1 << tmp_int_bit_index;
-      else
-         tmp_int &= ~(1 << tmp_int_bit_index);
-      tmp_int_bit_index++;
-      b++;
-   }
-   if (tmp_int_bit_index == num_bits && result_index * 4 < len) {
-      res_arr[result_index] =
-          (float)(tmp_int * base_peak_intensity) / (exp2(num_bits) - 1);
-      result_index++;
-      tmp_int_bit_index = 0;
-   }
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, &res, len, a_args->dest, a_args->dest_len);
-
-   // Move src pointer
-   *a_args->src +=
-       sizeof(uint32_t) + sizeof(float) + sizeof(uint32_t) + num_bytes;
+static inline void vdelta_put16(unsigned char* dst, long i, double v) {
+   uint16_t q = (uint16_t)floor(v);
+   memcpy(dst + i * sizeof(uint16_t), &q, sizeof(uint16_t));
+}
 
-   // // Free buffer
-   // free(res);
-   return;
+static inline void vdelta_put24(unsigned char* dst, long i, double v) {
+   uint32_t q = floor(v) > VDELTA_MAX24 ? VDELTA_MAX24 : (uint32_t)floor(v);
+   dst[i * 3] = (q >> 16) & 0xFF;
+   dst[i * 3 + 1] = (q >> 8) & 0xFF;
+   dst[i * 3 + 2] = q & 0xFF;
 }
 
 /**
- * @brief Variable Bit Rate (VBR) encoding function for 64-bit doubles.
+ * @brief Lossless transform, the source array is re-encoded untouched.
  * @param args Pointer to `algo_args` struct.
  * @return void
- * 
+ *
  * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
  */
-void algo_encode_vbr_64d(void* args)
-{
+static void algo_decode_lossless(void* args) {
    // Parse args
    algo_args* a_args = (algo_args*)args;
 
-   if (a_args == NULL) {
-      error("algo_encode_vbr_64d: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_encode_vbr_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get source array
-   unsigned char* arr = (unsigned char*)(*a_args->src);
-
-   unsigned char* tmp_arr =
-       arr + sizeof(uint32_t) + sizeof(double) + sizeof(uint32_t);
+   size_t len = 0;
 
-   // Get array length
-   uint32_t len = *(uint32_t*)(*a_args->src);
-
-   if (len <= 0) {
-      error("algo_encode_vbr_64d: len is <= 0");
+   if (a_args->src == NULL) {
+      error("algo_decode_lossless: src is NULL");
       a_args->ret_code = -1;
       return;
    }
 
-   // Allocate buffer
-   void* res = calloc(1, len);
-
-   if (res == NULL) {
-      error("algo_encode_vbr_64d: malloc failed");
+   // Decode using specified encoding format, straight to the staging block
+   if (a_args->dec_fun(a_args->z, *a_args->src, a_args->src_len, a_args->out,
+                       &len)) {
       a_args->ret_code = -1;
       return;
    }
 
-   double* res_arr = (double*)res;
-
-   double base_peak_intensity =
-       *(double*)((uint8_t*)(*a_args->src) + sizeof(uint32_t));
-
-   uint32_t num_bytes = *(uint32_t*)((uint8_t*)(*a_args->src) +
-                                     sizeof(uint32_t) + sizeof(double));
-
-   double threshold = (double)a_args->scale_factor;
-
-   int num_bits = ceil(log2((base_peak_intensity / threshold) + 1));
-
-   if (num_bits == 1)
-      num_bits = 2;  // 1 bit is not enough
-
-   int b = 0;
-
-   int result_index = 0;
-
-   uint64_t tmp_int = 0;
-
-   int tmp_int_bit_index = 0;
-
-   int res_len = (int)ceil(num_bytes * 8);  // in bits
-
-   for (int i = 0; i < res_len; i++) {
-      int value = (tmp_arr[b / 8] & (1 << (b % 8))) != 0;
-      if (tmp_int_bit_index == num_bits && result_index * 8 < len) {
-         res_arr[result_index] =
-             (double)(tmp_int * base_peak_intensity) / (exp2(num_bits) - 1);
-         result_index++;
-         tmp_int_bit_index = 0;
-      }
-      if (value)
-         tmp_int |= 1 << tmp_int_bit_index;
-      else
-         tmp_int &= ~(1 << tmp_int_bit_index);
-      tmp_int_bit_index++;
-      b++;
-   }
-   if (tmp_int_bit_index == num_bits && result_index * 8 < len) {
-      res_arr[result_index] =
-          (double)(tmp_int * base_peak_intensity) / (exp2(num_bits) - 1);
-      result_index++;
-      tmp_int_bit_index = 0;
-   }
-
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, &res, len, a_args->dest, a_args->dest_len);
-
-   // Move src pointer
-   *a_args->src +=
-       sizeof(uint32_t) + sizeof(double) + sizeof(uint32_t) + num_bytes;
-
-   // // Free buffer
-   // free(res);
-   return;
+   algo_decode_commit(a_args, a_args->out->mem + a_args->out->size, len);
 }
 
-/**
- * @brief Bitpack encoding function for 32-bit floats.
- * @param args Pointer to `algo_args` struct.
- * @return void
- * 
- * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
- */
-void algo_encode_bitpack_32f(void* args)
-{
+static void algo_encode_lossless(void* args) {
    // Parse args
    algo_args* a_args = (algo_args*)args;
 
-   if (a_args == NULL) {
-      error("algo_encode_bitpack_32f: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _32f_) {
-      error("algo_encode_bitpack_32f: Unknown data format. Expected _32f_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Get source array
-   unsigned char* arr = (unsigned char*)(*a_args->src);
-
-   unsigned char* tmp_arr =
-       arr + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);
-
-   // Get array length (in bytes)
-   uint32_t len = *(uint32_t*)(*a_args->src) * sizeof(float);
-
-   if (len <= 0) {
-      error("algo_encode_bitpack_32f: len is <= 0");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   // Allocate buffer
-   void* res = calloc(1, len);
-
-   if (res == NULL) {
-      error("algo_encode_bitpack_32f: malloc failed");
+   if (a_args->src == NULL) {
+      error("algo_encode_lossless: src is NULL");
       a_args->ret_code = -1;
       return;
    }
 
-   float* res_arr = (float*)res;
-
-   uint8_t num_bits = *(uint8_t*)((uint8_t*)(*a_args->src) + sizeof(uint32_t));
-
-   uint32_t num_bytes = *(uint32_t*)((uint8_t*)(*a_args->src) +
-                                     sizeof(uint32_t) + sizeof(uint8_t));
-
-   int b = 0;
-
-   int result_index = 0;
-
-   uint64_t tmp_int = 0;
-
-   int tmp_int_bit_index = 0;
-
-   int res_len = (int)ceil(num_bytes * 8);  // in bits
-
-   for (int i = 0; i < res_len; i++) {
-      int value = (tmp_arr[b / 8] & (1 << (b % 8))) != 0;
-      if (tmp_int_bit_index == num_bits && result_index * 4 < len) {
-         res_arr[result_index] =
-             (float)(tmp_int * a_args->scale_factor) / (exp2(num_bits) - 1);
-         result_index++;
-         tmp_int_bit_index = 0;
-      }
-      if (value)
-         tmp_int |= 1 << tmp_int_bit_index;
-      else
-         tmp_int &= ~(1 << tmp_int_bit_index);
-      tmp_int_bit_index++;
-      b++;
-   }
-   if (tmp_int_bit_index == num_bits && result_index * 4 < len) {
-      res_arr[result_index] =
-          (float)(tmp_int * a_args->scale_factor) / (exp2(num_bits) - 1);
-      result_index++;
-      tmp_int_bit_index = 0;
-   }
-
    // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, &res, len, a_args->dest, a_args->dest_len);
-
-   // Move src pointer
-   *a_args->src +=
-       sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t) + num_bytes;
-
-   // // Free buffer
-   // free(res);
-   return;
+   a_args->enc_fun(a_args->z, a_args->src, a_args->src_len, a_args->dest,
+                   a_args->dest_len);
 }
 
 /**
- * @brief Bitpack encoding function for 64-bit doubles.
+ * @brief Cast of 64-bit doubles to 32-bit floats, stored after a float
+ * holding the number of values.
  * @param args Pointer to `algo_args` struct.
  * @return void
- * 
+ *
  * Note: Returns errors via `a_args->ret_code`, which is set to -1 on error and 0 on success.
  */
-void algo_encode_bitpack_64d(void* args)
-{
-   // Parse args
+static void algo_decode_cast32_64d(void* args) {
    algo_args* a_args = (algo_args*)args;
+   char* decoded;
+   size_t decoded_len;
 
-   if (a_args == NULL) {
-      error("algo_encode_bitpack_64d: args is NULL");
-      a_args->ret_code = -1;
-      return;
-   }
-
-   if (a_args->src_format != _64d_) {
-      error("algo_encode_bitpack_64d: Unknown data format. Expected _64d_, got %d", a_args->src_format);
-      a_args->ret_code = -1;
+   if (algo_decode_source(a_args, _64d_, "64d", __func__, &decoded,
+                          &decoded_len))
       return;
-   }
 
-   // Get source array
-   unsigned char* arr = (unsigned char*)(*a_args->src);
+   uint16_t len = decoded_len / sizeof(double);
+   size_t res_len = (len + 1) * sizeof(float);
+   float* res = algo_decode_alloc(a_args, res_len, __func__);
 
-   unsigned char* tmp_arr =
-       arr + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);
+   if (res != NULL) {
+      const double* f = (const double*)decoded;
+      for (long i = 0; i < len; i++) res[i + 1] = (float)f[i];
 
-   // Get array length (in bytes)
-   uint32_t len = *(uint32_t*)(*a_args->src) * sizeof(double);
+      // Store length of array in first 4 bytes
+      res[0] = (float)len;
 
-   if (len <= 0) {
-      error("algo_encode_bitpack_64d: len is <= 0");
-      a_args->ret_code = -1;
-      return;
+      algo_decode_commit(a_args, res, res_len);
    }
+}
 
-   // Allocate buffer
-   void* res = calloc(1, len);
+static void algo_encode_cast32_64d(void* args) {
+   algo_args* a_args = (algo_args*)args;
 
-   if (res == NULL) {
-      error("algo_encode_bitpack_64d: malloc failed");
-      a_args->ret_code = -1;
+   if (algo_encode_check(a_args, _64d_, "64d", __func__))
       return;
-   }
-
-   double* res_arr = (double*)res;
-
-   uint8_t num_bits = *(uint8_t*)((uint8_t*)(*a_args->src) + sizeof(uint32_t));
-
-   uint32_t num_bytes = *(uint32_t*)((uint8_t*)(*a_args->src) +
-                                     sizeof(uint32_t) + sizeof(uint8_t));
 
-   int b = 0;
-
-   int result_index = 0;
+   const float* arr = (const float*)(*a_args->src);
+   uint16_t len = (uint16_t)arr[0];
+   double* res = algo_encode_alloc(a_args, len, sizeof(double), __func__);
 
-   uint64_t tmp_int = 0;
+   if (res == NULL)
+      return;
 
-   int tmp_int_bit_index = 0;
+   for (long i = 0; i < len; i++) res[i] = (double)arr[i + 1];
+
+   algo_encode_result(a_args, res, len * sizeof(double),
+                      (len + 1) * sizeof(float));
+}
+
+/**
+ * @brief Cast to 16-bit unsigned integers of the values times the scale
+ * factor, clipped to UINT16_MAX, after a uint16_t holding their number.
+ */
+#define DEFINE_CAST16(T, sfx)                                                 \
+   static void algo_decode_cast16_##sfx(void* args) {                         \
+      algo_args* a_args = (algo_args*)args;                                   \
+      char* decoded;                                                          \
+      size_t decoded_len;                                                     \
+                                                                              \
+      if (algo_decode_source(a_args, _##sfx##_, #sfx, __func__, &decoded,    \
+                             &decoded_len))                                   \
+         return;                                                              \
+                                                                              \
+      uint16_t len = decoded_len / sizeof(T);                                 \
+      size_t res_len = (len + 1) * sizeof(uint16_t);                          \
+      uint16_t* res = algo_decode_alloc(a_args, res_len, __func__);           \
+                                                                              \
+      if (res != NULL) {                                                      \
+         const T* f = (const T*)decoded;                                      \
+         for (long i = 0; i < len; i++) {                                     \
+            uint64_t q = (uint64_t)(f[i] * a_args->scale_factor);             \
+            res[i + 1] = q > UINT16_MAX ? UINT16_MAX : (uint16_t)q;           \
+         }                                                                    \
+                                                                              \
+         memcpy(res, &len, sizeof(uint16_t));                                 \
+         algo_decode_commit(a_args, res, res_len);                            \
+      }                                                                       \
+   }                                                                          \
+                                                                              \
+   static void algo_encode_cast16_##sfx(void* args) {                         \
+      algo_args* a_args = (algo_args*)args;                                   \
+                                                                              \
+      if (algo_encode_check(a_args, _##sfx##_, #sfx, __func__))               \
+         return;                                                              \
+                                                                              \
+      const uint16_t* arr = (const uint16_t*)(*a_args->src);                  \
+      uint16_t len = arr[0];                                                  \
+      T* res = algo_encode_alloc(a_args, len, sizeof(T), __func__);           \
+                                                                              \
+      if (res == NULL)                                                        \
+         return;                                                              \
+                                                                              \
+      for (long i = 0; i < len; i++)                                          \
+         res[i] = (T)(arr[i + 1] / a_args->scale_factor);                     \
+                                                                              \
+      algo_encode_result(a_args, res, len * sizeof(T),                        \
+                         (len + 1) * sizeof(uint16_t));                       \
+   }
+
+/**
+ * @brief Log2 transform, see log2_quantize_32f(). The 16-bit values follow a
+ * uint16_t holding their number.
+ */
+#define DEFINE_LOG2(T, sfx)                                                   \
+   static void algo_decode_log_2_transform_##sfx(void* args) {                \
+      algo_args* a_args = (algo_args*)args;                                   \
+      char* decoded;                                                          \
+      size_t decoded_len;                                                     \
+                                                                              \
+      if (algo_decode_source(a_args, _##sfx##_, #sfx, __func__, &decoded,    \
+                             &decoded_len))                                   \
+         return;                                                              \
+                                                                              \
+      uint16_t len = decoded_len / sizeof(T);                                 \
+      size_t res_len = (len + 1) * sizeof(uint16_t);                          \
+      uint16_t* res = algo_decode_alloc(a_args, res_len, __func__);           \
+                                                                              \
+      if (res != NULL) {                                                      \
+         log2_quantize_##sfx((const T*)decoded, len, a_args->scale_factor,    \
+                             res + 1);                                        \
+                                                                              \
+         memcpy(res, &len, sizeof(uint16_t));                                 \
+         algo_decode_commit(a_args, res, res_len);                            \
+      }                                                                       \
+   }                                                                          \
+                                                                              \
+   static void algo_encode_log_2_transform_##sfx(void* args) {                \
+      algo_args* a_args = (algo_args*)args;                                   \
+                                                                              \
+      if (algo_encode_check(a_args, _##sfx##_, #sfx, __func__))               \
+         return;                                                              \
+                                                                              \
+      const uint16_t* arr = (const uint16_t*)(*a_args->src);                  \
+      uint16_t len = arr[0];                                                  \
+      T* res = algo_encode_alloc(a_args, len, sizeof(T), __func__);           \
+                                                                              \
+      if (res == NULL)                                                        \
+         return;                                                              \
+                                                                              \
+      exp2_dequantize_##sfx(arr + 1, len, a_args->scale_factor, res);         \
+                                                                              \
+      algo_encode_result(a_args, res, len * sizeof(T),                        \
+                         (len + 1) * sizeof(uint16_t));                       \
+   }
+
+/**
+ * @brief Delta transform with `bits`-wide deltas quantized by the scale
+ * factor (see delta_quantize_32f() for `mode`). The deltas follow a uint16_t
+ * holding the number of values and the first value in full precision.
+ */
+#define DEFINE_DELTA(bits, T, sfx, mode)                                      \
+   static void algo_decode_delta##bits##_transform_##sfx(void* args) {        \
+      algo_args* a_args = (algo_args*)args;                                   \
+      char* decoded;                                                          \
+      size_t decoded_len;                                                     \
+                                                                              \
+      if (algo_decode_source(a_args, _##sfx##_, #sfx, __func__, &decoded,    \
+                             &decoded_len))                                   \
+         return;                                                              \
+                                                                              \
+      uint16_t len = decoded_len / sizeof(T);                                 \
+      size_t res_len = len * (bits / 8) + sizeof(uint16_t) + sizeof(T);       \
+      unsigned char* res = algo_decode_alloc(a_args, res_len, __func__);      \
+                                                                              \
+      if (res != NULL) {                                                      \
+         memcpy(res, &len, sizeof(uint16_t));                                 \
+         memcpy(res + sizeof(uint16_t), decoded, sizeof(T));                  \
+         delta_quantize_##sfx((const T*)decoded, len, a_args->scale_factor,   \
+                              mode, res + sizeof(uint16_t) + sizeof(T));      \
+                                                                              \
+         algo_decode_commit(a_args, res, res_len);                            \
+      }                                                                       \
+   }                                                                          \
+                                                                              \
+   static void algo_encode_delta##bits##_transform_##sfx(void* args) {        \
+      algo_args* a_args = (algo_args*)args;                                   \
+                                                                              \
+      if (algo_encode_check(a_args, _##sfx##_, #sfx, __func__))               \
+         return;                                                              \
+                                                                              \
+      const unsigned char* src = (const unsigned char*)(*a_args->src);        \
+      uint16_t len = *(const uint16_t*)src;                                   \
+      T* res = algo_encode_alloc(a_args, len, sizeof(T), __func__);           \
+                                                                              \
+      if (res == NULL)                                                        \
+         return;                                                              \
+                                                                              \
+      const unsigned char* arr = src + sizeof(uint16_t) + sizeof(T);          \
+      memcpy(res, src + sizeof(uint16_t), sizeof(T));                         \
+      for (long i = 1; i < len; i++)                                          \
+         res[i] = res[i - 1] +                                                \
+                  DELTA_FIELD##bits(T, arr, i - 1, a_args->scale_factor);     \
+                                                                              \
+      algo_encode_result(a_args, res, len * sizeof(T),                        \
+                         len * (bits / 8) + sizeof(uint16_t) + sizeof(T));    \
+   }
+
+/**
+ * @brief Delta transform with `bits`-wide deltas scaled to the largest
+ * difference of the array. The deltas follow a uint16_t holding the number
+ * of values, the first value and the scale factor, both as floats.
+ */
+#define DEFINE_VDELTA(bits, T, sfx)                                           \
+   static void algo_decode_vdelta##bits##_transform_##sfx(void* args) {       \
+      algo_args* a_args = (algo_args*)args;                                   \
+      char* decoded;                                                          \
+      size_t decoded_len;                                                     \
+                                                                              \
+      if (algo_decode_source(a_args, _##sfx##_, #sfx, __func__, &decoded,    \
+                             &decoded_len))                                   \
+         return;                                                              \
+                                                                              \
+      uint16_t len = decoded_len / sizeof(T);                                 \
+      size_t res_len = len * (bits / 8) + sizeof(uint16_t) + 2 * sizeof(float); \
+      unsigned char* res = algo_decode_alloc(a_args, res_len, __func__);      \
+                                                                              \
+      if (res != NULL) {                                                      \
+         const T* f = (const T*)decoded;                                      \
+         unsigned char* dest = res + sizeof(uint16_t) + 2 * sizeof(float);    \
+                                                                              \
+         double diff_max = 0;                                                 \
+         for (long i = 1; i < len; i++) {                                     \
+            VDELTA_DIFF##bits(T) diff = f[i] - f[i - 1];                      \
+            if (diff > diff_max)                                              \
+               diff_max = diff;                                               \
+         }                                                                    \
+                                                                              \
+         float scale_factor = VDELTA_MAX##bits / (float)diff_max;             \
+         float starting = (float)f[0];                                        \
+                                                                              \
+         for (long i = 1; i < len; i++) {                                     \
+            VDELTA_DIFF##bits(T) diff = f[i] - f[i - 1];                      \
+            vdelta_put##bits(dest, i - 1, diff * scale_factor);               \
+         }                                                                    \
+                                                                              \
+         memcpy(res, &len, sizeof(uint16_t));                                 \
+         memcpy(res + sizeof(uint16_t), &starting, sizeof(float));            \
+         memcpy(res + sizeof(uint16_t) + sizeof(float), &scale_factor,        \
+                sizeof(float));                                               \
+         algo_decode_commit(a_args, res, res_len);                            \
+      }                                                                       \
+   }                                                                          \
+                                                                              \
+   static void algo_encode_vdelta##bits##_transform_##sfx(void* args) {       \
+      algo_args* a_args = (algo_args*)args;                                   \
+                                                                              \
+      if (algo_encode_check(a_args, _##sfx##_, #sfx, __func__))               \
+         return;                                                              \
+                                                                              \
+      const unsigned char* src = (const unsigned char*)(*a_args->src);        \
+      uint16_t len = *(const uint16_t*)src;                                   \
+      T* res = algo_encode_alloc(a_args, len, sizeof(T), __func__);           \
+                                                                              \
+      if (res == NULL)                                                        \
+         return;                                                              \
+                                                                              \
+      float start, scale_factor;                                              \
+      memcpy(&start, src + sizeof(uint16_t), sizeof(float));                  \
+      memcpy(&scale_factor, src + sizeof(uint16_t) + sizeof(float),           \
+             sizeof(float));                                                  \
+      const unsigned char* arr = src + sizeof(uint16_t) + 2 * sizeof(float);  \
+                                                                              \
+      res[0] = start;                                                         \
+      for (long i = 1; i < len; i++)                                          \
+         res[i] = res[i - 1] + DELTA_FIELD##bits(T, arr, i - 1, scale_factor); \
+                                                                              \
+      algo_encode_result(a_args, res, len * sizeof(T),                        \
+                         len * (bits / 8) + sizeof(uint16_t) +                \
+                             2 * sizeof(float));                              \
+   }
+
+/**
+ * @brief Variable bit rate transform: each value is stored on the number of
+ * bits needed to tell the base peak intensity apart from the threshold (the
+ * scale factor). The bit stream follows a uint32_t holding the length of the
+ * array in bytes, the base peak intensity and a uint32_t holding the length
+ * of the bit stream.
+ */
+#define DEFINE_VBR(T, sfx)                                                    \
+   static void algo_decode_vbr_##sfx(void* args) {                            \
+      algo_args* a_args = (algo_args*)args;                                   \
+      char* decoded;                                                          \
+      size_t decoded_len;                                                     \
+      size_t header_size = sizeof(uint32_t) + sizeof(T) + sizeof(uint32_t);   \
+                                                                              \
+      if (algo_decode_source(a_args, _##sfx##_, #sfx, __func__, &decoded,    \
+                             &decoded_len))                                   \
+         return;                                                              \
+                                                                              \
+      if (decoded_len + header_size > UINT32_MAX) {                           \
+         error("%s: decoded_len > UINT32_MAX", __func__);                     \
+         a_args->ret_code = -1;                                               \
+         return;                                                              \
+      }                                                                       \
+                                                                              \
+      uint32_t len = (uint32_t)decoded_len;                                   \
+      const T* f = (const T*)decoded;                                         \
+      T threshold = (T)a_args->scale_factor;                                  \
+                                                                              \
+      T base_peak_intensity = 0;                                              \
+      for (uint32_t i = 0; i < len / sizeof(T); i++) {                        \
+         if (f[i] > base_peak_intensity)                                      \
+            base_peak_intensity = f[i];                                       \
+      }                                                                       \
+                                                                              \
+      int num_bits = ceil(log2((base_peak_intensity / threshold) + 1));       \
+      if (num_bits == 1)                                                      \
+         num_bits = 2; /* 1 bit is not enough */                              \
+                                                                              \
+      uint32_t res_len = (int)ceil(len / 4 * num_bits / 8) + header_size + 1; \
+      unsigned char* res = algo_decode_alloc(a_args, res_len, __func__);      \
+                                                                              \
+      if (res != NULL) {                                                      \
+         double max_int = exp2(num_bits) - 1;                                 \
+         bit_writer_t w = {res + header_size, 0, 0};                          \
+                                                                              \
+         for (uint32_t i = 0; i < len / sizeof(T); i++)                       \
+            bits_put_wide(&w, (uint64_t)(f[i] / base_peak_intensity * max_int), \
+                          num_bits);                                          \
+                                                                              \
+         /* Pad the last byte with 0's */                                     \
+         bits_flush(&w);                                                      \
+         uint32_t bytes_used = w.dst - (res + header_size);                   \
+                                                                              \
+         memcpy(res, &len, sizeof(uint32_t));                                 \
+         memcpy(res + sizeof(uint32_t), &base_peak_intensity, sizeof(T));     \
+         memcpy(res + sizeof(uint32_t) + sizeof(T), &bytes_used,              \
+                sizeof(uint32_t));                                            \
+         algo_decode_commit(a_args, res, header_size + bytes_used);           \
+      }                                                                       \
+   }                                                                          \
+                                                                              \
+   static void algo_encode_vbr_##sfx(void* args) {                            \
+      algo_args* a_args = (algo_args*)args;                                   \
+      size_t header_size = sizeof(uint32_t) + sizeof(T) + sizeof(uint32_t);   \
+                                                                              \
+      if (algo_encode_check(a_args, _##sfx##_, #sfx, __func__))               \
+         return;                                                              \
+                                                                              \
+      const unsigned char* src = (const unsigned char*)(*a_args->src);        \
+      uint32_t len = *(const uint32_t*)src;                                   \
+      T* res = algo_encode_alloc(a_args, len, 1, __func__);                   \
+                                                                              \
+      if (res == NULL)                                                        \
+         return;                                                              \
+                                                                              \
+      T base_peak_intensity = *(const T*)(src + sizeof(uint32_t));            \
+      uint32_t num_bytes =                                                    \
+          *(const uint32_t*)(src + sizeof(uint32_t) + sizeof(T));             \
+                                                                              \
+      double threshold = (double)a_args->scale_factor;                        \
+      int num_bits = ceil(log2((base_peak_intensity / threshold) + 1));       \
+      if (num_bits == 1)                                                      \
+         num_bits = 2; /* 1 bit is not enough */                              \
+                                                                              \
+      double max_int = exp2(num_bits) - 1;                                    \
+      bit_reader_t r = {src + header_size, src + header_size + num_bytes, 0,  \
+                        0};                                                   \
+      long n = bits_field_count(num_bytes, num_bits, len / sizeof(T));        \
+                                                                              \
+      for (long i = 0; i < n; i++)                                            \
+         res[i] =                                                             \
+             (T)(bits_get_wide(&r, num_bits) * base_peak_intensity) / max_int; \
+                                                                              \
+      algo_encode_result(a_args, res, len, header_size + num_bytes);          \
+   }
+
+/**
+ * @brief Bit packing transform: values are divided by the scale factor,
+ * clipped to ]0, 1] and stored on 27 bits. The bit stream follows a uint32_t
+ * holding the number of values, a byte holding the number of bits and a
+ * uint32_t holding the length of the bit stream.
+ */
+#define DEFINE_BITPACK(T, sfx)                                                \
+   static void algo_decode_bitpack_##sfx(void* args) {                        \
+      algo_args* a_args = (algo_args*)args;                                   \
+      char* decoded;                                                          \
+      size_t decoded_len;                                                     \
+      size_t header_size =                                                    \
+          sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);              \
+                                                                              \
+      if (algo_decode_source(a_args, _##sfx##_, #sfx, __func__, &decoded,    \
+                             &decoded_len))                                   \
+         return;                                                              \
+                                                                              \
+      if (decoded_len + header_size > UINT32_MAX) {                           \
+         error("%s: decoded_len > UINT32_MAX", __func__);                     \
+         a_args->ret_code = -1;                                               \
+         return;                                                              \
+      }                                                                       \
+                                                                              \
+      uint32_t len = (uint32_t)(decoded_len / sizeof(T));                     \
+      const T* f = (const T*)decoded;                                         \
+      uint8_t num_bits = 27; /* TODO: add as argument */                      \
+                                                                              \
+      uint32_t expected_bytes = (uint32_t)ceil(len * ((T)num_bits / 8));      \
+      uint32_t res_len = expected_bytes + header_size;                        \
+      unsigned char* res = algo_decode_alloc(a_args, res_len, __func__);      \
+                                                                              \
+      if (res != NULL) {                                                      \
+         double max_int = exp2(num_bits) - 1;                                 \
+         bit_writer_t w = {res + header_size, 0, 0};                          \
+                                                                              \
+         for (uint32_t i = 0; i < len; i++) {                                 \
+            T scaled = f[i] / a_args->scale_factor;                           \
+            if (scaled > 1.0)                                                 \
+               scaled = 1.0; /* clipping */                                   \
+            else if (scaled <= 0)                                             \
+               scaled = a_args->scale_factor / max_int; /* smallest value */  \
+            bits_put_wide(&w, (uint64_t)(scaled * max_int), num_bits);        \
+         }                                                                    \
+                                                                              \
+         /* Pad the last byte with 0's */                                     \
+         bits_flush(&w);                                                      \
+         uint32_t bytes_used = w.dst - (res + header_size);                   \
+                                                                              \
+         memcpy(res, &len, sizeof(uint32_t));                                 \
+         memcpy(res + sizeof(uint32_t), &num_bits, sizeof(uint8_t));          \
+         memcpy(res + sizeof(uint32_t) + sizeof(uint8_t), &bytes_used,        \
+                sizeof(uint32_t));                                            \
+         algo_decode_commit(a_args, res, header_size + bytes_used);           \
+      }                                                                       \
+   }                                                                          \
+                                                                              \
+   static void algo_encode_bitpack_##sfx(void* args) {                        \
+      algo_args* a_args = (algo_args*)args;                                   \
+      size_t header_size =                                                    \
+          sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t);              \
+                                                                              \
+      if (algo_encode_check(a_args, _##sfx##_, #sfx, __func__))               \
+         return;                                                              \
+                                                                              \
+      const unsigned char* src = (const unsigned char*)(*a_args->src);        \
+      uint32_t len = *(const uint32_t*)src * sizeof(T); /* in bytes */        \
+      T* res = algo_encode_alloc(a_args, len, 1, __func__);                   \
+                                                                              \
+      if (res == NULL)                                                        \
+         return;                                                              \
+                                                                              \
+      uint8_t num_bits = src[sizeof(uint32_t)];                               \
+      uint32_t num_bytes =                                                    \
+          *(const uint32_t*)(src + sizeof(uint32_t) + sizeof(uint8_t));       \
+                                                                              \
+      double max_int = exp2(num_bits) - 1;                                    \
+      bit_reader_t r = {src + header_size, src + header_size + num_bytes, 0,  \
+                        0};                                                   \
+      long n = bits_field_count(num_bytes, num_bits, len / sizeof(T));        \
+                                                                              \
+      for (long i = 0; i < n; i++)                                            \
+         res[i] = (T)(bits_get_wide(&r, num_bits) * a_args->scale_factor) /   \
+                  max_int;                                                    \
+                                                                              \
+      algo_encode_result(a_args, res, len, header_size + num_bytes);          \
+   }
+
+/**
+ * @brief Instantiates every transform for an element type. `delta16_mode`
+ * is how 16-bit deltas are stored (wrapped for floats, clipped for doubles).
+ */
+#define DEFINE_TRANSFORMS(T, sfx, delta16_mode) \
+   DEFINE_CAST16(T, sfx)                        \
+   DEFINE_LOG2(T, sfx)                          \
+   DEFINE_DELTA(16, T, sfx, delta16_mode)       \
+   DEFINE_DELTA(24, T, sfx, DELTA_CLIP24)       \
+   DEFINE_DELTA(32, T, sfx, DELTA_WRAP32)       \
+   DEFINE_VDELTA(16, T, sfx)                    \
+   DEFINE_VDELTA(24, T, sfx)                    \
+   DEFINE_VBR(T, sfx)                           \
+   DEFINE_BITPACK(T, sfx)
+
+DEFINE_TRANSFORMS(float, 32f, DELTA_WRAP16)
+DEFINE_TRANSFORMS(double, 64d, DELTA_CLIP16)
 
-   int res_len = (int)ceil(num_bytes * 8);  // in bits
+/*
+    @section Algo switch
+*/
 
-   for (int i = 0; i < res_len; i++) {
-      int value = (tmp_arr[b / 8] & (1 << (b % 8))) != 0;
-      if (tmp_int_bit_index == num_bits && result_index * 8 < len) {
-         res_arr[result_index] =
-             (double)(tmp_int * a_args->scale_factor) / (exp2(num_bits) - 1);
-         result_index++;
-         tmp_int_bit_index = 0;
-      }
-      if (value)
-         tmp_int |= 1 << tmp_int_bit_index;
-      else
-         tmp_int &= ~(1 << tmp_int_bit_index);
-      tmp_int_bit_index++;
-      b++;
-   }
-   if (tmp_int_bit_index == num_bits && result_index * 8 < len) {
-      res_arr[result_index] =
-          (double)(tmp_int * a_args->scale_factor) / (exp2(num_bits) - 1);
-      result_index++;
-      tmp_int_bit_index = 0;
+/* Columns of the transform table, one per element type. */
+enum { ALGO_32F, ALGO_64D, ALGO_TYPES };
+
+typedef struct {
+   Algo compress[ALGO_TYPES];
+   Algo decompress[ALGO_TYPES];
+} algo_table_t;
+
+#define ALGO_ROW(name)                                              \
+   {{algo_decode_##name##_32f, algo_decode_##name##_64d},           \
+    {algo_encode_##name##_32f, algo_encode_##name##_64d}}
+
+/* Transforms by algorithm (offset by _lossless_). Casting 32 to 32 is just
+ * lossless. */
+static const algo_table_t algo_table[] = {
+    [_lossless_ - _lossless_] = {{algo_decode_lossless, algo_decode_lossless},
+                                 {algo_encode_lossless, algo_encode_lossless}},
+    [_cast_64_to_32_ - _lossless_] =
+        {{algo_decode_lossless, algo_decode_cast32_64d},
+         {algo_encode_lossless, algo_encode_cast32_64d}},
+    [_cast_64_to_16_ - _lossless_] = ALGO_ROW(cast16),
+    [_log2_transform_ - _lossless_] = ALGO_ROW(log_2_transform),
+    [_delta16_transform_ - _lossless_] = ALGO_ROW(delta16_transform),
+    [_delta24_transform_ - _lossless_] = ALGO_ROW(delta24_transform),
+    [_delta32_transform_ - _lossless_] = ALGO_ROW(delta32_transform),
+    [_vdelta16_transform_ - _lossless_] = ALGO_ROW(vdelta16_transform),
+    [_vdelta24_transform_ - _lossless_] = ALGO_ROW(vdelta24_transform),
+    [_vbr_ - _lossless_] = ALGO_ROW(vbr),
+    [_bitpack_ - _lossless_] = ALGO_ROW(bitpack),
+};
+
+/**
+ * @brief Returns the row of the transform table of an algorithm and the
+ * column of an accession.
+ * @param algo The compression algorithm type.
+ * @param accession The data type accession.
+ * @param type Set to the column of the accession.
+ * @return The row, or NULL if the algorithm or accession type is unknown.
+ */
+static const algo_table_t* get_algo_entry(int algo, int accession, int* type) {
+   switch (accession) {
+      case _32f_:
+         *type = ALGO_32F;
+         break;
+      case _64d_:
+         *type = ALGO_64D;
+         break;
+      default:
+         // Lossless leaves the data untouched, whatever its type.
+         if (algo != _lossless_)
+            return NULL;
+         *type = ALGO_32F;
    }
 
-   // Encode using specified encoding format
-   a_args->enc_fun(a_args->z, &res, len, a_args->dest, a_args->dest_len);
-
-   // Move src pointer
-   *a_args->src +=
-       sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t) + num_bytes;
+   if (algo < _lossless_ ||
+       algo - _lossless_ >= (int)(sizeof(algo_table) / sizeof(algo_table[0])))
+      return NULL;
 
-   // // Free buffer
-   // free(res);
-   return;
+   return &algo_table[algo - _lossless_];
 }
 
-/*
-    @section Algo switch
-*/
-
 /**
  * @brief Returns the appropriate compression algorithm function pointer based on the provided algorithm and accession type.
  * @param algo The compression algorithm type.
@@ -3298,94 +911,15 @@ void algo_encode_bitpack_64d(void* args)
  * @return A function pointer to the corresponding compression algorithm. If the algorithm or accession type is unknown, it returns NULL and logs an error.
  */
 Algo set_compress_algo(int algo, int accession) {
-   switch (algo) {
-      case _lossless_:
-         return algo_decode_lossless;
-      case _log2_transform_: {
-         switch (accession) {
-            case _32f_:
-               return algo_decode_log_2_transform_32f;
-            case _64d_:
-               return algo_decode_log_2_transform_64d;
-         }
-      };
-      case _cast_64_to_32_: {
-         switch (accession) {
-            case _64d_:
-               return algo_decode_cast32_64d;
-            case _32f_:
-               return algo_decode_lossless;  // casting 32 to 32 is just
-                                             // lossless
-         }
-      };
-      case _cast_64_to_16_: {
-         switch (accession) {
-            case _64d_:
-               return algo_decode_cast16_64d;
-            case _32f_:
-               return algo_decode_cast16_32f;
-         }
-      };
-      case _delta16_transform_: {
-         switch (accession) {
-            case _32f_:
-               return algo_decode_delta16_transform_32f;
-            case _64d_:
-               return algo_decode_delta16_transform_64d;
-         }
-      };
-      case _delta24_transform_: {
-         switch (accession) {
-            case _32f_:
-               return algo_decode_delta24_transform_32f;
-            case _64d_:
-               return algo_decode_delta24_transform_64d;
-         }
-      };
-      case _delta32_transform_: {
-         switch (accession) {
-            case _32f_:
-               return algo_decode_delta32_transform_32f;
-            case _64d_:
-               return algo_decode_delta32_transform_64d;
-         }
-      };
-      case _vdelta16_transform_: {
-         switch (accession) {
-            case _32f_:
-               return algo_decode_vdelta16_transform_32f;
-            case _64d_:
-               return algo_decode_vdelta16_transform_64d;
-         }
-      };
-      case _vdelta24_transform_: {
-         switch (accession) {
-            case _32f_:
-               return algo_decode_vdelta24_transform_32f;
-            case _64d_:
-               return algo_decode_vdelta24_transform_64d;
-         }
-      };
-      case _vbr_: {
-         switch (accession) {
-            case _32f_:
-               return algo_decode_vbr_32f;
-            case _64d_:
-               return algo_decode_vbr_64d;
-         }
-      };
-      case _bitpack_: {
-         switch (accession) {
-            case _32f_:
-               return algo_decode_bitpack_32f;
-            case _64d_:
-               return algo_decode_bitpack_64d;
-         }
-      };
-      default:
-         error("set_compress_algo: Unknown compression algorithm");
-         return NULL;
+   int type;
+   const algo_table_t* entry = get_algo_entry(algo, accession, &type);
+
+   if (entry == NULL || entry->compress[type] == NULL) {
+      error("set_compress_algo: Unknown compression algorithm");
+      return NULL;
    }
+
+   return entry->compress[type];
 }
 
 /**
@@ -3395,94 +929,15 @@ Algo set_compress_algo(int algo, int accession) {
  * @return A function pointer to the corresponding decompression algorithm. If the algorithm or accession type is unknown, it returns NULL and logs an error.
  */
 Algo set_decompress_algo(int algo, int accession) {
-   switch (algo) {
-      case _lossless_:
-         return algo_encode_lossless;
-      case _log2_transform_: {
-         switch (accession) {
-            case _32f_:
-               return algo_encode_log_2_transform_32f;
-            case _64d_:
-               return algo_encode_log_2_transform_64d;
-         }
-      };
-      case _cast_64_to_32_: {
-         switch (accession) {
-            case _64d_:
-               return algo_encode_cast32_64d;
-            case _32f_:
-               return algo_encode_lossless;  // casting 32 to 32 is just
-                                             // lossless
-         }
-      };
-      case _cast_64_to_16_: {
-         switch (accession) {
-            case _64d_:
-               return algo_encode_cast16_64d;
-            case _32f_:
-               return algo_encode_cast16_32f;
-         }
-      }
-      case _delta16_transform_: {
-         switch (accession) {
-            case _32f_:
-               return algo_encode_delta16_transform_32f;
-            case _64d_:
-               return algo_encode_delta16_transform_64d;
-         }
-      };
-      case _delta24_transform_: {
-         switch (accession) {
-            case _32f_:
-               return algo_encode_delta24_transform_32f;
-            case _64d_:
-               return algo_encode_delta24_transform_64d;
-         }
-      };
-      case _delta32_transform_: {
-         switch (accession) {
-            case _32f_:
-               return algo_encode_delta32_transform_32f;
-            case _64d_:
-               return algo_encode_delta32_transform_64d;
-         }
-      };
-      case _vdelta16_transform_: {
-         switch (accession) {
-            case _32f_:
-               return algo_encode_vdelta16_transform_32f;
-            case _64d_:
-               return algo_encode_vdelta16_transform_64d;
-         }
-      };
-      case _vdelta24_transform_: {
-         switch (accession) {
-            case _32f_:
-               return algo_encode_vdelta24_transform_32f;
-            case _64d_:
-               return algo_encode_vdelta24_transform_64d;
-         }
-      };
-      case _vbr_: {
-         switch (accession) {
-            case _32f_:
-               return algo_encode_vbr_32f;
-            case _64d_:
-               return algo_encode_vbr_64d;
-         }
-      };
-      case _bitpack_: {
-         switch (accession) {
-            case _32f_:
-               return algo_encode_bitpack_32f;
-            case _64d_:
-               return algo_encode_bitpack_64d;
-         }
-      };
-      default:
-         error("set_decompress_algo: Unknown compression algorithm");
-         return NULL;
+   int type;
+   const algo_table_t* entry = get_algo_entry(algo, accession, &type);
+
+   if (entry == NULL || entry->decompress[type] == NULL) {
+      error("set_decompress_algo: Unknown compression algorithm");
+      return NULL;
    }
+
+   return entry->decompress[type];
 }
 
 /**
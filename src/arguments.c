@@ -50,6 +50,35 @@ void init_args(Arguments* args) {
    args->target_inten_format = _ZSTD_compression_;  // default
 
    args->zstd_compression_level = 3;  // default
+
+   args->chrom_time_lossy = "lossless";  // default
+   args->chrom_int_lossy = "lossless";   // default
+   args->chrom_time_scale_factor = 0;
+   args->chrom_int_scale_factor = 0;
+
+   args->metadata_flags = METADATA_FLAGS;  // default: capture all columns
+   args->describe_metadata = 0;
+
+   args->max_pending = 0;  // default: 2 * threads
+
+   args->zlib_engine = DEFLATE_ONESHOT;         // default
+   args->zlib_level = Z_DEFAULT_COMPRESSION;    // default
+
+   args->target_binary_encoding = 0;  // default: original
+
+   args->rt_range = NULL;
+
+   args->frame_size = 256e+3;  // default
+
+   args->cache_size = 1e+9;  // default
+
+   args->xic_mz = NULL;
+   args->xic_length = 0;
+   args->xic_ppm = 10;  // default
+
+   args->tic_only = 0;
+
+   args->cpu = SIMD_AUTO;  // default
 }
 
 /**
@@ -131,6 +160,328 @@ int set_int_lossy(Arguments* args, const char* int_lossy) {
    return 0;  // Indicate success
 }
 
+/**
+* @brief Sets the lossy compression algorithm for chromatogram time arrays.
+* Accepts the same algorithms and default scale factors as set_mz_lossy().
+* @param args A pointer to the `Arguments` struct.
+* @param time_lossy The name of the lossy compression algorithm to set.
+* @return Returns 0 on success, 1 on error.
+*/
+int set_chrom_time_lossy(Arguments* args, const char* time_lossy) {
+   Arguments tmp;
+
+   init_args(&tmp);
+   if (set_mz_lossy(&tmp, time_lossy))
+      return 1;
+
+   args->chrom_time_lossy = tmp.mz_lossy;
+   args->chrom_time_scale_factor = tmp.mz_scale_factor;
+   return 0;
+}
+
+/**
+* @brief Sets the lossy compression algorithm for chromatogram intensity
+* arrays. Accepts the same algorithms and default scale factors as
+* set_int_lossy().
+* @param args A pointer to the `Arguments` struct.
+* @param int_lossy The name of the lossy compression algorithm to set.
+* @return Returns 0 on success, 1 on error.
+*/
+int set_chrom_int_lossy(Arguments* args, const char* int_lossy) {
+   Arguments tmp;
+
+   init_args(&tmp);
+   if (set_int_lossy(&tmp, int_lossy))
+      return 1;
+
+   args->chrom_int_lossy = tmp.int_lossy;
+   args->chrom_int_scale_factor = tmp.int_scale_factor;
+   return 0;
+}
+
+/**
+* @brief Sets which per-spectrum metadata columns are captured during
+* compression.
+* @param args A pointer to the `Arguments` struct.
+* @param columns Comma separated list of precursor, charge, tic, basepeak,
+* isolation, or one of all/none.
+* @return Returns 0 on success, 1 on error.
+*/
+int set_metadata_flags(Arguments* args, const char* columns) {
+   static const struct {
+      const char* name;
+      int flags;
+   } names[] = {{"all", METADATA_FLAGS}, {"none", 0},
+                {"precursor", PRECURSOR_MZ}, {"charge", CHARGE},
+                {"tic", TIC}, {"basepeak", BASE_PEAK},
+                {"isolation", ISOLATION}};
+   int flags = 0;
+   const char* ptr = columns;
+   size_t len, i;
+
+   while (*ptr) {
+      len = strcspn(ptr, ",");
+      for (i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+         if (strlen(names[i].name) == len &&
+             strncmp(ptr, names[i].name, len) == 0)
+            break;
+      if (i == sizeof(names) / sizeof(names[0])) {
+         fprintf(stderr, "Invalid metadata column: %.*s\n", (int)len, ptr);
+         return 1;  // Indicate error
+      }
+      flags |= names[i].flags;
+      ptr += len;
+      if (*ptr == ',')
+         ptr++;
+   }
+
+   args->metadata_flags = flags;
+   return 0;  // Indicate success
+}
+
+/**
+* @brief Sets the deflate backend used to re-encode zlib compressed arrays.
+* @param args A pointer to the `Arguments` struct.
+* @param engine "oneshot" or "stream".
+* @return Returns 0 on success, 1 on error.
+*/
+int set_zlib_engine(Arguments* args, const char* engine) {
+   if (strcmp(engine, "oneshot") == 0)
+      args->zlib_engine = DEFLATE_ONESHOT;
+   else if (strcmp(engine, "stream") == 0)
+      args->zlib_engine = DEFLATE_STREAM;
+   else {
+      fprintf(stderr, "Invalid zlib engine: %s\n", engine);
+      return 1;  // Indicate error
+   }
+   return 0;  // Indicate success
+}
+
+/**
+* @brief Sets the level used to re-encode zlib compressed arrays. Levels other
+* than the default (-1) do not reproduce the original mzML byte for byte.
+* @param args A pointer to the `Arguments` struct.
+* @param level "default" or a level between 0 and 9.
+* @return Returns 0 on success, 1 on error.
+*/
+int set_zlib_level(Arguments* args, const char* level) {
+   char* end;
+   long l;
+
+   if (strcmp(level, "default") == 0) {
+      args->zlib_level = Z_DEFAULT_COMPRESSION;
+      return 0;  // Indicate success
+   }
+
+   l = strtol(level, &end, 10);
+   if (*level == '\0' || *end != '\0' || l < Z_DEFAULT_COMPRESSION ||
+       l > Z_BEST_COMPRESSION) {
+      fprintf(stderr, "Invalid zlib level: %s\n", level);
+      return 1;  // Indicate error
+   }
+   args->zlib_level = (int)l;
+   return 0;  // Indicate success
+}
+
+/**
+* @brief Sets the instruction set of the vector kernels, overriding the one
+* detected from the CPU (e.g. to benchmark each kernel).
+* @param args A pointer to the `Arguments` struct.
+* @param cpu "auto", "scalar", "sse2", "avx2" or "avx512".
+* @return Returns 0 on success, 1 on error.
+*/
+int set_cpu(Arguments* args, const char* cpu) {
+   if (strcmp(cpu, "auto") == 0) {
+      args->cpu = SIMD_AUTO;
+      return 0;  // Indicate success
+   }
+   for (int level = SIMD_SCALAR; level <= SIMD_AVX512; level++)
+      if (strcmp(cpu, get_simd_level_name(level)) == 0) {
+         args->cpu = level;
+         return 0;  // Indicate success
+      }
+   fprintf(stderr, "Invalid cpu: %s\n", cpu);
+   return 1;  // Indicate error
+}
+
+/**
+* @brief Sets the compression of binary arrays written on decompression and
+* extraction. The cvParam and encodedLength of each array are rewritten to
+* match.
+* @param args A pointer to the `Arguments` struct.
+* @param encoding "none", "zlib", or "original".
+* @return Returns 0 on success, 1 on error.
+*/
+int set_target_binary_encoding(Arguments* args, const char* encoding) {
+   if (strcmp(encoding, "none") == 0)
+      args->target_binary_encoding = _no_comp_;
+   else if (strcmp(encoding, "zlib") == 0)
+      args->target_binary_encoding = _zlib_;
+   else if (strcmp(encoding, "original") == 0)
+      args->target_binary_encoding = 0;
+   else {
+      fprintf(stderr, "Invalid target binary encoding: %s\n", encoding);
+      return 1;  // Indicate error
+   }
+   return 0;  // Indicate success
+}
+
+/**
+* @brief Selects spectra by retention time for extraction.
+* @param args A pointer to the `Arguments` struct.
+* @param range "start-end" in minutes (eg. 30-45).
+* @return Returns 0 on success, 1 on error.
+*/
+int set_rt_range(Arguments* args, const char* range) {
+   char *sep, *end;
+   float start, stop;
+
+   start = strtof(range, &sep);
+   if (sep == range || *sep != '-') {
+      fprintf(stderr, "Invalid retention time range: %s\n", range);
+      return 1;  // Indicate error
+   }
+   stop = strtof(sep + 1, &end);
+   if (end == sep + 1 || *end != '\0' || stop < start) {
+      fprintf(stderr, "Invalid retention time range: %s\n", range);
+      return 1;  // Indicate error
+   }
+
+   args->rt_range = malloc(2 * sizeof(float));
+   if (args->rt_range == NULL) {
+      fprintf(stderr, "set_rt_range: malloc failed\n");
+      return 1;  // Indicate error
+   }
+   args->rt_range[0] = start;
+   args->rt_range[1] = stop;
+   return 0;  // Indicate success
+}
+
+/**
+* @brief Selects the target m/z of extracted-ion chromatograms.
+* @param args A pointer to the `Arguments` struct.
+* @param targets Comma separated m/z values (eg. 445.12,524.26).
+* @return Returns 0 on success, 1 on error.
+*/
+int set_xic(Arguments* args, const char* targets) {
+   const char* p = targets;
+   char* end;
+   long n = 1;
+
+   for (; *p; p++)
+      if (*p == ',')
+         n++;
+
+   args->xic_mz = malloc(n * sizeof(double));
+   if (args->xic_mz == NULL) {
+      fprintf(stderr, "set_xic: malloc failed\n");
+      return 1;  // Indicate error
+   }
+
+   p = targets;
+   for (args->xic_length = 0; args->xic_length < n; args->xic_length++) {
+      args->xic_mz[args->xic_length] = strtod(p, &end);
+      if (end == p || args->xic_mz[args->xic_length] <= 0 ||
+          (*end != ',' && *end != '\0')) {
+         fprintf(stderr, "Invalid XIC m/z list: %s\n", targets);
+         free(args->xic_mz);
+         args->xic_mz = NULL;
+         args->xic_length = 0;
+         return 1;  // Indicate error
+      }
+      p = end + 1;
+   }
+   return 0;  // Indicate success
+}
+
+/**
+* @brief Sets the half width of extracted-ion chromatogram windows.
+* @param args A pointer to the `Arguments` struct.
+* @param ppm Tolerance in parts per million of each target m/z.
+* @return Returns 0 on success, 1 on error.
+*/
+int set_xic_ppm(Arguments* args, const char* ppm) {
+   char* end;
+   double r = strtod(ppm, &end);
+
+   if (end == ppm || *end != '\0' || r < 0) {
+      fprintf(stderr, "Invalid ppm tolerance: %s\n", ppm);
+      return 1;  // Indicate error
+   }
+   args->xic_ppm = r;
+   return 0;  // Indicate success
+}
+
+/**
+* @brief Parses a size with a KB, MB or GB suffix.
+* @param size The string to parse (eg. 256KB).
+* @return The size in bytes, -1 on error.
+*/
+static long parse_size(const char* size) {
+   char* end;
+   long r;
+
+   r = strtol(size, &end, 10);
+   if (end == size)
+      return -1;
+   if (strcmp(end, "KB") == 0 || strcmp(end, "kb") == 0)
+      return r * 1e+3;
+   if (strcmp(end, "MB") == 0 || strcmp(end, "mb") == 0)
+      return r * 1e+6;
+   if (strcmp(end, "GB") == 0 || strcmp(end, "gb") == 0)
+      return r * 1e+9;
+   return -1;
+}
+
+/**
+* @brief Sets the size of the frames blocks are split in. Frames are
+* decompressed independently, so extracting a spectrum only decompresses the
+* frames covering it. Only applies to zstd and uncompressed blocks.
+* @param args A pointer to the `Arguments` struct.
+* @param size A size (xKB, xMB), or "none" to store one frame per block.
+* @return Returns 0 on success, 1 on error.
+*/
+int set_frame_size(Arguments* args, const char* size) {
+   long frame_size;
+
+   if (strcmp(size, "none") == 0 || strcmp(size, "0") == 0) {
+      args->frame_size = 0;
+      return 0;  // Indicate success
+   }
+
+   frame_size = parse_size(size);
+   if (frame_size <= 0 || frame_size > UINT32_MAX) {
+      fprintf(stderr, "Invalid frame size: %s\n", size);
+      return 1;  // Indicate error
+   }
+   args->frame_size = frame_size;
+   return 0;  // Indicate success
+}
+
+/**
+* @brief Sets the amount of decompressed blocks kept in memory during
+* extraction. Least recently used blocks are released past this size.
+* @param args A pointer to the `Arguments` struct.
+* @param size A size (xKB, xMB, xGB), or "none" to keep every block.
+* @return Returns 0 on success, 1 on error.
+*/
+int set_cache_size(Arguments* args, const char* size) {
+   long cache_size;
+
+   if (strcmp(size, "none") == 0) {
+      args->cache_size = 0;
+      return 0;  // Indicate success
+   }
+
+   cache_size = parse_size(size);
+   if (cache_size <= 0) {
+      fprintf(stderr, "Invalid cache size: %s\n", size);
+      return 1;  // Indicate error
+   }
+   args->cache_size = cache_size;
+   return 0;  // Indicate success
+}
+
 /**
 * @brief Parses a scale factor from a string.
 * @param scale_factor_str The string containing the scale factor.
@@ -196,6 +547,8 @@ int set_compress_runtime_variables(Arguments* args, data_format_t* df) {
    int mz_fmt = get_algo_type(args->mz_lossy);
    int inten_fmt = get_algo_type(args->int_lossy);
 
+   get_simd_level();  // Detect before the compression threads use it.
+
    if (mz_fmt == -1) {
       error("set_compress_runtime_variables: Invalid mz lossy compression type: %s\n",
               args->mz_lossy);
@@ -247,6 +600,9 @@ int set_compress_runtime_variables(Arguments* args, data_format_t* df) {
    // Set ZSTD compression level.
    df->zstd_compression_level = args->zstd_compression_level;
 
+   // Set frame size.
+   df->frame_size = args->frame_size;
+
    // Set scale factor.
    df->mz_scale_factor = args->mz_scale_factor;
    df->int_scale_factor = args->int_scale_factor;
@@ -254,6 +610,36 @@ int set_compress_runtime_variables(Arguments* args, data_format_t* df) {
    return 0;
 }
 
+/**
+ * @brief Sets the compression runtime variables of the chromatogram data
+ * format. Chromatogram time arrays take the place of m/z arrays.
+ * @param args A pointer to the `Arguments` struct.
+ * @param df A pointer to the chromatogram `data_format_t` struct.
+ * @return Returns 0 on success, 1 on error.
+ */
+int set_chrom_compress_runtime_variables(Arguments* args, data_format_t* df) {
+   Arguments chrom_args;
+
+   if (args == NULL || df == NULL) {
+      error("NULL passed to set_chrom_compress_runtime_variables\n");
+      return 1;
+   }
+
+   if (args->chrom_time_lossy == NULL)
+      args->chrom_time_lossy = "lossless";
+   if (args->chrom_int_lossy == NULL)
+      args->chrom_int_lossy = "lossless";
+
+   chrom_args = *args;
+   chrom_args.mz_lossy = args->chrom_time_lossy;
+   chrom_args.int_lossy = args->chrom_int_lossy;
+   chrom_args.mz_scale_factor = args->chrom_time_scale_factor;
+   chrom_args.int_scale_factor = args->chrom_int_scale_factor;
+   chrom_args.frame_size = 0;  // Chromatogram streams are read whole.
+
+   return set_compress_runtime_variables(&chrom_args, df);
+}
+
 /**
  * @brief Sets the decompression runtime variables for the given data format and footer. This function initializes the decompression functions based on the target formats specified in the footer.
  * @param df A pointer to the data_format_t struct to set the decompression variables for
@@ -264,9 +650,14 @@ int set_compress_runtime_variables(Arguments* args, data_format_t* df) {
 int set_decompress_runtime_variables(data_format_t* df, footer_t* msz_footer) {
    // Set target encoding and decompression functions.
    df->encode_source_compression_mz_fun = set_encode_fun(
-       df->source_compression, msz_footer->mz_fmt, df->source_mz_fmt);
+       df->output_compression, msz_footer->mz_fmt, df->source_mz_fmt);
    df->encode_source_compression_inten_fun = set_encode_fun(
-       df->source_compression, msz_footer->inten_fmt, df->source_mz_fmt);
+       df->output_compression, msz_footer->inten_fmt, df->source_inten_fmt);
+
+   df->no_encode_mz_fun =
+       set_encode_fun(_no_encode_, msz_footer->mz_fmt, df->source_mz_fmt);
+   df->no_encode_inten_fun = set_encode_fun(
+       _no_encode_, msz_footer->inten_fmt, df->source_inten_fmt);
 
    if (df->encode_source_compression_mz_fun == NULL ||
        df->encode_source_compression_inten_fun == NULL) {
@@ -0,0 +1,317 @@
+/**
+ * @file cache.c
+ * @author Chris Grams (chrisagrams@gmail.com)
+ * @brief Byte-bounded LRU cache of decompressed blocks. Extraction stores
+ * decompressed (block_len_t->cache) and re-encoded (encoded_cache) blocks on
+ * the block_len_t itself; a block_cache_t attached to the block queues keeps
+ * the least recently used blocks under a byte limit. Blocks are pinned while
+ * in use so their buffers are never freed under a caller. Every cache
+ * operation takes the cache's lock, and threads filling the same block are
+ * serialized by block_cache_lock_block() so a block is decompressed once.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright
+ *
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mscompress.h"
+
+struct block_cache_sync_t {
+#ifdef _WIN32
+   CRITICAL_SECTION lock;
+   CONDITION_VARIABLE block_done;  // Signaled when a busy block is released.
+#else
+   pthread_mutex_t lock;
+   pthread_cond_t block_done;
+#endif
+};
+
+#ifdef _WIN32
+static void cache_lock(block_cache_t* c) {
+   EnterCriticalSection(&c->sync->lock);
+}
+static void cache_unlock(block_cache_t* c) {
+   LeaveCriticalSection(&c->sync->lock);
+}
+static void cache_wait(block_cache_t* c) {
+   SleepConditionVariableCS(&c->sync->block_done, &c->sync->lock, INFINITE);
+}
+static void cache_broadcast(block_cache_t* c) {
+   WakeAllConditionVariable(&c->sync->block_done);
+}
+#else
+static void cache_lock(block_cache_t* c) { pthread_mutex_lock(&c->sync->lock); }
+static void cache_unlock(block_cache_t* c) {
+   pthread_mutex_unlock(&c->sync->lock);
+}
+static void cache_wait(block_cache_t* c) {
+   pthread_cond_wait(&c->sync->block_done, &c->sync->lock);
+}
+static void cache_broadcast(block_cache_t* c) {
+   pthread_cond_broadcast(&c->sync->block_done);
+}
+#endif
+
+static size_t cached_bytes(block_len_t* blk) {
+   size_t r = 0;
+
+   if (blk->cache != NULL)
+      r += blk->original_size;
+   if (blk->encoded_cache != NULL)
+      r += blk->encoded_cache_len;
+   return r;
+}
+
+static void lru_unlink(block_cache_t* cache, block_len_t* blk) {
+   if (blk->lru_prev)
+      blk->lru_prev->lru_next = blk->lru_next;
+   else
+      cache->head = blk->lru_next;
+
+   if (blk->lru_next)
+      blk->lru_next->lru_prev = blk->lru_prev;
+   else
+      cache->tail = blk->lru_prev;
+
+   blk->lru_prev = NULL;
+   blk->lru_next = NULL;
+}
+
+static void lru_push_front(block_cache_t* cache, block_len_t* blk) {
+   blk->lru_prev = NULL;
+   blk->lru_next = cache->head;
+   if (cache->head)
+      cache->head->lru_prev = blk;
+   cache->head = blk;
+   if (cache->tail == NULL)
+      cache->tail = blk;
+}
+
+static void evict(block_cache_t* cache, block_len_t* blk) {
+   lru_unlink(cache, blk);
+
+   free(blk->cache);
+   free(blk->frames_decoded);
+   free(blk->encoded_cache);
+   free(blk->encoded_cache_lens);
+   blk->cache = NULL;
+   blk->frames_decoded = NULL;
+   blk->encoded_cache = NULL;
+   blk->encoded_cache_lens = NULL;
+   blk->encoded_cache_len = 0;
+   blk->encoded_cache_fmt = 0;
+
+   cache->used -= blk->cached_size;
+   cache->evictions++;
+
+   blk->cached_size = 0;
+   blk->block_cache = NULL;
+}
+
+static void detach(block_cache_t* cache, block_len_t* blk) {
+   lru_unlink(cache, blk);
+   cache->used -= blk->cached_size;
+   blk->cached_size = 0;
+   blk->block_cache = NULL;
+}
+
+static void charge(block_cache_t* cache, block_len_t* blk) {
+   size_t size = cached_bytes(blk);
+
+   cache->used += size - blk->cached_size;
+   blk->cached_size = size;
+}
+
+static void shrink(block_cache_t* cache) {
+   block_len_t* curr = cache->tail;
+   block_len_t* prev;
+
+   if (cache->limit == 0)
+      return;
+
+   while (cache->used > cache->limit && curr != NULL) {
+      prev = curr->lru_prev;
+      if (curr->pins == 0)
+         evict(cache, curr);
+      curr = prev;
+   }
+}
+
+block_cache_t* alloc_block_cache(size_t limit)
+/**
+ * @brief Allocates an empty block cache.
+ *
+ * @param limit Bytes of decompressed data to keep, 0 for no limit. Blocks
+ * larger than the limit are released as soon as they are unpinned.
+ *
+ * @return A block_cache_t on success, NULL on error.
+ */
+{
+   block_cache_t* r = calloc(1, sizeof(block_cache_t));
+
+   if (r == NULL) {
+      error("alloc_block_cache: malloc failure.\n");
+      return NULL;
+   }
+   r->sync = malloc(sizeof(struct block_cache_sync_t));
+   if (r->sync == NULL) {
+      error("alloc_block_cache: malloc failure.\n");
+      free(r);
+      return NULL;
+   }
+#ifdef _WIN32
+   InitializeCriticalSection(&r->sync->lock);
+   InitializeConditionVariable(&r->sync->block_done);
+#else
+   pthread_mutex_init(&r->sync->lock, NULL);
+   pthread_cond_init(&r->sync->block_done, NULL);
+#endif
+   r->limit = limit;
+   return r;
+}
+
+void dealloc_block_cache(block_cache_t* cache)
+/**
+ * @brief Releases every block held by the cache and frees it. Queues sharing
+ * the cache must be detached (queue->cache = NULL) by the caller.
+ */
+{
+   if (cache == NULL)
+      return;
+   while (cache->tail != NULL) evict(cache, cache->tail);
+#ifdef _WIN32
+   DeleteCriticalSection(&cache->sync->lock);
+#else
+   pthread_mutex_destroy(&cache->sync->lock);
+   pthread_cond_destroy(&cache->sync->block_done);
+#endif
+   free(cache->sync);
+   free(cache);
+}
+
+void set_block_cache_limit(block_cache_t* cache, size_t limit) {
+   cache_lock(cache);
+   cache->limit = limit;
+   shrink(cache);
+   cache_unlock(cache);
+}
+
+void block_cache_pin(block_cache_t* cache, block_len_t* blk)
+/**
+ * @brief Marks blk as in use and most recently used. blk->cache and
+ * blk->encoded_cache stay valid until the matching block_cache_unpin(). Counts
+ * a hit if the block is already decompressed, a miss otherwise.
+ *
+ * @param cache Cache of the block's queue. Does nothing if NULL.
+ */
+{
+   if (cache == NULL || blk == NULL)
+      return;
+
+   cache_lock(cache);
+
+   if (blk->block_cache == cache && blk->cached_size > 0)
+      cache->hits++;
+   else
+      cache->misses++;
+
+   if (blk->block_cache == cache)
+      lru_unlink(cache, blk);
+   else {
+      if (blk->block_cache != NULL)
+         detach(blk->block_cache, blk);  // Held by another cache.
+      blk->block_cache = cache;
+   }
+   lru_push_front(cache, blk);
+
+   blk->pins++;
+
+   cache_unlock(cache);
+}
+
+void block_cache_unpin(block_cache_t* cache, block_len_t* blk)
+/**
+ * @brief Releases a pin taken by block_cache_pin(), charges the block's
+ * current size to the cache and evicts least recently used blocks that are
+ * not pinned until the cache is within its limit.
+ */
+{
+   if (cache == NULL || blk == NULL || blk->block_cache != cache)
+      return;
+
+   cache_lock(cache);
+
+   if (blk->pins > 0)
+      blk->pins--;
+
+   if (!blk->busy)
+      charge(cache, blk);
+
+   shrink(cache);
+
+   cache_unlock(cache);
+}
+
+void block_cache_remove(block_len_t* blk)
+/**
+ * @brief Detaches blk from its cache without freeing its buffers (e.g. before
+ * the block itself is freed).
+ */
+{
+   block_cache_t* cache = blk->block_cache;
+
+   if (cache == NULL)
+      return;
+
+   cache_lock(cache);
+   detach(cache, blk);
+   cache_unlock(cache);
+}
+
+void block_cache_lock_block(block_len_t* blk)
+/**
+ * @brief Waits until no other thread is filling blk, then reserves it. Taken
+ * around decompressing (decmp_block_range()) or encoding a pinned block, so a
+ * block requested by several threads is decompressed by the first one and
+ * found decompressed by the others. Does nothing if blk is not held by a
+ * cache.
+ */
+{
+   block_cache_t* cache = blk->block_cache;
+
+   if (cache == NULL)
+      return;
+
+   cache_lock(cache);
+   while (blk->busy) cache_wait(cache);
+   blk->busy = 1;
+   cache_unlock(cache);
+}
+
+void block_cache_unlock_block(block_len_t* blk)
+/**
+ * @brief Releases a block reserved by block_cache_lock_block() and charges
+ * what was decompressed to the cache.
+ */
+{
+   block_cache_t* cache = blk->block_cache;
+
+   if (cache == NULL)
+      return;
+
+   cache_lock(cache);
+   blk->busy = 0;
+   charge(cache, blk);
+   shrink(cache);
+   cache_broadcast(cache);
+   cache_unlock(cache);
+}
@@ -298,6 +298,7 @@ compress_args_t* alloc_compress_args(char* input_map, data_positions_t* dp,
    r->mode = mode;
 
    r->ret = NULL;
+   r->spectrum_ends = NULL;
 
    return r;
 }
@@ -306,14 +307,91 @@ void dealloc_compress_args(compress_args_t* args) {
    if (args) {
       if (args->ret)
          dealloc_cmp_buff(args->ret);
+      free(args->spectrum_ends);
       free(args);
    }
 }
 
+static cmp_block_t* compress_block(compression_fun compression_fun,
+                                   ZSTD_CCtx* czstd, int compression_level,
+                                   size_t frame_size, data_block_t* block,
+                                   size_t* cmp_len)
+/**
+ * @brief Compresses a data block into a cmp_block_t. If frame_size is set and
+ * compressed frames can be concatenated (zstd, no compression), the block is
+ * compressed as independent frames of frame_size bytes and their ends are
+ * recorded, so readers can decompress part of the block (see
+ * decmp_block_range()). The concatenated frames still decompress as one block.
+ *
+ * @return A cmp_block_t on success, NULL on error.
+ */
+{
+   cmp_block_t* r;
+   uint64_t* frame_ends;
+   uint32_t n_frames, i;
+   size_t frame_len, out_off = 0;
+   char *out, *frame;
+
+   if (frame_size == 0 || block->size <= frame_size ||
+       (compression_fun != zstd_compress && compression_fun != no_compress)) {
+      out = compression_fun(czstd, block->mem, block->size, cmp_len,
+                            compression_level);
+      if (out == NULL)
+         return NULL;
+      return alloc_cmp_block(out, *cmp_len, block->size);
+   }
+
+   n_frames = (block->size + frame_size - 1) / frame_size;
+
+   out = malloc(compression_fun == zstd_compress
+                    ? n_frames * ZSTD_compressBound(frame_size)
+                    : block->size);
+   frame_ends = malloc(n_frames * sizeof(uint64_t));
+   if (out == NULL || frame_ends == NULL) {
+      error("compress_block: malloc() error.\n");
+      free(out);
+      free(frame_ends);
+      return NULL;
+   }
+
+   for (i = 0; i < n_frames; i++) {
+      frame_len = block->size - i * frame_size;
+      if (frame_len > frame_size)
+         frame_len = frame_size;
+
+      frame = compression_fun(czstd, block->mem + i * frame_size, frame_len,
+                              cmp_len, compression_level);
+      if (frame == NULL) {
+         free(out);
+         free(frame_ends);
+         return NULL;
+      }
+      memcpy(out + out_off, frame, *cmp_len);
+      free(frame);
+
+      out_off += *cmp_len;
+      frame_ends[i] = out_off;
+   }
+
+   *cmp_len = out_off;
+
+   r = alloc_cmp_block(out, out_off, block->size);
+   if (r == NULL) {
+      free(out);
+      free(frame_ends);
+      return NULL;
+   }
+   r->frame_size = frame_size;
+   r->frame_ends = frame_ends;
+   r->n_frames = n_frames;
+
+   return r;
+}
+
 void cmp_routine(compression_fun compression_fun, ZSTD_CCtx* czstd,
-                 int compression_level, cmp_blk_queue_t* cmp_buff,
-                 data_block_t** curr_block, char* input, size_t len,
-                 size_t* tot_size, size_t* tot_cmp)
+                 int compression_level, size_t frame_size,
+                 cmp_blk_queue_t* cmp_buff, data_block_t** curr_block,
+                 char* input, size_t len, size_t* tot_size, size_t* tot_cmp)
 /**
  * @brief A routine to compress an XML block.
  * Given an offset within an .mzML document and length, this function will
@@ -325,6 +403,8 @@ void cmp_routine(compression_fun compression_fun, ZSTD_CCtx* czstd,
  * @param czstd A ZSTD compression context allocated by alloc_cctx() (one per
  * thread).
  *
+ * @param frame_size Size of the frames a block is split in, 0 for one frame.
+ *
  * @param cmp_buff A dereferenced pointer to the cmp_buff vector.
  *
  * @param curr_block Current data block to append to and/or compress.
@@ -343,7 +423,6 @@ void cmp_routine(compression_fun compression_fun, ZSTD_CCtx* czstd,
  *
  */
 {
-   void* cmp;
    cmp_block_t* cmp_block;
    size_t cmp_len = 0;
    size_t prev_size = 0;
@@ -351,10 +430,8 @@ void cmp_routine(compression_fun compression_fun, ZSTD_CCtx* czstd,
    data_block_t* tmp_block = *curr_block;
 
    if (!append_mem((*curr_block), input, len)) {
-      cmp = compression_fun(czstd, (*curr_block)->mem, (*curr_block)->size,
-                            &cmp_len, compression_level);
-
-      cmp_block = alloc_cmp_block(cmp, cmp_len, (*curr_block)->size);
+      cmp_block = compress_block(compression_fun, czstd, compression_level,
+                                 frame_size, *curr_block, &cmp_len);
 
       // print("\t||  [Block %05d]       %011ld       %011ld   %05.02f%%  ||\n",
       // cmp_buff->populated, (*curr_block)->size, cmp_len,
@@ -382,6 +459,7 @@ void cmp_routine(compression_fun compression_fun, ZSTD_CCtx* czstd,
  * @param compression_fun A function pointer to the compression function to be used.
  * @param czstd A ZSTD compression context allocated by alloc_cctx() (one per thread).
  * @param compression_level An integer representing the compression level.
+ * @param frame_size Size of the frames a block is split in, 0 for one frame.
  * @param cmp_buff A dereferenced pointer to the cmp_buff vector.
  * @param curr_block Current data block to append to and/or compress.
  * @param tot_size A pass-by-reference variable to bookkeep total number of XML bytes processed.
@@ -389,10 +467,10 @@ void cmp_routine(compression_fun compression_fun, ZSTD_CCtx* czstd,
  * @return 0 on success, -1 on error.
  */
 int cmp_flush(compression_fun compression_fun, ZSTD_CCtx* czstd,
-               int compression_level, cmp_blk_queue_t* cmp_buff,
-               data_block_t** curr_block, size_t* tot_size, size_t* tot_cmp)
+               int compression_level, size_t frame_size,
+               cmp_blk_queue_t* cmp_buff, data_block_t** curr_block,
+               size_t* tot_size, size_t* tot_cmp)
 {
-   void* cmp;
    cmp_block_t* cmp_block;
    size_t cmp_len = 0;
 
@@ -401,10 +479,8 @@ int cmp_flush(compression_fun compression_fun, ZSTD_CCtx* czstd,
       return -1;
    }
 
-   cmp = compression_fun(czstd, (*curr_block)->mem, (*curr_block)->size,
-                         &cmp_len, compression_level);
-
-   cmp_block = alloc_cmp_block(cmp, cmp_len, (*curr_block)->size);
+   cmp_block = compress_block(compression_fun, czstd, compression_level,
+                              frame_size, *curr_block, &cmp_len);
    if (cmp_block == NULL) {
       error("cmp_flush: Failed to allocate cmp_block.\n");
       return -1;
@@ -463,6 +539,7 @@ void cmp_dump(cmp_blk_queue_t* cmp_buff, block_len_queue_t* blk_len_queue,
       front = pop_cmp_block(cmp_buff);
 
       append_block_len(blk_len_queue, front->original_size, front->size);
+      set_block_len_frames(blk_len_queue, front);
 
       start = get_time();
       write_cmp_blk(front, fd);
@@ -489,8 +566,11 @@ void cmp_xml_routine(compression_fun compression_fun, ZSTD_CCtx* czstd,
  * @brief cmp_routine wrapper for XML data.
  */
 {
-   cmp_routine(compression_fun, czstd, df->zstd_compression_level, cmp_buff,
-               curr_block, input, len, tot_size, tot_cmp);
+   (void)a_args;
+
+   cmp_routine(compression_fun, czstd, df->zstd_compression_level,
+               df->frame_size, cmp_buff, curr_block, input, len, tot_size,
+               tot_cmp);
 }
 
 void cmp_binary_routine(compression_fun compression_fun, ZSTD_CCtx* czstd,
@@ -501,14 +581,20 @@ void cmp_binary_routine(compression_fun compression_fun, ZSTD_CCtx* czstd,
 /**
  * @brief cmp_routine wrapper for binary data.
  *        Decodes base64 binary with encoding specified within df->compression
- * before compression.
+ * and applies the target transform. The decoder and the transform write
+ * straight to the end of curr_block, so the array is not copied again.
  */
 {
+   // Arrays are staged in curr_block and compressed by the caller.
+   (void)compression_fun;
+   (void)czstd;
+   (void)cmp_buff;
+   (void)tot_size;
+   (void)tot_cmp;
+
    size_t binary_len = 0;
    char* binary_buff = NULL;
 
-   // df->decode_source_compression_fun(input, len, &binary_buff, &binary_len);
-
    if (a_args == NULL)
       error("cmp_binary_routine: Failed to allocate algo_args.\n");
 
@@ -516,18 +602,12 @@ void cmp_binary_routine(compression_fun compression_fun, ZSTD_CCtx* czstd,
    a_args->src_len = len;
    a_args->dest = &binary_buff;
    a_args->dest_len = &binary_len;
-   a_args->src_format = df->source_mz_fmt;  // TODO: This is a hack. Need to
-                                            // fix.
+   a_args->out = *curr_block;
 
    df->target_mz_fun((void*)a_args);  // TODO: This is a hack. Need to fix.
 
-   if (binary_buff == NULL)
-      error("cmp_binary_routine: binary_buff is NULL\n");
-
-   cmp_routine(compression_fun, czstd, df->zstd_compression_level, cmp_buff,
-               curr_block, binary_buff, binary_len, tot_size, tot_cmp);
-
-   free(binary_buff);
+   if (a_args->ret_code != 0 || binary_buff == NULL)
+      error("cmp_binary_routine: Failed to decode binary.\n");
 }
 
 #ifdef _WIN32
@@ -570,8 +650,8 @@ void* compress_routine(void* args)
       return NULL;
    }
 
-   a_args->z =
-       alloc_z_stream();  // Allocate a z_stream to intermediately store data.
+   a_args->z = alloc_z_stream(
+       cb_args->df);  // Allocate a z_stream to intermediately store data.
 
    if (a_args->z == NULL) {
       error("compress_routine: Failed to allocate z_stream.\n");
@@ -602,14 +682,21 @@ void* compress_routine(void* args)
 
    if (cb_args->mode == _xml_)
       cmp_fun = cmp_xml_routine;
-   else
+   else {
       cmp_fun = cmp_binary_routine;
+      // Record where each spectrum ends in the decompressed stream so readers
+      // can transform a single spectrum (see write_spectrum_index()).
+      cb_args->spectrum_ends =
+          malloc(cb_args->dp->total_spec * sizeof(uint64_t));
+   }
 
    if (cb_args->mode == _mass_) {
       a_args->dec_fun = cb_args->df->decode_source_compression_mz_fun;
+      a_args->src_format = cb_args->df->source_mz_fmt;
       a_args->scale_factor = cb_args->df->mz_scale_factor;
    } else if (cb_args->mode == _intensity_) {
       a_args->dec_fun = cb_args->df->decode_source_compression_inten_fun;
+      a_args->src_format = cb_args->df->source_inten_fmt;
       a_args->scale_factor = cb_args->df->int_scale_factor;
    } else if (cb_args->mode == _xml_)
       a_args->dec_fun = NULL;
@@ -629,15 +716,16 @@ void* compress_routine(void* args)
 
       char* map = cb_args->input_map + cb_args->dp->start_positions[i];
 
-      if (len == 0)
-         continue;  // Skip empty data blocks (e.g. empty spectra)
+      if (len > 0)  // Skip empty data blocks (e.g. empty spectra)
+         cmp_fun(cb_args->comp_fun, czstd, a_args, cmp_buff, &curr_block,
+                 cb_args->df, map, len, &tot_size, &tot_cmp);
 
-      cmp_fun(cb_args->comp_fun, czstd, a_args, cmp_buff, &curr_block,
-              cb_args->df, map, len, &tot_size, &tot_cmp);
+      if (cb_args->spectrum_ends != NULL)
+         cb_args->spectrum_ends[i] = tot_size + curr_block->size;
    }
 
    cmp_flush(cb_args->comp_fun, czstd, cb_args->df->zstd_compression_level,
-             cmp_buff, &curr_block, &tot_size,
+             cb_args->df->frame_size, cmp_buff, &curr_block, &tot_size,
              &tot_cmp); /* Flush remainder datablocks */
 
    print(
@@ -676,6 +764,7 @@ block_len_queue_t* compress_parallel(char* input_map, data_positions_t** ddp,
 
    int divisions_used = 0;
    int divisions_left = divisions;
+   int single_block;
 
    for (i = divisions_used; i < divisions; i++) {
       compress_args_t* i_args = alloc_compress_args(input_map, ddp[i], df, comp_fun,
@@ -722,7 +811,14 @@ block_len_queue_t* compress_parallel(char* input_map, data_positions_t** ddp,
 #endif
 
       for (i = divisions_used; i < divisions_used + threads; i++) {
+         // Spectrum ends are only meaningful if the division is one block.
+         single_block = args[i]->ret != NULL && args[i]->ret->populated == 1;
          cmp_dump(args[i]->ret, blk_len_queue, fd);
+         if (single_block && args[i]->spectrum_ends != NULL) {
+            blk_len_queue->tail->spectrum_ends = args[i]->spectrum_ends;
+            blk_len_queue->tail->n_spectra = args[i]->dp->total_spec;
+            args[i]->spectrum_ends = NULL;
+         }
          dealloc_compress_args(args[i]);
       }
       divisions_used += threads;
@@ -731,6 +827,62 @@ block_len_queue_t* compress_parallel(char* input_map, data_positions_t** ddp,
    return blk_len_queue;
 }
 
+/**
+ * @brief Compresses the chromatogram time and intensity arrays into their own
+ * binary streams. Block lengths are stored in chrom->time_block_lens and
+ * chrom->inten_block_lens, stream positions and formats in chrom->footer.
+ * @param input_map A mmap pointer to the .mzML file.
+ * @param arguments A pointer to the `Arguments` struct.
+ * @param chrom Chromatograms found by scan_chromatograms().
+ * @param blocksize The blocksize used for the spectra streams.
+ * @param output_fd File descriptor to write compressed blocks to.
+ * @return 0 on success, 1 on error.
+ */
+static int compress_chromatograms(char* input_map, Arguments* arguments,
+                                  chromatograms_t* chrom, long blocksize,
+                                  int output_fd) {
+   data_format_t* df = chrom->df;
+   data_positions_t* dp;
+
+   if (set_chrom_compress_runtime_variables(arguments, df))
+      return 1;
+
+   chrom->footer = calloc(1, sizeof(footer_t));
+   if (chrom->footer == NULL) {
+      error("compress_chromatograms: Failed to allocate footer.\n");
+      return 1;
+   }
+
+   chrom->footer->mz_fmt = get_algo_type(arguments->chrom_time_lossy);
+   chrom->footer->inten_fmt = get_algo_type(arguments->chrom_int_lossy);
+   chrom->footer->num_spectra = df->source_total_spec;
+   chrom->footer->original_filesize = chrom->division->size;
+   chrom->footer->n_divisions = 1;
+
+   print("\t===chromatogram time binary===\n");
+   chrom->footer->mz_binary_pos = get_offset(output_fd);
+   df->target_mz_fun =
+       set_compress_algo(chrom->footer->mz_fmt, df->source_mz_fmt);
+   dp = chrom->division->mz;
+   chrom->time_block_lens = compress_parallel(
+       input_map, &dp, df, df->mz_compression_fun, blocksize, blocksize / 3,
+       _mass_, 1, 1, output_fd);
+
+   print("\t===chromatogram int binary===\n");
+   chrom->footer->inten_binary_pos = get_offset(output_fd);
+   df->target_mz_fun =
+       set_compress_algo(chrom->footer->inten_fmt, df->source_inten_fmt);
+   dp = chrom->division->inten;
+   chrom->inten_block_lens = compress_parallel(
+       input_map, &dp, df, df->inten_compression_fun, blocksize,
+       blocksize / 3, _intensity_, 1, 1, output_fd);
+
+   if (chrom->time_block_lens == NULL || chrom->inten_block_lens == NULL)
+      return 1;
+
+   return 0;
+}
+
 void compress_mzml(char* input_map, size_t input_filesize, Arguments* arguments,
                    data_format_t* df, divisions_t* divisions, int output_fd) {
    // Initialize footer to all 0's to not write garbage to file.
@@ -739,6 +891,8 @@ void compress_mzml(char* input_map, size_t input_filesize, Arguments* arguments,
    block_len_queue_t *xml_block_lens, *mz_binary_block_lens,
        *inten_binary_block_lens;
 
+   sections_t* sections;
+
    data_positions_t **xml_divisions = join_xml(divisions),
                     **mz_divisions = join_mz(divisions),
                     **inten_divisions = join_inten(divisions);
@@ -784,13 +938,28 @@ void compress_mzml(char* input_map, size_t input_filesize, Arguments* arguments,
    print("\t===int binary===\n");
    footer->inten_binary_pos = get_offset(output_fd);
    df->target_mz_fun = set_compress_algo(
-       footer->inten_fmt, df->source_mz_fmt);  // TODO, rename target_mz_fun
+       footer->inten_fmt, df->source_inten_fmt);  // TODO, rename target_mz_fun
    inten_binary_block_lens = compress_parallel(
        (char*)input_map, inten_divisions, df, df->inten_compression_fun,
        blocksize, blocksize / 3, _intensity_, divisions->n_divisions, threads,
        output_fd); /* Compress int binary */
    free(inten_divisions);
 
+   if (divisions->chromatograms != NULL &&
+       compress_chromatograms(input_map, arguments, divisions->chromatograms,
+                              blocksize, output_fd)) {
+      error("compress_mzml: Failed to compress chromatograms.\n");
+      return;
+   }
+
+   // Write frame index before the block tables are freed by
+   // dump_block_len_queue().
+   sections = alloc_sections();
+   block_len_queue_t* frame_queues[] = {xml_block_lens, mz_binary_block_lens,
+                                        inten_binary_block_lens};
+   write_frame_index(frame_queues, 3, sections, output_fd);
+   write_spectrum_index(frame_queues + 1, 2, sections, output_fd);
+
    // Dump block_len_queue to msz file.
    footer->xml_blk_pos = get_offset(output_fd);
    dump_block_len_queue(xml_block_lens, output_fd);
@@ -805,6 +974,20 @@ void compress_mzml(char* input_map, size_t input_filesize, Arguments* arguments,
    footer->divisions_t_pos = get_offset(fds[1]);
    write_divisions(divisions, fds[1]);
 
+   // Write optional sections to file.
+   if (divisions->chromatograms != NULL)
+      write_chromatograms(divisions->chromatograms, sections, fds[1]);
+   if (divisions->metadata != NULL) {
+      if (complete_tic_metadata(input_map, df, divisions, threads))
+         warning("compress_mzml: Failed to compute missing TIC values.\n");
+      write_metadata(divisions->metadata, sections,
+                     arguments->zstd_compression_level, fds[1]);
+   }
+   write_ret_times(divisions, sections, fds[1]);
+   write_secondary_indexes(divisions, sections, fds[1]);
+   write_sections(sections, fds[1]);
+   dealloc_sections(sections);
+
    // Write footer to file.
    footer->original_filesize = input_filesize;
    footer->n_divisions =
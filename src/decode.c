@@ -20,6 +20,8 @@
 #include "libbase64.h"
 #include "mscompress.h"
 
+#define DECODE_CHUNK 16384  // Base64 characters decoded per inflate() call.
+
 char* base64_alloc(size_t size) {
    char* r;
 
@@ -53,198 +55,214 @@ void decode_base64(char* src, char* dest, size_t src_len, size_t* out_len)
             b64_ret);
 }
 
-void decode_zlib_fun(z_stream* z, char* src, size_t src_len, char** dest,
-                     size_t* out_len, data_block_t* tmp)
+static int inflate_base64(z_stream* z, char* src, size_t src_len,
+                          data_block_t* dest, size_t offset, size_t* out_len)
+/**
+ * @brief Base64 decodes and inflates a zlib compressed string in a single
+ * pass. The string is base64 decoded DECODE_CHUNK characters at a time into a
+ * buffer on the stack, which is inflated straight to the end of dest. No
+ * intermediate copy of the compressed or decompressed array is made.
+ *
+ * @param z A z_stream allocated by alloc_z_stream().
+ *
+ * @param offset Number of bytes left free before the decompressed data.
+ *
+ * @param out_len Set to the length of the decompressed data.
+ *
+ * @return 0 on success, -1 on error.
+ */
+{
+   struct base64_state state;
+   char chunk[DECODE_CHUNK / 4 * 3];
+   size_t chunk_len, n, avail;
+   size_t pos = dest->size + offset;
+   z_stream* inf = zlib_inflate_stream(z);
+   int ret = Z_OK;
+
+   if (inf == NULL)
+      return -1;
+
+   base64_stream_decode_init(&state, 0);
+
+   for (size_t i = 0; i < src_len && ret != Z_STREAM_END; i += n) {
+      n = src_len - i < DECODE_CHUNK ? src_len - i : DECODE_CHUNK;
+
+      if (base64_stream_decode(&state, src + i, n, chunk, &chunk_len) != 1) {
+         error("inflate_base64: base64_stream_decode returned with an error.\n");
+         return -1;
+      }
+
+      inf->next_in = (Bytef*)chunk;
+      inf->avail_in = (uInt)chunk_len;
+
+      do {
+         // Keep room for at least a chunk's worth of output.
+         if (reserve_data_block(dest, offset + inf->total_out + DECODE_CHUNK) ==
+             NULL)
+            return -1;
+
+         avail = dest->max_size - pos - inf->total_out;
+         inf->next_out = (Bytef*)dest->mem + pos + inf->total_out;
+         inf->avail_out = avail > UINT32_MAX ? UINT32_MAX : (uInt)avail;
+
+         ret = inflate(inf, Z_NO_FLUSH);
+
+         if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            error("inflate_base64: inflate returned with an error. (%d)\n",
+                  ret);
+            return -1;
+         }
+      } while (inf->avail_out == 0 && ret != Z_STREAM_END);
+   }
+
+   *out_len = inf->total_out;
+
+   return 0;
+}
+
+int decode_zlib_fun(z_stream* z, char* src, size_t src_len,
+                    data_block_t* dest, size_t* out_len)
 /**
  * @brief Decodes an mzML binary block with "zlib" encoding.
- *        Decodes base64 string, zlib decodes the string, and appends resulting
- * binary buffer with the length of the buffer stored within the first
- * ZLIB_SIZE_OFFSET bytes of the buffer. Decoded binary data starts at
- * b64_out_buff + ZLIB_SIZE_OFFSET.
+ *        Base64 decodes and inflates the string to the end of dest, with the
+ * length of the binary stored within the first ZLIB_SIZE_OFFSET bytes.
+ * Decoded binary data starts at dest->mem + dest->size + ZLIB_SIZE_OFFSET.
  *
- * @param input_map Pointer representing mmap'ed mzML file.
+ * @param z A z_stream allocated by alloc_z_stream().
  *
- * @param start_position Position of first byte of <binary> block.
+ * @param src Pointer to beginning of base64 string.
  *
- * @param end_position Position of last byte of </binary> block.
+ * @param src_len Length of base64 string.
  *
- * @param out_len Contains resulting buffer size on return.
+ * @param dest Data block to decode to, grown if needed. Its size is left
+ * unchanged.
  *
- * @param tmp Pointer to data_block_t struct used for temporary storage.
+ * @param out_len Contains resulting buffer size on return.
  *
- * @return A malloc'ed buffer with first ZLIB_SIZE_OFFSET bytes containing
- * length of decoded binary and resulting decoded binary buffer.
+ * @return 0 on success, -1 on error.
  */
 {
-   if (src == NULL)
-      error("decode_zlib_fun: src is NULL.\n");
+   ZLIB_TYPE header;
+   size_t decmp_size = 0;
 
-   if (src_len <= 0)
-      error("decode_zlib_fun: src_len is <= 0.\n");
+   if (src == NULL || src_len == 0) {
+      error("decode_zlib_fun: src is empty.\n");
+      return -1;
+   }
 
-   if (dest == NULL)
+   if (dest == NULL || out_len == NULL) {
       error("decode_zlib_fun: dest is NULL.\n");
+      return -1;
+   }
 
-   if (out_len == NULL)
-      error("decode_zlib_fun: out_len is NULL.\n");
-
-   if (tmp == NULL)
-      error("decode_zlib_fun: tmp is NULL.\n");
-
-   if (z == NULL)
-      error("decode_zlib_fun: z is NULL.\n");
-
-   size_t b64_out_len = 0;
-
-   // char* b64_out_buff = base64_alloc(sizeof(char) * src_len);
-
-   if (tmp->max_size < src_len)
-      realloc_data_block(tmp, src_len);
-
-   char* b64_out_buff = tmp->mem;
-
-   decode_base64(src, b64_out_buff, src_len, &b64_out_len);
-
-   if (b64_out_buff == NULL)
-      error("decode_zlib_fun: base64_decode returned with an error.\n");
-
-   zlib_block_t* decmp_output = zlib_alloc(ZLIB_SIZE_OFFSET);
-
-   ZLIB_TYPE decmp_size =
-       (ZLIB_TYPE)zlib_decompress(z, b64_out_buff, decmp_output, b64_out_len);
-
-   int zlib_ret = zlib_append_header(decmp_output, &decmp_size, ZLIB_SIZE_OFFSET);
-   if (zlib_ret != 0)
-      error("decode_zlib_fun: zlib_append_header returned with an error.\n");
+   if (inflate_base64(z, src, src_len, dest, ZLIB_SIZE_OFFSET, &decmp_size))
+      return -1;
 
-   // free(b64_out_buff);
+   header = (ZLIB_TYPE)decmp_size;
+   memcpy(dest->mem + dest->size, &header, ZLIB_SIZE_OFFSET);
 
    *out_len = decmp_size + ZLIB_SIZE_OFFSET;
 
-   *dest = (char*)decmp_output->mem;
-
-   free(decmp_output);
+   return 0;
 }
 
-void decode_zlib_fun_no_header(z_stream* z, char* src, size_t src_len,
-                               char** dest, size_t* out_len,
-                               data_block_t* tmp) {
-   /**
-    * @brief Decodes a zlib compressed buffer without header and stores the
-    * output in a new buffer.
-    *
-    * This function takes a zlib compressed buffer without header, decodes it,
-    * and stores the output in a newly allocated buffer. The input buffer must
-    * be a base64 encoded string, which will be decoded before decompression.
-    *
-    * @param z Pointer to a zlib stream object.
-    * @param src Pointer to the source buffer containing the compressed data.
-    * @param src_len Length of the source buffer in bytes.
-    * @param dest Pointer to the destination buffer where the decompressed data
-    * will be stored.
-    * @param out_len Pointer to a variable where the size of the decompressed
-    * data will be stored.
-    * @param tmp Pointer to a data_block_t object used as a temporary buffer.
-    *
-    * @return None.
-    *
-    * @note The caller is responsible for freeing the destination buffer after
-    * use.
-    * @note The temporary buffer will be reallocated if its size is smaller than
-    * the size of the source buffer.
-    * @note This function will terminate the program with an error message if
-    * any of the input parameters are NULL or invalid.
-    */
-   if (src == NULL)
-      error("decode_zlib_fun_no_header: src is NULL.\n");
-
-   if (src_len <= 0)
-      error("decode_zlib_fun_no_header: src_len is <= 0.\n");
-
-   if (dest == NULL)
-      error("decode_zlib_fun_no_header: dest is NULL.\n");
-
-   if (out_len == NULL)
-      error("decode_zlib_fun_no_header: out_len is NULL.\n");
-
-   if (z == NULL)
-      error("decode_zlib_fun: z is NULL.\n");
-
-   size_t b64_out_len = 0;
-
-   if (tmp->max_size < src_len)
-      realloc_data_block(tmp, src_len);
-
-   char* b64_out_buff = tmp->mem;
-
-   decode_base64(src, b64_out_buff, src_len, &b64_out_len);
-
-   if (b64_out_buff == NULL)
-      error(
-          "decode_zlib_fun_no_header: base64_decode returned with an error.\n");
-
-   zlib_block_t* decmp_output = zlib_alloc(0);
-
-   ZLIB_TYPE decmp_size =
-       (ZLIB_TYPE)zlib_decompress(z, b64_out_buff, decmp_output, b64_out_len);
-
-   // free(b64_out_buff);
-
-   *out_len = decmp_size;
+int decode_zlib_fun_no_header(z_stream* z, char* src, size_t src_len,
+                              data_block_t* dest, size_t* out_len)
+/**
+ * @brief Decodes an mzML binary block with "zlib" encoding to the end of
+ * dest, without a length header.
+ *
+ * @param z A z_stream allocated by alloc_z_stream().
+ *
+ * @param src Pointer to beginning of base64 string.
+ *
+ * @param src_len Length of base64 string.
+ *
+ * @param dest Data block to decode to, grown if needed. Its size is left
+ * unchanged.
+ *
+ * @param out_len Contains resulting buffer size on return.
+ *
+ * @return 0 on success, -1 on error.
+ */
+{
+   if (src == NULL || src_len == 0) {
+      error("decode_zlib_fun_no_header: src is empty.\n");
+      return -1;
+   }
 
-   *dest = (char*)decmp_output->mem;
+   if (dest == NULL || out_len == NULL) {
+      error("decode_zlib_fun_no_header: dest is NULL.\n");
+      return -1;
+   }
 
-   free(decmp_output);
+   return inflate_base64(z, src, src_len, dest, 0, out_len);
 }
 
-void decode_no_comp_fun_w_header(z_stream* z, char* src, size_t src_len,
-                                 char** dest, size_t* out_len,
-                                 data_block_t* tmp)
+int decode_no_comp_fun_w_header(z_stream* z, char* src, size_t src_len,
+                                data_block_t* dest, size_t* out_len)
 /**
  * @brief Decodes an mzML binary block with "no comp" encoding.
- *        Decodes base64 string and appends a binary buffer with the length of
- * the buffer stored within the first ZLIB_SIZE_OFFSET bytes of the buffer.
- *        Decoded binary data starts at b64_out_buff + ZLIB_SIZE_OFFSET.
+ *        Base64 decodes the string to the end of dest, with the length of the
+ * binary stored within the first ZLIB_SIZE_OFFSET bytes. Decoded binary data
+ * starts at dest->mem + dest->size + ZLIB_SIZE_OFFSET.
  *
- * @param input_map Pointer representing mmap'ed mzML file.
+ * @param src Pointer to beginning of base64 string.
  *
- * @param start_position Position of first byte of <binary> block.
+ * @param src_len Length of base64 string.
  *
- * @param end_position Position of last byte of </binary> block.
+ * @param dest Data block to decode to, grown if needed. Its size is left
+ * unchanged.
  *
  * @param out_len Contains resulting buffer size on return.
  *
- * @return A malloc'ed buffer with first ZLIB_SIZE_OFFSET bytes containing
- * length of decoded binary and resulting decoded binary buffer.
+ * @return 0 on success, -1 on error.
  */
 {
+   ZLIB_TYPE header;
    char* b64_out_buff;
 
-   size_t header;
-
-   b64_out_buff = base64_alloc(src_len + ZLIB_SIZE_OFFSET);
+   b64_out_buff = reserve_data_block(dest, src_len + ZLIB_SIZE_OFFSET);
+   if (b64_out_buff == NULL)
+      return -1;
 
-   decode_base64(src, b64_out_buff + ZLIB_SIZE_OFFSET, src_len, out_len);
+   if (base64_decode(src, src_len, b64_out_buff + ZLIB_SIZE_OFFSET, out_len,
+                     0) != 1) {
+      error("decode_no_comp_fun_w_header: base64_decode returned with an "
+            "error.\n");
+      return -1;
+   }
 
    header = (ZLIB_TYPE)(*out_len);
-
    memcpy(b64_out_buff, &header, ZLIB_SIZE_OFFSET);
 
    *out_len += ZLIB_SIZE_OFFSET;
 
-   *dest = b64_out_buff;
+   return 0;
 }
 
-void decode_no_comp_fun_no_header(z_stream* z, char* src, size_t src_len,
-                                  char** dest, size_t* out_len,
-                                  data_block_t* tmp) {
+int decode_no_comp_fun_no_header(z_stream* z, char* src, size_t src_len,
+                                 data_block_t* dest, size_t* out_len)
+/**
+ * @brief Decodes an mzML binary block with "no comp" encoding to the end of
+ * dest, without a length header.
+ *
+ * @return 0 on success, -1 on error.
+ */
+{
    char* b64_out_buff;
 
-   b64_out_buff = base64_alloc(src_len);
+   b64_out_buff = reserve_data_block(dest, src_len);
+   if (b64_out_buff == NULL)
+      return -1;
 
-   decode_base64(src, b64_out_buff, src_len, out_len);
+   if (base64_decode(src, src_len, b64_out_buff, out_len, 0) != 1) {
+      error("decode_no_comp_fun_no_header: base64_decode returned with an "
+            "error.\n");
+      return -1;
+   }
 
-   *dest = b64_out_buff;
+   return 0;
 }
 
 /**
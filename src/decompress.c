@@ -177,6 +177,91 @@ void* decmp_block(decompression_fun decompress_fun, ZSTD_DCtx* dctx,
    return out_buff;
 }
 
+/**
+ * @brief Decompresses the frames of a block covering [start, start + len) into
+ * blk->cache. Frames decoded by previous calls are kept (blk->frames_decoded),
+ * so the cache fills up as more of the block is requested. Blocks without a
+ * frame index are decompressed whole.
+ * @param decompress_fun The decompression function of the block.
+ * @param dctx A ZSTD decompression context.
+ * @param input_map The input buffer containing the compressed data.
+ * @param offset The offset within the input buffer where the compressed block starts.
+ * @param blk A block_len_t struct of the block.
+ * @param start Offset of the requested range within the decompressed block.
+ * @param len Length of the requested range.
+ * @return blk->cache (the whole decompressed block, of which at least the requested range is filled) on success. NULL on error.
+ */
+char* decmp_block_range(decompression_fun decompress_fun, ZSTD_DCtx* dctx,
+                        void* input_map, long offset, block_len_t* blk,
+                        size_t start, size_t len) {
+   uint32_t first, last, i;
+   uint64_t frame_start, org_start, org_len;
+   size_t ret;
+
+   if (blk == NULL)
+      return NULL;
+
+   if (blk->cache != NULL && blk->frames_decoded == NULL)
+      return blk->cache;  // Whole block already decompressed.
+
+   if (blk->n_frames == 0 ||
+       (decompress_fun != zstd_decompress && decompress_fun != no_decompress)) {
+      blk->cache = decmp_block(decompress_fun, dctx, input_map, offset, blk);
+      return blk->cache;
+   }
+
+   if (len == 0 || start + len > blk->original_size) {
+      if (start + len > blk->original_size)
+         error("decmp_block_range: Range [%zu, %zu) out of block.\n", start,
+               start + len);
+      return blk->cache;
+   }
+
+   if (blk->cache == NULL) {
+      blk->cache = malloc(blk->original_size);
+      blk->frames_decoded = calloc(blk->n_frames, sizeof(uint8_t));
+      if (blk->cache == NULL || blk->frames_decoded == NULL) {
+         error("decmp_block_range: malloc() error.\n");
+         free(blk->cache);
+         free(blk->frames_decoded);
+         blk->cache = NULL;
+         blk->frames_decoded = NULL;
+         return NULL;
+      }
+   }
+
+   first = start / blk->frame_size;
+   last = (start + len - 1) / blk->frame_size;
+
+   for (i = first; i <= last; i++) {
+      if (blk->frames_decoded[i])
+         continue;
+
+      frame_start = i > 0 ? blk->frame_ends[i - 1] : 0;
+      org_start = (uint64_t)i * blk->frame_size;
+      org_len = blk->original_size - org_start;
+      if (org_len > blk->frame_size)
+         org_len = blk->frame_size;
+
+      if (decompress_fun == no_decompress)
+         memcpy(blk->cache + org_start,
+                (char*)input_map + offset + frame_start, org_len);
+      else {
+         ret = ZSTD_decompressDCtx(dctx, blk->cache + org_start, org_len,
+                                   (char*)input_map + offset + frame_start,
+                                   blk->frame_ends[i] - frame_start);
+         if (ret != org_len) {
+            error("decmp_block_range: ZSTD_decompressDCtx() error: %s\n",
+                  ZSTD_getErrorName(ret));
+            return NULL;
+         }
+      }
+      blk->frames_decoded[i] = 1;
+   }
+
+   return blk->cache;
+}
+
 
 /**
  * @brief Allocates a decompress_args_t struct and initializes its fields. Returns the struct on success, NULL on error.
@@ -220,6 +305,7 @@ decompress_args_t* alloc_decompress_args(
    r->footer_mz_bin_off = footer_mz_bin_off;
    r->footer_inten_bin_off = footer_inten_bin_off;
 
+   r->dest = NULL;
    r->ret = NULL;
    r->ret_len = 0;
 
@@ -232,7 +318,7 @@ decompress_args_t* alloc_decompress_args(
  */
 void dealloc_decompress_args(decompress_args_t* args) {
    if (args) {
-      if (args->ret)
+      if (args->ret && args->ret != args->dest)
          free(args->ret);
       free(args);
    }
@@ -272,59 +358,195 @@ DWORD WINAPI decompress_routine_win(LPVOID lpParam) {
 #endif
 
 /**
- * @brief Thread routine for decompression. Calls the decmp_block function to decompress the data blocks and writes the decompressed data to the output buffer.
- * @param args A pointer to the decompress_args_t struct containing the arguments for decompression.
- * @return Always returns NULL. `args->ret` will contain the decompressed data and `args->ret_len` will contain the length of the decompressed data on success.
- * on error, `args->ret` will be NULL and `args->ret_len` will be -1.
- *
- * Note: The caller is responsible for freeing the memory allocated for `args->ret`.
+ * @brief Returns the size in bytes of one element of a binary data format.
  */
-void* decompress_routine(void* args) {
-   // Get thread ID
-   int tid = get_thread_id();
+static size_t get_fmt_size(uint32_t fmt) {
+   switch (fmt) {
+      case _16e_:
+         return 2;
+      case _32i_:
+      case _32f_:
+         return 4;
+      default:
+         return 8;
+   }
+}
 
-   // Cast the input argument to the correct type
-   decompress_args_t* db_args = (decompress_args_t*)args;
+/**
+ * @brief Returns the last defaultArrayLength found in an XML segment, or -1
+ * if the segment has none.
+ */
+static long get_array_length(char* xml, size_t len) {
+   char *ptr = xml, *end = xml + len, *found = NULL;
 
-   // Check if the input arguments are valid
-   if (db_args == NULL) {
-      error("decompress_routine: Decompression arguments are null.\n");
-      return NULL;
+   while ((ptr = find_in_range(ptr, end, "defaultArrayLength=\"")) != NULL) {
+      found = ptr;
+      ptr++;
    }
+   if (found == NULL)
+      return -1;
+   return strtol(found + strlen("defaultArrayLength=\""), NULL, 10);
+}
 
-   // Initialize the return values to NULL and -1 in case of early return due to errors
-   db_args->ret = NULL;
-   db_args->ret_len = -1;
+/**
+ * @brief Upper bound of the length of a re-encoded binary array.
+ * @param n_points Number of elements in the array (-1 if unknown).
+ * @param fmt Data format of the array (_32f_, _64d_, ...).
+ * @param compression Source compression (_zlib_ or _no_comp_).
+ * @param encoded_len Length of the array in the original mzML, used if
+ * n_points is unknown.
+ * @return The maximum number of bytes the base64 output can take.
+ */
+static size_t get_encoded_bound(long n_points, uint32_t fmt,
+                                uint32_t compression, size_t encoded_len) {
+   size_t raw_len;
 
-   // Allocate a decompression context
-   ZSTD_DCtx* dctx = alloc_dctx();
+   if (n_points < 0)
+      return encoded_len * 2;  // defaultArrayLength is required by mzML; this
+                               // is only a fallback.
 
-   // Check if the decompression context was successfully allocated
-   if (dctx == NULL) {
-      error("decompress_routine: ZSTD Context failed.\n");
-      return NULL;
+   raw_len = n_points * get_fmt_size(fmt);
+
+   if (compression == _zlib_)
+      raw_len = compressBound(raw_len);
+
+   return ((raw_len + 2) / 3) * 4;
+}
+
+/**
+ * @brief Copies an XML segment to buff + buff_off. If re-encoded binary arrays
+ * can change length (see encoded_length_changes()), the segment's compression
+ * cvParam is rewritten and length_pos is set to the encodedLength value to
+ * update once the next array is encoded (-1 otherwise).
+ * @param next_array Set if an array re-encoded here follows the segment.
+ * Segments without one (e.g. the end of a division, which may hold arrays
+ * stored in the XML) are copied as is.
+ * @param next_fmt Format of the array following the segment.
+ * @param n_points Number of elements of that array (-1 if unknown).
+ * @return Number of bytes written.
+ */
+static size_t copy_xml_segment(data_format_t* df, char* buff, size_t buff_off,
+                               char* xml, size_t len, int next_array,
+                               uint32_t next_fmt, long n_points,
+                               long* length_pos) {
+   long encoded_len = -1;
+   size_t r;
+
+   *length_pos = -1;
+
+   if (!encoded_length_changes(df) || !next_array) {
+      memcpy(buff + buff_off, xml, len);
+      return len;
    }
 
-   // Get the division information from the arguments
-   division_t* division = db_args->division;
+   // Uncompressed arrays have a known length, which saves shifting the array
+   // in set_encoded_length().
+   if (df->output_compression == _no_comp_ && n_points >= 0)
+      encoded_len = ((n_points * get_fmt_size(next_fmt) + 2) / 3) * 4;
 
-   // Decompress each block of data
-   char *decmp_xml = (char*)decmp_block(
-            db_args->df->xml_decompression_fun, dctx, db_args->input_map,
-            db_args->footer_xml_off, db_args->xml_blk),
-        *decmp_mz_binary = (char*)decmp_block(
-            db_args->df->mz_decompression_fun, dctx, db_args->input_map,
-            db_args->footer_mz_bin_off, db_args->mz_binary_blk),
-        *decmp_inten_binary = (char*)decmp_block(
-            db_args->df->inten_decompression_fun, dctx, db_args->input_map,
-            db_args->footer_inten_bin_off, db_args->inten_binary_blk);
+   r = rewrite_binary_xml(buff + buff_off, xml, len, df->source_compression,
+                          df->output_compression, encoded_len, length_pos);
+   if (*length_pos >= 0)
+      *length_pos += buff_off;
 
-   size_t binary_len = 0;
+   return r;
+}
 
-   int64_t buff_off = 0, xml_off = 0, mz_off = 0, inten_off = 0;
+/**
+ * @brief Grows a decompression output buffer to hold at least needed bytes. A
+ * buffer borrowed from the output mapping (*owned == 0) cannot grow, so its
+ * first used bytes are moved to a malloc'd buffer instead.
+ * @return 0 on success, -1 on error.
+ */
+static int reserve_output(char** buff, size_t* capacity, int* owned,
+                          size_t used, size_t needed) {
+   char* tmp;
+   size_t new_capacity;
+
+   if (needed <= *capacity)
+      return 0;
+
+   new_capacity = *capacity + *capacity / 2;
+   if (new_capacity < needed)
+      new_capacity = needed;
+
+   if (*owned)
+      tmp = realloc(*buff, new_capacity);
+   else if ((tmp = malloc(new_capacity)) != NULL)
+      memcpy(tmp, *buff, used);
+   if (tmp == NULL) {
+      error("reserve_output: realloc() error.\n");
+      return -1;
+   }
+
+   *buff = tmp;
+   *capacity = new_capacity;
+   *owned = 1;
+   return 0;
+}
+
+/**
+ * @brief Returns where the next binary array, of at most bound bytes, is
+ * encoded. A bound that does not fit in a borrowed buffer is usually far above
+ * the actual length, so the array is then encoded to scratch and placed by
+ * place_array() rather than moving the whole division off the mapping.
+ * @return The encoding destination on success, NULL on error.
+ */
+static char* array_dest(char** buff, size_t* capacity, int* owned,
+                        size_t buff_off, size_t bound, char** scratch,
+                        size_t* scratch_capacity) {
+   int scratch_owned = 1;
+
+   if (!*owned && buff_off + bound > *capacity) {
+      if (reserve_output(scratch, scratch_capacity, &scratch_owned, 0,
+                         bound) != 0)
+         return NULL;
+      return *scratch;
+   }
+
+   if (reserve_output(buff, capacity, owned, buff_off, buff_off + bound) != 0)
+      return NULL;
+   return *buff + buff_off;
+}
+
+/**
+ * @brief Moves an array encoded to scratch by array_dest() to buff_off.
+ * @param slack Room to keep after the array.
+ * @return 0 on success, -1 on error.
+ */
+static int place_array(char** buff, size_t* capacity, int* owned,
+                       size_t buff_off, char* array, size_t len,
+                       size_t slack) {
+   if (array == *buff + buff_off)
+      return 0;
+   if (reserve_output(buff, capacity, owned, buff_off,
+                      buff_off + len + slack) != 0)
+      return -1;
+   memcpy(*buff + buff_off, array, len);
+   return 0;
+}
+
+/**
+ * @brief Rebuilds a division from its decompressed blocks, re-encoding the
+ * binary arrays in between the XML segments.
+ * @param db_args The decompression arguments of the division.
+ * @param decmp_xml The decompressed XML block.
+ * @param decmp_mz_binary The decompressed m/z block.
+ * @param decmp_inten_binary The decompressed intensity block.
+ * @param a_args Algorithm arguments with an allocated z_stream.
+ * @param out_len A pointer to a size_t where the length of the division will be stored.
+ * @return The division (db_args->dest or a malloc'd buffer) on success, NULL on error.
+ */
+static char* decode_division(decompress_args_t* db_args, char* decmp_xml,
+                             char* decmp_mz_binary, char* decmp_inten_binary,
+                             algo_args* a_args, size_t* out_len) {
+   division_t* division = db_args->division;
+
+   int64_t buff_off = 0, xml_off = 0;
    int64_t xml_i = 0, mz_i = 0, inten_i = 0;
 
    int block = 0;
+   int failed = 0;
 
    long len = division->size;
 
@@ -334,7 +556,18 @@ void* decompress_routine(void* args) {
       return NULL;
    }
 
-   char* buff = malloc(len * 2);
+   // The buffer starts at division->size, the length of the original
+   // division, and grows by a bound before each segment since re-encoded
+   // arrays may differ in length. Room for a rewritten cvParam is only needed
+   // when the encoded lengths can change.
+   size_t capacity = len;
+   size_t slack = encoded_length_changes(db_args->df) ? BINARY_XML_SLACK : 0;
+   long n_points = -1;
+   long length_pos = -1;  // encodedLength to set after the next array.
+   int owned = db_args->dest == NULL;
+   char* buff = owned ? malloc(capacity) : db_args->dest;
+   char* scratch = NULL;
+   size_t scratch_capacity = 0;
 
    if (buff == NULL) {
       error(
@@ -342,34 +575,15 @@ void* decompress_routine(void* args) {
       return NULL;
    }
 
-   db_args->ret = buff;
-
    int64_t curr_len = 0;
-
-   algo_args* a_args = malloc(sizeof(algo_args));
-   
-   if (a_args == NULL) {
-      error("decompress_routine: Failed to allocate algo_args.\n");
-      return NULL;
-   }
-
-   a_args->z = alloc_z_stream();
-
-   if (a_args->z == NULL) {
-      error("decompress_routine: Failed to allocate z_stream.\n");
-      free(a_args);
-      return NULL;
-   }
-
-   a_args->ret_code = 0; // Initialize return code to 0 (success).
-
+   long n;
 
    size_t algo_output_len = 0;
    a_args->dest_len = &algo_output_len;
 
    data_positions_t* curr_dp;
 
-   while (block != -1) {
+   while (block != -1 && !failed) {
       switch (block) {
          case 0:  // xml
             curr_dp = division->xml;
@@ -385,9 +599,19 @@ void* decompress_routine(void* args) {
                break;
             }
             assert(curr_len > 0 && curr_len <= len);
-            memcpy(buff + buff_off, decmp_xml + xml_off, curr_len);
+            if (reserve_output(&buff, &capacity, &owned, buff_off,
+                               buff_off + curr_len + slack) != 0) {
+               failed = 1;
+               break;
+            }
+            n = get_array_length(decmp_xml + xml_off, curr_len);
+            if (n >= 0)
+               n_points = n;
+            buff_off += copy_xml_segment(
+                db_args->df, buff, buff_off, decmp_xml + xml_off, curr_len,
+                mz_i < division->mz->total_spec, db_args->df->source_mz_fmt,
+                n_points, &length_pos);
             xml_off += curr_len;
-            buff_off += curr_len;
             xml_i++;
             block++;
             break;
@@ -405,9 +629,18 @@ void* decompress_routine(void* args) {
                break;
             }
             assert(curr_len > 0 && curr_len < len);
+            a_args->dest = array_dest(
+                &buff, &capacity, &owned, buff_off,
+                slack + get_encoded_bound(n_points, db_args->df->source_mz_fmt,
+                                          db_args->df->output_compression,
+                                          curr_len),
+                &scratch, &scratch_capacity);
+            if (a_args->dest == NULL) {
+               failed = 1;
+               break;
+            }
             a_args->src = (char**)&decmp_mz_binary;
             a_args->src_len = curr_len;
-            a_args->dest = buff + buff_off;
             a_args->src_format = db_args->df->source_mz_fmt;
             a_args->enc_fun = db_args->df->encode_source_compression_mz_fun;
             a_args->scale_factor = db_args->df->mz_scale_factor;
@@ -417,11 +650,23 @@ void* decompress_routine(void* args) {
 
             if (a_args->ret_code != 0) {
                error("decompress_routine: Failed to encode mz block.\n");
-               free(a_args);
-               return NULL;
+               failed = 1;
+               break;
+            }
+
+            if (place_array(&buff, &capacity, &owned, buff_off,
+                            (char*)a_args->dest, *a_args->dest_len,
+                            slack) != 0) {
+               failed = 1;
+               break;
             }
 
             buff_off += *a_args->dest_len;
+            if (length_pos >= 0) {
+               buff_off += set_encoded_length(buff, length_pos, buff_off,
+                                              *a_args->dest_len);
+               length_pos = -1;
+            }
             mz_i++;
             block++;
             break;
@@ -439,9 +684,19 @@ void* decompress_routine(void* args) {
                break;
             }
             assert(curr_len > 0 && curr_len < len);
-            memcpy(buff + buff_off, decmp_xml + xml_off, curr_len);
+            if (reserve_output(&buff, &capacity, &owned, buff_off,
+                               buff_off + curr_len + slack) != 0) {
+               failed = 1;
+               break;
+            }
+            n = get_array_length(decmp_xml + xml_off, curr_len);
+            if (n >= 0)
+               n_points = n;
+            buff_off += copy_xml_segment(
+                db_args->df, buff, buff_off, decmp_xml + xml_off, curr_len,
+                inten_i < division->inten->total_spec,
+                db_args->df->source_inten_fmt, n_points, &length_pos);
             xml_off += curr_len;
-            buff_off += curr_len;
             xml_i++;
             block++;
             break;
@@ -459,9 +714,18 @@ void* decompress_routine(void* args) {
                break;
             }
             assert(curr_len > 0 && curr_len < len);
+            a_args->dest = array_dest(
+                &buff, &capacity, &owned, buff_off,
+                slack + get_encoded_bound(n_points, db_args->df->source_inten_fmt,
+                                          db_args->df->output_compression,
+                                          curr_len),
+                &scratch, &scratch_capacity);
+            if (a_args->dest == NULL) {
+               failed = 1;
+               break;
+            }
             a_args->src = (char**)&decmp_inten_binary;
             a_args->src_len = curr_len;
-            a_args->dest = buff + buff_off;
             a_args->src_format = db_args->df->source_inten_fmt;
             a_args->enc_fun = db_args->df->encode_source_compression_inten_fun;
             a_args->scale_factor = db_args->df->int_scale_factor;
@@ -471,11 +735,23 @@ void* decompress_routine(void* args) {
 
             if (a_args->ret_code != 0) {
                error("decompress_routine: Failed to encode intensity block.\n");
-               free(a_args);
-               return NULL;
+               failed = 1;
+               break;
             }
-            
+
+            if (place_array(&buff, &capacity, &owned, buff_off,
+                            (char*)a_args->dest, *a_args->dest_len,
+                            slack) != 0) {
+               failed = 1;
+               break;
+            }
+
             buff_off += *a_args->dest_len;
+            if (length_pos >= 0) {
+               buff_off += set_encoded_length(buff, length_pos, buff_off,
+                                              *a_args->dest_len);
+               length_pos = -1;
+            }
             inten_i++;
             block = 0;
             break;
@@ -484,34 +760,402 @@ void* decompress_routine(void* args) {
       }
    }
 
-   db_args->ret_len = buff_off;
+   free(scratch);
+
+   if (failed) {
+      if (owned)
+         free(buff);
+      return NULL;
+   }
+
+   *out_len = buff_off;
+   return buff;  // May have been moved by reserve_output().
+}
+
+/**
+ * @brief Thread routine for decompression. Calls the decmp_block function to decompress the data blocks and writes the decompressed data to the output buffer.
+ * @param args A pointer to the decompress_args_t struct containing the arguments for decompression.
+ * @return Always returns NULL. `args->ret` will contain the decompressed data and `args->ret_len` will contain the length of the decompressed data on success.
+ * on error, `args->ret` will be NULL and `args->ret_len` will be -1.
+ *
+ * Note: The caller is responsible for freeing the memory allocated for `args->ret`.
+ */
+void* decompress_routine(void* args) {
+   // Cast the input argument to the correct type
+   decompress_args_t* db_args = (decompress_args_t*)args;
+
+   // Check if the input arguments are valid
+   if (db_args == NULL) {
+      error("decompress_routine: Decompression arguments are null.\n");
+      return NULL;
+   }
+
+   // Initialize the return values to NULL and -1 in case of early return due to errors
+   db_args->ret = NULL;
+   db_args->ret_len = -1;
+
+   // Allocate a decompression context
+   ZSTD_DCtx* dctx = alloc_dctx();
+
+   // Check if the decompression context was successfully allocated
+   if (dctx == NULL) {
+      error("decompress_routine: ZSTD Context failed.\n");
+      return NULL;
+   }
+
+   // Decompress each block of data
+   char *decmp_xml = (char*)decmp_block(
+            db_args->df->xml_decompression_fun, dctx, db_args->input_map,
+            db_args->footer_xml_off, db_args->xml_blk),
+        *decmp_mz_binary = (char*)decmp_block(
+            db_args->df->mz_decompression_fun, dctx, db_args->input_map,
+            db_args->footer_mz_bin_off, db_args->mz_binary_blk),
+        *decmp_inten_binary = (char*)decmp_block(
+            db_args->df->inten_decompression_fun, dctx, db_args->input_map,
+            db_args->footer_inten_bin_off, db_args->inten_binary_blk);
+   algo_args* a_args = NULL;
+   size_t ret_len = 0;
+
+   // decmp_block() only returns NULL for a present block on error.
+   if ((decmp_xml == NULL && db_args->xml_blk != NULL) ||
+       (decmp_mz_binary == NULL && db_args->mz_binary_blk != NULL) ||
+       (decmp_inten_binary == NULL && db_args->inten_binary_blk != NULL)) {
+      error("decompress_routine: Failed to decompress division blocks.\n");
+   } else if ((a_args = malloc(sizeof(algo_args))) == NULL) {
+      error("decompress_routine: Failed to allocate algo_args.\n");
+   } else if ((a_args->z = alloc_z_stream(db_args->df)) == NULL) {
+      error("decompress_routine: Failed to allocate z_stream.\n");
+   } else {
+      a_args->ret_code = 0; // Initialize return code to 0 (success).
+      db_args->ret = decode_division(db_args, decmp_xml, decmp_mz_binary,
+                                     decmp_inten_binary, a_args, &ret_len);
+      if (db_args->ret != NULL)
+         db_args->ret_len = ret_len;
+      dealloc_z_stream(a_args->z);
+   }
 
-   dealloc_z_stream(a_args->z);
+   free(a_args);
+   free(decmp_xml);
+   free(decmp_mz_binary);
+   free(decmp_inten_binary);
+   ZSTD_freeDCtx(dctx);
 
    return NULL;
 }
 
 
+/**
+ * @brief Determines if the reconstructed size of every division is known
+ * before decompression. This holds when all streams are lossless (the output
+ * is byte-identical to the original mzML) and the division sizes add up to the
+ * original file size. Sizes are unknown if the length of re-encoded arrays can
+ * change (encoded_length_changes()).
+ * @return 1 if division->size is the exact output length of every division, 0
+ * otherwise.
+ */
+static int output_sizes_known(data_format_t* df, footer_t* footer,
+                              chromatograms_t* chrom, divisions_t* divisions) {
+   uint64_t total = 0;
+   int i;
+
+   if (footer->mz_fmt != _lossless_ || footer->inten_fmt != _lossless_)
+      return 0;
+   if (encoded_length_changes(df))
+      return 0;
+   if (chrom != NULL && (chrom->footer->mz_fmt != _lossless_ ||
+                         chrom->footer->inten_fmt != _lossless_ ||
+                         encoded_length_changes(chrom->df)))
+      return 0;
+
+   for (i = 0; i < divisions->n_divisions; i++)
+      total += divisions->divisions[i]->size;
+
+   return total == footer->original_filesize;
+}
+
+/**
+ * @brief State shared between the decompression worker pool and the ordered
+ * writer. Divisions are handed to workers in order, and at most max_pending
+ * divisions may be decompressed but not yet written, which bounds peak memory.
+ */
+typedef struct {
+   decompress_args_t** args;
+   int n_divisions;
+   int next;         // Next division to hand to a worker.
+   int pending;      // Divisions started but not yet written.
+   int max_pending;
+   int failed;       // Set by the writer to stop the workers.
+   int* done;
+
+#ifdef _WIN32
+   CRITICAL_SECTION lock;
+   CONDITION_VARIABLE ready;  // Signaled when a division finishes.
+   CONDITION_VARIABLE space;  // Signaled when the writer frees a slot.
+#else
+   pthread_mutex_t lock;
+   pthread_cond_t ready;
+   pthread_cond_t space;
+#endif
+} decompress_pool_t;
+
+#ifdef _WIN32
+typedef CONDITION_VARIABLE pool_cond_t;
+static void pool_lock(decompress_pool_t* p) { EnterCriticalSection(&p->lock); }
+static void pool_unlock(decompress_pool_t* p) { LeaveCriticalSection(&p->lock); }
+static void pool_wait(decompress_pool_t* p, pool_cond_t* c) {
+   SleepConditionVariableCS(c, &p->lock, INFINITE);
+}
+static void pool_broadcast(pool_cond_t* c) { WakeAllConditionVariable(c); }
+#else
+typedef pthread_cond_t pool_cond_t;
+static void pool_lock(decompress_pool_t* p) { pthread_mutex_lock(&p->lock); }
+static void pool_unlock(decompress_pool_t* p) { pthread_mutex_unlock(&p->lock); }
+static void pool_wait(decompress_pool_t* p, pool_cond_t* c) {
+   pthread_cond_wait(c, &p->lock);
+}
+static void pool_broadcast(pool_cond_t* c) { pthread_cond_broadcast(c); }
+#endif
+
+static decompress_pool_t* alloc_decompress_pool(decompress_args_t** args,
+                                                int n_divisions,
+                                                int max_pending) {
+   decompress_pool_t* r = malloc(sizeof(decompress_pool_t));
+   if (r == NULL) {
+      error("alloc_decompress_pool: malloc() error.\n");
+      return NULL;
+   }
+   r->done = calloc(n_divisions, sizeof(int));
+   if (r->done == NULL) {
+      error("alloc_decompress_pool: malloc() error.\n");
+      free(r);
+      return NULL;
+   }
+   r->args = args;
+   r->n_divisions = n_divisions;
+   r->next = 0;
+   r->pending = 0;
+   r->max_pending = max_pending;
+   r->failed = 0;
+#ifdef _WIN32
+   InitializeCriticalSection(&r->lock);
+   InitializeConditionVariable(&r->ready);
+   InitializeConditionVariable(&r->space);
+#else
+   pthread_mutex_init(&r->lock, NULL);
+   pthread_cond_init(&r->ready, NULL);
+   pthread_cond_init(&r->space, NULL);
+#endif
+   return r;
+}
+
+static void dealloc_decompress_pool(decompress_pool_t* pool) {
+#ifdef _WIN32
+   DeleteCriticalSection(&pool->lock);
+#else
+   pthread_mutex_destroy(&pool->lock);
+   pthread_cond_destroy(&pool->ready);
+   pthread_cond_destroy(&pool->space);
+#endif
+   free(pool->done);
+   free(pool);
+}
+
+/**
+ * @brief Worker of the decompression pool. Takes the next division once a
+ * pending slot is available, decompresses it and marks it done for the writer.
+ * @param arg A pointer to the decompress_pool_t.
+ * @return Always returns NULL.
+ */
+static void* decompress_worker(void* arg) {
+   decompress_pool_t* pool = (decompress_pool_t*)arg;
+   int i;
+
+   for (;;) {
+      pool_lock(pool);
+      while (!pool->failed && pool->next < pool->n_divisions &&
+             pool->pending >= pool->max_pending)
+         pool_wait(pool, &pool->space);
+      if (pool->failed || pool->next >= pool->n_divisions) {
+         pool_unlock(pool);
+         return NULL;
+      }
+      i = pool->next++;
+      pool->pending++;
+      pool_unlock(pool);
+
+      decompress_routine(pool->args[i]);
+
+      pool_lock(pool);
+      pool->done[i] = 1;
+      pool_broadcast(&pool->ready);
+      pool_unlock(pool);
+   }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI decompress_worker_win(LPVOID lpParam) {
+   decompress_worker(lpParam);
+   return 0;
+}
+#endif
+
+/**
+ * @brief Runs the decompression pool over every division and writes them in
+ * order. With an output mapping, divisions are written in place at their
+ * prefix-sum offsets (args[i]->dest) and the writer only checks them.
+ * @param args Decompression arguments of every division. Each one is freed
+ * and set to NULL once written, unless divisions are written in place.
+ * @param max_pending Maximum number of divisions decompressed but not yet
+ * written, when writing sequentially.
+ * @param output_map Output mapping, or NULL to write to fd.
+ * @return 0 on success, -1 on error, 1 if a division written in place does
+ * not have its original length (the output must then be written
+ * sequentially).
+ */
+static int run_decompress_pool(decompress_args_t** args, int n_divisions,
+                               int threads, int max_pending, char* output_map,
+                               int fd) {
+   double start, stop;
+   int status = 0;
+   int i;
+
+   decompress_pool_t* pool = alloc_decompress_pool(
+       args, n_divisions, output_map != NULL ? n_divisions : max_pending);
+   if (pool == NULL)
+      return -1;
+
+#ifdef _WIN32
+   HANDLE* ptid = (HANDLE*)malloc(sizeof(HANDLE) * threads);
+#else
+   pthread_t* ptid = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+#endif
+   if (ptid == NULL) {
+      error("decompress_msz: malloc failure.\n");
+      dealloc_decompress_pool(pool);
+      return -1;
+   }
+
+   // Start the worker pool; it lives until every division is decompressed.
+   for (i = 0; i < threads; i++) {
+#ifdef _WIN32
+      ptid[i] =
+          CreateThread(NULL, 0, decompress_worker_win, pool, 0, NULL);
+      if (ptid[i] == NULL) {
+         perror("CreateThread");
+         break;
+      }
+#else
+      int ret = pthread_create(&ptid[i], NULL, decompress_worker, pool);
+      if (ret != 0) {
+         perror("pthread_create");
+         break;
+      }
+#endif
+   }
+
+   // Stop the threads that did start before the pool goes away.
+   if (i < threads) {
+      threads = i;
+      status = -1;
+      pool_lock(pool);
+      pool->failed = 1;
+      pool_broadcast(&pool->space);
+      pool_unlock(pool);
+   }
+
+   // Ordered writer: write divisions in order as soon as each one is ready
+   // while the workers continue on the following divisions.
+   for (i = 0; i < n_divisions && status == 0; i++) {
+      pool_lock(pool);
+      while (!pool->done[i]) pool_wait(pool, &pool->ready);
+      pool_unlock(pool);
+
+      if (args[i]->ret == NULL || args[i]->ret_len == -1)
+         status = -1;
+      else if (output_map != NULL &&
+               args[i]->ret_len != args[i]->division->size)
+         status = 1;
+
+      if (status != 0) {
+         if (status == -1)
+            error("decompress_msz: Decompression failed for division %d.\n",
+                  i);
+         pool_lock(pool);
+         pool->failed = 1;
+         pool_broadcast(&pool->space);
+         pool_unlock(pool);
+         break;
+      }
+
+      if (output_map != NULL) {
+         // Output that outgrew the mapping on the way still fits in the end.
+         if (args[i]->ret != args[i]->dest)
+            memcpy(args[i]->dest, args[i]->ret, args[i]->ret_len);
+         continue;  // Written in place.
+      }
+
+      start = get_time();
+      write_to_file(fd, args[i]->ret, args[i]->ret_len);
+      stop = get_time();
+
+      print("\tWrote %ld bytes to disk (%1.2fmb/s)\n", args[i]->ret_len,
+            (float)args[i]->ret_len / (stop - start) / 1024 / 1024);
+
+      dealloc_decompress_args(args[i]);
+      args[i] = NULL;
+
+      pool_lock(pool);
+      pool->pending--;
+      pool_broadcast(&pool->space);
+      pool_unlock(pool);
+   }
+
+#ifdef _WIN32
+   if (threads > 0)
+      WaitForMultipleObjects(threads, ptid, TRUE, INFINITE);
+#else
+   for (i = 0; i < threads; i++) {
+      int ret = pthread_join(ptid[i], NULL);
+      if (ret != 0) {
+         perror("pthread_join");
+         status = -1;
+      }
+   }
+#endif
+
+   dealloc_decompress_pool(pool);
+   free(ptid);
+
+   return status;
+}
+
 /**
  * @brief Decompresses an .msz file and writes the decompressed data to the provided file descriptor. Uses multiple threads to decompress the data in parallel.
  * @param input_map The input buffer containing the compressed data.
  * @param input_filesize The size of the input buffer.
  * @param arguments A pointer to an Arguments struct containing the command line arguments.
  * @param fd The file descriptor to write the decompressed data to.
+ * @return 0 on success, -1 on error. On error the output is incomplete and
+ * should be discarded by the caller.
  */
-void decompress_msz(char* input_map, size_t input_filesize,
-                    Arguments* arguments, int fd) {
+int decompress_msz(char* input_map, size_t input_filesize,
+                   Arguments* arguments, int fd) {
    block_len_queue_t *xml_block_lens, *mz_binary_block_lens,
        *inten_binary_block_lens;
    footer_t* msz_footer;
+   chromatograms_t* chrom;
 
    int n_divisions = 0;
    divisions_t* divisions;
    data_format_t* df;
    int threads = arguments->threads;
+   int status = 0;
 
    print("\tDetected .msz file, reading header and footer...\n");
 
+   if (check_format_version(input_map))
+      return -1;
+
    df = get_header_df(input_map);
 
    parse_footer(&msz_footer, input_map, input_filesize, &xml_block_lens,
@@ -520,25 +1164,37 @@ void decompress_msz(char* input_map, size_t input_filesize,
 
    if (n_divisions == 0) {
       warning("No divisions found in file, aborting...\n");
-      return;
+      return -1;
    }
 
+   if (arguments->target_binary_encoding != 0)
+      df->output_compression = arguments->target_binary_encoding;
+   if (set_deflate_backend(df, arguments->zlib_engine, arguments->zlib_level))
+      return -1;
+
    int ret = set_decompress_runtime_variables(df, msz_footer);
    if (ret != 0) {
       error("decompress_msz: Failed to set decompression runtime variables.\n");
-      return;
+      return -1;
+   }
+
+   if (read_chromatograms(input_map, input_filesize, &chrom)) {
+      error("decompress_msz: Failed to read chromatograms.\n");
+      return -1;
+   }
+   if (chrom != NULL && arguments->target_binary_encoding != 0)
+      chrom->df->output_compression = arguments->target_binary_encoding;
+   if (chrom != NULL &&
+       (set_deflate_backend(chrom->df, arguments->zlib_engine,
+                            arguments->zlib_level) != 0 ||
+        set_decompress_runtime_variables(chrom->df, chrom->footer) != 0)) {
+      error("decompress_msz: Failed to set chromatogram decompression runtime variables.\n");
+      return -1;
    }
 
    decompress_args_t** args =
        malloc(sizeof(decompress_args_t*) * divisions->n_divisions);
 
-#ifdef _WIN32
-   HANDLE* ptid = (HANDLE*)malloc(sizeof(HANDLE) * divisions->n_divisions);
-#else
-   pthread_t* ptid =
-       (pthread_t*)malloc(sizeof(pthread_t) * divisions->n_divisions);
-#endif
-
    block_len_t *xml_blk, *mz_binary_blk, *inten_binary_blk;
 
    uint64_t footer_xml_off = 0, footer_mz_bin_off = 0,
@@ -547,21 +1203,25 @@ void decompress_msz(char* input_map, size_t input_filesize,
 
    int i;
 
-   int divisions_used = 0;
-   int divisions_left = divisions->n_divisions;
-
-   double start, stop;
-
    for (i = 0; i < divisions->n_divisions; i++) {
       xml_blk = pop_block_len(xml_block_lens);
       mz_binary_blk = pop_block_len(mz_binary_block_lens);
       inten_binary_blk = pop_block_len(inten_binary_block_lens);
 
-      args[i] = alloc_decompress_args(
-          input_map, df, xml_blk, mz_binary_blk, inten_binary_blk,
-          divisions->divisions[i], footer_xml_off + msz_footer->xml_pos,
-          footer_mz_bin_off + msz_footer->mz_binary_pos,
-          footer_inten_bin_off + msz_footer->inten_binary_pos);
+      if (chrom != NULL && i == divisions->n_divisions - 1)
+         // The trailing XML division interleaves chromatogram arrays.
+         args[i] = alloc_decompress_args(
+             input_map, chrom->df, xml_blk,
+             pop_block_len(chrom->time_block_lens),
+             pop_block_len(chrom->inten_block_lens), chrom->division,
+             footer_xml_off + msz_footer->xml_pos, chrom->footer->mz_binary_pos,
+             chrom->footer->inten_binary_pos);
+      else
+         args[i] = alloc_decompress_args(
+             input_map, df, xml_blk, mz_binary_blk, inten_binary_blk,
+             divisions->divisions[i], footer_xml_off + msz_footer->xml_pos,
+             footer_mz_bin_off + msz_footer->mz_binary_pos,
+             footer_inten_bin_off + msz_footer->inten_binary_pos);
 
       if (xml_blk != NULL)
          footer_xml_off += xml_blk->compressed_size;
@@ -571,61 +1231,71 @@ void decompress_msz(char* input_map, size_t input_filesize,
          footer_inten_bin_off += inten_binary_blk->compressed_size;
    }
 
-   while (divisions_left > 0) {
-      if (divisions_left < threads)
-         threads = divisions_left;
+   if (threads > divisions->n_divisions)
+      threads = divisions->n_divisions;
+   if (threads < 1)
+      threads = 1;
 
-      for (i = divisions_used; i < divisions_used + threads; i++) {
-#ifdef _WIN32
-         ptid[i] =
-             CreateThread(NULL, 0, decompress_routine_win, args[i], 0, NULL);
-         if (ptid[i] == NULL) {
-            perror("CreateThread");
-            return;
-         }
-#else
-         int ret =
-             pthread_create(&ptid[i], NULL, decompress_routine, (void*)args[i]);
-         if (ret != 0) {
-            perror("pthread_create");
-            return;
-         }
-#endif
-      }
+   // When the output size of every division is known, workers write straight
+   // into a pre-sized output mapping at their prefix-sum offsets and no
+   // writer or staging buffer is needed.
+   char* output_map = NULL;
+   size_t output_len = 0;
 
-#ifdef _WIN32
-      WaitForMultipleObjects(threads, ptid + divisions_used, TRUE, INFINITE);
-#else
-      for (i = divisions_used; i < divisions_used + threads; i++) {
-         int ret = pthread_join(ptid[i], NULL);
-         if (ret != 0) {
-            perror("pthread_join");
-            return;
-         }
+   if (output_sizes_known(df, msz_footer, chrom, divisions)) {
+      output_len = msz_footer->original_filesize;
+      output_map = get_output_mapping(fd, output_len);
+   }
+
+   if (output_map != NULL) {
+      uint64_t offset = 0;
+      for (i = 0; i < divisions->n_divisions; i++) {
+         args[i]->dest = output_map + offset;
+         offset += args[i]->division->size;
       }
-#endif
+   }
 
-      for (i = divisions_used; i < divisions_used + threads; i++) {
-         if (args[i]->ret == NULL || args[i]->ret_len == -1) {
-            error("decompress_msz: Decompression failed for division %d.\n", i);
-            return;
-         }
-         start = get_time();
-         write_to_file(fd, args[i]->ret, args[i]->ret_len);
-         stop = get_time();
+   status = run_decompress_pool(args, divisions->n_divisions, threads,
+                                arguments->max_pending > 0
+                                    ? arguments->max_pending
+                                    : threads * 2,
+                                output_map, fd);
 
-         print("\tWrote %ld bytes to disk (%1.2fmb/s)\n", args[i]->ret_len,
-               (float)args[i]->ret_len / (stop - start) / 1024 / 1024);
+   if (output_map != NULL) {
+      remove_mapping(output_map, output_len);
+      if (status == 0)
+         print("\tWrote %ld bytes to disk\n", output_len);
+   }
 
-         dealloc_decompress_args(args[i]);
+   if (status == 1) {
+      // Re-encoded arrays differ in length from the original ones (e.g. the
+      // source was deflated at another level), so the prefix-sum offsets do
+      // not hold. Start over and write the divisions sequentially.
+      print("\tDivision sizes differ from the original, rewriting output...\n");
+      for (i = 0; i < divisions->n_divisions; i++) {
+         if (args[i]->ret != args[i]->dest)
+            free(args[i]->ret);
+         args[i]->ret = NULL;
+         args[i]->dest = NULL;
       }
-
-      divisions_left -= threads;
-      divisions_used += threads;
+      status = truncate_output(fd) != 0
+                   ? -1
+                   : run_decompress_pool(args, divisions->n_divisions, threads,
+                                         arguments->max_pending > 0
+                                             ? arguments->max_pending
+                                             : threads * 2,
+                                         NULL, fd);
    }
 
+   for (i = 0; i < divisions->n_divisions; i++)
+      dealloc_decompress_args(args[i]);
    free(args);
-   free(ptid);
+
+   // Leave no partially written output behind.
+   if (status != 0 && truncate_output(fd) != 0)
+      warning("decompress_msz: Failed to truncate partial output.\n");
+
+   return status != 0 ? -1 : 0;
 }
 
 /**
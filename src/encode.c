@@ -38,16 +38,16 @@ void encode_base64(zlib_block_t* zblk, char* dest, size_t src_len,
  */
 {
    if (zblk == NULL || zblk->buff == NULL)
-      error("encode_base64: zblk is NULL");
+      error("encode_base64: zblk is NULL\n");
 
    if (dest == NULL)
-      error("encode_base64: dest is NULL");
+      error("encode_base64: dest is NULL\n");
 
-   if (src_len <= 0 || src_len > ZLIB_BUFF_FACTOR)
-      error("encode_base64: src_len is invalid");
+   if (src_len > ZLIB_BUFF_FACTOR)
+      error("encode_base64: src_len is invalid\n");
 
    if (out_len == NULL)
-      error("encode_base64: out_len is NULL");
+      error("encode_base64: out_len is NULL\n");
 
    // char* b64_out_buff;
 
@@ -64,129 +64,104 @@ void encode_base64(zlib_block_t* zblk, char* dest, size_t src_len,
 void encode_zlib_fun_no_header(z_stream* z, char** src, size_t src_len,
                                char* dest, size_t* out_len) {
    // assert(0); // this is broken now, need to fix
+   if (src_len == 0) {  // Empty array, encodes to an empty string.
+      *out_len = 0;
+      return;
+   }
+
    if (src == NULL || *src == NULL)
-      error("encode_zlib_fun: src is NULL");
+      error("encode_zlib_fun: src is NULL\n");
 
-   if (src_len <= 0 || src_len > ZLIB_BUFF_FACTOR)
-      error("encode_zlib_fun: src_len is invalid");
+   if (src_len > ZLIB_BUFF_FACTOR)
+      error("encode_zlib_fun: src_len is invalid\n");
 
    if (dest == NULL)
-      error("encode_zlib_fun: dest is NULL");
+      error("encode_zlib_fun: dest is NULL\n");
 
    if (out_len == NULL)
-      error("encode_zlib_fun: out_len is NULL");
+      error("encode_zlib_fun: out_len is NULL\n");
 
    if (z == NULL)
-      error("encode_zlib_fun: z is NULL");
+      error("encode_zlib_fun: z is NULL\n");
 
    Bytef* zlib_encoded;
 
    size_t zlib_len = 0;
 
-   zlib_block_t* decmp_input;
-
-   zlib_block_t* cmp_output;
-
-   decmp_input = zlib_alloc(0);
-   decmp_input->mem = *src;
-   decmp_input->buff = decmp_input->mem + decmp_input->offset;
-
-   cmp_output = zlib_alloc(0);
-
-   // void* decmp_header = zlib_pop_header(decmp_input);
-
-   // uint16_t org_len = *(uint16_t*)decmp_header;
-
-   zlib_len = (size_t)zlib_compress(z, ((Bytef*)*src), cmp_output, src_len);
+   zlib_len = (size_t)zlib_deflate(z, ((Bytef*)*src), src_len, &zlib_encoded);
    if (zlib_len == 0) {
-      error("encode_zlib_fun: zlib_compress error\n");
-      free(decmp_input);
-      free(cmp_output);
+      error("encode_zlib_fun: zlib_deflate error\n");
       // Continue to move forward
       *src += src_len;
       return;
    }
-   // zlib_len = (size_t)zlib_compress(((Bytef*)*src) + ZLIB_SIZE_OFFSET,
-   // cmp_output, src_len);
 
-   free(decmp_input);
-   // free(decmp_header);
-
-   encode_base64(cmp_output, dest, zlib_len, out_len);
+   base64_encode(zlib_encoded, zlib_len, dest, out_len, 0);
 
    *src += src_len;
 }
 
 void encode_zlib_fun_w_header(z_stream* z, char** src, size_t src_len,
                               char* dest, size_t* out_len) {
+   if (src_len == 0) {  // Empty array, encodes to an empty string.
+      *out_len = 0;
+      return;
+   }
+
    if (src == NULL || *src == NULL)
-      error("encode_zlib_fun: src is NULL");
+      error("encode_zlib_fun: src is NULL\n");
 
-   if (src_len <= 0 || src_len > ZLIB_BUFF_FACTOR)
-      error("encode_zlib_fun: src_len is invalid");
+   if (src_len > ZLIB_BUFF_FACTOR)
+      error("encode_zlib_fun: src_len is invalid\n");
 
    if (dest == NULL)
-      error("encode_zlib_fun: dest is NULL");
+      error("encode_zlib_fun: dest is NULL\n");
 
    if (out_len == NULL)
-      error("encode_zlib_fun: out_len is NULL");
+      error("encode_zlib_fun: out_len is NULL\n");
 
    if (z == NULL)
-      error("encode_zlib_fun: z is NULL");
+      error("encode_zlib_fun: z is NULL\n");
 
    Bytef* zlib_encoded;
 
    size_t zlib_len = 0;
 
-   zlib_block_t* decmp_input;
-
-   zlib_block_t* cmp_output;
-
-   decmp_input = malloc(sizeof(zlib_block_t));
-   decmp_input->offset = ZLIB_SIZE_OFFSET;
-   decmp_input->mem = *src;
-   decmp_input->buff = decmp_input->mem + decmp_input->offset;
-   decmp_input->len = src_len + decmp_input->offset;
-
-   cmp_output = zlib_alloc(0);
+   ZLIB_TYPE org_len = *(ZLIB_TYPE*)*src;
 
-   void* decmp_header = zlib_pop_header(decmp_input);
-
-   ZLIB_TYPE org_len = *(ZLIB_TYPE*)decmp_header;
-
-   zlib_len = (size_t)zlib_compress(z, ((Bytef*)*src) + ZLIB_SIZE_OFFSET,
-                                    cmp_output, org_len);
+   zlib_len = (size_t)zlib_deflate(z, ((Bytef*)*src) + ZLIB_SIZE_OFFSET,
+                                   org_len, &zlib_encoded);
 
    if (zlib_len == 0) {
-      error("encode_zlib_fun: zlib_compress error\n");
-      free(decmp_input);
-      free(cmp_output);
+      error("encode_zlib_fun: zlib_deflate error\n");
       // Continue to move forward
       *src += org_len + ZLIB_SIZE_OFFSET;
       return;
    }
 
-   free(decmp_input);
-   free(decmp_header);
-
-   encode_base64(cmp_output, dest, zlib_len, out_len);
+   base64_encode(zlib_encoded, zlib_len, dest, out_len, 0);
 
    *src += (ZLIB_SIZE_OFFSET + org_len);
 }
 
 void encode_no_comp_fun_w_header(z_stream* z, char** src, size_t src_len,
                                  char* dest, size_t* out_len) {
+   if (src_len == 0) {  // Empty array, encodes to an empty string.
+      *out_len = 0;
+      return;
+   }
+
    if (src == NULL || *src == NULL)
-      error("encode_zlib_fun: src is NULL");
+      error("encode_zlib_fun: src is NULL\n");
 
-   if (src_len <= 0 || src_len > ZLIB_BUFF_FACTOR)
-      error("encode_zlib_fun: src_len is invalid");
+   if (src_len > ZLIB_BUFF_FACTOR)
+      error("encode_zlib_fun: src_len is invalid\n");
 
    if (dest == NULL)
-      error("encode_zlib_fun: dest is NULL");
+      error("encode_zlib_fun: dest is NULL\n");
 
    if (out_len == NULL)
-      error("encode_zlib_fun: out_len is NULL");
+      error("encode_zlib_fun: out_len is NULL\n");
 
    Bytef* zlib_encoded;
 
@@ -194,7 +169,7 @@ void encode_no_comp_fun_w_header(z_stream* z, char** src, size_t src_len,
 
    zlib_block_t* decmp_input = malloc(sizeof(zlib_block_t));
    if (decmp_input == NULL)
-      error("encode_no_comp_fun: malloc failed");
+      error("encode_no_comp_fun: malloc failed\n");
 
    decmp_input->mem = *src;
    decmp_input->offset = ZLIB_SIZE_OFFSET;
@@ -209,17 +184,22 @@ void encode_no_comp_fun_w_header(z_stream* z, char** src, size_t src_len,
 
 void encode_no_comp_fun_no_header(z_stream* z, char** src, size_t src_len,
                                   char* dest, size_t* out_len) {
+   if (src_len == 0) {  // Empty array, encodes to an empty string.
+      *out_len = 0;
+      return;
+   }
+
    if (src == NULL || *src == NULL)
-      error("encode_zlib_fun: src is NULL");
+      error("encode_zlib_fun: src is NULL\n");
 
-   if (src_len <= 0 || src_len > ZLIB_BUFF_FACTOR)
-      error("encode_zlib_fun: src_len is invalid");
+   if (src_len > ZLIB_BUFF_FACTOR)
+      error("encode_zlib_fun: src_len is invalid\n");
 
    if (dest == NULL)
-      error("encode_zlib_fun: dest is NULL");
+      error("encode_zlib_fun: dest is NULL\n");
 
    if (out_len == NULL)
-      error("encode_zlib_fun: out_len is NULL");
+      error("encode_zlib_fun: out_len is NULL\n");
 
    Bytef* zlib_encoded;
 
@@ -227,7 +207,7 @@ void encode_no_comp_fun_no_header(z_stream* z, char** src, size_t src_len,
 
    zlib_block_t* decmp_input = malloc(sizeof(zlib_block_t));
    if (decmp_input == NULL)
-      error("encode_no_comp_fun: malloc failed");
+      error("encode_no_comp_fun: malloc failed\n");
 
    decmp_input->mem = *src;
    // decmp_input->offset = ZLIB_SIZE_OFFSET;
@@ -252,13 +232,28 @@ void no_encode_w_header(z_stream* z, char** src, size_t src_len, char* dest,
    decmp_input->offset = ZLIB_SIZE_OFFSET;
    decmp_input->buff = decmp_input->mem + decmp_input->offset;
 
-   ZLIB_TYPE org_len = *(ZLIB_TYPE*)zlib_pop_header(decmp_input);
+   ZLIB_TYPE* header = zlib_pop_header(decmp_input);
+   ZLIB_TYPE org_len = *header;
 
    *out_len = org_len;
 
    memcpy(dest, decmp_input->buff, org_len);
 
    *src += org_len + ZLIB_SIZE_OFFSET;
+
+   free(header);
+   free(decmp_input);
+}
+
+void no_encode_no_header(z_stream* z, char** src, size_t src_len, char* dest,
+                         size_t* out_len)
+/*
+    Performs no encoding on the output of a lossy transform, which has no
+    header.
+*/
+{
+   memcpy(dest, *src, src_len);
+   *out_len = src_len;
 }
 
 /**
@@ -289,9 +284,165 @@ encode_fun set_encode_fun(int compression_method, int algo, int accession) {
              (algo == _cast_64_to_32_ && accession == _32f_))
             return no_encode_w_header;
          else
-            assert(0);  // Not yet implemented!
+            return no_encode_no_header;
       default:
          error("Invalid compression method.");
          return NULL;
    }
 }
+
+static const char* get_compression_name(uint32_t compression) {
+   switch (compression) {
+      case _zlib_:
+         return "zlib compression";
+      case _no_comp_:
+         return "no compression";
+      default:
+         return NULL;
+   }
+}
+
+size_t rewrite_binary_xml(char* dest, char* src, size_t len, uint32_t from,
+                          uint32_t to, long encoded_len, long* length_pos)
+/**
+ * @brief Copies an XML segment preceding a binary array, replacing the
+ * compression cvParam (accession and name) `from` with `to`. Used when
+ * binary arrays are re-encoded with a different compression than the source.
+ * Only the last binaryDataArray of the segment, the one the following array
+ * belongs to, is rewritten; arrays stored in the XML itself (e.g.
+ * chromatograms) keep their cvParams.
+ *
+ * @param dest Output buffer of at least len + BINARY_XML_SLACK bytes.
+ *
+ * @param src XML segment.
+ *
+ * @param len Length of the XML segment.
+ *
+ * @param from Source compression accession (_zlib_, _no_comp_).
+ *
+ * @param to Target compression accession (_zlib_, _no_comp_).
+ *
+ * @param encoded_len If >= 0, replaces the value of encodedLength.
+ *
+ * @param length_pos Return by reference of the offset in dest of the last
+ * encodedLength value, -1 if the segment has none. See set_encoded_length().
+ *
+ * @return Number of bytes written to dest.
+ */
+{
+   char from_acc[32], to_acc[32];
+   const char* to_name = get_compression_name(to);
+   char *p = src, *end = src + len, *acc, *lenp, *next, *q;
+   size_t off = 0, n;
+
+   snprintf(from_acc, sizeof(from_acc), "\"MS:%u\"", from);
+   snprintf(to_acc, sizeof(to_acc), "\"MS:%u\"", to);
+
+   *length_pos = -1;
+
+   // Copy everything up to the last binaryDataArray as is.
+   q = src;
+   while ((next = find_in_range(q, end, "<binaryDataArray ")) != NULL) {
+      p = next;
+      q = next + 1;
+   }
+   memcpy(dest, src, p - src);
+   off = p - src;
+
+   while (1) {
+      acc = to_name != NULL ? find_in_range(p, end, from_acc) : NULL;
+      lenp = find_in_range(p, end, "encodedLength=\"");
+      if (acc == NULL && lenp == NULL)
+         break;
+
+      next = (lenp != NULL && (acc == NULL || lenp < acc)) ? lenp : acc;
+      memcpy(dest + off, p, next - p);
+      off += next - p;
+
+      if (next == lenp) {
+         n = strlen("encodedLength=\"");
+         memcpy(dest + off, lenp, n);
+         off += n;
+         p = lenp + n;
+         *length_pos = off;
+         if (encoded_len >= 0) {
+            off += sprintf(dest + off, "%ld", encoded_len);
+            while (p < end && *p >= '0' && *p <= '9') p++;
+         }
+         continue;
+      }
+
+      n = strlen(to_acc);
+      memcpy(dest + off, to_acc, n);
+      off += n;
+      p = acc + strlen(from_acc);
+
+      // name="..." follows the accession within the same cvParam.
+      q = find_in_range(p, end, "name=\"");
+      next = q != NULL ? memchr(p, '>', end - p) : NULL;
+      if (q == NULL || (next != NULL && q > next))
+         continue;
+      q += strlen("name=\"");
+      memcpy(dest + off, p, q - p);
+      off += q - p;
+      n = strlen(to_name);
+      memcpy(dest + off, to_name, n);
+      off += n;
+      p = q;
+      while (p < end && *p != '"') p++;
+   }
+
+   memcpy(dest + off, p, end - p);
+   off += end - p;
+
+   return off;
+}
+
+long set_encoded_length(char* buff, long length_pos, size_t end,
+                        size_t encoded_len)
+/**
+ * @brief Sets the encodedLength value recorded by rewrite_binary_xml() once
+ * the length of the re-encoded array is known. If the number of digits
+ * changes, buff[value end, end) is shifted.
+ *
+ * @param buff Output buffer. Must have room for end + BINARY_XML_SLACK bytes.
+ *
+ * @param length_pos Offset of the encodedLength value in buff.
+ *
+ * @param end End of the data written to buff.
+ *
+ * @param encoded_len Length of the re-encoded array.
+ *
+ * @return The change in length of buff (new end - end).
+ */
+{
+   char digits[24];
+   char* value = buff + length_pos;
+   size_t old_len = 0, new_len;
+
+   while (value[old_len] >= '0' && value[old_len] <= '9') old_len++;
+
+   new_len = snprintf(digits, sizeof(digits), "%zu", encoded_len);
+
+   if (new_len != old_len)
+      memmove(value + new_len, value + old_len,
+              end - (length_pos + old_len));
+   memcpy(value, digits, new_len);
+
+   return (long)new_len - (long)old_len;
+}
+
+int encoded_length_changes(data_format_t* df)
+/**
+ * @brief Determines if re-encoded binary arrays can differ in length from the
+ * source, so the XML preceding them has to be rewritten: either the output
+ * compression differs from the source or zlib arrays are re-deflated at a
+ * non-default level (set_deflate_backend()).
+ *
+ * @return 1 if encodedLength has to be rewritten, 0 otherwise.
+ */
+{
+   return df->output_compression != df->source_compression ||
+          (df->source_compression == _zlib_ &&
+           df->zlib_level != Z_DEFAULT_COMPRESSION);
+}
@@ -1,3 +1,8 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -70,70 +75,30 @@ void extract_mzml(char* input_map, divisions_t* divisions, int output_fd) {
 }
 
 int determine_division_by_index(divisions_t* divisions, long index) {
-   int i = 0;
-   long sum = 0;
-
-   for (i; i < divisions->n_divisions; i++) {
-      division_t* curr = divisions->divisions[i];
-      if (curr) {
-         if (curr->mz) {
-            sum += curr->mz->total_spec;
-            if (index < sum) {
-               return i;
-            }
-         }
-      }
-   }
-   return -1;
+   return find_division(divisions, index, NULL);
 }
 
 void determine_spectrum_start_end(divisions_t* divisions, long index,
                                   uint64_t* start, uint64_t* end) {
-   division_t* curr;
-   data_positions_t* spectra;
-   int division_index = 0;
-   long offset = 0;
-
-   for (int i = 0; i < divisions->n_divisions; i++) {
-      curr = divisions->divisions[i];
-      spectra = curr->spectra;
-
-      if (index < spectra->total_spec + offset)
-         break;
+   long local_index;
+   int division_index = find_division(divisions, index, &local_index);
 
-      offset += spectra->total_spec;
-      division_index++;
+   if (division_index < 0) {
+      error("determine_spectrum_start_end: index %ld out of range.\n", index);
+      *start = *end = 0;
+      return;
    }
 
    *start = divisions->divisions[division_index]
-                ->spectra->start_positions[index - offset];
+                ->spectra->start_positions[local_index];
    *end = divisions->divisions[division_index]
-              ->spectra->end_positions[index - offset];
+              ->spectra->end_positions[local_index];
    return;
 }
 
 int determine_division(divisions_t* divisions, long target) {
-   int i = 0;
-   long sum = 0;
-   for (i; i < divisions->n_divisions; i++) {
-      division_t* curr = divisions->divisions[i];
-
-      if (!curr) {
-         warning("determine_division: curr division is NULL.\n");
-         return -1;
-      }
-      data_positions_t* spectra = curr->spectra;
-
-      if (!spectra) {
-         warning("determine_division: spectra is NULL.\n");
-         // return -1;
-      } else {
-         sum += spectra->total_spec;
-         if (target < sum)
-            return i;
-      }
-   }
-   return 0;
+   int r = find_division(divisions, target, NULL);
+   return r < 0 ? 0 : r;
 }
 
 char* extract_mzml_header(char* blk, division_t* first_division,
@@ -163,7 +128,12 @@ char* extract_mzml_header(char* blk, division_t* first_division,
    return res;
 }
 
-char* extract_mzml_footer(char* blk, divisions_t* divisions, size_t* out_len) {
+char* extract_mzml_footer(char* blk, size_t blk_len, divisions_t* divisions,
+                          size_t* out_len)
+/*
+ * Extract from [Last spectra end position -> End of last XML block]
+ */
+{
    data_positions_t *spectra, *xml;
    char* res;
 
@@ -201,7 +171,7 @@ char* extract_mzml_footer(char* blk, divisions_t* divisions, size_t* out_len) {
        last_spectra_end -
        divisions->divisions[last_xml_division]->xml->start_positions[0];
 
-   *out_len = last_xml_end - last_spectra_end;
+   *out_len = blk_len - offset;
 
    res = malloc(*out_len);
 
@@ -211,6 +181,25 @@ char* extract_mzml_footer(char* blk, divisions_t* divisions, size_t* out_len) {
 }
 
 
+/**
+ * @brief decmp_block_range() for a pinned block. Threads decompressing the
+ * same block are serialized (see block_cache_lock_block()), so frames
+ * requested concurrently are only decompressed once.
+ * @return blk->cache on success. NULL on error.
+ */
+static char* decmp_pinned_range(decompression_fun decompress_fun,
+                                ZSTD_DCtx* dctx, void* input_map, long offset,
+                                block_len_t* blk, size_t start, size_t len) {
+   char* r;
+
+   block_cache_lock_block(blk);
+   r = decmp_block_range(decompress_fun, dctx, input_map, offset, blk, start,
+                         len);
+   block_cache_unlock_block(blk);
+
+   return r;
+}
+
 /**
  * @brief Extracts the XML block corresponding to the start of a spectrum from the input map.
  * @param input_map The input buffer containing the compressed data.
@@ -274,21 +263,22 @@ char* extract_spectrum_start_xml(char* input_map, ZSTD_DCtx* dctx,
    xml_blk_len = get_block_by_index(xml_block_lens, division_index);
    xml_blk_offset =
        xml_pos + get_block_offset_by_index(xml_block_lens, division_index);
-
-   if (!xml_blk_len->cache) {
-      decmp_xml = (char*)decmp_block(df->xml_decompression_fun, dctx, input_map,
-                                     xml_blk_offset, xml_blk_len);
-      if (decmp_xml == NULL) {
-         error("extract_spectrum_start_xml: Failed to decompress XML block.\n");
-         return NULL;
-      }
-      xml_blk_len->cache = decmp_xml;
-   } else
-      decmp_xml = xml_blk_len->cache;
+   block_cache_pin(xml_block_lens->cache, xml_blk_len);
 
    *out_len = xml_end_position - xml_start_position - xml_start_offset;
+
+   decmp_xml = decmp_pinned_range(df->xml_decompression_fun, dctx, input_map,
+                                  xml_blk_offset, xml_blk_len,
+                                  xml_buff_offset + xml_start_offset, *out_len);
+   if (decmp_xml == NULL) {
+      error("extract_spectrum_start_xml: Failed to decompress XML block.\n");
+      block_cache_unpin(xml_block_lens->cache, xml_blk_len);
+      return NULL;
+   }
+
    res = malloc(*out_len);
    memcpy(res, decmp_xml + xml_buff_offset + xml_start_offset, *out_len);
+   block_cache_unpin(xml_block_lens->cache, xml_blk_len);
 
    return res;
 }
@@ -356,21 +346,22 @@ char* extract_spectrum_inner_xml(char* input_map, ZSTD_DCtx* dctx,
    xml_blk_len = get_block_by_index(xml_block_lens, division_index);
    xml_blk_offset =
        xml_pos + get_block_offset_by_index(xml_block_lens, division_index);
-
-   if (!xml_blk_len->cache) {
-      decmp_xml = (char*)decmp_block(df->xml_decompression_fun, dctx, input_map,
-                                     xml_blk_offset, xml_blk_len);
-      if (decmp_xml == NULL) {
-         error("extract_spectrum_inner_xml: Failed to decompress XML block.\n");
-         return NULL;
-      }
-      xml_blk_len->cache = decmp_xml;
-   } else
-      decmp_xml = xml_blk_len->cache;
+   block_cache_pin(xml_block_lens->cache, xml_blk_len);
 
    *out_len = xml_end_position - xml_start_position;
+
+   decmp_xml = decmp_pinned_range(df->xml_decompression_fun, dctx, input_map,
+                                  xml_blk_offset, xml_blk_len, xml_buff_offset,
+                                  *out_len);
+   if (decmp_xml == NULL) {
+      error("extract_spectrum_inner_xml: Failed to decompress XML block.\n");
+      block_cache_unpin(xml_block_lens->cache, xml_blk_len);
+      return NULL;
+   }
+
    res = malloc(*out_len);
    memcpy(res, decmp_xml + xml_buff_offset, *out_len);
+   block_cache_unpin(xml_block_lens->cache, xml_blk_len);
 
    return res;
 }
@@ -437,28 +428,52 @@ char* extract_spectrum_last_xml(char* input_map, ZSTD_DCtx* dctx,
    xml_blk_len = get_block_by_index(xml_block_lens, division_index);
    xml_blk_offset =
        xml_pos + get_block_offset_by_index(xml_block_lens, division_index);
-
-   if (!xml_blk_len->cache) {
-      decmp_xml = (char*)decmp_block(df->xml_decompression_fun, dctx, input_map,
-                                     xml_blk_offset, xml_blk_len);
-      xml_blk_len->cache = decmp_xml;
-      if (decmp_xml == NULL) {
-         error("extract_spectrum_last_xml: Failed to decompress XML block.\n");
-         return NULL;
-      }
-   } else
-      decmp_xml = xml_blk_len->cache;
+   block_cache_pin(xml_block_lens->cache, xml_blk_len);
 
    *out_len = (xml_end_position - xml_start_position) -
               (xml_end_position - spectrum_end) + 1;  //+1 For newline
+
+   decmp_xml = decmp_pinned_range(df->xml_decompression_fun, dctx, input_map,
+                                  xml_blk_offset, xml_blk_len, xml_buff_offset,
+                                  *out_len);
+   if (decmp_xml == NULL) {
+      error("extract_spectrum_last_xml: Failed to decompress XML block.\n");
+      block_cache_unpin(xml_block_lens->cache, xml_blk_len);
+      return NULL;
+   }
+
    res = malloc(*out_len);
    memcpy(res, decmp_xml + xml_buff_offset, *out_len);
+   block_cache_unpin(xml_block_lens->cache, xml_blk_len);
 
    return res;
 }
 
+/* Lossy transforms store as little as 2 bits per value, so their raw
+ * (_no_encode_) output can be 32 times larger than what is stored. */
+#define RAW_LOSSY_EXPANSION 32
+
+/**
+ * @brief Bounds the output of encoding spectra into a preallocated buffer.
+ * Encoded output is bounded by the source span of the spectra, raw output by
+ * the stored (decompressed) data.
+ * @param encode_fun The encoding function.
+ * @param source_len Length of the spectra in the source mzML.
+ * @param stored_len Length of the spectra in the decompressed block.
+ * @return The size of the buffer to allocate.
+ */
+static size_t encoded_bound(encode_fun encode_fun, size_t source_len,
+                            size_t stored_len) {
+   if (encode_fun == no_encode_w_header)
+      return source_len > stored_len ? source_len : stored_len;
+   if (encode_fun == no_encode_no_header)
+      return stored_len * RAW_LOSSY_EXPANSION + sizeof(double);
+   return source_len;
+}
+
 /**
  * @brief Encodes a binary block using the specified encoding function and algorithm.
+ * @param df The data format, which selects the deflate backend and level.
  * @param blk A pointer to the `block_len_t` structure containing the binary block to be encoded.
  * @param curr_dp A pointer to the `data_positions_t` structure containing the positions of the data to be encoded.
  * @param source_fmt The format of the source data.
@@ -470,10 +485,10 @@ char* extract_spectrum_last_xml(char* input_map, ZSTD_DCtx* dctx,
  * 
  * Note: Caller is responsible for freeing the memory allocated for the encoded cache and its lengths in the `block_len_t` structure after use.
  */
-int encode_binary_block(block_len_t* blk, data_positions_t* curr_dp,
-                         uint32_t source_fmt, uint32_t target_fmt,
-                         encode_fun encode_fun, float scale_factor,
-                         Algo target_fun) 
+int encode_binary_block(data_format_t* df, block_len_t* blk,
+                        data_positions_t* curr_dp, uint32_t source_fmt,
+                        uint32_t target_fmt, encode_fun encode_fun,
+                        float scale_factor, Algo target_fun)
 {
    if (blk->encoded_cache_len > 0 && blk->encoded_cache_fmt == target_fmt) {
       // Already encoded with the same format, no need to re-encode
@@ -494,8 +509,10 @@ int encode_binary_block(block_len_t* blk, data_positions_t* curr_dp,
    char* decmp_binary = blk->cache;
 
    // Allocate a buffer to hold the encoded data. The size is determined by the total length of the binary data to be encoded.
-   char* buff = malloc(curr_dp->end_positions[total_spec - 1] -
-                       curr_dp->start_positions[0]);
+   char* buff = malloc(encoded_bound(encode_fun,
+                                     curr_dp->end_positions[total_spec - 1] -
+                                         curr_dp->start_positions[0],
+                                     blk->original_size));
    if (!buff) {
       error("encode_binary_block: Failed to allocate buffer for encoded data.\n");
       free(a_args);
@@ -513,7 +530,7 @@ int encode_binary_block(block_len_t* blk, data_positions_t* curr_dp,
    uint64_t buff_off = 0;
 
    // Initialize the z_stream for encoding
-   a_args->z = alloc_z_stream();
+   a_args->z = alloc_z_stream(df);
    if (!a_args->z) {
       error("encode_binary_block: Failed to allocate z_stream.\n");
       free(a_args);
@@ -579,6 +596,88 @@ char* extract_from_encoded_block(block_len_t* blk, long index,
    return res;
 }
 
+/**
+ * @brief Transforms a single spectrum of a binary block indexed by the
+ * spectrum index (see read_spectrum_index()). Only the frames holding the
+ * spectrum are decompressed and only the spectrum is run through target_fun.
+ * @param decompress_fun Decompression function of the block.
+ * @param blk_offset The offset of the block within the input buffer.
+ * @param blk A block with blk->spectrum_ends set, pinned by the caller.
+ * @param dp Positions of the block's spectra within the source mzML.
+ * @param index Index of the spectrum within the block.
+ * @param out_len A pointer to a `size_t` where the length of the encoded spectrum will be stored.
+ * @return A pointer to the encoded spectrum on success. NULL on error.
+ */
+static char* extract_indexed_spectrum(
+    char* input_map, ZSTD_DCtx* dctx, data_format_t* df,
+    decompression_fun decompress_fun, long blk_offset, block_len_t* blk,
+    data_positions_t* dp, long index,
+    uint32_t source_fmt, encode_fun encode_fun, float scale_factor,
+    Algo target_fun, size_t* out_len) {
+   size_t start = index > 0 ? blk->spectrum_ends[index - 1] : 0;
+   size_t len = blk->spectrum_ends[index] - start;
+   size_t algo_output_len = 0, span, bound;
+   algo_args a_args;
+   char *decmp_binary, *src, *res;
+
+   *out_len = 0;
+
+   if (len == 0)  // Empty spectrum, nothing was stored.
+      return malloc(1);
+
+   decmp_binary = decmp_pinned_range(decompress_fun, dctx, input_map,
+                                     blk_offset, blk, start, len);
+   if (decmp_binary == NULL) {
+      error("extract_indexed_spectrum: Failed to decompress block.\n");
+      return NULL;
+   }
+
+   // Bounded by the spectrum alone; re-encoding the stored data may not
+   // reproduce the source span byte for byte, so allow for zlib and base64
+   // overhead on top.
+   span = dp->end_positions[index] - dp->start_positions[index];
+   bound = encoded_bound(encode_fun, span, len);
+   if (encode_fun != no_encode_w_header && encode_fun != no_encode_no_header &&
+       bound < ((compressBound(len) + 2) / 3) * 4)
+      bound = ((compressBound(len) + 2) / 3) * 4;
+   res = malloc(bound);
+   if (res == NULL) {
+      error("extract_indexed_spectrum: Failed to allocate buffer.\n");
+      return NULL;
+   }
+
+   a_args.z = alloc_z_stream(df);
+   if (a_args.z == NULL) {
+      error("extract_indexed_spectrum: Failed to allocate z_stream.\n");
+      free(res);
+      return NULL;
+   }
+
+   src = decmp_binary + start;
+   a_args.src = &src;
+   a_args.src_len = span;
+   a_args.dest = (char**)res;
+   a_args.dest_len = &algo_output_len;
+   a_args.src_format = source_fmt;
+   a_args.enc_fun = encode_fun;
+   a_args.tmp = NULL;
+   a_args.scale_factor = scale_factor;
+   a_args.ret_code = 0;
+
+   target_fun((void*)&a_args);
+   dealloc_z_stream(a_args.z);
+
+   if (a_args.ret_code != 0) {
+      error("extract_indexed_spectrum: Failed to encode spectrum %ld.\n",
+            index);
+      free(res);
+      return NULL;
+   }
+
+   *out_len = algo_output_len;
+   return realloc(res, algo_output_len > 0 ? algo_output_len : 1);
+}
+
 
 /**
  * @brief Extracts the m/z values for a given spectrum index from the input map.
@@ -610,49 +709,60 @@ char* extract_spectrum_mz(char* input_map, ZSTD_DCtx* dctx, data_format_t* df,
    char* res;
 
    // Determine what division contains mz and in which position
-   for (division_index; division_index < divisions->n_divisions;
-        division_index++) {
-      division_t* curr = divisions->divisions[division_index];
-      mz = curr->mz;
-      if (index < mz_off + mz->total_spec) {
-         mz_off = index - mz_off;
-         start_position = curr->mz->start_positions[mz_off];
-         end_position = curr->mz->end_positions[mz_off];
-         src_len = end_position - start_position;
-         break;
-      }
-      mz_off += mz->total_spec;
+   division_index = find_division(divisions, index, &mz_off);
+   if (division_index < 0) {
+      error("extract_spectrum_mz: index %ld out of range.\n", index);
+      return NULL;
    }
+   mz = divisions->divisions[division_index]->mz;
+   start_position = mz->start_positions[mz_off];
+   end_position = mz->end_positions[mz_off];
+   src_len = end_position - start_position;
 
    mz_blk_len = get_block_by_index(mz_binary_block_lens, division_index);
    mz_blk_offset =
        mz_binary_blk_pos +
        get_block_offset_by_index(mz_binary_block_lens, division_index);
 
-   if (!mz_blk_len->cache) {
-      decmp_mz = (char*)decmp_block(df->xml_decompression_fun, dctx, input_map,
-                                    mz_blk_offset, mz_blk_len);
-      if (decmp_mz == NULL) {
-         error("extract_spectrum_mz: Failed to decompress mz block.\n");
-         return NULL;
-      }
-      mz_blk_len->cache = decmp_mz;
-   } else
-      decmp_mz = mz_blk_len->cache;
+   block_cache_pin(mz_binary_block_lens->cache, mz_blk_len);
+
+   if (mz_blk_len->spectrum_ends != NULL &&
+       mz_blk_len->n_spectra == (uint32_t)mz->total_spec) {
+      res = extract_indexed_spectrum(
+          input_map, dctx, df, df->xml_decompression_fun, mz_blk_offset,
+          mz_blk_len, mz, mz_off, df->source_mz_fmt,
+          encode ? df->encode_source_compression_mz_fun : df->no_encode_mz_fun,
+          df->mz_scale_factor, df->target_mz_fun, out_len);
+      block_cache_unpin(mz_binary_block_lens->cache, mz_blk_len);
+      return res;
+   }
+
+   // Without a spectrum index, the block is transformed as a whole.
+   block_cache_lock_block(mz_blk_len);
+   decmp_mz = decmp_block_range(df->xml_decompression_fun, dctx, input_map,
+                                mz_blk_offset, mz_blk_len, 0,
+                                mz_blk_len->original_size);
+   if (decmp_mz == NULL) {
+      error("extract_spectrum_mz: Failed to decompress mz block.\n");
+      block_cache_unlock_block(mz_blk_len);
+      block_cache_unpin(mz_binary_block_lens->cache, mz_blk_len);
+      return NULL;
+   }
 
    if (!encode) {
       encode_binary_block(
-          mz_blk_len, mz, df->source_mz_fmt, _no_encode_,
-          set_encode_fun(_no_encode_, _lossless_,
-                         _64d_), /* Disables encoding for python library*/
+          df, mz_blk_len, mz, df->source_mz_fmt, _no_encode_,
+          df->no_encode_mz_fun, /* Disables encoding for python library*/
           df->mz_scale_factor, df->target_mz_fun);
    } else {
-      encode_binary_block(mz_blk_len, mz, df->source_mz_fmt,
+      encode_binary_block(df, mz_blk_len, mz, df->source_mz_fmt,
                           df->target_mz_format,
                           df->encode_source_compression_mz_fun,
                           df->mz_scale_factor, df->target_mz_fun);
    }
    res = extract_from_encoded_block(mz_blk_len, mz_off, out_len);
+   block_cache_unlock_block(mz_blk_len);
+   block_cache_unpin(mz_binary_block_lens->cache, mz_blk_len);
 
    return res;
 }
@@ -688,64 +798,195 @@ char* extract_spectrum_inten(char* input_map, ZSTD_DCtx* dctx,
    char* res;
 
    // Determine what division contains iten and in which position
-   for (division_index; division_index < divisions->n_divisions;
-        division_index++) {
-      division_t* curr = divisions->divisions[division_index];
-      inten = curr->inten;
-      if (index < inten_off + inten->total_spec) {
-         inten_off = index - inten_off;
-         start_position = curr->inten->start_positions[inten_off];
-         end_position = curr->inten->end_positions[inten_off];
-         src_len = end_position - start_position;
-         break;
-      }
-      inten_off += inten->total_spec;
+   division_index = find_division(divisions, index, &inten_off);
+   if (division_index < 0) {
+      error("extract_spectrum_inten: index %ld out of range.\n", index);
+      return NULL;
    }
+   inten = divisions->divisions[division_index]->inten;
+   start_position = inten->start_positions[inten_off];
+   end_position = inten->end_positions[inten_off];
+   src_len = end_position - start_position;
 
    inten_blk_len = get_block_by_index(inten_binary_block_lens, division_index);
    inten_blk_offset =
        inten_binary_blk_pos +
        get_block_offset_by_index(inten_binary_block_lens, division_index);
 
-   if (!inten_blk_len->cache) {
-      decmp_inten =
-          (char*)decmp_block(df->xml_decompression_fun, dctx, input_map,
-                             inten_blk_offset, inten_blk_len);
-      if (decmp_inten == NULL) {
-         error("extract_spectrum_inten: Failed to decompress intensity block.\n");
-         return NULL;
-      }
-      inten_blk_len->cache = decmp_inten;
-   } else
-      decmp_inten = inten_blk_len->cache;
+   block_cache_pin(inten_binary_block_lens->cache, inten_blk_len);
+
+   if (inten_blk_len->spectrum_ends != NULL &&
+       inten_blk_len->n_spectra == (uint32_t)inten->total_spec) {
+      res = extract_indexed_spectrum(
+          input_map, dctx, df, df->xml_decompression_fun, inten_blk_offset,
+          inten_blk_len, inten, inten_off, df->source_inten_fmt,
+          encode ? df->encode_source_compression_inten_fun
+                 : df->no_encode_inten_fun,
+          df->int_scale_factor, df->target_inten_fun, out_len);
+      block_cache_unpin(inten_binary_block_lens->cache, inten_blk_len);
+      return res;
+   }
+
+   // Without a spectrum index, the block is transformed as a whole.
+   block_cache_lock_block(inten_blk_len);
+   decmp_inten = decmp_block_range(df->xml_decompression_fun, dctx, input_map,
+                                   inten_blk_offset, inten_blk_len, 0,
+                                   inten_blk_len->original_size);
+   if (decmp_inten == NULL) {
+      error("extract_spectrum_inten: Failed to decompress intensity block.\n");
+      block_cache_unlock_block(inten_blk_len);
+      block_cache_unpin(inten_binary_block_lens->cache, inten_blk_len);
+      return NULL;
+   }
 
    if (!encode) {
       int ret = encode_binary_block(
-          inten_blk_len, inten, df->source_inten_fmt, _no_encode_,
-          set_encode_fun(_no_encode_, _lossless_,
-                         _64d_), /* Disables encoding for python library*/
+          df, inten_blk_len, inten, df->source_inten_fmt, _no_encode_,
+          df->no_encode_inten_fun, /* Disables encoding for python library*/
           df->int_scale_factor, df->target_inten_fun);
       if (ret != 0) {
          error("extract_spectrum_inten: Failed to encode intensity block.\n");
+         block_cache_unlock_block(inten_blk_len);
+         block_cache_unpin(inten_binary_block_lens->cache, inten_blk_len);
          return NULL;
       }
    } else {
-      int ret = encode_binary_block(inten_blk_len, inten, df->source_inten_fmt,
-                          df->target_inten_format,
-                          df->encode_source_compression_inten_fun,
-                          df->int_scale_factor, df->target_inten_fun);
+      int ret = encode_binary_block(
+          df, inten_blk_len, inten, df->source_inten_fmt,
+          df->target_inten_format, df->encode_source_compression_inten_fun,
+          df->int_scale_factor, df->target_inten_fun);
       if (ret != 0) {
          error("extract_spectrum_inten: Failed to encode intensity block.\n");
+         block_cache_unlock_block(inten_blk_len);
+         block_cache_unpin(inten_binary_block_lens->cache, inten_blk_len);
          return NULL;
       }
    }
 
    res = extract_from_encoded_block(inten_blk_len, inten_off, out_len);
+   block_cache_unlock_block(inten_blk_len);
+   block_cache_unpin(inten_binary_block_lens->cache, inten_blk_len);
 
    return res;
 }
 
 
+/**
+ * @brief Extracts the time or intensity array of a chromatogram directly from
+ * the chromatogram binary streams, without decompressing any XML.
+ * @param input_map The input buffer containing the compressed data.
+ * @param dctx A pointer to a `ZSTD_DCtx` struct for decompression.
+ * @param chrom Chromatograms read by read_chromatograms(), with decompression runtime variables set.
+ * @param type `_time_` or `_intensity_`.
+ * @param index The index of the chromatogram to extract.
+ * @param out_len A pointer to a `size_t` where the length of the extracted array will be stored.
+ * @param encode An integer flag indicating whether to encode the extracted array (1) or not (0).
+ * @return A pointer to the extracted array on success. NULL on error.
+ */
+char* extract_chromatogram_binary(char* input_map, ZSTD_DCtx* dctx,
+                                  chromatograms_t* chrom, int type, long index,
+                                  size_t* out_len, int encode) {
+   data_format_t* df;
+   data_positions_t* dp;
+   block_len_t* blk_len;
+   long blk_offset;
+   uint32_t source_fmt, target_fmt;
+   decompression_fun decmp_fun;
+   encode_fun enc_fun;
+   float scale_factor;
+   Algo target_fun;
+   char* decmp;
+
+   if (chrom == NULL || index < 0 || index >= chrom->division->mz->total_spec) {
+      error("extract_chromatogram_binary: Invalid chromatogram index %ld.\n",
+            index);
+      return NULL;
+   }
+
+   df = chrom->df;
+
+   if (type == _time_) {
+      dp = chrom->division->mz;
+      blk_len = get_block_by_index(chrom->time_block_lens, 0);
+      blk_offset = chrom->footer->mz_binary_pos;
+      source_fmt = df->source_mz_fmt;
+      target_fmt = df->target_mz_format;
+      decmp_fun = df->mz_decompression_fun;
+      enc_fun = df->encode_source_compression_mz_fun;
+      scale_factor = df->mz_scale_factor;
+      target_fun = df->target_mz_fun;
+   } else if (type == _intensity_) {
+      dp = chrom->division->inten;
+      blk_len = get_block_by_index(chrom->inten_block_lens, 0);
+      blk_offset = chrom->footer->inten_binary_pos;
+      source_fmt = df->source_inten_fmt;
+      target_fmt = df->target_inten_format;
+      decmp_fun = df->inten_decompression_fun;
+      enc_fun = df->encode_source_compression_inten_fun;
+      scale_factor = df->int_scale_factor;
+      target_fun = df->target_inten_fun;
+   } else {
+      error("extract_chromatogram_binary: Invalid array type %d.\n", type);
+      return NULL;
+   }
+
+   if (blk_len == NULL) {
+      error("extract_chromatogram_binary: Chromatogram block not found.\n");
+      return NULL;
+   }
+
+   if (!blk_len->cache) {
+      decmp = (char*)decmp_block(decmp_fun, dctx, input_map, blk_offset,
+                                 blk_len);
+      if (decmp == NULL) {
+         error("extract_chromatogram_binary: Failed to decompress block.\n");
+         return NULL;
+      }
+      blk_len->cache = decmp;
+   }
+
+   if (!encode) {
+      if (encode_binary_block(
+              df, blk_len, dp, source_fmt, _no_encode_,
+              set_encode_fun(_no_encode_, _lossless_,
+                             _64d_), /* Disables encoding for python library*/
+              scale_factor, target_fun) != 0) {
+         error("extract_chromatogram_binary: Failed to encode block.\n");
+         return NULL;
+      }
+   } else {
+      if (encode_binary_block(df, blk_len, dp, source_fmt, target_fmt,
+                              enc_fun, scale_factor, target_fun) != 0) {
+         error("extract_chromatogram_binary: Failed to encode block.\n");
+         return NULL;
+      }
+   }
+
+   return extract_from_encoded_block(blk_len, index, out_len);
+}
+
+/**
+ * @brief Copies the XML preceding a binary array of an extracted spectrum. If
+ * the arrays were re-encoded with a different compression than the source
+ * (--target-binary-encoding) or deflate level (--zlib-level), the compression
+ * cvParam and encodedLength are rewritten to match.
+ * @param dest Output buffer of at least len + BINARY_XML_SLACK bytes.
+ * @param encoded_len Length of the array following the XML.
+ * @return Number of bytes written.
+ */
+static size_t copy_spectrum_xml(data_format_t* df, char* dest, char* xml,
+                                size_t len, size_t encoded_len) {
+   long length_pos;
+
+   if (!encoded_length_changes(df)) {
+      memcpy(dest, xml, len);
+      return len;
+   }
+
+   return rewrite_binary_xml(dest, xml, len, df->source_compression,
+                             df->output_compression, encoded_len, &length_pos);
+}
+
 /**
  * @brief Extracts the complete spectrum for a given index from the input map.
  * @param input_map The input buffer containing the compressed data.
@@ -784,15 +1025,10 @@ char* extract_spectra(char* input_map, ZSTD_DCtx* dctx, data_format_t* df,
    determine_spectrum_start_end(divisions, index, &spectrum_start,
                                 &spectrum_end);
 
-   res = calloc((spectrum_end - spectrum_start),
-                2);  // Over-allocate as b64 may grow
-
    size_t start_xml_len = 0;
    char* spectrum_start_xml = extract_spectrum_start_xml(
        input_map, dctx, df, xml_block_lens, xml_pos, divisions, spectrum_start,
        spectrum_end, &start_xml_len);
-   memcpy(res, spectrum_start_xml, start_xml_len);
-   *out_len += start_xml_len;
 
    size_t mz_len = 0;
    char* spectrum_mz =
@@ -802,11 +1038,9 @@ char* extract_spectra(char* input_map, ZSTD_DCtx* dctx, data_format_t* df,
    if (spectrum_mz == NULL) {
       error("extract_spectra: Failed to extract m/z values for spectrum index %ld.\n",
             index);
-      free(res);
+      free(spectrum_start_xml);
       return NULL;
    }
-   memcpy(res + *out_len, spectrum_mz, mz_len);
-   *out_len += mz_len;
 
    size_t inner_xml_len = 0;
    char* spectrum_inner_xml = extract_spectrum_inner_xml(
@@ -816,13 +1050,11 @@ char* extract_spectra(char* input_map, ZSTD_DCtx* dctx, data_format_t* df,
    if (spectrum_inner_xml == NULL) {
       error("extract_spectra: Failed to extract inner XML for spectrum index %ld.\n",
             index);
-      free(res);
+      free(spectrum_start_xml);
+      free(spectrum_mz);
       return NULL;
    }
 
-   memcpy(res + *out_len, spectrum_inner_xml, inner_xml_len);
-   *out_len += inner_xml_len;
-
    size_t inten_len = 0;
    char* spectrum_inten =
        extract_spectrum_inten(input_map, dctx, df, inten_binary_block_lens,
@@ -830,13 +1062,12 @@ char* extract_spectra(char* input_map, ZSTD_DCtx* dctx, data_format_t* df,
    if (spectrum_inten == NULL) {
       error("extract_spectra: Failed to extract intensity values for spectrum index %ld.\n",
             index);
-      free(res);
+      free(spectrum_start_xml);
+      free(spectrum_mz);
+      free(spectrum_inner_xml);
       return NULL;
    }
 
-   memcpy(res + *out_len, spectrum_inten, inten_len);
-   *out_len += inten_len;
-
    size_t last_xml_len = 0;
    char* spectrum_last_xml = extract_spectrum_last_xml(
        input_map, dctx, df, xml_block_lens, xml_pos, divisions, spectrum_start,
@@ -844,20 +1075,374 @@ char* extract_spectra(char* input_map, ZSTD_DCtx* dctx, data_format_t* df,
    if (spectrum_last_xml == NULL) {
       error("extract_spectra: Failed to extract last XML for spectrum index %ld.\n",
             index);
-      free(res);
+      free(spectrum_start_xml);
+      free(spectrum_mz);
+      free(spectrum_inner_xml);
+      free(spectrum_inten);
+      return NULL;
+   }
+
+   // All lengths are known, so the XML preceding each array can be rewritten
+   // in one pass if arrays were re-encoded with a different compression.
+   // One more byte keeps the result NUL-terminated.
+   res = malloc(start_xml_len + mz_len + inner_xml_len + inten_len +
+                last_xml_len + 2 * BINARY_XML_SLACK + 1);
+   if (res == NULL) {
+      error("extract_spectra: Failed to allocate spectrum buffer.\n");
+      free(spectrum_start_xml);
+      free(spectrum_mz);
+      free(spectrum_inner_xml);
+      free(spectrum_inten);
+      free(spectrum_last_xml);
       return NULL;
    }
 
+   *out_len += copy_spectrum_xml(df, res + *out_len, spectrum_start_xml,
+                                 start_xml_len, mz_len);
+   memcpy(res + *out_len, spectrum_mz, mz_len);
+   *out_len += mz_len;
+
+   *out_len += copy_spectrum_xml(df, res + *out_len, spectrum_inner_xml,
+                                 inner_xml_len, inten_len);
+   memcpy(res + *out_len, spectrum_inten, inten_len);
+   *out_len += inten_len;
+
    memcpy(res + *out_len, spectrum_last_xml, last_xml_len);
    *out_len += last_xml_len;
+   res[*out_len] = '\0';
+
+   free(spectrum_start_xml);
+   free(spectrum_mz);
+   free(spectrum_inner_xml);
+   free(spectrum_inten);
+   free(spectrum_last_xml);
 
    print("Extracted spectrum index %ld\n", index);
    return res;
 }
 
-void extract_msz(char* input_map, size_t input_filesize, long* indicies,
-                 long indicies_length, uint32_t* scans, long scans_length,
-                 uint16_t ms_level, int output_fd) {
+/* Requested spectra handed to a worker at once. Batches never span divisions,
+ * so a worker decompresses the blocks of a single division per batch. */
+#define EXTRACT_BATCH_SIZE 16
+
+/**
+ * @brief A run of requested spectra from the same division, extracted by one
+ * worker into a single buffer.
+ */
+typedef struct {
+   long* indices;
+   long n_indices;
+   char* ret;
+   size_t ret_len;
+   int failed;
+} extract_batch_t;
+
+/**
+ * @brief State shared between the extraction worker pool and the ordered
+ * writer. Batches are handed to workers in order, and at most max_pending
+ * batches may be extracted but not yet written, which bounds peak memory.
+ */
+typedef struct {
+   char* input_map;
+   data_format_t* df;
+   footer_t* footer;
+   divisions_t* divisions;
+   block_len_queue_t* xml_block_lens;
+   block_len_queue_t* mz_binary_block_lens;
+   block_len_queue_t* inten_binary_block_lens;
+
+   extract_batch_t* batches;
+   long n_batches;
+   long next;        // Next batch to hand to a worker.
+   long pending;     // Batches started but not yet written.
+   long max_pending;
+   int failed;       // Set by the writer to stop the workers.
+   int* done;
+
+#ifdef _WIN32
+   CRITICAL_SECTION lock;
+   CONDITION_VARIABLE ready;  // Signaled when a batch finishes.
+   CONDITION_VARIABLE space;  // Signaled when the writer frees a slot.
+#else
+   pthread_mutex_t lock;
+   pthread_cond_t ready;
+   pthread_cond_t space;
+#endif
+} extract_pool_t;
+
+#ifdef _WIN32
+typedef CONDITION_VARIABLE pool_cond_t;
+static void pool_lock(extract_pool_t* p) { EnterCriticalSection(&p->lock); }
+static void pool_unlock(extract_pool_t* p) { LeaveCriticalSection(&p->lock); }
+static void pool_wait(extract_pool_t* p, pool_cond_t* c) {
+   SleepConditionVariableCS(c, &p->lock, INFINITE);
+}
+static void pool_broadcast(pool_cond_t* c) { WakeAllConditionVariable(c); }
+#else
+typedef pthread_cond_t pool_cond_t;
+static void pool_lock(extract_pool_t* p) { pthread_mutex_lock(&p->lock); }
+static void pool_unlock(extract_pool_t* p) { pthread_mutex_unlock(&p->lock); }
+static void pool_wait(extract_pool_t* p, pool_cond_t* c) {
+   pthread_cond_wait(c, &p->lock);
+}
+static void pool_broadcast(pool_cond_t* c) { pthread_cond_broadcast(c); }
+#endif
+
+/**
+ * @brief Splits the requested indices in batches of consecutive indices from
+ * the same division, keeping the requested order.
+ * @param n_batches Set to the number of batches.
+ * @return The batches on success, NULL on error.
+ */
+static extract_batch_t* batch_indices(divisions_t* divisions, long* indices,
+                                      long n_indices, long* n_batches) {
+   extract_batch_t* r;
+   int division, prev_division = -1;
+   long n = 0;
+
+   r = calloc(n_indices > 0 ? n_indices : 1, sizeof(extract_batch_t));
+   if (r == NULL) {
+      error("batch_indices: malloc failure.\n");
+      return NULL;
+   }
+
+   for (long i = 0; i < n_indices; i++) {
+      division = find_division(divisions, indices[i], NULL);
+      if (n == 0 || division != prev_division ||
+          r[n - 1].n_indices == EXTRACT_BATCH_SIZE) {
+         r[n].indices = indices + i;
+         n++;
+      }
+      r[n - 1].n_indices++;
+      prev_division = division;
+   }
+
+   *n_batches = n;
+   return r;
+}
+
+static extract_pool_t* alloc_extract_pool(extract_batch_t* batches,
+                                          long n_batches, long max_pending) {
+   extract_pool_t* r = calloc(1, sizeof(extract_pool_t));
+   if (r == NULL) {
+      error("alloc_extract_pool: malloc() error.\n");
+      return NULL;
+   }
+   r->done = calloc(n_batches > 0 ? n_batches : 1, sizeof(int));
+   if (r->done == NULL) {
+      error("alloc_extract_pool: malloc() error.\n");
+      free(r);
+      return NULL;
+   }
+   r->batches = batches;
+   r->n_batches = n_batches;
+   r->max_pending = max_pending;
+#ifdef _WIN32
+   InitializeCriticalSection(&r->lock);
+   InitializeConditionVariable(&r->ready);
+   InitializeConditionVariable(&r->space);
+#else
+   pthread_mutex_init(&r->lock, NULL);
+   pthread_cond_init(&r->ready, NULL);
+   pthread_cond_init(&r->space, NULL);
+#endif
+   return r;
+}
+
+static void dealloc_extract_pool(extract_pool_t* pool) {
+#ifdef _WIN32
+   DeleteCriticalSection(&pool->lock);
+#else
+   pthread_mutex_destroy(&pool->lock);
+   pthread_cond_destroy(&pool->ready);
+   pthread_cond_destroy(&pool->space);
+#endif
+   free(pool->done);
+   free(pool);
+}
+
+/**
+ * @brief Extracts the spectra of a batch into one buffer. Spectra that fail to
+ * extract are skipped (extract_spectra() reports them), as the sequential
+ * extraction did.
+ */
+static void extract_batch(extract_pool_t* pool, ZSTD_DCtx* dctx,
+                          extract_batch_t* batch) {
+   size_t capacity = 0, spectrum_len;
+   char *spectrum, *buff;
+
+   for (long i = 0; i < batch->n_indices; i++) {
+      spectrum_len = 0;
+      spectrum = extract_spectra(
+          pool->input_map, dctx, pool->df, pool->xml_block_lens,
+          pool->mz_binary_block_lens, pool->inten_binary_block_lens,
+          pool->footer->xml_pos, pool->footer->mz_binary_pos,
+          pool->footer->inten_binary_pos, pool->footer->mz_fmt,
+          pool->footer->inten_fmt, pool->divisions, batch->indices[i],
+          &spectrum_len);
+      if (spectrum == NULL)
+         continue;
+
+      if (batch->ret_len + spectrum_len > capacity) {
+         capacity = (batch->ret_len + spectrum_len) * 2;
+         buff = realloc(batch->ret, capacity);
+         if (buff == NULL) {
+            error("extract_batch: malloc failure.\n");
+            free(spectrum);
+            batch->failed = 1;
+            return;
+         }
+         batch->ret = buff;
+      }
+      memcpy(batch->ret + batch->ret_len, spectrum, spectrum_len);
+      batch->ret_len += spectrum_len;
+      free(spectrum);
+   }
+}
+
+/**
+ * @brief Worker of the extraction pool. Takes the next batch once a pending
+ * slot is available, extracts it and marks it done for the writer.
+ * @param arg A pointer to the extract_pool_t.
+ * @return Always returns NULL.
+ */
+static void* extract_worker(void* arg) {
+   extract_pool_t* pool = (extract_pool_t*)arg;
+   ZSTD_DCtx* dctx = alloc_dctx();
+   long i;
+
+   for (;;) {
+      pool_lock(pool);
+      while (!pool->failed && pool->next < pool->n_batches &&
+             pool->pending >= pool->max_pending)
+         pool_wait(pool, &pool->space);
+      if (pool->failed || pool->next >= pool->n_batches) {
+         pool_unlock(pool);
+         break;
+      }
+      i = pool->next++;
+      pool->pending++;
+      pool_unlock(pool);
+
+      if (dctx == NULL)
+         pool->batches[i].failed = 1;
+      else
+         extract_batch(pool, dctx, &pool->batches[i]);
+
+      pool_lock(pool);
+      pool->done[i] = 1;
+      pool_broadcast(&pool->ready);
+      pool_unlock(pool);
+   }
+
+   if (dctx != NULL)
+      ZSTD_freeDCtx(dctx);
+   return NULL;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI extract_worker_win(LPVOID lpParam) {
+   extract_worker(lpParam);
+   return 0;
+}
+#endif
+
+/**
+ * @brief Extracts the requested spectra on a pool of threads and writes them
+ * in the requested order. Spectra are grouped by division (batch_indices()) so
+ * each worker mostly decompresses its own blocks; blocks shared between
+ * workers are decompressed once through the block cache.
+ * @return 0 on success, 1 on error.
+ */
+static int extract_spectra_parallel(extract_pool_t* pool, int threads,
+                                    int output_fd) {
+   long i;
+   int t, r = 0;
+
+   if (threads > pool->n_batches)
+      threads = pool->n_batches;
+   if (threads < 1)
+      threads = 1;
+
+#ifdef _WIN32
+   HANDLE* ptid = (HANDLE*)malloc(sizeof(HANDLE) * threads);
+#else
+   pthread_t* ptid = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+#endif
+   if (ptid == NULL) {
+      error("extract_spectra_parallel: malloc failure.\n");
+      return 1;
+   }
+
+   for (t = 0; t < threads; t++) {
+#ifdef _WIN32
+      ptid[t] = CreateThread(NULL, 0, extract_worker_win, pool, 0, NULL);
+      if (ptid[t] == NULL) {
+         perror("CreateThread");
+         break;
+      }
+#else
+      if (pthread_create(&ptid[t], NULL, extract_worker, pool) != 0) {
+         perror("pthread_create");
+         break;
+      }
+#endif
+   }
+   if (t == 0) {
+      free(ptid);
+      return 1;
+   }
+   threads = t;
+
+   // Ordered writer: write batches in order as soon as each one is ready
+   // while the workers continue on the following batches.
+   for (i = 0; i < pool->n_batches; i++) {
+      pool_lock(pool);
+      while (!pool->done[i]) pool_wait(pool, &pool->ready);
+      pool_unlock(pool);
+
+      if (pool->batches[i].failed) {
+         error("extract_msz: Extraction failed for batch %ld.\n", i);
+         pool_lock(pool);
+         pool->failed = 1;
+         pool_broadcast(&pool->space);
+         pool_unlock(pool);
+         r = 1;
+         break;
+      }
+
+      write_to_file(output_fd, pool->batches[i].ret, pool->batches[i].ret_len);
+      free(pool->batches[i].ret);
+      pool->batches[i].ret = NULL;
+
+      pool_lock(pool);
+      pool->pending--;
+      pool_broadcast(&pool->space);
+      pool_unlock(pool);
+   }
+
+#ifdef _WIN32
+   WaitForMultipleObjects(threads, ptid, TRUE, INFINITE);
+#else
+   for (t = 0; t < threads; t++) pthread_join(ptid[t], NULL);
+#endif
+   free(ptid);
+
+   for (i = 0; i < pool->n_batches; i++) free(pool->batches[i].ret);
+
+   return r;
+}
+
+/**
+ * @brief Extracts the spectra selected by indicies, scans, ms_level or
+ * rt_range from an msz file and writes them as mzML to output_fd.
+ * @return 0 on success, -1 on error.
+ */
+int extract_msz(char* input_map, size_t input_filesize, long* indicies,
+                long indicies_length, uint32_t* scans, long scans_length,
+                uint16_t ms_level, float* rt_range,
+                uint32_t target_binary_encoding, int zlib_engine,
+                int zlib_level, long cache_size, int threads, int output_fd) {
    block_len_queue_t *xml_block_lens, *mz_binary_block_lens,
        *inten_binary_block_lens;
    footer_t* msz_footer;
@@ -868,8 +1453,13 @@ void extract_msz(char* input_map, size_t input_filesize, long* indicies,
 
    ZSTD_DCtx* dctx = alloc_dctx();
 
-   if (dctx == NULL)
-      error("decompress_routine: ZSTD Context failed.\n");
+   if (dctx == NULL) {
+      error("extract_msz: ZSTD Context failed.\n");
+      return -1;
+   }
+
+   if (check_format_version(input_map))
+      return -1;
 
    df = get_header_df(input_map);
 
@@ -877,23 +1467,58 @@ void extract_msz(char* input_map, size_t input_filesize, long* indicies,
                 &mz_binary_block_lens, &inten_binary_block_lens, &divisions,
                 &n_divisions);
 
+   // Secondary indexes answer the queries below without walking the
+   // divisions. Files written without them fall back to the divisions.
+   msz_index_t* index = read_secondary_indexes(input_map, input_filesize);
+
    if (ms_level != 0)  // MS level selected
    {
-      indicies = map_ms_level_to_index_from_divisions(ms_level, divisions,
-                                                      &indicies_length);
+      indicies = query_ms_level_index(index, ms_level, &indicies_length);
+      if (indicies == NULL)
+         indicies = map_ms_level_to_index_from_divisions(ms_level, divisions,
+                                                         &indicies_length);
    }
 
    else if (scans_length > 0)  // Scan extraction selected
    {
-      indicies = map_scans_to_index_from_divisions(scans, scans_length,
-                                                   divisions, &indicies_length);
+      indicies =
+          query_scan_index(index, scans, scans_length, &indicies_length);
+      if (indicies == NULL)
+         indicies = map_scans_to_index_from_divisions(
+             scans, scans_length, divisions, &indicies_length);
+   }
+
+   else if (rt_range != NULL)  // Retention time window selected
+   {
+      indicies = query_rt_index(index, rt_range, &indicies_length);
+      if (indicies == NULL) {
+         // Only divisions overlapping the window are read (and later
+         // decompressed).
+         int n =
+             read_ret_times(input_map, input_filesize, divisions, rt_range);
+         if (n < 0) {
+            error("extract_msz: msz file has no retention times.\n");
+            return -1;
+         }
+         print("%d of %d divisions overlap retention time range.\n", n,
+               n_divisions);
+         indicies = map_rt_range_to_index_from_divisions(rt_range, divisions,
+                                                         &indicies_length);
+      }
    }
 
+   dealloc_secondary_indexes(index);
+
+   if (target_binary_encoding != 0)
+      df->output_compression = target_binary_encoding;
+   if (set_deflate_backend(df, zlib_engine, zlib_level))
+      return -1;
+
    set_decompress_runtime_variables(df, msz_footer);
 
    if (n_divisions == 0) {
       warning("No divisions found in file, aborting...\n");
-      return;
+      return -1;
    }
 
    block_len_t *xml_blk_len, *mz_binary_blk_len, *inten_binary_blk_len;
@@ -903,34 +1528,58 @@ void extract_msz(char* input_map, size_t input_filesize, long* indicies,
    char *decmp_xml, *decmp_mz_binary, *decmp_inten_binary;
    division_t* curr_division = divisions->divisions[0];
 
+   // Bound the decompressed blocks kept while extracting. The cache is also
+   // what keeps workers from decompressing the same block twice, so it is
+   // used (without limit) even if cache_size is 0.
+   block_cache_t* cache = alloc_block_cache(cache_size > 0 ? cache_size : 0);
+   if (cache == NULL)
+      return -1;
+   xml_block_lens->cache = cache;
+   mz_binary_block_lens->cache = cache;
+   inten_binary_block_lens->cache = cache;
+
    // Get mzML header (in first division):
    size_t header_len = 0;
    xml_blk_len = get_block_by_index(xml_block_lens, 0);
    xml_blk_offset = msz_footer->xml_pos;
-   decmp_xml = (char*)decmp_block(df->xml_decompression_fun, dctx, input_map,
-                                  xml_blk_offset, xml_blk_len);
+   block_cache_pin(cache, xml_blk_len);
+   decmp_xml = decmp_pinned_range(df->xml_decompression_fun, dctx, input_map,
+                                  xml_blk_offset, xml_blk_len, 0,
+                                  curr_division->spectra->start_positions[0]);
    if (decmp_xml == NULL) {
       error("extract_msz: Failed to decompress XML block for mzML header.\n");
-      return;
+      return -1;
    }
-   xml_blk_len->cache = decmp_xml;  // Cache decompressed block
    char* mzml_header =
        extract_mzml_header(decmp_xml, curr_division, &header_len);
+   block_cache_unpin(cache, xml_blk_len);
    // print("%s\n", mzml_header);
    write_to_file(output_fd, mzml_header, header_len);
 
    // Get spectra
-   for (long i = 0; i < indicies_length; i++) {
-      size_t spectra_len = 0;
-      char* spectrum = extract_spectra(
-          input_map, dctx, df, xml_block_lens, mz_binary_block_lens,
-          inten_binary_block_lens, msz_footer->xml_pos,
-          msz_footer->mz_binary_pos, msz_footer->inten_binary_pos,
-          msz_footer->mz_fmt, msz_footer->inten_fmt, divisions, indicies[i],
-          &spectra_len);
-      write_to_file(output_fd, spectrum, spectra_len);
-      free(spectrum);
-   }
+   long n_batches = 0;
+   extract_batch_t* batches =
+       batch_indices(divisions, indicies, indicies_length, &n_batches);
+   if (batches == NULL)
+      return -1;
+   extract_pool_t* pool =
+       alloc_extract_pool(batches, n_batches, threads > 0 ? threads * 2 : 2);
+   if (pool == NULL)
+      return -1;
+   pool->input_map = input_map;
+   pool->df = df;
+   pool->footer = msz_footer;
+   pool->divisions = divisions;
+   pool->xml_block_lens = xml_block_lens;
+   pool->mz_binary_block_lens = mz_binary_block_lens;
+   pool->inten_binary_block_lens = inten_binary_block_lens;
+
+   int ret = extract_spectra_parallel(pool, threads, output_fd);
+   dealloc_extract_pool(pool);
+   free(batches);
+   if (ret != 0)
+      return -1;
+   print("Extracted %ld spectra in %ld batches.\n", indicies_length, n_batches);
 
    // Get mzML footer (in last division):
    size_t footer_len = 0;
@@ -938,14 +1587,58 @@ void extract_msz(char* input_map, size_t input_filesize, long* indicies,
    xml_blk_offset =
        msz_footer->xml_pos +
        get_block_offset_by_index(xml_block_lens, divisions->n_divisions - 1);
-   decmp_xml = (char*)decmp_block(df->xml_decompression_fun, dctx, input_map,
-                                  xml_blk_offset, xml_blk_len);
+   block_cache_pin(cache, xml_blk_len);
+   decmp_xml = decmp_pinned_range(df->xml_decompression_fun, dctx, input_map,
+                                  xml_blk_offset, xml_blk_len, 0,
+                                  xml_blk_len->original_size);
    if (decmp_xml == NULL) {
       error("extract_msz: Failed to decompress XML block for mzML footer.\n");
-      return;
+      return -1;
+   }
+   size_t decmp_xml_len = xml_blk_len->original_size;
+
+   chromatograms_t* chrom;
+   if (read_chromatograms(input_map, input_filesize, &chrom)) {
+      error("extract_msz: Failed to read chromatograms.\n");
+      return -1;
    }
-   xml_blk_len->cache = decmp_xml;  // Cache decompressed block
-   char* mzml_footer = extract_mzml_footer(decmp_xml, divisions, &footer_len);
+   if (chrom != NULL) {
+      // Chromatogram arrays are stored outside of the XML block, rebuild the
+      // trailing division.
+      if (target_binary_encoding != 0)
+         chrom->df->output_compression = target_binary_encoding;
+      if (set_deflate_backend(chrom->df, zlib_engine, zlib_level) != 0 ||
+          set_decompress_runtime_variables(chrom->df, chrom->footer) != 0) {
+         error("extract_msz: Failed to set chromatogram decompression runtime variables.\n");
+         return -1;
+      }
+      decompress_args_t* chrom_args = alloc_decompress_args(
+          input_map, chrom->df, xml_blk_len,
+          get_block_by_index(chrom->time_block_lens, 0),
+          get_block_by_index(chrom->inten_block_lens, 0), chrom->division,
+          xml_blk_offset, chrom->footer->mz_binary_pos,
+          chrom->footer->inten_binary_pos);
+      decompress_routine(chrom_args);
+      if (chrom_args->ret == NULL) {
+         error("extract_msz: Failed to decompress chromatograms.\n");
+         return -1;
+      }
+      decmp_xml = chrom_args->ret;
+      decmp_xml_len = chrom_args->ret_len;
+   }
+
+   char* mzml_footer =
+       extract_mzml_footer(decmp_xml, decmp_xml_len, divisions, &footer_len);
    // print("%s\n", mzml_footer);
    write_to_file(output_fd, mzml_footer, footer_len);
+   block_cache_unpin(cache, xml_blk_len);
+
+   if (cache_size > 0)
+      print("Block cache: %lu hits, %lu misses, %lu evictions.\n", cache->hits,
+            cache->misses, cache->evictions);
+   xml_block_lens->cache = NULL;
+   mz_binary_block_lens->cache = NULL;
+   inten_binary_block_lens->cache = NULL;
+   dealloc_block_cache(cache);
+   return 0;
 }
\ No newline at end of file
@@ -131,28 +131,125 @@ long update_fd_pos(int fd, long increment) {
    return 0;
 }
 
+void* get_output_mapping(int fd, size_t size)
+/**
+ * @brief Extends the output file to size bytes and maps it writable so
+ * threads can write their output directly at known offsets. The file position
+ * is moved to the end of the mapped region.
+ *
+ * @return A pointer to the writable mapping on success, NULL on error (e.g.
+ * output is not a regular file).
+ */
+{
+   void* mapped_data = NULL;
+   struct stat buff;
+
+   if (fd == -1 || size == 0)
+      return NULL;
+
+   // Only map freshly created regular files; pipes and files that already
+   // hold data (e.g. stdout redirected with >>) are written sequentially.
+   if (fstat(fd, &buff) == -1 || (buff.st_mode & S_IFMT) != S_IFREG ||
+       buff.st_size != 0)
+      return NULL;
+
+#ifdef _WIN32
+
+   HANDLE hFile = (HANDLE)_get_osfhandle(fd);
+   HANDLE hMapping =
+       CreateFileMapping(hFile, NULL, PAGE_READWRITE, (DWORD)(size >> 32),
+                         (DWORD)(size & 0xFFFFFFFF), NULL);
+
+   if (hMapping != NULL) {
+      mapped_data = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, size);
+      CloseHandle(hMapping);
+   }
+
+#else
+
+   if (ftruncate(fd, size) != 0)
+      return NULL;
+
+   mapped_data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (mapped_data == MAP_FAILED) {
+      ftruncate(fd, 0);
+      return NULL;
+   }
+
+#endif
+
+   if (mapped_data != NULL) {
+#ifdef _WIN32
+      lseek64(fd, size, SEEK_SET);
+#else
+      lseek(fd, size, SEEK_SET);
+#endif
+      update_fd_pos(fd, size);
+   }
+
+   return mapped_data;
+}
+
+int truncate_output(int fd)
+/**
+ * @brief Discards everything written to a regular output file and moves the
+ * file position back to its start. Pipes cannot be rewound and are left as is.
+ *
+ * @return 0 on success (or if fd is not a regular file), -1 on error.
+ */
+{
+   struct stat buff;
+
+   if (fd == -1 || fstat(fd, &buff) == -1)
+      return -1;
+   if ((buff.st_mode & S_IFMT) != S_IFREG)
+      return 0;
+
+#ifdef _WIN32
+   if (_chsize_s(fd, 0) != 0)
+      return -1;
+   lseek64(fd, 0, SEEK_SET);
+#else
+   if (ftruncate(fd, 0) != 0)
+      return -1;
+   lseek(fd, 0, SEEK_SET);
+#endif
+
+   for (int i = 0; i < 3; i++)
+      if (fds[i] == fd)
+         fd_pos[i] = 0;
+
+   return 0;
+}
+
 size_t write_to_file(int fd, char* buff, size_t n) {
    if (fd < 0)
       error("write_to_file: invalid file descriptor.\n");
 
    ssize_t rv;
+   size_t written = 0;
 
+   // Pipes (e.g. stdout) may accept less than n bytes per write().
+   while (written < n) {
 #ifdef _WIN32
-   rv = write(fd, buff, (unsigned int)n);
+      rv = write(fd, buff + written, (unsigned int)(n - written));
 #else
-   rv = write(fd, buff, n);
+      rv = write(fd, buff + written, n - written);
 #endif
+      if (rv < 0) {
+         if (errno == EINTR)
+            continue;
+         error("Error in writing %ld bytes to file descriptor %d. (%s)\n", n,
+               fd, strerror(errno));
+         break;
+      }
+      written += rv;
+   }
 
-   if (rv < 0)
-      error(
-          "Error in writing %ld bytes to file descriptor %d. Attempted to "
-          "write %s",
-          n, fd, buff);
-
-   if (!update_fd_pos(fd, rv))
+   if (!update_fd_pos(fd, written) && n > 0)
       error("write_to_file: error in updating fd pos\n");
 
-   return (size_t)rv;
+   return written;
 }
 
 size_t read_from_file(int fd, void* buff, size_t n) {
@@ -267,6 +364,11 @@ data_format_t* deserialize_df(char* buff) {
    memcpy(&r->int_scale_factor, buff + offset, sizeof(float));
    offset += sizeof(float);
 
+   /* runtime variables */
+   r->output_compression = r->source_compression;
+   r->zlib_engine = DEFLATE_ONESHOT;
+   r->zlib_level = Z_DEFAULT_COMPRESSION;
+
    return r;
 }
 
@@ -407,6 +509,153 @@ void print_footer_csv(footer_t* footer) {
           footer->mz_fmt, footer->inten_fmt);
 }
 
+sections_t* alloc_sections()
+/**
+ * @brief Allocates an empty section table.
+ *
+ * @return An empty sections_t on success, NULL on error.
+ */
+{
+   sections_t* r = malloc(sizeof(sections_t));
+   if (r == NULL) {
+      error("alloc_sections: malloc failed.\n");
+      return NULL;
+   }
+   r->entries = NULL;
+   r->n_sections = 0;
+   return r;
+}
+
+void dealloc_sections(sections_t* sections) {
+   if (sections) {
+      if (sections->entries)
+         free(sections->entries);
+      free(sections);
+   }
+}
+
+int add_section(sections_t* sections, uint32_t type, uint64_t pos,
+                uint64_t len)
+/**
+ * @brief Appends a section entry to the section table.
+ *
+ * @param sections Section table allocated by alloc_sections().
+ *
+ * @param type Section type (e.g. CHROMATOGRAM_SECTION).
+ *
+ * @param pos msz file position of the start of the section.
+ *
+ * @param len Length of the section in bytes.
+ *
+ * @return 0 on success, -1 on error.
+ */
+{
+   section_t* entries;
+
+   if (sections == NULL) {
+      error("add_section: sections is NULL.\n");
+      return -1;
+   }
+
+   entries = realloc(sections->entries,
+                     sizeof(section_t) * (sections->n_sections + 1));
+   if (entries == NULL) {
+      error("add_section: realloc failed.\n");
+      return -1;
+   }
+
+   entries[sections->n_sections].type = type;
+   entries[sections->n_sections].reserved = 0;
+   entries[sections->n_sections].pos = pos;
+   entries[sections->n_sections].len = len;
+
+   sections->entries = entries;
+   sections->n_sections++;
+
+   return 0;
+}
+
+section_t* find_section(sections_t* sections, uint32_t type) {
+   if (sections == NULL)
+      return NULL;
+   for (uint32_t i = 0; i < sections->n_sections; i++)
+      if (sections->entries[i].type == type)
+         return &sections->entries[i];
+   return NULL;
+}
+
+void write_sections(sections_t* sections, int fd)
+/**
+ * @brief Writes the section table followed by a section_trailer_t. Must be
+ * called right before write_footer() so the trailer directly precedes the
+ * footer. Nothing is written for an empty table, leaving the file layout
+ * unchanged.
+ *
+ * @param sections A populated section table.
+ *
+ * @param fd File descriptor to write to.
+ */
+{
+   section_trailer_t trailer;
+
+   if (sections == NULL || sections->n_sections == 0)
+      return;
+
+   trailer.sections_pos = get_offset(fd);
+   trailer.n_sections = sections->n_sections;
+   trailer.magic_tag = SECTION_MAGIC_TAG;
+
+   write_to_file(fd, (char*)sections->entries,
+                 sizeof(section_t) * sections->n_sections);
+   write_to_file(fd, (char*)&trailer, sizeof(section_trailer_t));
+}
+
+sections_t* read_sections(void* input_map, long filesize)
+/**
+ * @brief Reads the section table of an mmap'ed msz file.
+ *
+ * @param input_map mmap'ed msz file.
+ *
+ * @param filesize Size of the msz file.
+ *
+ * @return A sections_t (empty if the file has no sections) on success, NULL on
+ * error.
+ */
+{
+   section_trailer_t* trailer;
+   long trailer_pos;
+   sections_t* r;
+
+   r = alloc_sections();
+   if (r == NULL)
+      return NULL;
+
+   trailer_pos = filesize - sizeof(footer_t) - sizeof(section_trailer_t);
+   if (trailer_pos < HEADER_SIZE)
+      return r;
+
+   trailer = (section_trailer_t*)((char*)input_map + trailer_pos);
+
+   // The table must end exactly where the trailer starts; this rules out
+   // files written before sections existed.
+   if (trailer->magic_tag != SECTION_MAGIC_TAG ||
+       trailer->sections_pos + sizeof(section_t) * trailer->n_sections !=
+           (uint64_t)trailer_pos)
+      return r;
+
+   r->entries = malloc(sizeof(section_t) * trailer->n_sections);
+   if (r->entries == NULL) {
+      error("read_sections: malloc failed.\n");
+      free(r);
+      return NULL;
+   }
+   memcpy(r->entries, (char*)input_map + trailer->sections_pos,
+          sizeof(section_t) * trailer->n_sections);
+   r->n_sections = trailer->n_sections;
+
+   return r;
+}
+
 int is_msz(void* input_map, size_t input_length)
 /**
  * @brief Determines if file mapped in input_map is an msz file.
@@ -433,6 +682,31 @@ int is_msz(void* input_map, size_t input_length)
    return 0;
 }
 
+int check_format_version(void* input_map)
+/**
+ * @brief Checks that this build can read the format version of an msz file.
+ *        Files of a newer major version would be misread (see
+ *        FORMAT_VERSION_MAJOR) and are rejected.
+ *
+ * @param input_map Pointer to the memory-mapped file.
+ *
+ * @return 0 if the file can be read. 1 otherwise.
+ */
+{
+   int major, minor;
+
+   memcpy(&major, (char*)input_map + sizeof(int), sizeof(int));
+   memcpy(&minor, (char*)input_map + 2 * sizeof(int), sizeof(int));
+
+   if (major > FORMAT_VERSION_MAJOR) {
+      error("Unsupported msz format version %d.%d (supported up to %d.x).\n",
+            major, minor, FORMAT_VERSION_MAJOR);
+      return 1;
+   }
+
+   return 0;
+}
+
 int is_mzml(void* input_map, size_t input_length)
 /**
  * @brief Determines if file mapped in input_map is an mzML file.
@@ -555,13 +829,22 @@ char* strip_or_append_extension(char* input) {
 int open_output_file(char* path) {
    int fd = -1;
 
-   if (path) {
+   if (path && strcmp(path, "-") == 0) {  // Stream to stdout.
+#ifdef _WIN32
+      fd = _fileno(stdout);
+      _setmode(fd, _O_BINARY);
+#else
+      fd = STDOUT_FILENO;
+#endif
+      fds[1] = fd;
+   } else if (path) {
 #ifdef _WIN32
-      fd = _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_APPEND | _O_BINARY,
+      fd = _open(path, _O_RDWR | _O_CREAT | _O_TRUNC | _O_BINARY,
                  0666);  // open in binary mode to avoid newline translation in
                          // Windows.
 #else
-      fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666);
+      fd = open(path, O_RDWR | O_CREAT | O_TRUNC,
+                0666);  // O_RDWR for get_output_mapping().
 #endif
       if (fd < 0)
          warning("Error in opening output file descriptor. (%s)\n",
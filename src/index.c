@@ -0,0 +1,602 @@
+/**
+ * @file index.c
+ * @author Chris Grams (chrisagrams@gmail.com)
+ * @brief Secondary indexes mapping scan numbers, MS levels and retention times
+ * to spectrum indices. The indexes are built from the divisions at compression
+ * time and stored uncompressed, 8-byte aligned, in their own sections so a
+ * reader answers queries straight from the mmap'ed file without walking the
+ * divisions.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mscompress.h"
+
+/* MS level index containers cover 65536 spectra. Containers holding more than
+ * MS_LEVEL_ARRAY_MAX spectra are stored as a bitmap, smaller ones as a sorted
+ * array of uint16_t offsets within the chunk. */
+#define MS_LEVEL_CHUNK_BITS 16
+#define MS_LEVEL_CHUNK_SIZE (1 << MS_LEVEL_CHUNK_BITS)
+#define MS_LEVEL_BITMAP_SIZE (MS_LEVEL_CHUNK_SIZE / 8)
+#define MS_LEVEL_ARRAY_MAX 4096
+
+#define ALIGN8(x) (((x) + 7) & ~(uint64_t)7)
+
+typedef struct {
+   uint32_t scan;
+   uint32_t index;
+} scan_entry_t;
+
+typedef struct {
+   float rt;
+   uint32_t index;
+} rt_entry_t;
+
+static int cmp_scan_entry(const void* a, const void* b) {
+   const scan_entry_t* x = a;
+   const scan_entry_t* y = b;
+   if (x->scan != y->scan)
+      return x->scan < y->scan ? -1 : 1;
+   return (x->index > y->index) - (x->index < y->index);
+}
+
+static int cmp_rt_entry(const void* a, const void* b) {
+   const rt_entry_t* x = a;
+   const rt_entry_t* y = b;
+   // Spectra without a retention time (NaN) sort last.
+   if (isnan(x->rt) || isnan(y->rt)) {
+      if (isnan(x->rt) != isnan(y->rt))
+         return isnan(x->rt) ? 1 : -1;
+   } else if (x->rt != y->rt) {
+      return x->rt < y->rt ? -1 : 1;
+   }
+   return (x->index > y->index) - (x->index < y->index);
+}
+
+static int cmp_long(const void* a, const void* b) {
+   long x = *(const long*)a;
+   long y = *(const long*)b;
+   return (x > y) - (x < y);
+}
+
+static void write_aligned_section(sections_t* sections, uint32_t type,
+                                  char* buff, uint64_t len, int fd) {
+   char zeros[8] = {0};
+   uint64_t section_pos;
+
+   section_pos = get_offset(fd);
+   if (section_pos % 8 != 0) {
+      write_to_file(fd, zeros, 8 - section_pos % 8);
+      section_pos = ALIGN8(section_pos);
+   }
+   write_to_file(fd, buff, len);
+   add_section(sections, type, section_pos, len);
+}
+
+static long count_spectra(divisions_t* divisions) {
+   long n = 0;
+   for (int i = 0; i < divisions->n_divisions; i++)
+      n += divisions->divisions[i]->spectra->total_spec;
+   return n;
+}
+
+static void write_scan_index(divisions_t* divisions, long n_spectra, int fd,
+                             sections_t* sections)
+/**
+ * @brief Writes SCAN_INDEX_SECTION: the number of entries as a uint64_t
+ * followed by {scan, index} uint32_t pairs sorted by scan number. A scan
+ * number repeated across divisions keeps one entry per spectrum.
+ */
+{
+   char* buff;
+   scan_entry_t* entries;
+   uint64_t n = n_spectra;
+   long k = 0;
+
+   buff = malloc(sizeof(uint64_t) + n * sizeof(scan_entry_t));
+   if (buff == NULL) {
+      warning("write_scan_index: malloc failure.\n");
+      return;
+   }
+   memcpy(buff, &n, sizeof(uint64_t));
+   entries = (scan_entry_t*)(buff + sizeof(uint64_t));
+
+   for (int i = 0; i < divisions->n_divisions; i++) {
+      division_t* div = divisions->divisions[i];
+      for (long j = 0; j < div->spectra->total_spec; j++, k++) {
+         entries[k].scan = div->scans[j];
+         entries[k].index = k;
+      }
+   }
+   qsort(entries, n, sizeof(scan_entry_t), cmp_scan_entry);
+
+   write_aligned_section(sections, SCAN_INDEX_SECTION, buff,
+                         sizeof(uint64_t) + n * sizeof(scan_entry_t), fd);
+   free(buff);
+}
+
+static void write_ms_level_index(divisions_t* divisions, long n_spectra,
+                                 int fd, sections_t* sections)
+/**
+ * @brief Writes MS_LEVEL_INDEX_SECTION, one compressed bitmap per MS level.
+ * Layout (offsets relative to the section start):
+ *    uint64_t n_spectra
+ *    uint32_t n_levels, n_chunks
+ *    uint32_t levels[n_levels]                  (padded to 8 bytes)
+ *    {uint32_t offset, cardinality}[n_levels][n_chunks]
+ *    containers, each 8-byte aligned
+ * Chunk c of a level covers spectra [c * 65536, (c + 1) * 65536).
+ */
+{
+   uint16_t* all_levels;
+   uint32_t levels[256];
+   uint32_t n_levels = 0, n_chunks, *dir, *fill;
+   uint64_t n = n_spectra, len, pos;
+   char* buff;
+   long i, k = 0;
+   uint32_t l, c;
+
+   all_levels = malloc(n * sizeof(uint16_t) + 1);
+   if (all_levels == NULL) {
+      warning("write_ms_level_index: malloc failure.\n");
+      return;
+   }
+   for (int d = 0; d < divisions->n_divisions; d++) {
+      division_t* div = divisions->divisions[d];
+      for (long j = 0; j < div->spectra->total_spec; j++)
+         all_levels[k++] = div->ms_levels[j];
+   }
+
+   for (i = 0; i < n_spectra; i++) {
+      for (l = 0; l < n_levels; l++)
+         if (levels[l] == all_levels[i])
+            break;
+      if (l == n_levels) {
+         if (n_levels == sizeof(levels) / sizeof(levels[0])) {
+            warning("write_ms_level_index: too many MS levels, skipping.\n");
+            free(all_levels);
+            return;
+         }
+         levels[n_levels++] = all_levels[i];
+      }
+   }
+
+   n_chunks = (n + MS_LEVEL_CHUNK_SIZE - 1) / MS_LEVEL_CHUNK_SIZE;
+
+   // Cardinalities first, to size the section.
+   dir = calloc((size_t)n_levels * n_chunks * 2 + 1, sizeof(uint32_t));
+   if (dir == NULL) {
+      warning("write_ms_level_index: malloc failure.\n");
+      free(all_levels);
+      return;
+   }
+   for (i = 0; i < n_spectra; i++) {
+      for (l = 0; levels[l] != all_levels[i]; l++);
+      dir[(l * n_chunks + (i >> MS_LEVEL_CHUNK_BITS)) * 2 + 1]++;
+   }
+
+   pos = sizeof(uint64_t) + 2 * sizeof(uint32_t) +
+         ALIGN8(n_levels * sizeof(uint32_t)) +
+         (uint64_t)n_levels * n_chunks * 2 * sizeof(uint32_t);
+   for (l = 0; l < n_levels; l++) {
+      for (c = 0; c < n_chunks; c++) {
+         uint32_t* e = &dir[(l * n_chunks + c) * 2];
+         e[0] = pos;
+         if (e[1] > MS_LEVEL_ARRAY_MAX)
+            pos += MS_LEVEL_BITMAP_SIZE;
+         else
+            pos += ALIGN8(e[1] * sizeof(uint16_t));
+      }
+   }
+   len = pos;
+
+   buff = calloc(len, 1);
+   if (buff == NULL) {
+      warning("write_ms_level_index: malloc failure.\n");
+      free(dir);
+      free(all_levels);
+      return;
+   }
+   memcpy(buff, &n, sizeof(uint64_t));
+   memcpy(buff + sizeof(uint64_t), &n_levels, sizeof(uint32_t));
+   memcpy(buff + sizeof(uint64_t) + sizeof(uint32_t), &n_chunks,
+          sizeof(uint32_t));
+   pos = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+   memcpy(buff + pos, levels, n_levels * sizeof(uint32_t));
+   pos += ALIGN8(n_levels * sizeof(uint32_t));
+   memcpy(buff + pos, dir, (size_t)n_levels * n_chunks * 2 * sizeof(uint32_t));
+
+   // Fill containers. Spectra are visited in order so arrays come out sorted.
+   fill = calloc((size_t)n_levels * n_chunks + 1, sizeof(uint32_t));
+   if (fill == NULL) {
+      warning("write_ms_level_index: malloc failure.\n");
+      free(buff);
+      free(dir);
+      free(all_levels);
+      return;
+   }
+   for (i = 0; i < n_spectra; i++) {
+      uint16_t low = i & (MS_LEVEL_CHUNK_SIZE - 1);
+      uint32_t* e;
+
+      for (l = 0; levels[l] != all_levels[i]; l++);
+      c = i >> MS_LEVEL_CHUNK_BITS;
+      e = &dir[(l * n_chunks + c) * 2];
+      if (e[1] > MS_LEVEL_ARRAY_MAX)
+         ((uint64_t*)(buff + e[0]))[low >> 6] |= (uint64_t)1 << (low & 63);
+      else
+         ((uint16_t*)(buff + e[0]))[fill[l * n_chunks + c]++] = low;
+   }
+
+   write_aligned_section(sections, MS_LEVEL_INDEX_SECTION, buff, len, fd);
+
+   free(fill);
+   free(buff);
+   free(dir);
+   free(all_levels);
+}
+
+static void write_rt_index(divisions_t* divisions, long n_spectra, int fd,
+                           sections_t* sections)
+/**
+ * @brief Writes RT_INDEX_SECTION: the number of entries as a uint64_t followed
+ * by {retention time (float, minutes), index (uint32_t)} pairs sorted by
+ * retention time.
+ */
+{
+   char* buff;
+   rt_entry_t* entries;
+   uint64_t n = n_spectra;
+   long k = 0;
+
+   for (int i = 0; i < divisions->n_divisions; i++)
+      if (divisions->divisions[i]->spectra->total_spec > 0 &&
+          divisions->divisions[i]->ret_times == NULL)
+         return;  // Not scanned with RETTIME.
+
+   buff = malloc(sizeof(uint64_t) + n * sizeof(rt_entry_t));
+   if (buff == NULL) {
+      warning("write_rt_index: malloc failure.\n");
+      return;
+   }
+   memcpy(buff, &n, sizeof(uint64_t));
+   entries = (rt_entry_t*)(buff + sizeof(uint64_t));
+
+   for (int i = 0; i < divisions->n_divisions; i++) {
+      division_t* div = divisions->divisions[i];
+      for (long j = 0; j < div->spectra->total_spec; j++, k++) {
+         entries[k].rt = div->ret_times[j];
+         entries[k].index = k;
+      }
+   }
+   qsort(entries, n, sizeof(rt_entry_t), cmp_rt_entry);
+
+   write_aligned_section(sections, RT_INDEX_SECTION, buff,
+                         sizeof(uint64_t) + n * sizeof(rt_entry_t), fd);
+   free(buff);
+}
+
+void write_secondary_indexes(divisions_t* divisions, sections_t* sections,
+                             int fd)
+/**
+ * @brief Writes the scan number, MS level and retention time indexes of the
+ * spectra in divisions. The retention time index is only written if the
+ * divisions were scanned with RETTIME.
+ *
+ * @param divisions Divisions scanned with SCANNUM and MSLEVEL.
+ *
+ * @param sections Section table to register the sections in.
+ *
+ * @param fd File descriptor to write to.
+ */
+{
+   long n_spectra;
+
+   if (divisions == NULL || divisions->n_divisions == 0)
+      return;
+
+   n_spectra = count_spectra(divisions);
+   if (n_spectra == 0 || (uint64_t)n_spectra > UINT32_MAX)
+      return;
+
+   for (int i = 0; i < divisions->n_divisions; i++)
+      if (divisions->divisions[i]->spectra->total_spec > 0 &&
+          (divisions->divisions[i]->scans == NULL ||
+           divisions->divisions[i]->ms_levels == NULL))
+         return;
+
+   write_scan_index(divisions, n_spectra, fd, sections);
+   write_ms_level_index(divisions, n_spectra, fd, sections);
+   write_rt_index(divisions, n_spectra, fd, sections);
+}
+
+msz_index_t* read_secondary_indexes(void* input_map, long input_filesize)
+/**
+ * @brief Maps the secondary indexes of an msz file. The returned indexes point
+ * into input_map, which must outlive them.
+ *
+ * @return A msz_index_t on success, NULL if the msz file has no secondary
+ * indexes or on error.
+ */
+{
+   sections_t* sections;
+   section_t* section;
+   msz_index_t* r;
+   char* ptr;
+   uint64_t n;
+
+   sections = read_sections(input_map, input_filesize);
+   if (sections == NULL)
+      return NULL;
+
+   r = calloc(1, sizeof(msz_index_t));
+   if (r == NULL) {
+      error("read_secondary_indexes: malloc failure.\n");
+      dealloc_sections(sections);
+      return NULL;
+   }
+
+   section = find_section(sections, SCAN_INDEX_SECTION);
+   if (section != NULL && section->pos % 8 == 0 &&
+       section->len >= sizeof(uint64_t)) {
+      ptr = (char*)input_map + section->pos;
+      memcpy(&n, ptr, sizeof(uint64_t));
+      if (section->len == sizeof(uint64_t) + n * sizeof(scan_entry_t)) {
+         r->n_scans = n;
+         r->scans = (uint32_t*)(ptr + sizeof(uint64_t));
+      }
+   }
+
+   section = find_section(sections, MS_LEVEL_INDEX_SECTION);
+   if (section != NULL && section->pos % 8 == 0 &&
+       section->len >= sizeof(uint64_t) + 2 * sizeof(uint32_t)) {
+      r->ms_levels = (char*)input_map + section->pos;
+      r->ms_levels_len = section->len;
+   }
+
+   section = find_section(sections, RT_INDEX_SECTION);
+   if (section != NULL && section->pos % 8 == 0 &&
+       section->len >= sizeof(uint64_t)) {
+      ptr = (char*)input_map + section->pos;
+      memcpy(&n, ptr, sizeof(uint64_t));
+      if (section->len == sizeof(uint64_t) + n * sizeof(rt_entry_t)) {
+         r->n_rt = n;
+         r->rt = (char*)(ptr + sizeof(uint64_t));
+      }
+   }
+
+   dealloc_sections(sections);
+
+   if (r->scans == NULL && r->ms_levels == NULL && r->rt == NULL) {
+      free(r);
+      return NULL;
+   }
+   return r;
+}
+
+void dealloc_secondary_indexes(msz_index_t* index) { free(index); }
+
+long* query_scan_index(msz_index_t* index, uint32_t* scans, long scans_length,
+                       long* indices_length)
+/**
+ * @brief Maps scan numbers to spectrum indices. Every spectrum carrying a
+ * requested scan number is returned, including scans repeated across
+ * divisions.
+ *
+ * @return Sorted, unique spectrum indices (to be freed by the caller), NULL if
+ * the msz file has no scan index.
+ */
+{
+   scan_entry_t* entries;
+   long* r;
+   long n = 0, max = scans_length > 0 ? scans_length : 1;
+
+   if (index == NULL || index->scans == NULL)
+      return NULL;
+   entries = (scan_entry_t*)index->scans;
+
+   r = malloc(max * sizeof(long));
+   if (r == NULL) {
+      error("query_scan_index: malloc failure.\n");
+      return NULL;
+   }
+
+   for (long i = 0; i < scans_length; i++) {
+      uint64_t lo = 0, hi = index->n_scans;
+      while (lo < hi) {
+         uint64_t mid = lo + (hi - lo) / 2;
+         if (entries[mid].scan < scans[i])
+            lo = mid + 1;
+         else
+            hi = mid;
+      }
+      for (; lo < index->n_scans && entries[lo].scan == scans[i]; lo++) {
+         if (n == max) {
+            long* tmp = realloc(r, max * 2 * sizeof(long));
+            if (tmp == NULL) {
+               error("query_scan_index: realloc failure.\n");
+               free(r);
+               return NULL;
+            }
+            r = tmp;
+            max *= 2;
+         }
+         r[n++] = entries[lo].index;
+      }
+   }
+
+   qsort(r, n, sizeof(long), cmp_long);
+   *indices_length = 0;
+   for (long i = 0; i < n; i++)
+      if (i == 0 || r[i] != r[i - 1])
+         r[(*indices_length)++] = r[i];
+
+   print("Found %ld spectra matching %ld scans.\n", *indices_length,
+         scans_length);
+   return r;
+}
+
+long* query_ms_level_index(msz_index_t* index, uint16_t ms_level,
+                           long* indices_length)
+/**
+ * @brief Maps an MS level to spectrum indices. A ms_level of (uint16_t)-1
+ * selects every spectrum above MS2.
+ *
+ * @return Sorted spectrum indices (to be freed by the caller), NULL if the msz
+ * file has no MS level index.
+ */
+{
+   uint64_t n_spectra;
+   uint32_t n_levels, n_chunks, *levels, *dir;
+   long* r;
+   long n = 0;
+
+   if (index == NULL || index->ms_levels == NULL)
+      return NULL;
+   if (index->ms_levels_len < sizeof(uint64_t) + 2 * sizeof(uint32_t)) {
+      error("query_ms_level_index: corrupted index.\n");
+      return NULL;
+   }
+
+   memcpy(&n_spectra, index->ms_levels, sizeof(uint64_t));
+   memcpy(&n_levels, index->ms_levels + sizeof(uint64_t), sizeof(uint32_t));
+   memcpy(&n_chunks, index->ms_levels + sizeof(uint64_t) + sizeof(uint32_t),
+          sizeof(uint32_t));
+   levels = (uint32_t*)(index->ms_levels + sizeof(uint64_t) +
+                        2 * sizeof(uint32_t));
+   dir = (uint32_t*)((char*)levels + ALIGN8(n_levels * sizeof(uint32_t)));
+   if ((char*)(dir + (uint64_t)n_levels * n_chunks * 2) >
+       index->ms_levels + index->ms_levels_len) {
+      error("query_ms_level_index: corrupted index.\n");
+      return NULL;
+   }
+
+   // Every container has to lie within the section and the cardinalities
+   // can not exceed the number of spectra.
+   for (uint64_t e = 0, total = 0; e < (uint64_t)n_levels * n_chunks; e++) {
+      uint64_t offset = dir[e * 2], count = dir[e * 2 + 1];
+      uint64_t size = count > MS_LEVEL_ARRAY_MAX ? MS_LEVEL_BITMAP_SIZE
+                                                 : count * sizeof(uint16_t);
+      total += count;
+      if (count > MS_LEVEL_CHUNK_SIZE || offset % 8 != 0 ||
+          offset + size > index->ms_levels_len || total > n_spectra) {
+         error("query_ms_level_index: corrupted index.\n");
+         return NULL;
+      }
+   }
+
+   r = malloc((n_spectra > 0 ? n_spectra : 1) * sizeof(long));
+   if (r == NULL) {
+      error("query_ms_level_index: malloc failure.\n");
+      return NULL;
+   }
+
+   for (uint32_t c = 0; c < n_chunks; c++) {
+      long base = (long)c << MS_LEVEL_CHUNK_BITS;
+      long chunk_start = n;
+      int n_matched = 0;
+
+      for (uint32_t l = 0; l < n_levels; l++) {
+         uint32_t* e = &dir[(l * n_chunks + c) * 2];
+
+         if (ms_level == (uint16_t)-1 ? levels[l] <= 2 : levels[l] != ms_level)
+            continue;
+         if (e[1] == 0)
+            continue;
+         n_matched++;
+
+         if (e[1] > MS_LEVEL_ARRAY_MAX) {
+            uint64_t* bitmap = (uint64_t*)(index->ms_levels + e[0]);
+            for (int w = 0; w < MS_LEVEL_BITMAP_SIZE / 8; w++) {
+               uint64_t word = bitmap[w];
+               for (int b = 0; word != 0; b++, word >>= 1)
+                  if (word & 1) {
+                     if ((uint64_t)n == n_spectra ||
+                         (uint64_t)(base + w * 64 + b) >= n_spectra) {
+                        error("query_ms_level_index: corrupted index.\n");
+                        free(r);
+                        return NULL;
+                     }
+                     r[n++] = base + w * 64 + b;
+                  }
+            }
+         } else {
+            uint16_t* array = (uint16_t*)(index->ms_levels + e[0]);
+            for (uint32_t j = 0; j < e[1]; j++) {
+               if ((uint64_t)(base + array[j]) >= n_spectra) {
+                  error("query_ms_level_index: corrupted index.\n");
+                  free(r);
+                  return NULL;
+               }
+               r[n++] = base + array[j];
+            }
+         }
+      }
+
+      // Several levels (above MS2) contributed to the chunk.
+      if (n_matched > 1)
+         qsort(r + chunk_start, n - chunk_start, sizeof(long), cmp_long);
+   }
+
+   *indices_length = n;
+   print("Found %ld spectra with ms level %ld.\n", n, ms_level);
+   return r;
+}
+
+long* query_rt_index(msz_index_t* index, float* rt_range,
+                     long* indices_length)
+/**
+ * @brief Maps a retention time window to spectrum indices.
+ *
+ * @param rt_range {start, end} in minutes, both inclusive.
+ *
+ * @return Sorted spectrum indices (to be freed by the caller), NULL if the msz
+ * file has no retention time index.
+ */
+{
+   rt_entry_t* entries;
+   uint64_t lo = 0, hi, first;
+   long* r;
+
+   if (index == NULL || index->rt == NULL)
+      return NULL;
+   entries = (rt_entry_t*)index->rt;
+
+   hi = index->n_rt;
+   while (lo < hi) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (entries[mid].rt < rt_range[0])
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   first = lo;
+   hi = index->n_rt;
+   while (lo < hi) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (entries[mid].rt <= rt_range[1])
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   r = malloc((lo - first + 1) * sizeof(long));
+   if (r == NULL) {
+      error("query_rt_index: malloc failure.\n");
+      return NULL;
+   }
+   for (uint64_t i = first; i < lo; i++) r[i - first] = entries[i].index;
+   qsort(r, lo - first, sizeof(long), cmp_long);
+
+   *indices_length = lo - first;
+   print("Found %ld spectra in retention time range.\n", *indices_length);
+   return r;
+}
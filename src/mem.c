@@ -68,6 +68,34 @@ data_block_t* realloc_data_block(data_block_t* db, size_t new_size) {
    return db;
 }
 
+/**
+ * @brief Grows a `data_block_t` by REALLOC_FACTOR until `len` bytes fit
+ * after its contents, so a producer can write straight to the end of the
+ * block. The size of the block is left unchanged.
+ * @param db A pointer to the `data_block_t` struct to reserve memory in.
+ * @param len The number of bytes to reserve.
+ * @return A pointer to the first reserved byte (db->mem + db->size) on
+ * success. NULL on error.
+ */
+char* reserve_data_block(data_block_t* db, size_t len) {
+   size_t new_size;
+
+   if (db == NULL) {
+      error("reserve_data_block: db is NULL.\n");
+      return NULL;
+   }
+
+   if (db->size + len >= db->max_size) {
+      new_size = db->max_size * REALLOC_FACTOR;
+      if (new_size <= db->size + len)
+         new_size = db->size + len + 1;
+      if (realloc_data_block(db, new_size) == NULL)
+         return NULL;
+   }
+
+   return db->mem + db->size;
+}
+
 /**
  * @brief Deallocates a `data_block_t` struct and its memory.
  * @param db A pointer to the `data_block_t` struct to be deallocated.
@@ -113,6 +141,9 @@ cmp_block_t* alloc_cmp_block(char* mem, size_t size, size_t original_size)
    r->size = size;
    r->max_size = size;
    r->original_size = original_size;
+   r->frame_size = 0;
+   r->frame_ends = NULL;
+   r->n_frames = 0;
    return r;
 }
 
@@ -125,6 +156,7 @@ int dealloc_cmp_block(cmp_block_t* blk) {
    if (blk) {
       if (blk->mem)
          free(blk->mem);
+      free(blk->frame_ends);
       free(blk);
    } else {
       error("dealloc_cmp_block: NULL pointer passed to dealloc_cmp_block.\n");
@@ -0,0 +1,334 @@
+/**
+ * @file metadata.c
+ * @author Chris Grams (chrisagrams@gmail.com)
+ * @brief Per-spectrum metadata columns (precursor m/z, charge, TIC, base peak,
+ * isolation window). Columns are captured by scan_mzml(), stored as zstd
+ * compressed sections in the msz file, and decompressed lazily on read so
+ * metadata queries never touch the XML blocks.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mscompress.h"
+
+/* Column element types. */
+#define COL_DOUBLE 0
+#define COL_FLOAT 1
+#define COL_UINT16 2
+
+static const struct {
+   const char* name;
+   const char* accession;  // cvParam holding the value.
+   int flag;               // scan_mzml() flag capturing the column.
+   int type;
+} metadata_columns[N_METADATA_COLUMNS] = {
+    {"precursor_mz", "\"MS:1000744\"", PRECURSOR_MZ, COL_DOUBLE},
+    {"charge", "\"MS:1000041\"", CHARGE, COL_UINT16},
+    {"tic", "\"MS:1000285\"", TIC, COL_FLOAT},
+    {"base_peak_mz", "\"MS:1000504\"", BASE_PEAK, COL_DOUBLE},
+    {"base_peak_intensity", "\"MS:1000505\"", BASE_PEAK, COL_FLOAT},
+    {"isolation_target", "\"MS:1000827\"", ISOLATION, COL_DOUBLE},
+    {"isolation_lower", "\"MS:1000828\"", ISOLATION, COL_FLOAT},
+    {"isolation_upper", "\"MS:1000829\"", ISOLATION, COL_FLOAT},
+};
+
+static size_t column_elem_size(int column) {
+   switch (metadata_columns[column].type) {
+      case COL_DOUBLE:
+         return sizeof(double);
+      case COL_FLOAT:
+         return sizeof(float);
+      default:
+         return sizeof(uint16_t);
+   }
+}
+
+static void set_column_value(metadata_t* meta, int column, long index,
+                             double value) {
+   switch (metadata_columns[column].type) {
+      case COL_DOUBLE:
+         ((double*)meta->columns[column])[index] = value;
+         break;
+      case COL_FLOAT:
+         ((float*)meta->columns[column])[index] = (float)value;
+         break;
+      default:
+         ((uint16_t*)meta->columns[column])[index] = (uint16_t)value;
+         break;
+   }
+}
+
+const char* get_metadata_column_name(int column) {
+   if (column < 0 || column >= N_METADATA_COLUMNS)
+      return NULL;
+   return metadata_columns[column].name;
+}
+
+metadata_t* alloc_metadata(int flags, long n_spectra)
+/**
+ * @brief Allocates metadata columns selected by flags for n_spectra spectra.
+ * Values are initialized as missing (NaN, 0 for charge).
+ *
+ * @param flags Bitwise OR of PRECURSOR_MZ, CHARGE, TIC, BASE_PEAK, ISOLATION.
+ *
+ * @param n_spectra Number of spectra.
+ *
+ * @return A metadata_t on success, NULL on error.
+ */
+{
+   metadata_t* r;
+   int i;
+
+   r = calloc(1, sizeof(metadata_t));
+   if (r == NULL) {
+      error("alloc_metadata: malloc failure.\n");
+      return NULL;
+   }
+
+   r->flags = flags & METADATA_FLAGS;
+   r->n_spectra = n_spectra;
+
+   for (i = 0; i < N_METADATA_COLUMNS; i++) {
+      if (!(r->flags & metadata_columns[i].flag))
+         continue;
+      r->columns[i] = calloc(n_spectra > 0 ? n_spectra : 1, column_elem_size(i));
+      if (r->columns[i] == NULL) {
+         error("alloc_metadata: malloc failure.\n");
+         dealloc_metadata(r);
+         return NULL;
+      }
+      if (metadata_columns[i].type != COL_UINT16)
+         for (long j = 0; j < n_spectra; j++) set_column_value(r, i, j, NAN);
+   }
+
+   return r;
+}
+
+void dealloc_metadata(metadata_t* meta) {
+   if (meta == NULL)
+      return;
+   for (int i = 0; i < N_METADATA_COLUMNS; i++)
+      if (meta->columns[i])
+         free(meta->columns[i]);
+   dealloc_sections(meta->sections);
+   free(meta);
+}
+
+void scan_spectrum_metadata(metadata_t* meta, long index, char* start,
+                            char* end)
+/**
+ * @brief Captures the metadata columns of one spectrum. Only [start, end) is
+ * searched so a missing cvParam never matches the next spectrum's.
+ *
+ * @param meta Metadata allocated by alloc_metadata().
+ *
+ * @param index Spectrum index.
+ *
+ * @param start Start of the <spectrum> element.
+ *
+ * @param end Start of the spectrum's first <binary> element.
+ */
+{
+   char* ptr;
+
+   if (index >= meta->n_spectra)
+      return;
+
+   for (int i = 0; i < N_METADATA_COLUMNS; i++) {
+      if (meta->columns[i] == NULL)
+         continue;
+      ptr = find_in_range(start, end, metadata_columns[i].accession);
+      if (ptr == NULL)
+         continue;
+      ptr = find_in_range(ptr, end, "value=\"");
+      if (ptr == NULL)
+         continue;
+      set_column_value(meta, i, index, strtod(ptr + strlen("value=\""), NULL));
+   }
+}
+
+void write_metadata(metadata_t* meta, sections_t* sections,
+                    int compression_level, int fd)
+/**
+ * @brief Writes each captured column as its own section
+ * (METADATA_SECTION(column)): the number of spectra as a uint64_t followed by
+ * the zstd compressed column.
+ *
+ * @param meta Metadata captured by scan_mzml().
+ *
+ * @param sections Section table to register the sections in.
+ *
+ * @param compression_level zstd compression level.
+ *
+ * @param fd File descriptor to write to.
+ */
+{
+   ZSTD_CCtx* cctx;
+   uint64_t n_spectra;
+   uint64_t section_pos;
+   size_t cmp_len;
+   void* cmp;
+
+   if (meta == NULL || meta->n_spectra <= 0)
+      return;
+
+   cctx = alloc_cctx();
+   if (cctx == NULL)
+      return;
+
+   n_spectra = meta->n_spectra;
+
+   for (int i = 0; i < N_METADATA_COLUMNS; i++) {
+      if (meta->columns[i] == NULL)
+         continue;
+
+      cmp = zstd_compress(cctx, meta->columns[i],
+                          n_spectra * column_elem_size(i), &cmp_len,
+                          compression_level);
+      if (cmp == NULL) {
+         warning("write_metadata: failed to compress column %s.\n",
+                 metadata_columns[i].name);
+         continue;
+      }
+
+      section_pos = get_offset(fd);
+      write_to_file(fd, (char*)&n_spectra, sizeof(uint64_t));
+      write_to_file(fd, cmp, cmp_len);
+      free(cmp);
+
+      add_section(sections, METADATA_SECTION(i), section_pos,
+                  sizeof(uint64_t) + cmp_len);
+   }
+
+   ZSTD_freeCCtx(cctx);
+}
+
+metadata_t* read_metadata(void* input_map, long input_filesize)
+/**
+ * @brief Reads the metadata section table of an msz file. No column is
+ * decompressed until requested through get_metadata_column().
+ *
+ * @param input_map mmap'ed msz file.
+ *
+ * @param input_filesize Size of the msz file.
+ *
+ * @return A metadata_t on success, NULL if the file has no metadata columns.
+ */
+{
+   sections_t* sections;
+   section_t* section;
+   metadata_t* r;
+
+   sections = read_sections(input_map, input_filesize);
+   if (sections == NULL)
+      return NULL;
+
+   r = calloc(1, sizeof(metadata_t));
+   if (r == NULL) {
+      error("read_metadata: malloc failure.\n");
+      dealloc_sections(sections);
+      return NULL;
+   }
+   r->input_map = input_map;
+   r->sections = sections;
+
+   for (int i = 0; i < N_METADATA_COLUMNS; i++) {
+      section = find_section(sections, METADATA_SECTION(i));
+      if (section == NULL)
+         continue;
+      r->flags |= metadata_columns[i].flag;
+      r->n_spectra = *(uint64_t*)((char*)input_map + section->pos);
+   }
+
+   if (r->flags == 0) {
+      dealloc_metadata(r);
+      return NULL;
+   }
+
+   return r;
+}
+
+void* get_metadata_column(metadata_t* meta, int column)
+/**
+ * @brief Returns a metadata column, decompressing it on first access.
+ *
+ * @param meta Metadata from scan_mzml() or read_metadata().
+ *
+ * @param column Column (METADATA_PRECURSOR_MZ, ...). See mscompress.h for the
+ * element type of each column.
+ *
+ * @return An array of meta->n_spectra values on success, NULL if the column
+ * was not captured or on error.
+ */
+{
+   section_t* section;
+   ZSTD_DCtx* dctx;
+
+   if (meta == NULL || column < 0 || column >= N_METADATA_COLUMNS)
+      return NULL;
+
+   if (meta->columns[column] != NULL)
+      return meta->columns[column];
+
+   section = find_section(meta->sections, METADATA_SECTION(column));
+   if (section == NULL)
+      return NULL;
+
+   dctx = alloc_dctx();
+   if (dctx == NULL)
+      return NULL;
+
+   meta->columns[column] = zstd_decompress(
+       dctx, meta->input_map + section->pos + sizeof(uint64_t),
+       section->len - sizeof(uint64_t),
+       meta->n_spectra * column_elem_size(column));
+
+   ZSTD_freeDCtx(dctx);
+
+   return meta->columns[column];
+}
+
+void print_metadata_csv(metadata_t* meta) {
+   int i;
+   long j;
+
+   printf("index");
+   for (i = 0; i < N_METADATA_COLUMNS; i++)
+      if (meta->flags & metadata_columns[i].flag) {
+         get_metadata_column(meta, i);
+         printf(",%s", metadata_columns[i].name);
+      }
+   printf("\n");
+
+   for (j = 0; j < meta->n_spectra; j++) {
+      printf("%ld", j);
+      for (i = 0; i < N_METADATA_COLUMNS; i++) {
+         if (!(meta->flags & metadata_columns[i].flag))
+            continue;
+         if (meta->columns[i] == NULL) {
+            printf(",");
+            continue;
+         }
+         switch (metadata_columns[i].type) {
+            case COL_DOUBLE:
+               printf(",%.10g", ((double*)meta->columns[i])[j]);
+               break;
+            case COL_FLOAT:
+               printf(",%g", ((float*)meta->columns[i])[j]);
+               break;
+            default:
+               printf(",%u", ((uint16_t*)meta->columns[i])[j]);
+               break;
+         }
+      }
+      printf("\n");
+   }
+}
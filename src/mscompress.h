@@ -10,10 +10,12 @@
 #define VERSION "1.0.2"
 #define STATUS "Dev"
 #define MIN_SUPPORT "0.1"
-#define MAX_SUPPORT "0.1"
+#define MAX_SUPPORT "2.0"  // Keep in step with FORMAT_VERSION_MAJOR.MINOR.
 #define ADDRESS "chrisagrams@gmail.com"
 
-#define FORMAT_VERSION_MAJOR 1
+// The major version changes when older readers would misread a file. 2.0
+// stores chromatogram arrays outside of the XML (CHROMATOGRAM_SECTION).
+#define FORMAT_VERSION_MAJOR 2
 #define FORMAT_VERSION_MINOR 0
 
 #define BUFSIZE 4096
@@ -25,7 +27,7 @@
 #define REALLOC_FACTOR 1.1  // realloc factor for zlib buffer
 
 #define MAGIC_TAG 0x035F51B5
-#define MESSAGE "MS Compress Format 1.0 Gao Laboratory at UIC"
+#define MESSAGE "MS Compress Format 2.0 Gao Laboratory at UIC"
 
 #define MESSAGE_SIZE 128
 #define MESSAGE_OFFSET 12
@@ -52,6 +54,7 @@
 
 #define _intensity_ 1000515
 #define _mass_ 1000514
+#define _time_ 1000595
 #define _xml_ 1000513  // TODO: change this
 
 #define _lossless_ 4700000
@@ -76,10 +79,40 @@
 #define EXTRACT_MSZ 4
 #define EXTERNAL 5
 #define DESCRIBE 6
+#define XIC 7
+#define TIC_BPC 8
 
 #define MSLEVEL 0x01
 #define SCANNUM 0x02
 #define RETTIME 0x04
+#define PRECURSOR_MZ 0x08
+#define CHARGE 0x10
+#define TIC 0x20
+#define BASE_PEAK 0x40
+#define ISOLATION 0x80
+#define METADATA_FLAGS (PRECURSOR_MZ | CHARGE | TIC | BASE_PEAK | ISOLATION)
+
+/* Metadata columns (see metadata.c for their types) */
+#define METADATA_PRECURSOR_MZ 0         // double
+#define METADATA_CHARGE 1               // uint16_t
+#define METADATA_TIC 2                  // float
+#define METADATA_BASE_PEAK_MZ 3         // double
+#define METADATA_BASE_PEAK_INTENSITY 4  // float
+#define METADATA_ISOLATION_TARGET 5     // double
+#define METADATA_ISOLATION_LOWER 6      // float
+#define METADATA_ISOLATION_UPPER 7      // float
+#define N_METADATA_COLUMNS 8
+
+#define SECTION_MAGIC_TAG 0x035F51B6
+
+#define CHROMATOGRAM_SECTION 1
+#define RET_TIME_SECTION 2
+#define FRAME_SECTION 3
+#define SPECTRUM_SECTION 4
+#define SCAN_INDEX_SECTION 5
+#define MS_LEVEL_INDEX_SECTION 6
+#define RT_INDEX_SECTION 7
+#define METADATA_SECTION(column) (0x100 + (column))
 
 #ifdef __cplusplus
 extern "C" {
@@ -110,6 +143,38 @@ typedef struct {
    int target_inten_format;
 
    int zstd_compression_level;
+
+   char* chrom_time_lossy;
+   char* chrom_int_lossy;
+   float chrom_time_scale_factor;
+   float chrom_int_scale_factor;
+
+   int metadata_flags;
+   int describe_metadata;
+
+   int max_pending;  // Max divisions held in memory during decompression.
+
+   int zlib_engine;  // DEFLATE_ONESHOT or DEFLATE_STREAM
+   int zlib_level;   // Level used to re-encode zlib arrays.
+
+   uint32_t target_binary_encoding;  // _zlib_, _no_comp_ or 0 (original)
+
+   float* rt_range;  // {start, end} in minutes, NULL if not selected.
+
+   long frame_size;  // Size of independently decodable frames within a
+                     // block, 0 for a single frame per block.
+
+   long cache_size;  // Bytes of decompressed blocks kept during extraction, 0
+                     // for no limit.
+
+   double* xic_mz;  // Target m/z of extracted-ion chromatograms, NULL if not
+                    // selected.
+   long xic_length;
+   double xic_ppm;  // Half width of XIC windows in ppm.
+
+   int tic_only;  // Print the TIC and base peak chromatogram.
+
+   int cpu;  // Instruction set of the vector kernels, SIMD_AUTO to detect.
 } Arguments;
 
 typedef struct {
@@ -131,12 +196,23 @@ typedef struct {
    uint16_t* ms_levels;
    float* ret_times;
 
+   struct metadata_t* metadata;  // NULL unless scan_mzml() was asked for
+                                 // metadata columns.
+
 } division_t;
 
 typedef struct {
    division_t** divisions;
    int n_divisions;
 
+   struct chromatograms_t* chromatograms;  // NULL if chromatograms are stored
+                                           // as XML.
+   struct metadata_t* metadata;  // Per-spectrum metadata columns, NULL if not
+                                 // captured.
+
+   /* Built by index_divisions(), NULL otherwise (see find_division()). */
+   uint64_t* spectrum_offsets;  // Spectra before each division (n + 1).
+   long spectra_per_division;   // Count of the leading divisions if equal.
 } divisions_t;
 
 typedef struct {
@@ -151,6 +227,12 @@ typedef struct cmp_block_t {
    size_t original_size;
    size_t max_size;
 
+   /* Set if mem holds several frames of frame_size original bytes (the last
+    * one shorter). frame_ends[i] is the end of frame i within mem. */
+   size_t frame_size;
+   uint64_t* frame_ends;
+   uint32_t n_frames;
+
    struct cmp_block_t* next;
 } cmp_block_t;
 
@@ -169,11 +251,33 @@ typedef struct block_len_t {
    char* cache;  // During msz extraction, store decompressed block here as a
                  // "cache".
 
+   /* Frame index, read from FRAME_SECTION. n_frames is 0 if the block is a
+    * single frame. If frames_decoded is set, cache is only partially filled:
+    * see decmp_block_range(). */
+   size_t frame_size;
+   uint64_t* frame_ends;
+   uint32_t n_frames;
+   uint8_t* frames_decoded;
+
+   /* Spectrum index of binary blocks, read from SPECTRUM_SECTION.
+    * spectrum_ends[i] is the end of spectrum i within the decompressed block,
+    * NULL if the block is not indexed. */
+   uint64_t* spectrum_ends;
+   uint32_t n_spectra;
+
    char* encoded_cache;
    uint32_t encoded_cache_fmt;
    uint64_t encoded_cache_len;
    size_t* encoded_cache_lens;
 
+   /* Set while the block is held by a block_cache_t (see cache.c). */
+   struct block_cache_t* block_cache;
+   struct block_len_t* lru_prev;
+   struct block_len_t* lru_next;
+   int pins;            // Users of cache/encoded_cache, never evicted if > 0.
+   int busy;            // Set while a thread fills cache/encoded_cache.
+   size_t cached_size;  // Bytes charged to block_cache.
+
 } block_len_t;
 
 typedef struct {
@@ -181,8 +285,34 @@ typedef struct {
    block_len_t* tail;
 
    int populated;
+
+   /* Set by read_block_len_queue(): the blocks are stored contiguously (and
+    * still linked) and offsets[i] is the sum of the compressed sizes of
+    * blocks[0..i), so lookups by index are O(1). */
+   block_len_t* blocks;
+   uint64_t* offsets;
+   int n_blocks;
+
+   struct block_cache_t* cache;  // Bounds the decompressed blocks kept during
+                                 // extraction, NULL for no limit.
 } block_len_queue_t;
 
+/* A byte-bounded LRU cache of decompressed blocks, shared by any number of
+ * block_len_queue_t (and msz files). */
+typedef struct block_cache_t {
+   size_t limit;  // Bytes of decompressed data to keep.
+   size_t used;
+
+   block_len_t* head;  // Most recently used.
+   block_len_t* tail;  // Least recently used.
+
+   uint64_t hits;
+   uint64_t misses;
+   uint64_t evictions;
+
+   struct block_cache_sync_t* sync;  // Lock shared by the cache's blocks.
+} block_cache_t;
+
 typedef struct {
    uint64_t xml_pos;  // msz file position of start of compressed XML data.
    uint64_t mz_binary_pos;     // msz file position of start of compressed m/z
@@ -201,6 +331,35 @@ typedef struct {
    int inten_fmt;
 } footer_t;
 
+/**
+ * @brief Entry of the optional section table stored between the divisions and
+ * the footer.
+ * @param type Section type (e.g. CHROMATOGRAM_SECTION).
+ * @param pos msz file position of the start of the section.
+ * @param len Length of the section in bytes.
+ */
+typedef struct {
+   uint32_t type;
+   uint32_t reserved;
+   uint64_t pos;
+   uint64_t len;
+} section_t;
+
+typedef struct {
+   section_t* entries;
+   uint32_t n_sections;
+} sections_t;
+
+/**
+ * @brief Written immediately before footer_t when an msz file has sections.
+ * Files without sections end with the footer only.
+ */
+typedef struct {
+   uint64_t sections_pos;
+   uint32_t n_sections;
+   int magic_tag;
+} section_trailer_t;
+
 typedef struct {
    Bytef* mem;
    Bytef* buff;
@@ -213,8 +372,7 @@ typedef struct {
 typedef void (*Algo)(void*);
 typedef Algo (*Algo_ptr)();
 
-typedef void (*decode_fun)(z_stream*, char*, size_t, char**, size_t*,
-                           data_block_t*);
+typedef int (*decode_fun)(z_stream*, char*, size_t, data_block_t*, size_t*);
 typedef decode_fun (*decode_fun_ptr)();
 
 typedef void (*encode_fun)(z_stream*, char**, size_t, char*, size_t*);
@@ -274,6 +432,8 @@ typedef struct {
    decode_fun decode_source_compression_inten_fun;
    encode_fun encode_source_compression_mz_fun;
    encode_fun encode_source_compression_inten_fun;
+   encode_fun no_encode_mz_fun;  // Output raw arrays (_no_encode_).
+   encode_fun no_encode_inten_fun;
    Algo target_xml_fun;
    Algo target_mz_fun;
    Algo target_inten_fun;
@@ -287,8 +447,93 @@ typedef struct {
    int zstd_compression_level;  // no need to write to file since ZSTD_DCtx
                                 // doesn't need it.
 
+   size_t frame_size;  // Compression frame size, 0 to disable.
+
+   uint32_t output_compression;  // Compression of binary arrays written on
+                                 // decompression (default:
+                                 // source_compression).
+   int zlib_engine;  // Deflate backend and level used to re-encode zlib
+   int zlib_level;   // arrays (see set_deflate_backend()).
+
 } data_format_t;
 
+/**
+ * @brief Chromatogram time and intensity arrays compressed through the binary
+ * path. The chromatograms are described as a single division where `spectra`
+ * holds the <chromatogram> elements, `mz` the time arrays and `inten` the
+ * intensity arrays. `df` and `footer` describe the chromatogram streams the
+ * same way the msz header and footer describe the spectra streams.
+ */
+typedef struct chromatograms_t {
+   data_format_t* df;
+   division_t* division;
+   footer_t* footer;
+   block_len_queue_t* time_block_lens;
+   block_len_queue_t* inten_block_lens;
+} chromatograms_t;
+
+/**
+ * @brief Per-spectrum numeric metadata stored column-wise. Each column is an
+ * array of n_spectra values indexed by spectrum index. Missing values are NaN
+ * (0 for charge). When read from an msz file, columns are decompressed on
+ * first access by get_metadata_column().
+ */
+typedef struct metadata_t {
+   int flags;  // Captured columns (PRECURSOR_MZ, CHARGE, ...)
+   long n_spectra;
+   void* columns[N_METADATA_COLUMNS];
+
+   /* msz reader only */
+   char* input_map;
+   sections_t* sections;
+} metadata_t;
+
+/**
+ * @brief Secondary indexes of an msz file (see index.c), pointing into the
+ * mmap'ed file. A NULL member means the file lacks that index.
+ */
+typedef struct msz_index_t {
+   uint64_t n_scans;
+   uint32_t* scans;  // {scan, index} pairs sorted by scan.
+
+   char* ms_levels;  // MS_LEVEL_INDEX_SECTION.
+   uint64_t ms_levels_len;
+
+   uint64_t n_rt;
+   char* rt;  // {float rt, uint32_t index} pairs sorted by retention time.
+} msz_index_t;
+
+/**
+ * @brief Extracted-ion chromatograms of n_targets m/z over n_scans MS1
+ * spectra. intensities holds one row of n_scans values per target.
+ */
+typedef struct xic_t {
+   long n_targets;
+   long n_scans;
+   double* mz;         // Target m/z of each row.
+   long* indices;      // Spectrum index of each column.
+   float* ret_times;   // Retention time of each column, NAN if unknown.
+   double* intensities;
+} xic_t;
+
+#define TIC_COMPUTED 1  // TIC summed from the intensity array.
+#define BPC_COMPUTED 2  // Base peak taken from the intensity array.
+
+/**
+ * @brief Total ion current and base peak chromatograms over n_spectra
+ * spectra. Values recorded by the instrument (cvParams or msz metadata) are
+ * preferred, and may differ from the intensity array (e.g. centroided
+ * arrays of a profile scan), so the source of each value is kept.
+ */
+typedef struct tic_t {
+   long n_spectra;
+   long* indices;      // Spectrum index of each point.
+   float* ret_times;   // Retention time of each point, NAN if unknown.
+   double* tic;        // Total ion current of each spectrum.
+   double* bpc;        // Base peak intensity of each spectrum.
+   uint8_t* computed;  // TIC_COMPUTED | BPC_COMPUTED, 0 if both recorded.
+} tic_t;
+
 /* arguments.c */
 void init_args(Arguments* args);
 int set_threads(Arguments* args, int threads);
@@ -296,7 +541,20 @@ int set_mz_lossy(Arguments* args, const char* mz_lossy);
 int set_int_lossy(Arguments* args, const char* int_lossy);
 int set_mz_scale_factor(Arguments* args, const char* scale_factor_str);
 int set_int_scale_factor(Arguments* args, const char* scale_factor_str);
+int set_chrom_time_lossy(Arguments* args, const char* time_lossy);
+int set_chrom_int_lossy(Arguments* args, const char* int_lossy);
 int set_compress_runtime_variables(Arguments* args, data_format_t* df);
+int set_chrom_compress_runtime_variables(Arguments* args, data_format_t* df);
+int set_metadata_flags(Arguments* args, const char* columns);
+int set_zlib_engine(Arguments* args, const char* engine);
+int set_zlib_level(Arguments* args, const char* level);
+int set_cpu(Arguments* args, const char* cpu);
+int set_target_binary_encoding(Arguments* args, const char* encoding);
+int set_rt_range(Arguments* args, const char* range);
+int set_xic(Arguments* args, const char* targets);
+int set_xic_ppm(Arguments* args, const char* ppm);
+int set_frame_size(Arguments* args, const char* size);
+int set_cache_size(Arguments* args, const char* size);
 int set_decompress_runtime_variables(data_format_t* df, footer_t* msz_footer);
 
 /* file.c */
@@ -305,6 +563,8 @@ extern int fds[3];
 
 void* get_mapping(int fd);
 int remove_mapping(void* addr, size_t length);
+void* get_output_mapping(int fd, size_t size);
+int truncate_output(int fd);
 int flush(int fd);
 int remove_file(char* path);
 size_t get_filesize(char* path);
@@ -317,6 +577,15 @@ data_format_t* get_header_df(void* input_map);
 void write_footer(footer_t* footer, int fd);
 footer_t* read_footer(void* input_map, long filesize);
 void print_footer_csv(footer_t* footer);
+char* serialize_df(data_format_t* df);
+data_format_t* deserialize_df(char* buff);
+sections_t* alloc_sections();
+void dealloc_sections(sections_t* sections);
+int add_section(sections_t* sections, uint32_t type, uint64_t pos,
+                uint64_t len);
+section_t* find_section(sections_t* sections, uint32_t type);
+void write_sections(sections_t* sections, int fd);
+sections_t* read_sections(void* input_map, long filesize);
 int prepare_fds(char* input_path, char** output_path, char* debug_output,
                 char** input_map, long* input_filesize, int* fds);
 int determine_filetype(void* input_map, size_t input_length);
@@ -325,16 +594,42 @@ int open_input_file(char* input_path);
 int open_output_file(char* path);
 int is_mzml(void* input_map, size_t input_length);
 int is_msz(void* input_map, size_t input_length);
+int check_format_version(void* input_map);
 int close_file(int fd);
 
 /* mem.c */
 
 data_block_t* alloc_data_block(size_t max_size);
 data_block_t* realloc_data_block(data_block_t* db, size_t new_size);
+char* reserve_data_block(data_block_t* db, size_t len);
 int dealloc_data_block(data_block_t* db);
 cmp_block_t* alloc_cmp_block(char* mem, size_t size, size_t original_size);
 int dealloc_cmp_block(cmp_block_t* blk);
 
+/* index.c */
+void write_secondary_indexes(divisions_t* divisions, sections_t* sections,
+                             int fd);
+msz_index_t* read_secondary_indexes(void* input_map, long input_filesize);
+void dealloc_secondary_indexes(msz_index_t* index);
+long* query_scan_index(msz_index_t* index, uint32_t* scans, long scans_length,
+                       long* indices_length);
+long* query_ms_level_index(msz_index_t* index, uint16_t ms_level,
+                           long* indices_length);
+long* query_rt_index(msz_index_t* index, float* rt_range,
+                     long* indices_length);
+
+/* metadata.c */
+metadata_t* alloc_metadata(int flags, long n_spectra);
+void dealloc_metadata(metadata_t* meta);
+void scan_spectrum_metadata(metadata_t* meta, long index, char* start,
+                            char* end);
+void write_metadata(metadata_t* meta, sections_t* sections,
+                    int compression_level, int fd);
+metadata_t* read_metadata(void* input_map, long input_filesize);
+void* get_metadata_column(metadata_t* meta, int column);
+const char* get_metadata_column_name(int column);
+void print_metadata_csv(metadata_t* meta);
+
 /* preprocess.c */
 
 long* map_ms_level_to_index(uint16_t ms_level, division_t* div,
@@ -362,8 +657,11 @@ void dump_ddp(data_positions_t** ddp, int divisions, int fd);
 data_positions_t** read_ddp(void* input_map, long position);
 void dealloc_df(data_format_t* df);
 void dealloc_dp(data_positions_t* dp);
+void write_division(division_t* div, int fd);
+division_t* read_division(void* input_map, long* position);
 void write_divisions(divisions_t* divisions, int fd);
 divisions_t* read_divisions(void* input_map, long position, int n_divisions);
+void dealloc_read_divisions(divisions_t* divisions);
 division_t* flatten_divisions(divisions_t* divisions);
 divisions_t* create_divisions(division_t* div, long n_divisions);
 long determine_n_divisions(long filesize, long blocksize);
@@ -377,7 +675,23 @@ long* map_scan_to_index(uint32_t* scans, long scans_length, division_t* div,
 long* map_scans_to_index_from_divisions(uint32_t* scans, long scans_length,
                                         divisions_t* divisions,
                                         long* indicies_length);
+long* map_rt_range_to_index(float* rt_range, division_t* div,
+                             long index_offset, long* indices_length);
+long* map_rt_range_to_index_from_divisions(float* rt_range,
+                                           divisions_t* divisions,
+                                           long* indicies_length);
+void write_ret_times(divisions_t* divisions, sections_t* sections, int fd);
+void index_divisions(divisions_t* divisions);
+int find_division(divisions_t* divisions, long index, long* local_index);
+int read_ret_times(void* input_map, long input_filesize,
+                   divisions_t* divisions, float* rt_range);
+char* find_in_range(char* start, char* end, const char* needle);
 division_t* scan_mzml(char* input_map, data_format_t* df, long end, int flags);
+chromatograms_t* scan_chromatograms(char* input_map, divisions_t* divisions);
+void write_chromatograms(chromatograms_t* chrom, sections_t* sections, int fd);
+int read_chromatograms(void* input_map, long input_filesize,
+                       chromatograms_t** chrom);
+void dealloc_read_chromatograms(chromatograms_t* chrom);
 int preprocess_mzml(char* input_map, long input_filesize, long* blocksize,
                     Arguments* arguments, data_format_t** df,
                     divisions_t** divisions);
@@ -422,16 +736,31 @@ decode_fun set_decode_fun(int compression_method, int algo, int accession);
 /* encode.c */
 
 encode_fun set_encode_fun(int compression_method, int algo, int accession);
+void no_encode_w_header(z_stream* z, char** src, size_t src_len, char* dest,
+                        size_t* out_len);
+void no_encode_no_header(z_stream* z, char** src, size_t src_len, char* dest,
+                         size_t* out_len);
 void encode_base64(zlib_block_t* zblk, char* dest, size_t src_len,
                    size_t* out_len);
 
+// Max growth of an XML segment by rewrite_binary_xml() + set_encoded_length().
+#define BINARY_XML_SLACK 64
+
+size_t rewrite_binary_xml(char* dest, char* src, size_t len, uint32_t from,
+                          uint32_t to, long encoded_len, long* length_pos);
+long set_encoded_length(char* buff, long length_pos, size_t end,
+                        size_t encoded_len);
+int encoded_length_changes(data_format_t* df);
+
 // char* encode_binary(char** src, int compression_method, size_t* out_len);
 
 /* extract.c */
 void extract_mzml(char* input_map, divisions_t* divisions, int output_fd);
-void extract_msz(char* input_map, size_t input_filesize, long* indicies,
-                 long indicies_length, uint32_t* scans, long scans_length,
-                 uint16_t ms_level, int output_fd);
+int extract_msz(char* input_map, size_t input_filesize, long* indicies,
+                long indicies_length, uint32_t* scans, long scans_length,
+                uint16_t ms_level, float* rt_range,
+                uint32_t target_binary_encoding, int zlib_engine,
+                int zlib_level, long cache_size, int threads, int output_fd);
 
 char* extract_spectrum_mz(char* input_map, ZSTD_DCtx* dctx, data_format_t* df,
                           block_len_queue_t* mz_binary_block_lens,
@@ -444,6 +773,10 @@ char* extract_spectrum_inten(char* input_map, ZSTD_DCtx* dctx,
                              long inten_binary_blk_pos, divisions_t* divisions,
                              long index, size_t* out_len, int encode);
 
+char* extract_chromatogram_binary(char* input_map, ZSTD_DCtx* dctx,
+                                  chromatograms_t* chrom, int type, long index,
+                                  size_t* out_len, int encode);
+
 char* extract_spectra(char* input_map, ZSTD_DCtx* dctx, data_format_t* df,
                       block_len_queue_t* xml_block_lens,
                       block_len_queue_t* mz_binary_block_lens,
@@ -463,6 +796,9 @@ typedef struct {
    cmp_blk_queue_t* ret;
    compression_fun comp_fun;
 
+   uint64_t* spectrum_ends;  // End of each spectrum within the decompressed
+                             // stream, binary modes only.
+
 } compress_args_t;
 
 ZSTD_CCtx* alloc_cctx();
@@ -488,6 +824,7 @@ compression_fun set_compress_fun(int accession);
  * @param footer_xml_off The offset within the input buffer where the XML block starts.
  * @param footer_mz_bin_off The offset within the input buffer where the m/z binary block starts.
  * @param footer_inten_bin_off The offset within the input buffer where the intensity binary block starts.
+ * @param dest Optional pre-sized destination (e.g. a region of a writable output mapping).
  * @param ret A pointer to a char* where the decompressed data will be stored.
  * @param ret_len A pointer to a size_t where the length of the decompressed data will be stored.
  */
@@ -503,6 +840,10 @@ typedef struct {
    uint64_t footer_mz_bin_off;
    uint64_t footer_inten_bin_off;
 
+   char* dest;  // If set, output is written here in place of a malloc'd
+                // buffer. Holds division->size bytes; longer output is moved
+                // to a malloc'd buffer (ret != dest).
+
    char* ret;
    size_t ret_len;
 
@@ -513,9 +854,21 @@ void* zstd_decompress(ZSTD_DCtx* dctx, void* src_buff, size_t src_len,
                       size_t org_len);
 void* decmp_block(decompression_fun decompress_fun, ZSTD_DCtx* dctx,
                   void* input_map, long offset, block_len_t* blk);
+char* decmp_block_range(decompression_fun decompress_fun, ZSTD_DCtx* dctx,
+                        void* input_map, long offset, block_len_t* blk,
+                        size_t start, size_t len);
+decompress_args_t* alloc_decompress_args(char* input_map, data_format_t* df,
+                                         block_len_t* xml_blk,
+                                         block_len_t* mz_binary_blk,
+                                         block_len_t* inten_binary_blk,
+                                         division_t* division,
+                                         uint64_t footer_xml_off,
+                                         uint64_t footer_mz_bin_off,
+                                         uint64_t footer_inten_bin_off);
+void dealloc_decompress_args(decompress_args_t* args);
 void* decompress_routine(void* args);
-void decompress_msz(char* input_map, size_t input_filesize, Arguments* args,
-                    int fd);
+int decompress_msz(char* input_map, size_t input_filesize, Arguments* args,
+                   int fd);
 decompression_fun set_decompress_fun(int accession);
 
 /* algo.c */
@@ -529,6 +882,7 @@ decompression_fun set_decompress_fun(int accession);
  * @param enc_fun A function pointer to the encoding function to be used.
  * @param dec_fun A function pointer to the decoding function to be used.
  * @param tmp A pointer to a `data_block_t` struct used for temporary storage during encoding/decoding.
+ * @param out The staging block compression transforms append their result to.
  * @param z A pointer to a `z_stream` struct used for zlib compression/decompression.
  * @param scale_factor A float representing the scale factor to be applied to the data during encoding/decoding.
  * @param ret_code An integer representing the return code of the algorithm.
@@ -542,6 +896,7 @@ typedef struct {
    encode_fun enc_fun;
    decode_fun dec_fun;
    data_block_t* tmp;
+   data_block_t* out;
    z_stream* z;
    float scale_factor;
    int ret_code;
@@ -551,6 +906,35 @@ Algo set_compress_algo(int algo, int accession);
 Algo set_decompress_algo(int algo, int accession);
 int get_algo_type(char* arg);
 
+/* simd.c */
+
+#define SIMD_AUTO -1  // Best level supported by the CPU.
+#define SIMD_SCALAR 0
+#define SIMD_SSE2 1
+#define SIMD_AVX2 2
+#define SIMD_AVX512 3
+
+/* Storage of quantized deltas (see delta_quantize_32f()) */
+#define DELTA_WRAP16 0  // uint16_t, truncated to 16 bits.
+#define DELTA_CLIP16 1  // uint16_t, clipped to UINT16_MAX.
+#define DELTA_CLIP24 2  // 24-bit big-endian, clipped to 2^24 - 1.
+#define DELTA_WRAP32 3  // uint32_t.
+
+int set_simd_level(int level);
+int get_simd_level();
+const char* get_simd_level_name(int level);
+const char* find_substring(const char* start, const char* end,
+                           const char* needle, size_t len);
+void delta_quantize_32f(const float* f, long len, float scale, int mode,
+                        void* dest);
+void delta_quantize_64d(const double* f, long len, float scale, int mode,
+                        void* dest);
+void log2_quantize_32f(const float* f, long len, float scale, uint16_t* dest);
+void log2_quantize_64d(const double* f, long len, float scale, uint16_t* dest);
+void exp2_dequantize_32f(const uint16_t* q, long len, float scale, float* dest);
+void exp2_dequantize_64d(const uint16_t* q, long len, float scale,
+                         double* dest);
+
 /* queue.c */
 cmp_blk_queue_t* alloc_cmp_buff();
 void dealloc_cmp_buff(cmp_blk_queue_t* queue);
@@ -567,11 +951,71 @@ long get_block_offset_by_index(block_len_queue_t* queue, int index);
 block_len_t* pop_block_len(block_len_queue_t* queue);
 void dump_block_len_queue(block_len_queue_t* queue, int fd);
 block_len_queue_t* read_block_len_queue(void* input_map, long offset, long end);
+void set_block_len_frames(block_len_queue_t* queue, cmp_block_t* cmp);
+void write_frame_index(block_len_queue_t** queues, int n_queues,
+                       sections_t* sections, int fd);
+int read_frame_index(void* input_map, long filesize, block_len_queue_t** queues,
+                     int n_queues);
+void write_spectrum_index(block_len_queue_t** queues, int n_queues,
+                          sections_t* sections, int fd);
+int read_spectrum_index(void* input_map, long filesize,
+                        block_len_queue_t** queues, int n_queues);
+
+/* cache.c */
+block_cache_t* alloc_block_cache(size_t limit);
+void dealloc_block_cache(block_cache_t* cache);
+void set_block_cache_limit(block_cache_t* cache, size_t limit);
+void block_cache_pin(block_cache_t* cache, block_len_t* blk);
+void block_cache_unpin(block_cache_t* cache, block_len_t* blk);
+void block_cache_remove(block_len_t* blk);
+void block_cache_lock_block(block_len_t* blk);
+void block_cache_unlock_block(block_len_t* blk);
+
+/* reader.c */
+typedef struct msz_reader_t msz_reader_t;
+
+msz_reader_t* open_msz_reader(char* path, long cache_size);
+void close_msz_reader(msz_reader_t* reader);
+long msz_reader_num_spectra(msz_reader_t* reader);
+block_cache_t* msz_reader_cache(msz_reader_t* reader);
+data_format_t* msz_reader_df(msz_reader_t* reader);
+float msz_reader_ret_time(msz_reader_t* reader, long index);
+long* msz_reader_ms_level(msz_reader_t* reader, uint16_t ms_level,
+                          long* indices_length);
+void* msz_reader_metadata_column(msz_reader_t* reader, int column);
+char* msz_reader_get_spectrum(msz_reader_t* reader, long index,
+                              size_t* out_len);
+long msz_reader_num_chromatograms(msz_reader_t* reader);
+data_format_t* msz_reader_chromatogram_df(msz_reader_t* reader);
+char* msz_reader_get_chromatogram(msz_reader_t* reader, int type, long index,
+                                  size_t* out_len);
+char* msz_reader_get_binary(msz_reader_t* reader, int type, long index,
+                            size_t* out_len);
+
+/* xic.c */
+xic_t* extract_xic(msz_reader_t* reader, double* mz, long n_targets,
+                   double ppm, int threads);
+void dealloc_xic(xic_t* xic);
+void print_xic_csv(xic_t* xic);
+
+/* tic.c */
+tic_t* compute_tic_msz(msz_reader_t* reader, uint16_t ms_level, int threads);
+tic_t* compute_tic_mzml(char* input_map, long input_filesize,
+                        uint16_t ms_level, int threads);
+int complete_tic_metadata(char* input_map, data_format_t* df,
+                          divisions_t* divisions, int threads);
+void dealloc_tic(tic_t* tic);
+void print_tic_csv(tic_t* tic);
 
 /* zl.c */
 
+#define DEFLATE_ONESHOT 0  // One deflate() call into a preallocated buffer.
+#define DEFLATE_STREAM 1   // Growable zlib_block_t (previous behaviour).
+
+int set_deflate_backend(data_format_t* df, int backend, int level);
+uInt zlib_deflate(z_stream* z, Bytef* input, uInt input_len, Bytef** output);
 zlib_block_t* zlib_alloc(int offset);
-z_stream* alloc_z_stream();
+z_stream* alloc_z_stream(data_format_t* df);
 void dealloc_z_stream(z_stream* z);
 int zlib_realloc(zlib_block_t* old_block, size_t new_size);
 void zlib_dealloc(zlib_block_t* blk);
@@ -581,6 +1025,7 @@ uInt zlib_compress(z_stream* z, Bytef* input, zlib_block_t* output,
                    uInt input_len);
 uInt zlib_decompress(z_stream* z, Bytef* input, zlib_block_t* output,
                      uInt input_len);
+z_stream* zlib_inflate_stream(z_stream* z);
 
 /* debug.c */
 void dump_divisions_to_file(data_positions_t** ddp, int divisions, int threads,
@@ -43,6 +43,8 @@ data_format_t* alloc_df() {
    if (df == NULL)
       error("alloc_df: malloc failure.\n");
    df->populated = 0;
+   df->zlib_engine = DEFLATE_ONESHOT;
+   df->zlib_level = Z_DEFAULT_COMPRESSION;
    return df;
 }
 
@@ -164,6 +166,7 @@ division_t* alloc_division(size_t n_xml, size_t n_mz, size_t n_inten) {
    d->scans = malloc(n_mz * sizeof(uint32_t));
    d->ms_levels = malloc(n_mz * sizeof(uint16_t));
    d->ret_times = NULL;
+   d->metadata = NULL;
 
    if (d->spectra == NULL || d->xml == NULL || d->mz == NULL ||
        d->inten == NULL)
@@ -392,16 +395,41 @@ long get_scan(char* spectrum_start) {
    return strtol(ptr, &e, 10);
 }
 
-float get_ret_time(char* spectrum_start) {
-   char* ptr = strstr(spectrum_start, "accession=\"MS:1000016\"") +
-               sizeof("accession=\"MS:1000016\"");
+float get_ret_time(char* start, char* end)
+/**
+ * @brief Returns the scan start time (MS:1000016) of a spectrum in minutes.
+ * Only [start, end) is searched so a missing cvParam never matches the next
+ * spectrum's. Returns NAN if the spectrum has none.
+ */
+{
+   char *ptr, *tag_end;
+   float r;
+
+   ptr = find_in_range(start, end, "accession=\"MS:1000016\"");
    if (ptr == NULL)
-      return 0;
-   ptr = strstr(ptr, "value=\"") + sizeof("value=\"") - 1;
-   char* e = strstr(ptr, "\"");
-   if (e == NULL)
-      return 0;
-   return strtof(ptr, &e);
+      return NAN;
+   tag_end = find_in_range(ptr, end, ">");
+   if (tag_end == NULL)
+      return NAN;
+   ptr = find_in_range(ptr, tag_end, "value=\"");
+   if (ptr == NULL)
+      return NAN;
+   r = strtof(ptr + strlen("value=\""), NULL);
+
+   // UO:0000010 (second), UO:0000031 (minute)
+   if (find_in_range(ptr, tag_end, "\"UO:0000010\"") != NULL)
+      r /= 60;
+
+   return r;
+}
+
+char* find_in_range(char* start, char* end, const char* needle)
+/**
+ * @brief strstr() bounded by end. Returns NULL if needle does not start and
+ * end within [start, end).
+ */
+{
+   return (char*)find_substring(start, end, needle, strlen(needle));
 }
 
 division_t* scan_mzml(char* input_map, data_format_t* df, long end, int flags) {
@@ -426,6 +454,13 @@ division_t* scan_mzml(char* input_map, data_format_t* df, long end, int flags) {
        (uint16_t*)calloc(df->source_total_spec, sizeof(uint16_t));
    float* ret_times = (float*)calloc(df->source_total_spec, sizeof(float));
 
+   metadata_t* metadata = NULL;
+   if (flags & METADATA_FLAGS) {
+      metadata = alloc_metadata(flags, df->source_total_spec);
+      if (metadata == NULL)
+         return NULL;
+   }
+
    if (xml_dp == NULL || mz_dp == NULL || inten_dp == NULL) {
       warning("scan_mzml: failed to allocate memory.\n");
       return NULL;
@@ -481,12 +516,6 @@ division_t* scan_mzml(char* input_map, data_format_t* df, long end, int flags) {
             return NULL;
       }
 
-      if (flags & RETTIME) {  // If we want to extract ret_times
-         ret_times[spec_curr] = get_ret_time(ptr);
-         if (ptr == NULL)
-            return NULL;
-      }
-
       // Now, get the binaries and set the start and end positions
       ptr = get_binary_start(ptr);
       if (ptr == NULL)
@@ -494,6 +523,16 @@ division_t* scan_mzml(char* input_map, data_format_t* df, long end, int flags) {
       mz_dp->start_positions[mz_curr] = ptr - input_map;
       xml_dp->end_positions[xml_curr++] = mz_dp->start_positions[mz_curr];
 
+      // Spectrum-level cvParams all precede the first <binary>.
+      if (flags & RETTIME)  // If we want to extract ret_times
+         ret_times[spec_curr] = get_ret_time(
+             input_map + spectra_dp->start_positions[spec_curr], ptr);
+
+      if (metadata != NULL)
+         scan_spectrum_metadata(
+             metadata, spec_curr,
+             input_map + spectra_dp->start_positions[spec_curr], ptr);
+
       ptr = get_binary_end(ptr);
       if (ptr == NULL)
          return NULL;
@@ -538,6 +577,8 @@ division_t* scan_mzml(char* input_map, data_format_t* df, long end, int flags) {
               df->source_total_spec, spec_curr);
       df->source_total_spec =
           spec_curr;  // Reset source_total_spec to the value actually found.
+      if (metadata != NULL)
+         metadata->n_spectra = spec_curr;
    }
    // xml base case
    xml_dp->end_positions[xml_curr] = end;
@@ -574,14 +615,227 @@ division_t* scan_mzml(char* input_map, data_format_t* df, long end, int flags) {
    div->scans = scans;
    div->ms_levels = ms_levels;
    div->ret_times = ret_times;
+   div->metadata = metadata;
 
    return div;
 }
 
+static char* parse_chromatogram_array(char* start, char* end, int* type,
+                                      int* fmt, int* compression)
+/**
+ * @brief Parses a <binaryDataArray> of a chromatogram beginning at start.
+ * Populates the array type (time/intensity), data format, and compression
+ * from the cvParam accessions within the array.
+ *
+ * @return Pointer to the start of the <binary> contents on success, NULL if
+ * the array cannot be found before end.
+ */
+{
+   char *array_end, *binary, *p;
+   int acc;
+
+   *type = *fmt = *compression = 0;
+
+   start = find_in_range(start, end, "<binaryDataArray");
+   if (start == NULL)
+      return NULL;
+   array_end = find_in_range(start, end, "</binaryDataArray>");
+   if (array_end == NULL)
+      return NULL;
+   binary = find_in_range(start, array_end, "<binary>");
+   if (binary == NULL)
+      return NULL;
+
+   p = start;
+   while ((p = find_in_range(p, binary, "accession=\"MS:")) != NULL) {
+      p += strlen("accession=\"MS:");
+      acc = atoi(p);
+      if (acc == _time_ || acc == _intensity_)
+         *type = acc;
+      else if (acc == _32f_ || acc == _64d_)
+         *fmt = acc;
+      else if (acc == _zlib_ || acc == _no_comp_)
+         *compression = acc;
+   }
+
+   return binary + strlen("<binary>");
+}
+
+chromatograms_t* scan_chromatograms(char* input_map, divisions_t* divisions)
+/**
+ * @brief Locates the <chromatogramList> within the trailing XML division and
+ * records the positions of the chromatogram time and intensity arrays so they
+ * can be compressed through the binary path. On success, the XML positions of
+ * the trailing division are split around the arrays (XML, time, XML,
+ * intensity, ..., XML), mirroring a spectra division.
+ *
+ * Chromatograms are only eligible if every chromatogram starts with a time
+ * array followed by an intensity array sharing the same formats. Otherwise,
+ * they remain in the XML stream.
+ *
+ * @param input_map A mmap pointer to the .mzML file.
+ *
+ * @param divisions Divisions created by create_divisions().
+ *
+ * @return A populated chromatograms_t (also stored in
+ * divisions->chromatograms) on success, NULL if there are no eligible
+ * chromatograms.
+ */
+{
+   division_t *trailing, *div;
+   data_positions_t *chrom_dp, *time_dp, *inten_dp, *xml_dp;
+   data_format_t* df;
+   chromatograms_t* r;
+   char *start, *end, *ptr, *chrom_end, *binary;
+   int type, fmt, compression;
+   int time_fmt = 0, inten_fmt = 0, chrom_compression = 0;
+   long count;
+   int i;
+
+   if (input_map == NULL || divisions == NULL || divisions->n_divisions < 1)
+      return NULL;
+
+   trailing = divisions->divisions[divisions->n_divisions - 1];
+   if (trailing == NULL || trailing->mz->total_spec != 0 ||
+       trailing->xml->total_spec != 1)
+      return NULL;
+
+   start = input_map + trailing->xml->start_positions[0];
+   end = input_map + trailing->xml->end_positions[0];
+
+   ptr = find_in_range(start, end, "<chromatogramList");
+   if (ptr == NULL)
+      return NULL;
+   ptr = find_in_range(ptr, end, "count=\"");
+   if (ptr == NULL)
+      return NULL;
+   count = atol(ptr + strlen("count=\""));
+   if (count <= 0)
+      return NULL;
+
+   chrom_dp = alloc_dp(count);
+   time_dp = alloc_dp(count);
+   inten_dp = alloc_dp(count);
+   xml_dp = alloc_dp(count * 2 + 1);
+
+   xml_dp->start_positions[0] = start - input_map;
+
+   for (i = 0; i < count; i++) {
+      ptr = find_in_range(ptr, end, "<chromatogram ");
+      if (ptr == NULL)
+         break;
+      chrom_end = find_in_range(ptr, end, "</chromatogram>");
+      if (chrom_end == NULL)
+         break;
+
+      chrom_dp->start_positions[i] = ptr - input_map;
+      chrom_dp->end_positions[i] =
+          chrom_end + strlen("</chromatogram>") - input_map;
+
+      // Time array
+      binary = parse_chromatogram_array(ptr, chrom_end, &type, &fmt,
+                                        &compression);
+      if (binary == NULL || type != _time_ || fmt == 0 || compression == 0 ||
+          (time_fmt && fmt != time_fmt) ||
+          (chrom_compression && compression != chrom_compression))
+         break;
+      time_fmt = fmt;
+      chrom_compression = compression;
+
+      time_dp->start_positions[i] = binary - input_map;
+      xml_dp->end_positions[i * 2] = time_dp->start_positions[i];
+      ptr = find_in_range(binary, chrom_end, "</binary>");
+      if (ptr == NULL)
+         break;
+      time_dp->end_positions[i] = ptr - input_map;
+      xml_dp->start_positions[i * 2 + 1] = time_dp->end_positions[i];
+
+      // Intensity array
+      binary = parse_chromatogram_array(ptr, chrom_end, &type, &fmt,
+                                        &compression);
+      if (binary == NULL || type != _intensity_ || fmt == 0 ||
+          (inten_fmt && fmt != inten_fmt) || compression != chrom_compression)
+         break;
+      inten_fmt = fmt;
+
+      inten_dp->start_positions[i] = binary - input_map;
+      xml_dp->end_positions[i * 2 + 1] = inten_dp->start_positions[i];
+      ptr = find_in_range(binary, chrom_end, "</binary>");
+      if (ptr == NULL)
+         break;
+      inten_dp->end_positions[i] = ptr - input_map;
+      xml_dp->start_positions[i * 2 + 2] = inten_dp->end_positions[i];
+
+      ptr = chrom_end;
+   }
+
+   if (i != count) {
+      print("\tChromatograms are not eligible for binary compression, "
+            "storing as XML.\n");
+      dealloc_dp(chrom_dp);
+      dealloc_dp(time_dp);
+      dealloc_dp(inten_dp);
+      dealloc_dp(xml_dp);
+      return NULL;
+   }
+
+   xml_dp->end_positions[count * 2] = end - input_map;
+
+   chrom_dp->total_spec = time_dp->total_spec = inten_dp->total_spec = count;
+   xml_dp->total_spec = count * 2 + 1;
+
+   df = alloc_df();
+   df->source_mz_fmt = time_fmt;
+   df->source_inten_fmt = inten_fmt;
+   df->source_compression = chrom_compression;
+   df->source_total_spec = count;
+   df->populated = 2;
+
+   div = malloc(sizeof(division_t));
+   r = malloc(sizeof(chromatograms_t));
+   if (div == NULL || r == NULL) {
+      error("scan_chromatograms: malloc failure.\n");
+      free(div);
+      free(r);
+      dealloc_df(df);
+      dealloc_dp(chrom_dp);
+      dealloc_dp(time_dp);
+      dealloc_dp(inten_dp);
+      dealloc_dp(xml_dp);
+      return NULL;
+   }
+
+   div->spectra = chrom_dp;
+   div->xml = xml_dp;
+   div->mz = time_dp;
+   div->inten = inten_dp;
+   div->size = trailing->size;
+   div->scans = calloc(count, sizeof(uint32_t));
+   div->ms_levels = calloc(count, sizeof(uint16_t));
+   div->ret_times = NULL;
+   div->metadata = NULL;
+
+   // The trailing division now shares the split XML positions.
+   dealloc_dp(trailing->xml);
+   trailing->xml = xml_dp;
+
+   r->df = df;
+   r->division = div;
+   r->footer = NULL;
+   r->time_block_lens = NULL;
+   r->inten_block_lens = NULL;
+
+   divisions->chromatograms = r;
+
+   print("\tFound %ld chromatograms.\n", count);
+
+   return r;
+}
+
 division_t* extract_one_spectra(division_t* div, long index) {
    data_positions_t *spectra_dp, *mz_dp, *inten_dp, *xml_dp;
 
-   division_t* new_div = (division_t*)malloc(sizeof(division_t));
+   division_t* new_div = (division_t*)calloc(1, sizeof(division_t));
    if (new_div == NULL)
       error("extract_one_spectra: failed to allocate division_t.\n");
 
@@ -639,6 +893,8 @@ division_t* extract_one_spectra(division_t* div, long index) {
    new_div->xml = xml_dp;
    new_div->mz = mz_dp;
    new_div->inten = inten_dp;
+   new_div->ret_times = NULL;
+   new_div->metadata = NULL;
 
    return new_div;
 }
@@ -655,7 +911,7 @@ division_t* extract_n_spectra(division_t* div, long* indicies, long n)
 {
    data_positions_t *spectra_dp, *mz_dp, *inten_dp, *xml_dp;
 
-   division_t* new_div = (division_t*)malloc(sizeof(division_t));
+   division_t* new_div = (division_t*)calloc(1, sizeof(division_t));
    if (new_div == NULL)
       error("extract_one_spectra: failed to allocate division_t.\n");
 
@@ -755,6 +1011,8 @@ division_t* extract_n_spectra(division_t* div, long* indicies, long n)
    new_div->xml = xml_dp;
    new_div->mz = mz_dp;
    new_div->inten = inten_dp;
+   new_div->ret_times = NULL;
+   new_div->metadata = NULL;
 
    return new_div;
 }
@@ -1166,6 +1424,8 @@ division_t* read_division(void* input_map, long* position) {
 
    r->scans = read_uint32_arr(input_map, position);
    r->ms_levels = read_uint16_arr(input_map, position);
+   r->ret_times = NULL;  // See read_ret_times().
+   r->metadata = NULL;
 
    return r;
 }
@@ -1184,10 +1444,141 @@ divisions_t* read_divisions(void* input_map, long position, int n_divisions) {
       r->divisions[i] = read_division(input_map, &position);
 
    r->n_divisions = n_divisions;
+   r->chromatograms = NULL;
+   r->metadata = NULL;
+   r->spectrum_offsets = NULL;
+   r->spectra_per_division = 0;
+
+   index_divisions(r);
 
    return r;
 }
 
+void dealloc_read_divisions(divisions_t* divisions)
+/**
+ * @brief Frees divisions returned by read_divisions(). Their positions, scans
+ * and MS levels point into the msz mapping and are not freed.
+ */
+{
+   division_t* div;
+
+   if (divisions == NULL)
+      return;
+
+   for (int i = 0; i < divisions->n_divisions; i++) {
+      div = divisions->divisions[i];
+      if (div == NULL)
+         continue;
+      free(div->spectra);
+      free(div->xml);
+      free(div->mz);
+      free(div->inten);
+      free(div->ret_times);
+      dealloc_metadata(div->metadata);
+      free(div);
+   }
+   free(divisions->divisions);
+   free(divisions->spectrum_offsets);
+   dealloc_metadata(divisions->metadata);
+   free(divisions);
+}
+
+void index_divisions(divisions_t* divisions)
+/**
+ * @brief Builds the cumulative spectrum count of divisions so find_division()
+ * maps a spectrum index to its division in O(log n) instead of summing
+ * total_spec over every division. Called once the divisions are read.
+ */
+{
+   uint64_t* offsets;
+   long per;
+   int i, n = divisions->n_divisions;
+
+   offsets = malloc((n + 1) * sizeof(uint64_t));
+   if (offsets == NULL) {
+      warning("index_divisions: malloc failure.\n");
+      return;
+   }
+
+   offsets[0] = 0;
+   for (i = 0; i < n; i++)
+      offsets[i + 1] = offsets[i] + divisions->divisions[i]->mz->total_spec;
+
+   // create_divisions() gives every division the same number of spectra,
+   // except the last spectra division (leftover) and the trailing XML one.
+   per = n > 0 ? divisions->divisions[0]->mz->total_spec : 0;
+   for (i = 1; i < n - 2 && per > 0; i++)
+      if (divisions->divisions[i]->mz->total_spec != per)
+         per = 0;
+
+   free(divisions->spectrum_offsets);
+   divisions->spectrum_offsets = offsets;
+   divisions->spectra_per_division = per;
+}
+
+int find_division(divisions_t* divisions, long index, long* local_index)
+/**
+ * @brief Finds the division holding spectrum index.
+ *
+ * @param local_index If not NULL, set to the index of the spectrum within the
+ * division.
+ *
+ * @return The division index, -1 if index is out of range.
+ */
+{
+   uint64_t* offsets = divisions->spectrum_offsets;
+   int n = divisions->n_divisions;
+   int lo, hi, mid;
+
+   if (index < 0)
+      return -1;
+
+   if (offsets == NULL) {  // Not indexed, sum total_spec.
+      long sum = 0;
+      for (lo = 0; lo < n; lo++) {
+         sum += divisions->divisions[lo]->mz->total_spec;
+         if (index < sum) {
+            if (local_index != NULL)
+               *local_index =
+                   index - (sum - divisions->divisions[lo]->mz->total_spec);
+            return lo;
+         }
+      }
+      return -1;
+   }
+
+   if ((uint64_t)index >= offsets[n])
+      return -1;
+
+   // Uniform divisions: compute directly, then fall back to a binary search
+   // for the leftover division.
+   lo = -1;
+   if (divisions->spectra_per_division > 0) {
+      mid = index / divisions->spectra_per_division;
+      if (mid < n && offsets[mid] <= (uint64_t)index &&
+          (uint64_t)index < offsets[mid + 1])
+         lo = mid;
+   }
+
+   if (lo < 0) {
+      // Last division with offsets[lo] <= index.
+      lo = 0;
+      hi = n - 1;
+      while (lo < hi) {
+         mid = lo + (hi - lo + 1) / 2;
+         if (offsets[mid] <= (uint64_t)index)
+            lo = mid;
+         else
+            hi = mid - 1;
+      }
+   }
+
+   if (local_index != NULL)
+      *local_index = index - offsets[lo];
+
+   return lo;
+}
+
 division_t* flatten_divisions(divisions_t* divisions) {
    size_t spectra_size = 0;
    size_t xml_size = 0;
@@ -1310,6 +1701,10 @@ divisions_t* create_divisions(division_t* div, long n_divisions) {
    // r->n_divisions = n_threads;
    r->n_divisions = n_divisions + 1;  // n_divisions + 1 for the last division
                                       // containing only remaining XML.
+   r->chromatograms = NULL;
+   r->metadata = NULL;
+   r->spectrum_offsets = NULL;
+   r->spectra_per_division = 0;
 
    //  Determine roughly how many spectra each division will contain
    long n_spec_per_div = div->mz->total_spec / n_divisions;
@@ -1322,6 +1717,8 @@ divisions_t* create_divisions(division_t* div, long n_divisions) {
    for (int i = 0; i < n_divisions - 1; i++) {
       r->divisions[i] =
           alloc_division(n_spec_per_div * 2, n_spec_per_div, n_spec_per_div);
+      if (div->ret_times != NULL)
+         r->divisions[i]->ret_times = malloc(n_spec_per_div * sizeof(float));
 
       for (int j = 0; j < n_spec_per_div; j++) {
          // Copy Spectra
@@ -1351,6 +1748,8 @@ divisions_t* create_divisions(division_t* div, long n_divisions) {
          // Copy scans, MS levels, etc.
          r->divisions[i]->scans[j] = div->scans[spec_i];
          r->divisions[i]->ms_levels[j] = div->ms_levels[spec_i];
+         if (div->ret_times != NULL)
+            r->divisions[i]->ret_times[j] = div->ret_times[spec_i];
 
          spec_i++;
       }
@@ -1375,6 +1774,8 @@ divisions_t* create_divisions(division_t* div, long n_divisions) {
 
    r->divisions[i] =
        alloc_division(n_spec_per_div * 2, n_spec_per_div, n_spec_per_div);
+   if (div->ret_times != NULL)
+      r->divisions[i]->ret_times = malloc(n_spec_per_div * sizeof(float));
 
    for (int j = 0; j < n_spec_per_div; j++) {
       // Copy Spectra
@@ -1404,6 +1805,8 @@ divisions_t* create_divisions(division_t* div, long n_divisions) {
       // Copy scans, MS levels, etc.
       r->divisions[i]->scans[j] = div->scans[spec_i];
       r->divisions[i]->ms_levels[j] = div->ms_levels[spec_i];
+      if (div->ret_times != NULL)
+         r->divisions[i]->ret_times[j] = div->ret_times[spec_i];
 
       spec_i++;
    }
@@ -1458,7 +1861,7 @@ long get_division_size_max(divisions_t* divisions) {
    long max = 0;
 
    for (int i = 0; i < divisions->n_divisions; i++) {
-      if (divisions->divisions[i]->size > max)
+      if ((long)divisions->divisions[i]->size > max)
          max = divisions->divisions[i]->size;
    }
 
@@ -1620,7 +2023,7 @@ long* map_ms_level_to_index(uint16_t ms_level, division_t* div,
    if (!is_monotonically_increasing(indicies, j))
       error("map_ms_level_to_index: Scans must be monotonically increasing.\n");
 
-   *indices_length = j - 1;
+   *indices_length = j;
 
    print("Found %ld spectra with ms level %ld.\n", j, ms_level);
 
@@ -1669,6 +2072,87 @@ long* map_ms_level_to_index_from_divisions(uint16_t ms_level,
    return result;
 }
 
+long* map_rt_range_to_index(float* rt_range, division_t* div,
+                             long index_offset, long* indices_length)
+/**
+ * @brief Maps the spectra of a division whose retention time lies within
+ * [rt_range[0], rt_range[1]] (minutes) to spectrum indices.
+ *
+ * @return An array of *indices_length indices, NULL if the division has no
+ * retention times or no spectrum in range.
+ */
+{
+   long* indicies;
+   long j = 0;
+
+   *indices_length = 0;
+
+   if (div->ret_times == NULL || div->spectra->total_spec == 0)
+      return NULL;
+
+   indicies = malloc(div->spectra->total_spec * sizeof(long));
+   if (indicies == NULL) {
+      error("map_rt_range_to_index: malloc failure.\n");
+      return NULL;
+   }
+
+   for (long i = 0; i < div->spectra->total_spec; i++)
+      if (div->ret_times[i] >= rt_range[0] && div->ret_times[i] <= rt_range[1])
+         indicies[j++] = i + index_offset;
+
+   if (j == 0) {
+      free(indicies);
+      return NULL;
+   }
+
+   *indices_length = j;
+   return indicies;
+}
+
+long* map_rt_range_to_index_from_divisions(float* rt_range,
+                                           divisions_t* divisions,
+                                           long* indicies_length)
+/**
+ * @brief Maps a retention time window to spectrum indices. Only divisions
+ * with ret_times (see read_ret_times()) are searched.
+ */
+{
+   long** indicies = malloc(sizeof(long*) * divisions->n_divisions);
+   long* indicies_lens = calloc(divisions->n_divisions, sizeof(long));
+
+   long total_len = 0;
+   long index_offset = 0;
+
+   for (int i = 0; i < divisions->n_divisions; i++) {
+      indicies[i] = map_rt_range_to_index(rt_range, divisions->divisions[i],
+                                          index_offset, &indicies_lens[i]);
+      total_len += indicies_lens[i];
+      index_offset += divisions->divisions[i]->spectra->total_spec;
+   }
+
+   long* result = malloc(sizeof(long) * (total_len > 0 ? total_len : 1));
+
+   long index = 0;
+   for (int i = 0; i < divisions->n_divisions; i++) {
+      if (indicies[i] == NULL)
+         continue;
+
+      for (int j = 0; j < indicies_lens[i]; j++) {
+         result[index] = indicies[i][j];
+         index++;
+      }
+      free(indicies[i]);
+   }
+   free(indicies);
+   free(indicies_lens);
+
+   print("Found %ld spectra with retention time in [%g, %g].\n", total_len,
+         rt_range[0], rt_range[1]);
+
+   *indicies_length = total_len;
+   return result;
+}
+
 long* map_scans_to_index_from_divisions(uint32_t* scans, long scans_length,
                                         divisions_t* divisions,
                                         long* indicies_length) {
@@ -1757,10 +2241,27 @@ int preprocess_mzml(char* input_map, long input_filesize, long* blocksize,
                                                  &(arguments->indices_length));
       div =
           extract_n_spectra(tmp, arguments->indices, arguments->indices_length);
+   } else if (arguments->rt_range != NULL) {
+      division_t* tmp = scan_mzml(
+          (char*)input_map, *df, input_filesize,
+          MSLEVEL | SCANNUM | RETTIME);  // A division encapsulating the entire
+                                         // file
+      if (tmp == NULL)
+         return 1;
+      arguments->indices = map_rt_range_to_index(
+          arguments->rt_range, tmp, 0, &(arguments->indices_length));
+      if (arguments->indices == NULL) {
+         warning("No spectra found in retention time range.\n");
+         return 1;
+      }
+      div =
+          extract_n_spectra(tmp, arguments->indices, arguments->indices_length);
    } else if (arguments->indices_length == 0 && arguments->scans_length == 0) {
       div = scan_mzml(
           (char*)input_map, *df, input_filesize,
-          MSLEVEL | SCANNUM);  // A division encapsulating the entire file
+          MSLEVEL | SCANNUM | RETTIME |
+              arguments->metadata_flags);  // A division encapsulating the
+                                           // entire file
    } else
       error("Invalid indicies_size: %ld\n", arguments->indices_length);
 
@@ -1775,6 +2276,10 @@ int preprocess_mzml(char* input_map, long input_filesize, long* blocksize,
       (*divisions)->divisions = (division_t**)malloc(sizeof(division_t*));
       (*divisions)->divisions[0] = div;
       (*divisions)->n_divisions = 1;
+      (*divisions)->chromatograms = NULL;
+      (*divisions)->metadata = NULL;
+      (*divisions)->spectrum_offsets = NULL;
+      (*divisions)->spectra_per_division = 0;
    } else {
       long n_divisions = determine_n_divisions(div->size, *blocksize);
 
@@ -1816,6 +2321,11 @@ int preprocess_mzml(char* input_map, long input_filesize, long* blocksize,
    if (*divisions == NULL)
       return 1;
 
+   (*divisions)->metadata = div->metadata;
+
+   if (arguments->indices_length == 0)
+      scan_chromatograms(input_map, *divisions);
+
    end = get_time();
 
    print("Preprocessing time: %1.4fs\n", end - start);
@@ -1830,6 +2340,10 @@ divisions_t* divide_external(long input_filesize, int n_divisions) {
 
    r->divisions = malloc(sizeof(division_t) * n_divisions);
    r->n_divisions = n_divisions;
+   r->chromatograms = NULL;
+   r->metadata = NULL;
+   r->spectrum_offsets = NULL;
+   r->spectra_per_division = 0;
 
    uint64_t division_size = input_filesize / n_divisions;
 
@@ -1862,6 +2376,9 @@ data_format_t* create_external_df() {
    df->target_mz_format = _ZSTD_compression_;
    df->target_inten_format = _ZSTD_compression_;
 
+   df->zlib_engine = DEFLATE_ONESHOT;
+   df->zlib_level = Z_DEFAULT_COMPRESSION;
+
    return df;
 }
 
@@ -1911,8 +2428,269 @@ void parse_footer(footer_t** footer, void* input_map, long input_filesize,
    *inten_binary_block_lens = read_block_len_queue(
        input_map, (*footer)->inten_binary_blk_pos, (*footer)->divisions_t_pos);
 
+   block_len_queue_t* frame_queues[] = {*xml_block_lens, *mz_binary_block_lens,
+                                        *inten_binary_block_lens};
+   read_frame_index(input_map, input_filesize, frame_queues, 3);
+   read_spectrum_index(input_map, input_filesize, frame_queues + 1, 2);
+
    *n_divisions = (*footer)->n_divisions;
 
    *divisions =
        read_divisions(input_map, (*footer)->divisions_t_pos, *n_divisions);
-}
\ No newline at end of file
+}
+
+void write_chromatograms(chromatograms_t* chrom, sections_t* sections, int fd)
+/**
+ * @brief Writes the chromatogram section: the serialized chromatogram
+ * data_format_t, the time and intensity block_len tables, the chromatogram
+ * division, and finally chrom->footer. The section is registered in sections.
+ *
+ * @param chrom Chromatograms compressed by compress_mzml().
+ *
+ * @param sections Section table to register the section in.
+ *
+ * @param fd File descriptor to write to.
+ */
+{
+   uint64_t section_pos;
+   char* df_buff;
+
+   section_pos = get_offset(fd);
+
+   df_buff = serialize_df(chrom->df);
+   write_to_file(fd, df_buff, DATA_FORMAT_T_SIZE);
+   free(df_buff);
+
+   chrom->footer->mz_binary_blk_pos = get_offset(fd);
+   dump_block_len_queue(chrom->time_block_lens, fd);
+   chrom->time_block_lens = NULL;  // Freed by dump_block_len_queue.
+
+   chrom->footer->inten_binary_blk_pos = get_offset(fd);
+   dump_block_len_queue(chrom->inten_block_lens, fd);
+   chrom->inten_block_lens = NULL;
+
+   chrom->footer->divisions_t_pos = get_offset(fd);
+   write_division(chrom->division, fd);
+
+   write_footer(chrom->footer, fd);
+
+   add_section(sections, CHROMATOGRAM_SECTION, section_pos,
+               get_offset(fd) - section_pos);
+}
+
+int read_chromatograms(void* input_map, long input_filesize,
+                       chromatograms_t** chrom)
+/**
+ * @brief Reads the chromatogram section of an msz file, if present.
+ *
+ * @param input_map mmap'ed msz file.
+ *
+ * @param input_filesize Size of the msz file.
+ *
+ * @param chrom Set to a populated chromatograms_t (see
+ * dealloc_read_chromatograms()), or NULL if the chromatograms are stored as
+ * XML.
+ *
+ * @return 0 on success or if the file has no chromatogram section, 1 on error.
+ */
+{
+   sections_t* sections;
+   section_t* section;
+   chromatograms_t* r;
+   long position;
+
+   *chrom = NULL;
+
+   sections = read_sections(input_map, input_filesize);
+   section = find_section(sections, CHROMATOGRAM_SECTION);
+   if (section == NULL) {
+      dealloc_sections(sections);
+      return 0;
+   }
+
+   r = calloc(1, sizeof(chromatograms_t));
+   if (r == NULL) {
+      error("read_chromatograms: malloc failure.\n");
+      dealloc_sections(sections);
+      return 1;
+   }
+
+   // The section is not aligned within the file, so the footer is copied out.
+   r->footer = malloc(sizeof(footer_t));
+   if (r->footer == NULL) {
+      error("read_chromatograms: malloc failure.\n");
+      free(r);
+      dealloc_sections(sections);
+      return 1;
+   }
+   if (section->len >= sizeof(footer_t))
+      memcpy(r->footer,
+             (char*)input_map + section->pos + section->len - sizeof(footer_t),
+             sizeof(footer_t));
+   if (section->len < sizeof(footer_t) || r->footer->magic_tag != MAGIC_TAG) {
+      error("read_chromatograms: invalid magic tag.\n");
+      free(r->footer);
+      free(r);
+      dealloc_sections(sections);
+      return 1;
+   }
+
+   r->df = deserialize_df((char*)input_map + section->pos);
+   r->df->populated = 2;
+
+   r->time_block_lens =
+       read_block_len_queue(input_map, r->footer->mz_binary_blk_pos,
+                            r->footer->inten_binary_blk_pos);
+   r->inten_block_lens =
+       read_block_len_queue(input_map, r->footer->inten_binary_blk_pos,
+                            r->footer->divisions_t_pos);
+
+   position = r->footer->divisions_t_pos;
+   r->division = read_division(input_map, &position);
+
+   dealloc_sections(sections);
+
+   *chrom = r;
+   return 0;
+}
+
+void dealloc_read_chromatograms(chromatograms_t* chrom)
+/**
+ * @brief Frees chromatograms returned by read_chromatograms(). Their
+ * positions point into the msz mapping and are not freed.
+ */
+{
+   if (chrom == NULL)
+      return;
+
+   dealloc_block_len_queue(chrom->time_block_lens);
+   dealloc_block_len_queue(chrom->inten_block_lens);
+   if (chrom->division != NULL) {
+      free(chrom->division->spectra);
+      free(chrom->division->xml);
+      free(chrom->division->mz);
+      free(chrom->division->inten);
+      free(chrom->division);
+   }
+   free(chrom->footer);
+   free(chrom->df);
+   free(chrom);
+}
+
+void write_ret_times(divisions_t* divisions, sections_t* sections, int fd)
+/**
+ * @brief Writes the retention time section (RET_TIME_SECTION): the number of
+ * divisions as a uint64_t, the {min, max} retention time of each division,
+ * then the retention time of every spectrum as floats, in minutes. Divisions
+ * can be pruned by reading the bounds alone.
+ *
+ * @param divisions Divisions with ret_times (scanned with RETTIME).
+ *
+ * @param sections Section table to register the section in.
+ *
+ * @param fd File descriptor to write to.
+ */
+{
+   uint64_t section_pos, n_divisions;
+   float* bounds;
+   division_t* div;
+   int i;
+   long j;
+
+   for (i = 0; i < divisions->n_divisions; i++)
+      if (divisions->divisions[i]->mz->total_spec > 0 &&
+          divisions->divisions[i]->ret_times == NULL)
+         return;  // Not scanned with RETTIME.
+
+   n_divisions = divisions->n_divisions;
+   bounds = malloc(n_divisions * 2 * sizeof(float));
+   if (bounds == NULL) {
+      warning("write_ret_times: malloc failure.\n");
+      return;
+   }
+
+   for (i = 0; i < divisions->n_divisions; i++) {
+      div = divisions->divisions[i];
+      bounds[i * 2] = INFINITY;
+      bounds[i * 2 + 1] = -INFINITY;
+      for (j = 0; j < div->mz->total_spec; j++) {
+         if (div->ret_times[j] < bounds[i * 2])
+            bounds[i * 2] = div->ret_times[j];
+         if (div->ret_times[j] > bounds[i * 2 + 1])
+            bounds[i * 2 + 1] = div->ret_times[j];
+      }
+   }
+
+   section_pos = get_offset(fd);
+   write_to_file(fd, (char*)&n_divisions, sizeof(uint64_t));
+   write_to_file(fd, (char*)bounds, n_divisions * 2 * sizeof(float));
+   for (i = 0; i < divisions->n_divisions; i++)
+      if (divisions->divisions[i]->mz->total_spec > 0)
+         write_to_file(fd, (char*)divisions->divisions[i]->ret_times,
+                       divisions->divisions[i]->mz->total_spec * sizeof(float));
+   free(bounds);
+
+   add_section(sections, RET_TIME_SECTION, section_pos,
+               get_offset(fd) - section_pos);
+}
+
+int read_ret_times(void* input_map, long input_filesize,
+                   divisions_t* divisions, float* rt_range)
+/**
+ * @brief Reads the retention times of the divisions overlapping rt_range from
+ * the retention time section. Other divisions are left without ret_times and
+ * their retention times are never read.
+ *
+ * @param rt_range {start, end} in minutes.
+ *
+ * @return Number of divisions overlapping rt_range, -1 if the msz file has no
+ * retention time section.
+ */
+{
+   sections_t* sections;
+   section_t* section;
+   char* ptr;
+   float bounds[2];
+   uint64_t n_divisions;
+   long offset = 0;
+   int i, r = 0;
+
+   sections = read_sections(input_map, input_filesize);
+   section = find_section(sections, RET_TIME_SECTION);
+   if (section == NULL) {
+      dealloc_sections(sections);
+      return -1;
+   }
+
+   ptr = (char*)input_map + section->pos;
+   memcpy(&n_divisions, ptr, sizeof(uint64_t));
+   if (n_divisions != (uint64_t)divisions->n_divisions) {
+      error("read_ret_times: division count mismatch.\n");
+      dealloc_sections(sections);
+      return -1;
+   }
+   ptr += sizeof(uint64_t);
+
+   for (i = 0; i < divisions->n_divisions; i++) {
+      division_t* div = divisions->divisions[i];
+      long n = div->mz->total_spec;
+
+      memcpy(bounds, ptr + i * 2 * sizeof(float), 2 * sizeof(float));
+      if (n > 0 && bounds[0] <= rt_range[1] && bounds[1] >= rt_range[0]) {
+         div->ret_times = malloc(n * sizeof(float));
+         if (div->ret_times == NULL) {
+            error("read_ret_times: malloc failure.\n");
+            break;
+         }
+         memcpy(div->ret_times,
+                ptr + n_divisions * 2 * sizeof(float) + offset * sizeof(float),
+                n * sizeof(float));
+         r++;
+      }
+      offset += n;
+   }
+
+   dealloc_sections(sections);
+
+   return r;
+}
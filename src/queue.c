@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "mscompress.h"
 
@@ -120,14 +121,33 @@ block_len_t* alloc_block_len(size_t original_size, size_t compressed_size) {
    r->encoded_cache_len = 0;
    r->encoded_cache_lens = NULL;
 
+   r->frame_size = 0;
+   r->frame_ends = NULL;
+   r->n_frames = 0;
+   r->frames_decoded = NULL;
+
+   r->spectrum_ends = NULL;
+   r->n_spectra = 0;
+
+   r->block_cache = NULL;
+   r->lru_prev = NULL;
+   r->lru_next = NULL;
+   r->pins = 0;
+   r->busy = 0;
+   r->cached_size = 0;
+
    return r;
 }
 
 void dealloc_block_len(block_len_t* blk) {
    if (blk) {
+      block_cache_remove(blk);
       if (blk->cache) {
          free(blk->cache);
       }
+      free(blk->frame_ends);
+      free(blk->frames_decoded);
+      free(blk->spectrum_ends);
       free(blk);
    }
 }
@@ -146,12 +166,30 @@ block_len_queue_t* alloc_block_len_queue() {
    r->tail = NULL;
    r->populated = 0;
 
+   r->blocks = NULL;
+   r->offsets = NULL;
+   r->n_blocks = 0;
+
+   r->cache = NULL;
+
    return r;
 }
 
 void dealloc_block_len_queue(block_len_queue_t* queue) {
    if (queue) {
-      if (queue->head) {
+      if (queue->blocks) {
+         for (int i = 0; i < queue->n_blocks; i++) {
+            block_cache_remove(&queue->blocks[i]);
+            free(queue->blocks[i].cache);
+            free(queue->blocks[i].encoded_cache);
+            free(queue->blocks[i].encoded_cache_lens);
+            free(queue->blocks[i].frame_ends);
+            free(queue->blocks[i].frames_decoded);
+            free(queue->blocks[i].spectrum_ends);
+         }
+         free(queue->blocks);
+         free(queue->offsets);
+      } else if (queue->head) {
          block_len_t* curr_head = queue->head;
          block_len_t* new_head = curr_head->next;
          while (new_head) {
@@ -184,7 +222,26 @@ void append_block_len(block_len_queue_t* queue, size_t original_size,
    return;
 }
 
+/**
+ * @brief Position of the queue's head in queue->blocks, -1 if the queue is not
+ * array-backed or empty. Indices passed to get_block_by_index() and
+ * get_block_offset_by_index() are relative to the head.
+ */
+static long get_head_position(block_len_queue_t* queue) {
+   if (queue->blocks == NULL || queue->head == NULL)
+      return -1;
+   return queue->head - queue->blocks;
+}
+
 block_len_t* get_block_by_index(block_len_queue_t* queue, int index) {
+   long head = get_head_position(queue);
+
+   if (head >= 0) {
+      if (index < 0 || head + index >= queue->n_blocks)
+         return NULL;
+      return &queue->blocks[head + index];
+   }
+
    block_len_t* current = queue->head;
    int i = 0;
 
@@ -205,6 +262,14 @@ long get_block_offset_by_index(block_len_queue_t* queue, int index)
     Note: These offsets are from the start of respective block section.
 */
 {
+   long head = get_head_position(queue);
+
+   if (head >= 0) {
+      if (index < 0 || head + index >= queue->n_blocks)
+         return -1;
+      return queue->offsets[head + index] - queue->offsets[head];
+   }
+
    block_len_t* current = queue->head;
    int i = 0;
    long offset = 0;
@@ -280,7 +345,7 @@ block_len_queue_t* read_block_len_queue(void* input_map, long offset,
    block_len_queue_t* r;
    long diff;
    int factor;
-   int i;
+   int i, n;
 
    r = alloc_block_len_queue();
 
@@ -288,13 +353,366 @@ block_len_queue_t* read_block_len_queue(void* input_map, long offset,
 
    factor = sizeof(size_t) * 2;
 
+   n = diff / factor;
+
    char* input_ptr = (char*)(input_map);
 
    input_ptr += offset;
 
-   for (i = 0; i < diff; i += factor)
-      append_block_len(r, *(size_t*)(input_ptr + i),
-                       *(size_t*)(input_ptr + i + sizeof(size_t)));
+   if (n <= 0)
+      return r;
+
+   r->blocks = malloc(n * sizeof(block_len_t));
+   r->offsets = malloc((n + 1) * sizeof(uint64_t));
+   if (r->blocks == NULL || r->offsets == NULL) {
+      error("read_block_len_queue: malloc failed\n");
+      free(r->blocks);
+      free(r->offsets);
+      free(r);
+      return NULL;
+   }
+
+   r->offsets[0] = 0;
+
+   for (i = 0; i < n; i++) {
+      block_len_t* blk = &r->blocks[i];
+
+      memcpy(&blk->original_size, input_ptr + i * factor, sizeof(size_t));
+      memcpy(&blk->compressed_size, input_ptr + i * factor + sizeof(size_t),
+             sizeof(size_t));
+      blk->next = i + 1 < n ? &r->blocks[i + 1] : NULL;
+
+      blk->cache = NULL;
+      blk->encoded_cache_fmt = 0;
+      blk->encoded_cache = NULL;
+      blk->encoded_cache_len = 0;
+      blk->encoded_cache_lens = NULL;
+
+      blk->frame_size = 0;
+      blk->frame_ends = NULL;
+      blk->n_frames = 0;
+      blk->frames_decoded = NULL;
+
+      blk->spectrum_ends = NULL;
+      blk->n_spectra = 0;
+
+      blk->block_cache = NULL;
+      blk->lru_prev = NULL;
+      blk->lru_next = NULL;
+      blk->pins = 0;
+      blk->busy = 0;
+      blk->cached_size = 0;
+
+      r->offsets[i + 1] = r->offsets[i] + blk->compressed_size;
+   }
+
+   r->head = &r->blocks[0];
+   r->tail = &r->blocks[n - 1];
+   r->populated = n;
+   r->n_blocks = n;
 
    return r;
-}
\ No newline at end of file
+}
+
+void set_block_len_frames(block_len_queue_t* queue, cmp_block_t* cmp)
+/**
+ * @brief Moves the frame index of a compressed block to the block_len_t
+ * appended for it (queue->tail).
+ */
+{
+   block_len_t* blk = queue->tail;
+
+   if (blk == NULL || cmp->n_frames == 0)
+      return;
+
+   blk->frame_size = cmp->frame_size;
+   blk->frame_ends = cmp->frame_ends;
+   blk->n_frames = cmp->n_frames;
+
+   cmp->frame_ends = NULL;
+   cmp->n_frames = 0;
+}
+
+void write_frame_index(block_len_queue_t** queues, int n_queues,
+                       sections_t* sections, int fd)
+/**
+ * @brief Writes the frame index section (FRAME_SECTION). For each queue: the
+ * number of blocks as a uint64_t, then for each block the number of frames,
+ * the frame size and the end of every frame within the block, as uint64_t.
+ * Nothing is written if no block was split in frames. Must be called before
+ * dump_block_len_queue() frees the queues.
+ *
+ * @param queues Block queues, in the order read_frame_index() expects them.
+ *
+ * @param sections Section table to register the section in.
+ *
+ * @param fd File descriptor to write to.
+ */
+{
+   block_len_t* blk;
+   uint64_t section_pos, n, buff[2];
+   int i, framed = 0;
+
+   for (i = 0; i < n_queues; i++)
+      for (blk = queues[i]->head; blk != NULL && !framed; blk = blk->next)
+         framed = blk->n_frames > 0;
+
+   if (!framed)
+      return;
+
+   section_pos = get_offset(fd);
+
+   for (i = 0; i < n_queues; i++) {
+      n = 0;
+      for (blk = queues[i]->head; blk != NULL; blk = blk->next) n++;
+      write_to_file(fd, (char*)&n, sizeof(uint64_t));
+
+      for (blk = queues[i]->head; blk != NULL; blk = blk->next) {
+         buff[0] = blk->n_frames;
+         buff[1] = blk->frame_size;
+         write_to_file(fd, (char*)buff, sizeof(buff));
+         if (blk->n_frames > 0)
+            write_to_file(fd, (char*)blk->frame_ends,
+                          blk->n_frames * sizeof(uint64_t));
+      }
+   }
+
+   add_section(sections, FRAME_SECTION, section_pos,
+               get_offset(fd) - section_pos);
+}
+
+static int valid_frames(block_len_t* blk, uint64_t n_frames,
+                        uint64_t frame_size, uint64_t* ends) {
+   if (frame_size == 0 ||
+       n_frames != (blk->original_size + frame_size - 1) / frame_size ||
+       ends[n_frames - 1] != blk->compressed_size)
+      return 0;
+   for (uint64_t i = 1; i < n_frames; i++)
+      if (ends[i] <= ends[i - 1])
+         return 0;
+   return 1;
+}
+
+static void clear_frame_index(block_len_queue_t** queues, int n_queues) {
+   block_len_t* blk;
+
+   for (int i = 0; i < n_queues; i++)
+      for (blk = queues[i]->head; blk != NULL; blk = blk->next) {
+         free(blk->frame_ends);
+         blk->frame_ends = NULL;
+         blk->n_frames = 0;
+         blk->frame_size = 0;
+      }
+}
+
+int read_frame_index(void* input_map, long filesize, block_len_queue_t** queues,
+                     int n_queues)
+/**
+ * @brief Reads the frame index section written by write_frame_index() into
+ * the blocks of queues. Files without the section (or with an index not
+ * matching the blocks) are left as single frame blocks.
+ *
+ * @param queues Block queues read by read_block_len_queue().
+ *
+ * @return 0 on success or if the file has no frame index, 1 on error.
+ */
+{
+   sections_t* sections;
+   section_t* section;
+   block_len_t* blk;
+   char *ptr, *end;
+   uint64_t n, buff[2], j;
+   int i, valid = 1;
+
+   sections = read_sections(input_map, filesize);
+   if (sections == NULL)
+      return 0;
+
+   section = find_section(sections, FRAME_SECTION);
+   if (section == NULL) {
+      dealloc_sections(sections);
+      return 0;
+   }
+
+   ptr = (char*)input_map + section->pos;
+   end = ptr + section->len;
+   dealloc_sections(sections);
+
+   for (i = 0; i < n_queues && valid; i++) {
+      valid = ptr + sizeof(uint64_t) <= end;
+      if (!valid)
+         break;
+      memcpy(&n, ptr, sizeof(uint64_t));
+      ptr += sizeof(uint64_t);
+
+      for (j = 0; j < n && valid; j++) {
+         valid = ptr + sizeof(buff) <= end;
+         if (!valid)
+            break;
+         memcpy(buff, ptr, sizeof(buff));
+         ptr += sizeof(buff);
+
+         blk = get_block_by_index(queues[i], j);
+         valid = blk != NULL && ptr + buff[0] * sizeof(uint64_t) <= end;
+         if (!valid || buff[0] == 0)
+            continue;
+
+         blk->frame_ends = malloc(buff[0] * sizeof(uint64_t));
+         if (blk->frame_ends == NULL) {
+            error("read_frame_index: malloc failed\n");
+            clear_frame_index(queues, n_queues);
+            return 1;
+         }
+         memcpy(blk->frame_ends, ptr, buff[0] * sizeof(uint64_t));
+         ptr += buff[0] * sizeof(uint64_t);
+
+         valid = valid_frames(blk, buff[0], buff[1], blk->frame_ends);
+         blk->n_frames = buff[0];
+         blk->frame_size = buff[1];
+      }
+   }
+
+   if (!valid) {
+      warning("read_frame_index: frame index does not match blocks, "
+              "ignoring.\n");
+      clear_frame_index(queues, n_queues);
+   }
+
+   return 0;
+}
+
+void write_spectrum_index(block_len_queue_t** queues, int n_queues,
+                          sections_t* sections, int fd)
+/**
+ * @brief Writes the spectrum index section (SPECTRUM_SECTION). For each
+ * queue: the number of blocks as a uint64_t, then for each block the number
+ * of spectra and the end of every spectrum within the decompressed block, as
+ * uint64_t. Blocks without an index are written with 0 spectra. Must be called
+ * before dump_block_len_queue() frees the queues.
+ *
+ * @param queues Binary block queues, in the order read_spectrum_index()
+ * expects them.
+ *
+ * @param sections Section table to register the section in.
+ *
+ * @param fd File descriptor to write to.
+ */
+{
+   block_len_t* blk;
+   uint64_t section_pos, n;
+   int i;
+
+   section_pos = get_offset(fd);
+
+   for (i = 0; i < n_queues; i++) {
+      n = 0;
+      for (blk = queues[i]->head; blk != NULL; blk = blk->next) n++;
+      write_to_file(fd, (char*)&n, sizeof(uint64_t));
+
+      for (blk = queues[i]->head; blk != NULL; blk = blk->next) {
+         n = blk->spectrum_ends != NULL ? blk->n_spectra : 0;
+         write_to_file(fd, (char*)&n, sizeof(uint64_t));
+         if (n > 0)
+            write_to_file(fd, (char*)blk->spectrum_ends, n * sizeof(uint64_t));
+      }
+   }
+
+   add_section(sections, SPECTRUM_SECTION, section_pos,
+               get_offset(fd) - section_pos);
+}
+
+static int valid_spectra(block_len_t* blk, uint64_t n_spectra, uint64_t* ends) {
+   if (ends[n_spectra - 1] != blk->original_size)
+      return 0;
+   for (uint64_t i = 1; i < n_spectra; i++)
+      if (ends[i] < ends[i - 1])
+         return 0;
+   return 1;
+}
+
+static void clear_spectrum_index(block_len_queue_t** queues, int n_queues) {
+   block_len_t* blk;
+
+   for (int i = 0; i < n_queues; i++)
+      for (blk = queues[i]->head; blk != NULL; blk = blk->next) {
+         free(blk->spectrum_ends);
+         blk->spectrum_ends = NULL;
+         blk->n_spectra = 0;
+      }
+}
+
+int read_spectrum_index(void* input_map, long filesize,
+                        block_len_queue_t** queues, int n_queues)
+/**
+ * @brief Reads the spectrum index section written by write_spectrum_index()
+ * into the blocks of queues. Files without the section (or with an index not
+ * matching the blocks) are extracted by transforming whole blocks.
+ *
+ * @param queues Binary block queues read by read_block_len_queue().
+ *
+ * @return 0 on success or if the file has no spectrum index, 1 on error.
+ */
+{
+   sections_t* sections;
+   section_t* section;
+   block_len_t* blk;
+   char *ptr, *end;
+   uint64_t n, n_spectra, j;
+   int i, valid = 1;
+
+   sections = read_sections(input_map, filesize);
+   if (sections == NULL)
+      return 0;
+
+   section = find_section(sections, SPECTRUM_SECTION);
+   if (section == NULL) {
+      dealloc_sections(sections);
+      return 0;
+   }
+
+   ptr = (char*)input_map + section->pos;
+   end = ptr + section->len;
+   dealloc_sections(sections);
+
+   for (i = 0; i < n_queues && valid; i++) {
+      valid = ptr + sizeof(uint64_t) <= end;
+      if (!valid)
+         break;
+      memcpy(&n, ptr, sizeof(uint64_t));
+      ptr += sizeof(uint64_t);
+
+      for (j = 0; j < n && valid; j++) {
+         valid = ptr + sizeof(uint64_t) <= end;
+         if (!valid)
+            break;
+         memcpy(&n_spectra, ptr, sizeof(uint64_t));
+         ptr += sizeof(uint64_t);
+
+         blk = get_block_by_index(queues[i], j);
+         valid = blk != NULL && n_spectra <= UINT32_MAX &&
+                 ptr + n_spectra * sizeof(uint64_t) <= end;
+         if (!valid || n_spectra == 0)
+            continue;
+
+         blk->spectrum_ends = malloc(n_spectra * sizeof(uint64_t));
+         if (blk->spectrum_ends == NULL) {
+            error("read_spectrum_index: malloc failed\n");
+            clear_spectrum_index(queues, n_queues);
+            return 1;
+         }
+         memcpy(blk->spectrum_ends, ptr, n_spectra * sizeof(uint64_t));
+         ptr += n_spectra * sizeof(uint64_t);
+
+         valid = valid_spectra(blk, n_spectra, blk->spectrum_ends);
+         blk->n_spectra = n_spectra;
+      }
+   }
+
+   if (!valid) {
+      warning("read_spectrum_index: spectrum index does not match blocks, "
+              "ignoring.\n");
+      clear_spectrum_index(queues, n_queues);
+   }
+
+   return 0;
+}
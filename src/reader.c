@@ -0,0 +1,421 @@
+/**
+ * @file reader.c
+ * @author Chris Grams (chrisagrams@gmail.com)
+ * @brief Random access reader of msz files, safe for concurrent use. A reader
+ * owns the file mapping, footer, divisions, block tables and a block cache
+ * shared by every thread calling it. Each call borrows a ZSTD_DCtx from the
+ * reader's pool so threads never share a decompression context, and a block
+ * requested by several threads at once is decompressed a single time (see
+ * block_cache_lock_block()).
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright
+ *
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mscompress.h"
+
+struct msz_reader_t {
+   int fd;
+   char* input_map;
+   long input_filesize;
+
+   data_format_t* df;
+   footer_t* footer;
+   divisions_t* divisions;
+   long n_spectra;
+   block_len_queue_t* xml_block_lens;
+   block_len_queue_t* mz_binary_block_lens;
+   block_len_queue_t* inten_binary_block_lens;
+   block_cache_t* cache;
+   msz_index_t* index;  // NULL if the file has no secondary indexes.
+   int has_ret_times;
+   metadata_t* metadata;  // NULL if the file has no metadata columns.
+   chromatograms_t* chrom;  // NULL if chromatograms are stored as XML.
+
+   ZSTD_DCtx** dctx_pool;  // Contexts not borrowed by a thread.
+   int n_dctx;
+   int max_dctx;
+
+#ifdef _WIN32
+   CRITICAL_SECTION lock;  // Protects dctx_pool.
+#else
+   pthread_mutex_t lock;
+#endif
+};
+
+#ifdef _WIN32
+static void reader_lock(msz_reader_t* r) { EnterCriticalSection(&r->lock); }
+static void reader_unlock(msz_reader_t* r) { LeaveCriticalSection(&r->lock); }
+#else
+static void reader_lock(msz_reader_t* r) { pthread_mutex_lock(&r->lock); }
+static void reader_unlock(msz_reader_t* r) { pthread_mutex_unlock(&r->lock); }
+#endif
+
+static ZSTD_DCtx* borrow_dctx(msz_reader_t* reader) {
+   ZSTD_DCtx* r = NULL;
+
+   reader_lock(reader);
+   if (reader->n_dctx > 0)
+      r = reader->dctx_pool[--reader->n_dctx];
+   reader_unlock(reader);
+
+   if (r == NULL)
+      r = alloc_dctx();
+   return r;
+}
+
+static void return_dctx(msz_reader_t* reader, ZSTD_DCtx* dctx) {
+   ZSTD_DCtx** pool;
+
+   if (dctx == NULL)
+      return;
+
+   reader_lock(reader);
+   if (reader->n_dctx == reader->max_dctx) {
+      pool = realloc(reader->dctx_pool,
+                     (reader->max_dctx * 2 + 1) * sizeof(ZSTD_DCtx*));
+      if (pool == NULL) {
+         reader_unlock(reader);
+         ZSTD_freeDCtx(dctx);
+         return;
+      }
+      reader->dctx_pool = pool;
+      reader->max_dctx = reader->max_dctx * 2 + 1;
+   }
+   reader->dctx_pool[reader->n_dctx++] = dctx;
+   reader_unlock(reader);
+}
+
+msz_reader_t* open_msz_reader(char* path, long cache_size)
+/**
+ * @brief Opens an msz file for random access.
+ *
+ * @param path Path of the msz file.
+ *
+ * @param cache_size Bytes of decompressed blocks kept by the reader, 0 for no
+ * limit.
+ *
+ * @return A msz_reader_t on success, NULL on error.
+ */
+{
+   msz_reader_t* r;
+   int n_divisions;
+
+   r = calloc(1, sizeof(msz_reader_t));
+   if (r == NULL) {
+      error("open_msz_reader: malloc failure.\n");
+      return NULL;
+   }
+#ifdef _WIN32
+   InitializeCriticalSection(&r->lock);
+#else
+   pthread_mutex_init(&r->lock, NULL);
+#endif
+
+   r->fd = open_input_file(path);
+   if (r->fd < 0) {
+      close_msz_reader(r);
+      return NULL;
+   }
+   r->input_filesize = get_filesize(path);
+   r->input_map = get_mapping(r->fd);
+   if (r->input_map == NULL || !is_msz(r->input_map, r->input_filesize)) {
+      error("open_msz_reader: %s is not an msz file.\n", path);
+      close_msz_reader(r);
+      return NULL;
+   }
+   if (check_format_version(r->input_map)) {
+      close_msz_reader(r);
+      return NULL;
+   }
+
+   r->df = get_header_df(r->input_map);
+   parse_footer(&r->footer, r->input_map, r->input_filesize,
+                &r->xml_block_lens, &r->mz_binary_block_lens,
+                &r->inten_binary_block_lens, &r->divisions, &n_divisions);
+   if (r->df == NULL || r->divisions == NULL) {
+      error("open_msz_reader: Failed to read %s.\n", path);
+      close_msz_reader(r);
+      return NULL;
+   }
+   set_decompress_runtime_variables(r->df, r->footer);
+
+   // The footer holds the spectra announced by the mzML, count those stored.
+   for (int i = 0; i < n_divisions; i++)
+      r->n_spectra += r->divisions->divisions[i]->mz->total_spec;
+
+   r->cache = alloc_block_cache(cache_size);
+   if (r->cache == NULL) {
+      close_msz_reader(r);
+      return NULL;
+   }
+   r->xml_block_lens->cache = r->cache;
+   r->mz_binary_block_lens->cache = r->cache;
+   r->inten_binary_block_lens->cache = r->cache;
+
+   if (read_chromatograms(r->input_map, r->input_filesize, &r->chrom)) {
+      error("open_msz_reader: Failed to read chromatograms of %s.\n", path);
+      close_msz_reader(r);
+      return NULL;
+   }
+   if (r->chrom != NULL)
+      set_decompress_runtime_variables(r->chrom->df, r->chrom->footer);
+
+   r->index = read_secondary_indexes(r->input_map, r->input_filesize);
+   r->metadata = read_metadata(r->input_map, r->input_filesize);
+
+   // Read every retention time up front so lookups never modify the
+   // divisions shared by the calling threads.
+   float all[2] = {-INFINITY, INFINITY};
+   r->has_ret_times = read_ret_times(r->input_map, r->input_filesize,
+                                     r->divisions, all) >= 0;
+
+   return r;
+}
+
+void close_msz_reader(msz_reader_t* reader)
+/**
+ * @brief Frees a reader and everything it owns. No call on the reader may be
+ * in progress.
+ */
+{
+   if (reader == NULL)
+      return;
+
+   // Blocks are detached from the cache as their queues are freed.
+   dealloc_block_len_queue(reader->xml_block_lens);
+   dealloc_block_len_queue(reader->mz_binary_block_lens);
+   dealloc_block_len_queue(reader->inten_binary_block_lens);
+   dealloc_block_cache(reader->cache);
+   dealloc_secondary_indexes(reader->index);
+   dealloc_metadata(reader->metadata);
+   dealloc_read_chromatograms(reader->chrom);
+
+   for (int i = 0; i < reader->n_dctx; i++)
+      ZSTD_freeDCtx(reader->dctx_pool[i]);
+   free(reader->dctx_pool);
+
+   dealloc_read_divisions(reader->divisions);
+   free(reader->df);
+   if (reader->input_map != NULL)
+      remove_mapping(reader->input_map, reader->input_filesize);
+   close_file(reader->fd);
+
+#ifdef _WIN32
+   DeleteCriticalSection(&reader->lock);
+#else
+   pthread_mutex_destroy(&reader->lock);
+#endif
+   free(reader);
+}
+
+long msz_reader_num_spectra(msz_reader_t* reader) {
+   return reader->n_spectra;
+}
+
+block_cache_t* msz_reader_cache(msz_reader_t* reader) {
+   return reader->cache;
+}
+
+data_format_t* msz_reader_df(msz_reader_t* reader) {
+   return reader->df;
+}
+
+float msz_reader_ret_time(msz_reader_t* reader, long index)
+/**
+ * @brief Returns the retention time of a spectrum in minutes, NAN if the msz
+ * file has no retention times or index is out of range.
+ */
+{
+   long local_index;
+   int division;
+
+   if (!reader->has_ret_times)
+      return NAN;
+   division = find_division(reader->divisions, index, &local_index);
+   if (division < 0 || reader->divisions->divisions[division]->ret_times == NULL)
+      return NAN;
+   return reader->divisions->divisions[division]->ret_times[local_index];
+}
+
+long* msz_reader_ms_level(msz_reader_t* reader, uint16_t ms_level,
+                          long* indices_length)
+/**
+ * @brief Maps an MS level to the indices of its spectra, from the MS level
+ * index if the file has one.
+ *
+ * @return Sorted spectrum indices (to be freed by the caller), NULL if no
+ * spectrum matches or on error.
+ */
+{
+   long* r;
+
+   *indices_length = 0;
+   r = query_ms_level_index(reader->index, ms_level, indices_length);
+   if (r == NULL)
+      r = map_ms_level_to_index_from_divisions(ms_level, reader->divisions,
+                                               indices_length);
+   return r;
+}
+
+void* msz_reader_metadata_column(msz_reader_t* reader, int column)
+/**
+ * @brief Returns a metadata column of the msz file (see get_metadata_column()).
+ * The column is decompressed under the reader's lock on first access.
+ *
+ * @return An array of one value per spectrum, NULL if the file does not hold
+ * the column or on error.
+ */
+{
+   void* r;
+
+   if (reader->metadata == NULL ||
+       reader->metadata->n_spectra != reader->n_spectra)
+      return NULL;
+
+   reader_lock(reader);
+   r = get_metadata_column(reader->metadata, column);
+   reader_unlock(reader);
+   return r;
+}
+
+long msz_reader_num_chromatograms(msz_reader_t* reader)
+/**
+ * @brief Returns the number of chromatograms whose arrays are stored outside
+ * of the XML, 0 if the file stores them as XML.
+ */
+{
+   if (reader->chrom == NULL)
+      return 0;
+   return reader->chrom->division->mz->total_spec;
+}
+
+data_format_t* msz_reader_chromatogram_df(msz_reader_t* reader)
+/**
+ * @brief Returns the data format of the chromatogram arrays, NULL if the file
+ * stores them as XML.
+ */
+{
+   return reader->chrom != NULL ? reader->chrom->df : NULL;
+}
+
+char* msz_reader_get_chromatogram(msz_reader_t* reader, int type, long index,
+                                  size_t* out_len)
+/**
+ * @brief Extracts the decoded time (type `_time_`) or intensity (type
+ * `_intensity_`) array of a chromatogram, in the source data format, without
+ * decompressing any XML. Safe to call from several threads at once.
+ *
+ * @return The array (to be freed by the caller) on success, NULL on error.
+ */
+{
+   ZSTD_DCtx* dctx;
+   char* r;
+
+   if (index < 0 || index >= msz_reader_num_chromatograms(reader)) {
+      error("msz_reader_get_chromatogram: index %ld out of range.\n", index);
+      return NULL;
+   }
+
+   dctx = borrow_dctx(reader);
+   if (dctx == NULL)
+      return NULL;
+
+   // Chromatogram blocks are decoded once and kept by their block_len_t
+   // rather than the block cache, so extraction runs under the lock.
+   reader_lock(reader);
+   r = extract_chromatogram_binary(reader->input_map, dctx, reader->chrom, type,
+                                   index, out_len, 0);
+   reader_unlock(reader);
+
+   return_dctx(reader, dctx);
+   return r;
+}
+
+char* msz_reader_get_spectrum(msz_reader_t* reader, long index,
+                              size_t* out_len)
+/**
+ * @brief Extracts the <spectrum> element of a spectrum. Safe to call from
+ * several threads at once.
+ *
+ * @param index The index of the spectrum.
+ *
+ * @param out_len A pointer to a `size_t` where the length of the spectrum will
+ * be stored.
+ *
+ * @return The spectrum XML (to be freed by the caller) on success, NULL on
+ * error.
+ */
+{
+   ZSTD_DCtx* dctx;
+   char* r;
+
+   if (index < 0 || index >= reader->n_spectra) {
+      error("msz_reader_get_spectrum: index %ld out of range.\n", index);
+      return NULL;
+   }
+
+   dctx = borrow_dctx(reader);
+   if (dctx == NULL)
+      return NULL;
+
+   *out_len = 0;  // extract_spectra() appends to *out_len.
+   r = extract_spectra(reader->input_map, dctx, reader->df,
+                       reader->xml_block_lens, reader->mz_binary_block_lens,
+                       reader->inten_binary_block_lens,
+                       reader->footer->xml_pos, reader->footer->mz_binary_pos,
+                       reader->footer->inten_binary_pos,
+                       reader->footer->mz_fmt, reader->footer->inten_fmt,
+                       reader->divisions, index, out_len);
+
+   return_dctx(reader, dctx);
+   return r;
+}
+
+char* msz_reader_get_binary(msz_reader_t* reader, int type, long index,
+                            size_t* out_len)
+/**
+ * @brief Extracts the decoded m/z (type `_mass_`) or intensity (type
+ * `_intensity_`) array of a spectrum, in the source data format. Safe to call
+ * from several threads at once.
+ *
+ * @return The array (to be freed by the caller) on success, NULL on error.
+ */
+{
+   ZSTD_DCtx* dctx;
+   char* r;
+
+   if (index < 0 || index >= reader->n_spectra) {
+      error("msz_reader_get_binary: index %ld out of range.\n", index);
+      return NULL;
+   }
+
+   dctx = borrow_dctx(reader);
+   if (dctx == NULL)
+      return NULL;
+
+   if (type == _mass_)
+      r = extract_spectrum_mz(reader->input_map, dctx, reader->df,
+                              reader->mz_binary_block_lens,
+                              reader->footer->mz_binary_pos, reader->divisions,
+                              index, out_len, 0);
+   else
+      r = extract_spectrum_inten(reader->input_map, dctx, reader->df,
+                                 reader->inten_binary_block_lens,
+                                 reader->footer->inten_binary_pos,
+                                 reader->divisions, index, out_len, 0);
+
+   return_dctx(reader, dctx);
+   return r;
+}
@@ -0,0 +1,911 @@
+/**
+ * @file simd.c
+ * @author Chris Grams (chrisagrams@gmail.com)
+ * @brief Vector kernels of the lossy transforms and of substring search with
+ * runtime dispatch between SSE2, AVX2 and AVX-512 (x86-64), and a scalar
+ * fallback elsewhere. The kernels of one instruction set are selected once,
+ * from the CPU features or the --cpu option (see set_simd_level()). Kernels
+ * are bit-identical to the scalar transforms: lanes outside the range where
+ * the vector instructions agree with the scalar code are handed back to it.
+ * The inverse log2 transform maps 16-bit values, so it is served from tables
+ * of the libm results instead.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright
+ *
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mscompress.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SIMD_TARGET(x)
+#define SIMD_INLINE __forceinline
+#else
+#define SIMD_TARGET(x) __attribute__((target(x)))
+#define SIMD_INLINE inline __attribute__((always_inline))
+#endif
+#endif
+
+/* Kernels of one instruction set. A kernel handles `lanes` values per call
+ * and hands them back to the scalar code if it returns -1. */
+typedef struct {
+   int level;
+   long lanes;
+   int (*delta_32f)(const float*, long, float, float, int32_t*);
+   int (*delta_64d)(const double*, long, float, float, int32_t*);
+   int (*log2_32f)(const float*, long, double, int32_t*);
+   int (*log2_64d)(const double*, long, double, int32_t*);
+   const char* (*find)(const char*, const char*, const char*, size_t);
+} simd_kernels_t;
+
+static const simd_kernels_t* get_simd_kernels();
+
+static int detect_simd_level() {
+#if defined(SIMD_X86) && defined(_MSC_VER)
+   int info[4];
+   unsigned long long xcr0;
+
+   __cpuid(info, 1);
+   if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)))  // OSXSAVE, AVX
+      return SIMD_SSE2;
+   xcr0 = _xgetbv(0);
+   if ((xcr0 & 0x6) != 0x6)
+      return SIMD_SSE2;
+   __cpuidex(info, 7, 0);
+   if ((info[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6)  // AVX512F
+      return SIMD_AVX512;
+   if (info[1] & (1 << 5))  // AVX2
+      return SIMD_AVX2;
+   return SIMD_SSE2;
+#elif defined(SIMD_X86)
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx512f"))
+      return SIMD_AVX512;
+   if (__builtin_cpu_supports("avx2"))
+      return SIMD_AVX2;
+   return SIMD_SSE2;
+#else
+   return SIMD_SCALAR;
+#endif
+}
+
+const char* get_simd_level_name(int level) {
+   switch (level) {
+      case SIMD_SSE2:
+         return "sse2";
+      case SIMD_AVX2:
+         return "avx2";
+      case SIMD_AVX512:
+         return "avx512";
+      default:
+         return "scalar";
+   }
+}
+
+/*
+    @section Delta quantization
+*/
+
+static uint32_t quantize_scalar(float p, int mode)
+/**
+ * @brief Quantizes a scaled delta exactly as the scalar delta transforms of
+ * algo.c always have, out-of-range values included.
+ */
+{
+   switch (mode) {
+      case DELTA_WRAP16:
+         return (uint16_t)floor(p);
+      case DELTA_CLIP16:
+         if (p > UINT16_MAX)
+            return UINT16_MAX;
+         return (uint16_t)floor(p);
+      case DELTA_CLIP24:
+         if (floor(p) > 16777215)  // UINT24 max
+            return 16777215;
+         return (uint32_t)floor(p);
+      default:
+         return (uint32_t)floor(p);
+   }
+}
+
+static float quantize_limit(int mode) {
+   // Deltas in [0, limit) are truncated by the vector conversion exactly as
+   // floor() and the integer cast of quantize_scalar() round them.
+   switch (mode) {
+      case DELTA_WRAP16:
+      case DELTA_CLIP16:
+         return 65536.0f;
+      case DELTA_CLIP24:
+         return 16777216.0f;
+      default:
+         return 2147483648.0f;
+   }
+}
+
+static void store_delta(void* dest, long i, uint32_t q, int mode) {
+   uint8_t* d;
+
+   switch (mode) {
+      case DELTA_WRAP16:
+      case DELTA_CLIP16:
+         ((uint16_t*)dest)[i] = (uint16_t)q;
+         break;
+      case DELTA_CLIP24:
+         d = (uint8_t*)dest + i * 3;
+         d[0] = (q >> 16) & 0xFF;
+         d[1] = (q >> 8) & 0xFF;
+         d[2] = q & 0xFF;
+         break;
+      default:
+         memcpy((uint32_t*)dest + i, &q, sizeof(uint32_t));
+         break;
+   }
+}
+
+static void store_deltas(void* dest, long i, const int32_t* q, long n,
+                         int mode) {
+   if (mode == DELTA_WRAP32) {
+      memcpy((uint32_t*)dest + i, q, n * sizeof(uint32_t));
+      return;
+   }
+   for (long j = 0; j < n; j++) store_delta(dest, i + j, (uint32_t)q[j], mode);
+}
+
+#ifdef SIMD_X86
+
+/* Each kernel quantizes deltas [i, i + lanes) of f (delta k is f[k + 1] - f[k])
+ * and returns 0, or returns -1 without storing anything if a lane is out of
+ * range. */
+
+SIMD_TARGET("sse2")
+static int quantize_sse2_32f(const float* f, long i, float scale, float limit,
+                             int32_t* q) {
+   __m128 d = _mm_sub_ps(_mm_loadu_ps(f + i + 1), _mm_loadu_ps(f + i));
+   __m128 p = _mm_mul_ps(d, _mm_set1_ps(scale));
+   __m128 ok = _mm_and_ps(_mm_cmpge_ps(p, _mm_setzero_ps()),
+                          _mm_cmplt_ps(p, _mm_set1_ps(limit)));
+   if (_mm_movemask_ps(ok) != 0xF)
+      return -1;
+   _mm_storeu_si128((__m128i*)q, _mm_cvttps_epi32(p));
+   return 0;
+}
+
+SIMD_TARGET("sse2")
+static int quantize_sse2_64d(const double* f, long i, float scale,
+                             float limit, int32_t* q) {
+   __m128 lo = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(f + i + 1),
+                                       _mm_loadu_pd(f + i)));
+   __m128 hi = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(f + i + 3),
+                                       _mm_loadu_pd(f + i + 2)));
+   __m128 p = _mm_mul_ps(_mm_movelh_ps(lo, hi), _mm_set1_ps(scale));
+   __m128 ok = _mm_and_ps(_mm_cmpge_ps(p, _mm_setzero_ps()),
+                          _mm_cmplt_ps(p, _mm_set1_ps(limit)));
+   if (_mm_movemask_ps(ok) != 0xF)
+      return -1;
+   _mm_storeu_si128((__m128i*)q, _mm_cvttps_epi32(p));
+   return 0;
+}
+
+SIMD_TARGET("avx2")
+static int quantize_avx2_32f(const float* f, long i, float scale, float limit,
+                             int32_t* q) {
+   __m256 d = _mm256_sub_ps(_mm256_loadu_ps(f + i + 1), _mm256_loadu_ps(f + i));
+   __m256 p = _mm256_mul_ps(d, _mm256_set1_ps(scale));
+   __m256 ok = _mm256_and_ps(
+       _mm256_cmp_ps(p, _mm256_setzero_ps(), _CMP_GE_OQ),
+       _mm256_cmp_ps(p, _mm256_set1_ps(limit), _CMP_LT_OQ));
+   if (_mm256_movemask_ps(ok) != 0xFF)
+      return -1;
+   _mm256_storeu_si256((__m256i*)q, _mm256_cvttps_epi32(p));
+   return 0;
+}
+
+SIMD_TARGET("avx2")
+static int quantize_avx2_64d(const double* f, long i, float scale,
+                             float limit, int32_t* q) {
+   __m128 lo = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(f + i + 1),
+                                             _mm256_loadu_pd(f + i)));
+   __m128 hi = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_loadu_pd(f + i + 5),
+                                             _mm256_loadu_pd(f + i + 4)));
+   __m256 p = _mm256_mul_ps(_mm256_set_m128(hi, lo), _mm256_set1_ps(scale));
+   __m256 ok = _mm256_and_ps(
+       _mm256_cmp_ps(p, _mm256_setzero_ps(), _CMP_GE_OQ),
+       _mm256_cmp_ps(p, _mm256_set1_ps(limit), _CMP_LT_OQ));
+   if (_mm256_movemask_ps(ok) != 0xFF)
+      return -1;
+   _mm256_storeu_si256((__m256i*)q, _mm256_cvttps_epi32(p));
+   return 0;
+}
+
+SIMD_TARGET("avx512f")
+static int quantize_avx512_32f(const float* f, long i, float scale,
+                               float limit, int32_t* q) {
+   __m512 d = _mm512_sub_ps(_mm512_loadu_ps(f + i + 1), _mm512_loadu_ps(f + i));
+   __m512 p = _mm512_mul_ps(d, _mm512_set1_ps(scale));
+   __mmask16 ok =
+       _mm512_cmp_ps_mask(p, _mm512_setzero_ps(), _CMP_GE_OQ) &
+       _mm512_cmp_ps_mask(p, _mm512_set1_ps(limit), _CMP_LT_OQ);
+   if (ok != 0xFFFF)
+      return -1;
+   _mm512_storeu_si512((void*)q, _mm512_cvttps_epi32(p));
+   return 0;
+}
+
+SIMD_TARGET("avx512f")
+static int quantize_avx512_64d(const double* f, long i, float scale,
+                               float limit, int32_t* q) {
+   __m256 lo = _mm512_cvtpd_ps(_mm512_sub_pd(_mm512_loadu_pd(f + i + 1),
+                                             _mm512_loadu_pd(f + i)));
+   __m256 hi = _mm512_cvtpd_ps(_mm512_sub_pd(_mm512_loadu_pd(f + i + 9),
+                                             _mm512_loadu_pd(f + i + 8)));
+   __m512 p = _mm512_mul_ps(
+       _mm512_castpd_ps(_mm512_insertf64x4(
+           _mm512_castpd256_pd512(_mm256_castps_pd(lo)), _mm256_castps_pd(hi),
+           1)),
+       _mm512_set1_ps(scale));
+   __mmask16 ok =
+       _mm512_cmp_ps_mask(p, _mm512_setzero_ps(), _CMP_GE_OQ) &
+       _mm512_cmp_ps_mask(p, _mm512_set1_ps(limit), _CMP_LT_OQ);
+   if (ok != 0xFFFF)
+      return -1;
+   _mm512_storeu_si512((void*)q, _mm512_cvttps_epi32(p));
+   return 0;
+}
+
+#endif /* SIMD_X86 */
+
+void delta_quantize_32f(const float* f, long len, float scale, int mode,
+                        void* dest)
+/**
+ * @brief Quantizes the len - 1 deltas of f: delta i is
+ * floor((f[i + 1] - f[i]) * scale), stored in dest as uint16_t (DELTA_WRAP16,
+ * DELTA_CLIP16), 24-bit big-endian (DELTA_CLIP24) or uint32_t (DELTA_WRAP32).
+ *
+ * @param f Source array.
+ *
+ * @param len Length of f.
+ *
+ * @param scale Scale factor of the deltas.
+ *
+ * @param mode How deltas out of the destination range are stored (see
+ * quantize_scalar()).
+ *
+ * @param dest Destination of the len - 1 deltas.
+ */
+{
+   long i = 0, n = len - 1;
+#ifdef SIMD_X86
+   const simd_kernels_t* k = get_simd_kernels();
+   int (*kernel)(const float*, long, float, float, int32_t*) = k->delta_32f;
+   float limit = quantize_limit(mode);
+   int32_t q[16];
+   long lanes = k->lanes;
+
+   for (; kernel != NULL && i + lanes <= n; i += lanes) {
+      if (kernel(f, i, scale, limit, q) == 0)
+         store_deltas(dest, i, q, lanes, mode);
+      else
+         for (long j = i; j < i + lanes; j++) {
+            float diff = f[j + 1] - f[j];
+            store_delta(dest, j, quantize_scalar(diff * scale, mode), mode);
+         }
+   }
+#endif
+   for (; i < n; i++) {
+      float diff = f[i + 1] - f[i];
+      store_delta(dest, i, quantize_scalar(diff * scale, mode), mode);
+   }
+}
+
+void delta_quantize_64d(const double* f, long len, float scale, int mode,
+                        void* dest)
+/**
+ * @brief delta_quantize_32f() of a double array. Deltas are rounded to float
+ * before scaling, as the 64-bit delta transforms always did.
+ */
+{
+   long i = 0, n = len - 1;
+#ifdef SIMD_X86
+   const simd_kernels_t* k = get_simd_kernels();
+   int (*kernel)(const double*, long, float, float, int32_t*) = k->delta_64d;
+   float limit = quantize_limit(mode);
+   int32_t q[16];
+   long lanes = k->lanes;
+
+   for (; kernel != NULL && i + lanes <= n; i += lanes) {
+      if (kernel(f, i, scale, limit, q) == 0)
+         store_deltas(dest, i, q, lanes, mode);
+      else
+         for (long j = i; j < i + lanes; j++) {
+            float diff = f[j + 1] - f[j];
+            store_delta(dest, j, quantize_scalar(diff * scale, mode), mode);
+         }
+   }
+#endif
+   for (; i < n; i++) {
+      float diff = f[i + 1] - f[i];
+      store_delta(dest, i, quantize_scalar(diff * scale, mode), mode);
+   }
+}
+
+/*
+    @section Log2 transform
+*/
+
+static uint16_t log2_scalar(double x, double scale)
+/**
+ * @brief Quantizes log2(x) exactly as the scalar log2 transforms of algo.c
+ * always have (x is the value plus one).
+ */
+{
+   return floor(log2(x) * scale);
+}
+
+/* log2(x) = e + log2(m) with x = m * 2^e and m in [sqrt(1/2), sqrt(2)), and
+ * ln(m) = 2 * atanh(t) = 2 * (t + t^3 / 3 + t^5 / 5 + ...) with
+ * t = (m - 1) / (m + 1), |t| < 0.1716. Eight terms keep the absolute error of
+ * the approximation under 1e-13. */
+#define LOG2_C0 1.0
+#define LOG2_C1 (1.0 / 3)
+#define LOG2_C2 (1.0 / 5)
+#define LOG2_C3 (1.0 / 7)
+#define LOG2_C4 (1.0 / 9)
+#define LOG2_C5 (1.0 / 11)
+#define LOG2_C6 (1.0 / 13)
+#define LOG2_C7 (1.0 / 15)
+#define LOG2_2_LN2 2.8853900817779268  // 2 / ln(2)
+
+/* Relative guard band around the approximation of log2(x) * scale. A lane
+ * whose guard band contains an integer could floor to a different value than
+ * libm and is handed back to log2_scalar(). */
+#define LOG2_GUARD 1e-10
+
+#ifdef SIMD_X86
+
+/* Each kernel quantizes values [i, i + lanes) of f and returns 0, or returns
+ * -1 without storing anything if a lane is out of range or too close to a
+ * quantization step. The helpers taking vector arguments are inlined into
+ * the kernels, whose exits clear the upper vector state before returning to
+ * SSE code (libm). */
+
+SIMD_TARGET("sse2")
+static SIMD_INLINE int log2_sse2(__m128d x, double scale, int32_t* q) {
+   const __m128i mant_mask = _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+   const __m128i one_bits = _mm_set1_epi64x(0x3FF0000000000000LL);
+   const __m128i magic_bits = _mm_set1_epi64x(0x4330000000000000LL);
+   const __m128d one = _mm_set1_pd(1.0);
+   __m128i bits = _mm_castpd_si128(x);
+   __m128d e = _mm_sub_pd(
+       _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(bits, 52), magic_bits)),
+       _mm_set1_pd(4503599627370496.0 + 1023));  // 2^52 + exponent bias
+   __m128d m = _mm_castsi128_pd(
+       _mm_or_si128(_mm_and_si128(bits, mant_mask), one_bits));
+   __m128d big = _mm_cmpgt_pd(m, _mm_set1_pd(1.4142135623730951));
+   m = _mm_or_pd(_mm_andnot_pd(big, m),
+                 _mm_and_pd(big, _mm_mul_pd(m, _mm_set1_pd(0.5))));
+   e = _mm_add_pd(e, _mm_and_pd(big, one));
+
+   __m128d t = _mm_div_pd(_mm_sub_pd(m, one), _mm_add_pd(m, one));
+   __m128d t2 = _mm_mul_pd(t, t);
+   __m128d p = _mm_set1_pd(LOG2_C7);
+   p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(LOG2_C6));
+   p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(LOG2_C5));
+   p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(LOG2_C4));
+   p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(LOG2_C3));
+   p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(LOG2_C2));
+   p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(LOG2_C1));
+   p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(LOG2_C0));
+   __m128d l = _mm_add_pd(e, _mm_mul_pd(_mm_mul_pd(t, p),
+                                        _mm_set1_pd(LOG2_2_LN2)));
+   __m128d y = _mm_mul_pd(l, _mm_set1_pd(scale));
+
+   // m == 1 is exact (powers of two, zero intensities): no guard band.
+   __m128d guard = _mm_and_pd(
+       _mm_cmpneq_pd(t, _mm_setzero_pd()),
+       _mm_mul_pd(_mm_add_pd(_mm_andnot_pd(_mm_set1_pd(-0.0), y),
+                             _mm_set1_pd(fabs(scale))),
+                  _mm_set1_pd(LOG2_GUARD)));
+   __m128d lo = _mm_sub_pd(y, guard);
+   __m128d hi = _mm_add_pd(y, guard);
+   __m128d ok = _mm_and_pd(
+       _mm_and_pd(_mm_cmpge_pd(x, _mm_set1_pd(2.2250738585072014e-308)),
+                  _mm_cmple_pd(x, _mm_set1_pd(1.7976931348623157e308))),
+       _mm_and_pd(_mm_cmpge_pd(lo, _mm_setzero_pd()),
+                  _mm_cmplt_pd(hi, _mm_set1_pd(65536.0))));
+   if (_mm_movemask_pd(ok) != 0x3)
+      return -1;
+   __m128i qlo = _mm_cvttpd_epi32(lo);
+   if (_mm_movemask_epi8(_mm_cmpeq_epi32(qlo, _mm_cvttpd_epi32(hi))) != 0xFFFF)
+      return -1;
+   _mm_storel_epi64((__m128i*)q, qlo);
+   return 0;
+}
+
+SIMD_TARGET("sse2")
+static int log2_sse2_32f(const float* f, long i, double scale, int32_t* q) {
+   __m128 x = _mm_add_ps(_mm_loadu_ps(f + i), _mm_set1_ps(1.0f));
+   if (log2_sse2(_mm_cvtps_pd(x), scale, q) != 0)
+      return -1;
+   return log2_sse2(_mm_cvtps_pd(_mm_movehl_ps(x, x)), scale, q + 2);
+}
+
+SIMD_TARGET("sse2")
+static int log2_sse2_64d(const double* f, long i, double scale, int32_t* q) {
+   const __m128d one = _mm_set1_pd(1.0);
+   if (log2_sse2(_mm_add_pd(_mm_loadu_pd(f + i), one), scale, q) != 0)
+      return -1;
+   return log2_sse2(_mm_add_pd(_mm_loadu_pd(f + i + 2), one), scale, q + 2);
+}
+
+SIMD_TARGET("avx2")
+static SIMD_INLINE int log2_avx2(__m256d x, double scale, int32_t* q) {
+   const __m256i mant_mask = _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+   const __m256i one_bits = _mm256_set1_epi64x(0x3FF0000000000000LL);
+   const __m256i magic_bits = _mm256_set1_epi64x(0x4330000000000000LL);
+   const __m256d one = _mm256_set1_pd(1.0);
+   __m256i bits = _mm256_castpd_si256(x);
+   __m256d e = _mm256_sub_pd(
+       _mm256_castsi256_pd(
+           _mm256_or_si256(_mm256_srli_epi64(bits, 52), magic_bits)),
+       _mm256_set1_pd(4503599627370496.0 + 1023));  // 2^52 + exponent bias
+   __m256d m = _mm256_castsi256_pd(
+       _mm256_or_si256(_mm256_and_si256(bits, mant_mask), one_bits));
+   __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(1.4142135623730951), _CMP_GT_OQ);
+   m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+   e = _mm256_add_pd(e, _mm256_and_pd(big, one));
+
+   __m256d t = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+   __m256d t2 = _mm256_mul_pd(t, t);
+   __m256d p = _mm256_set1_pd(LOG2_C7);
+   p = _mm256_add_pd(_mm256_mul_pd(p, t2), _mm256_set1_pd(LOG2_C6));
+   p = _mm256_add_pd(_mm256_mul_pd(p, t2), _mm256_set1_pd(LOG2_C5));
+   p = _mm256_add_pd(_mm256_mul_pd(p, t2), _mm256_set1_pd(LOG2_C4));
+   p = _mm256_add_pd(_mm256_mul_pd(p, t2), _mm256_set1_pd(LOG2_C3));
+   p = _mm256_add_pd(_mm256_mul_pd(p, t2), _mm256_set1_pd(LOG2_C2));
+   p = _mm256_add_pd(_mm256_mul_pd(p, t2), _mm256_set1_pd(LOG2_C1));
+   p = _mm256_add_pd(_mm256_mul_pd(p, t2), _mm256_set1_pd(LOG2_C0));
+   __m256d l = _mm256_add_pd(
+       e, _mm256_mul_pd(_mm256_mul_pd(t, p), _mm256_set1_pd(LOG2_2_LN2)));
+   __m256d y = _mm256_mul_pd(l, _mm256_set1_pd(scale));
+
+   // m == 1 is exact (powers of two, zero intensities): no guard band.
+   __m256d guard = _mm256_and_pd(
+       _mm256_cmp_pd(t, _mm256_setzero_pd(), _CMP_NEQ_OQ),
+       _mm256_mul_pd(_mm256_add_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), y),
+                                   _mm256_set1_pd(fabs(scale))),
+                     _mm256_set1_pd(LOG2_GUARD)));
+   __m256d lo = _mm256_sub_pd(y, guard);
+   __m256d hi = _mm256_add_pd(y, guard);
+   __m256d ok = _mm256_and_pd(
+       _mm256_and_pd(
+           _mm256_cmp_pd(x, _mm256_set1_pd(2.2250738585072014e-308),
+                         _CMP_GE_OQ),
+           _mm256_cmp_pd(x, _mm256_set1_pd(1.7976931348623157e308),
+                         _CMP_LE_OQ)),
+       _mm256_and_pd(_mm256_cmp_pd(lo, _mm256_setzero_pd(), _CMP_GE_OQ),
+                     _mm256_cmp_pd(hi, _mm256_set1_pd(65536.0), _CMP_LT_OQ)));
+   if (_mm256_movemask_pd(ok) != 0xF)
+      return -1;
+   __m128i qlo = _mm256_cvttpd_epi32(lo);
+   if (_mm_movemask_epi8(_mm_cmpeq_epi32(qlo, _mm256_cvttpd_epi32(hi))) !=
+       0xFFFF)
+      return -1;
+   _mm_storeu_si128((__m128i*)q, qlo);
+   return 0;
+}
+
+SIMD_TARGET("avx2")
+static int log2_avx2_32f(const float* f, long i, double scale, int32_t* q) {
+   __m256 x = _mm256_add_ps(_mm256_loadu_ps(f + i), _mm256_set1_ps(1.0f));
+   if (log2_avx2(_mm256_cvtps_pd(_mm256_castps256_ps128(x)), scale, q) != 0)
+      return -1;
+   return log2_avx2(_mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)), scale,
+                    q + 4);
+}
+
+SIMD_TARGET("avx2")
+static int log2_avx2_64d(const double* f, long i, double scale, int32_t* q) {
+   const __m256d one = _mm256_set1_pd(1.0);
+   if (log2_avx2(_mm256_add_pd(_mm256_loadu_pd(f + i), one), scale, q) != 0)
+      return -1;
+   return log2_avx2(_mm256_add_pd(_mm256_loadu_pd(f + i + 4), one), scale,
+                    q + 4);
+}
+
+SIMD_TARGET("avx512f")
+static SIMD_INLINE int log2_avx512(__m512d x, double scale, int32_t* q) {
+   const __m512i mant_mask = _mm512_set1_epi64(0x000FFFFFFFFFFFFFLL);
+   const __m512i one_bits = _mm512_set1_epi64(0x3FF0000000000000LL);
+   const __m512i magic_bits = _mm512_set1_epi64(0x4330000000000000LL);
+   const __m512d one = _mm512_set1_pd(1.0);
+   __m512i bits = _mm512_castpd_si512(x);
+   __m512d e = _mm512_sub_pd(
+       _mm512_castsi512_pd(
+           _mm512_or_si512(_mm512_srli_epi64(bits, 52), magic_bits)),
+       _mm512_set1_pd(4503599627370496.0 + 1023));  // 2^52 + exponent bias
+   __m512d m = _mm512_castsi512_pd(
+       _mm512_or_si512(_mm512_and_si512(bits, mant_mask), one_bits));
+   __mmask8 big = _mm512_cmp_pd_mask(m, _mm512_set1_pd(1.4142135623730951), _CMP_GT_OQ);
+   m = _mm512_mask_mul_pd(m, big, m, _mm512_set1_pd(0.5));
+   e = _mm512_mask_add_pd(e, big, e, one);
+
+   __m512d t = _mm512_div_pd(_mm512_sub_pd(m, one), _mm512_add_pd(m, one));
+   __m512d t2 = _mm512_mul_pd(t, t);
+   __m512d p = _mm512_set1_pd(LOG2_C7);
+   p = _mm512_fmadd_pd(p, t2, _mm512_set1_pd(LOG2_C6));
+   p = _mm512_fmadd_pd(p, t2, _mm512_set1_pd(LOG2_C5));
+   p = _mm512_fmadd_pd(p, t2, _mm512_set1_pd(LOG2_C4));
+   p = _mm512_fmadd_pd(p, t2, _mm512_set1_pd(LOG2_C3));
+   p = _mm512_fmadd_pd(p, t2, _mm512_set1_pd(LOG2_C2));
+   p = _mm512_fmadd_pd(p, t2, _mm512_set1_pd(LOG2_C1));
+   p = _mm512_fmadd_pd(p, t2, _mm512_set1_pd(LOG2_C0));
+   __m512d l = _mm512_fmadd_pd(_mm512_mul_pd(t, p),
+                               _mm512_set1_pd(LOG2_2_LN2), e);
+   __m512d y = _mm512_mul_pd(l, _mm512_set1_pd(scale));
+
+   // m == 1 is exact (powers of two, zero intensities): no guard band.
+   __m512d guard = _mm512_maskz_mul_pd(
+       _mm512_cmp_pd_mask(t, _mm512_setzero_pd(), _CMP_NEQ_OQ),
+       _mm512_add_pd(_mm512_abs_pd(y), _mm512_set1_pd(fabs(scale))),
+       _mm512_set1_pd(LOG2_GUARD));
+   __m512d lo = _mm512_sub_pd(y, guard);
+   __m512d hi = _mm512_add_pd(y, guard);
+   __mmask8 ok =
+       _mm512_cmp_pd_mask(x, _mm512_set1_pd(2.2250738585072014e-308),
+                          _CMP_GE_OQ) &
+       _mm512_cmp_pd_mask(x, _mm512_set1_pd(1.7976931348623157e308),
+                          _CMP_LE_OQ) &
+       _mm512_cmp_pd_mask(lo, _mm512_setzero_pd(), _CMP_GE_OQ) &
+       _mm512_cmp_pd_mask(hi, _mm512_set1_pd(65536.0), _CMP_LT_OQ);
+   if (ok != 0xFF)
+      return -1;
+   __m256i qlo = _mm512_cvttpd_epi32(lo);
+   if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(
+           qlo, _mm512_cvttpd_epi32(hi))) != -1)
+      return -1;
+   _mm256_storeu_si256((__m256i*)q, qlo);
+   return 0;
+}
+
+SIMD_TARGET("avx512f")
+static int log2_avx512_32f(const float* f, long i, double scale, int32_t* q) {
+   __m512 x = _mm512_add_ps(_mm512_loadu_ps(f + i), _mm512_set1_ps(1.0f));
+   if (log2_avx512(_mm512_cvtps_pd(_mm512_castps512_ps256(x)), scale, q) != 0)
+      return -1;
+   return log2_avx512(
+       _mm512_cvtps_pd(_mm256_castpd_ps(
+           _mm512_extractf64x4_pd(_mm512_castps_pd(x), 1))),
+       scale, q + 8);
+}
+
+SIMD_TARGET("avx512f")
+static int log2_avx512_64d(const double* f, long i, double scale,
+                           int32_t* q) {
+   const __m512d one = _mm512_set1_pd(1.0);
+   if (log2_avx512(_mm512_add_pd(_mm512_loadu_pd(f + i), one), scale, q) != 0)
+      return -1;
+   return log2_avx512(_mm512_add_pd(_mm512_loadu_pd(f + i + 8), one), scale,
+                      q + 8);
+}
+
+#endif /* SIMD_X86 */
+
+void log2_quantize_32f(const float* f, long len, float scale, uint16_t* dest)
+/**
+ * @brief Log2 transform of an array: dest[i] is
+ * floor(log2(f[i] + 1) * scale), as computed by libm.
+ *
+ * @param f Source array.
+ *
+ * @param len Length of f and dest.
+ *
+ * @param scale Scale factor of the logarithms.
+ *
+ * @param dest Destination of the len quantized values.
+ */
+{
+   long i = 0;
+#ifdef SIMD_X86
+   const simd_kernels_t* k = get_simd_kernels();
+   int (*kernel)(const float*, long, double, int32_t*) = k->log2_32f;
+   int32_t q[16];
+   long lanes = k->lanes;
+
+   for (; kernel != NULL && i + lanes <= len; i += lanes) {
+      if (kernel(f, i, scale, q) == 0)
+         for (long j = 0; j < lanes; j++) dest[i + j] = (uint16_t)q[j];
+      else
+         for (long j = i; j < i + lanes; j++)
+            dest[j] = log2_scalar(f[j] + 1, scale);
+   }
+#endif
+   for (; i < len; i++) dest[i] = log2_scalar(f[i] + 1, scale);
+}
+
+void log2_quantize_64d(const double* f, long len, float scale, uint16_t* dest)
+/**
+ * @brief log2_quantize_32f() of a double array.
+ */
+{
+   long i = 0;
+#ifdef SIMD_X86
+   const simd_kernels_t* k = get_simd_kernels();
+   int (*kernel)(const double*, long, double, int32_t*) = k->log2_64d;
+   int32_t q[16];
+   long lanes = k->lanes;
+
+   for (; kernel != NULL && i + lanes <= len; i += lanes) {
+      if (kernel(f, i, scale, q) == 0)
+         for (long j = 0; j < lanes; j++) dest[i + j] = (uint16_t)q[j];
+      else
+         for (long j = i; j < i + lanes; j++)
+            dest[j] = log2_scalar(f[j] + 1, scale);
+   }
+#endif
+   for (; i < len; i++) dest[i] = log2_scalar(f[i] + 1, scale);
+}
+
+/*
+    @section Inverse log2 transform
+*/
+
+#define EXP2_TABLES 4
+#define EXP2_TABLE_LEN 65536
+
+typedef struct {
+   float scale;
+   float* f32;   // (float)exp2(v / scale) - 1 for every 16-bit v.
+   double* f64;  // exp2(v / scale) - 1 for every 16-bit v.
+} exp2_table_t;
+
+static exp2_table_t exp2_tables[EXP2_TABLES];
+static int n_exp2_tables = 0;
+#ifdef _WIN32
+static SRWLOCK exp2_lock = SRWLOCK_INIT;
+#else
+static pthread_mutex_t exp2_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static exp2_table_t* get_exp2_table(float scale)
+/**
+ * @brief Returns the tables of a scale factor, building them on first use.
+ * Tables live until exit. Returns NULL once EXP2_TABLES scale factors are
+ * in use (or on malloc failure), in which case values are computed directly.
+ */
+{
+   exp2_table_t* r = NULL;
+
+#ifdef _WIN32
+   AcquireSRWLockExclusive(&exp2_lock);
+#else
+   pthread_mutex_lock(&exp2_lock);
+#endif
+   for (int t = 0; t < n_exp2_tables; t++)
+      if (exp2_tables[t].scale == scale)
+         r = &exp2_tables[t];
+
+   if (r == NULL && n_exp2_tables < EXP2_TABLES) {
+      float* f32 = malloc(EXP2_TABLE_LEN * sizeof(float));
+      double* f64 = malloc(EXP2_TABLE_LEN * sizeof(double));
+      if (f32 != NULL && f64 != NULL) {
+         for (long v = 0; v < EXP2_TABLE_LEN; v++) {
+            double e = exp2((double)v / scale);
+            f32[v] = (float)e - 1;
+            f64[v] = e - 1;
+         }
+         r = &exp2_tables[n_exp2_tables++];
+         r->scale = scale;
+         r->f32 = f32;
+         r->f64 = f64;
+      } else {
+         free(f32);
+         free(f64);
+      }
+   }
+#ifdef _WIN32
+   ReleaseSRWLockExclusive(&exp2_lock);
+#else
+   pthread_mutex_unlock(&exp2_lock);
+#endif
+   return r;
+}
+
+void exp2_dequantize_32f(const uint16_t* q, long len, float scale, float* dest)
+/**
+ * @brief Inverse log2 transform of an array: dest[i] is
+ * (float)exp2(q[i] / scale) - 1, as computed by libm. A 16-bit input has
+ * 65536 possible values, so they are looked up in a table of the libm
+ * results built once per scale factor.
+ *
+ * @param q Quantized values.
+ *
+ * @param len Length of q and dest.
+ *
+ * @param scale Scale factor of the logarithms.
+ *
+ * @param dest Destination of the len values.
+ */
+{
+   exp2_table_t* table = get_exp2_table(scale);
+
+   if (table == NULL) {
+      for (long i = 0; i < len; i++)
+         dest[i] = (float)exp2((double)q[i] / scale) - 1;
+      return;
+   }
+   for (long i = 0; i < len; i++) dest[i] = table->f32[q[i]];
+}
+
+void exp2_dequantize_64d(const uint16_t* q, long len, float scale,
+                         double* dest)
+/**
+ * @brief exp2_dequantize_32f() to a double array.
+ */
+{
+   exp2_table_t* table = get_exp2_table(scale);
+
+   if (table == NULL) {
+      for (long i = 0; i < len; i++)
+         dest[i] = exp2((double)q[i] / scale) - 1;
+      return;
+   }
+   for (long i = 0; i < len; i++) dest[i] = table->f64[q[i]];
+}
+
+/*
+    @section Substring search
+*/
+
+static const char* find_scalar(const char* start, const char* end,
+                               const char* needle, size_t len) {
+   for (; start + len <= end; start++)
+      if (*start == *needle && memcmp(start, needle, len) == 0)
+         return start;
+
+   return NULL;
+}
+
+#ifdef SIMD_X86
+
+/* Each kernel tests a block of positions at once for the first and last byte
+ * of the needle, and compares the whole needle only where both match. */
+
+static SIMD_INLINE int lowest_bit(uint32_t mask) {
+#ifdef _MSC_VER
+   unsigned long r;
+   _BitScanForward(&r, mask);
+   return (int)r;
+#else
+   return __builtin_ctz(mask);
+#endif
+}
+
+SIMD_TARGET("sse2")
+static const char* find_sse2(const char* start, const char* end,
+                             const char* needle, size_t len) {
+   __m128i first = _mm_set1_epi8(needle[0]);
+   __m128i last = _mm_set1_epi8(needle[len - 1]);
+
+   for (; end - start >= (long)(len + 15); start += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i*)start);
+      __m128i b = _mm_loadu_si128((const __m128i*)(start + len - 1));
+      uint32_t mask = _mm_movemask_epi8(
+          _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+      for (; mask != 0; mask &= mask - 1) {
+         int k = lowest_bit(mask);
+         if (memcmp(start + k, needle, len) == 0)
+            return start + k;
+      }
+   }
+   return find_scalar(start, end, needle, len);
+}
+
+SIMD_TARGET("avx2")
+static const char* find_avx2(const char* start, const char* end,
+                             const char* needle, size_t len) {
+   __m256i first = _mm256_set1_epi8(needle[0]);
+   __m256i last = _mm256_set1_epi8(needle[len - 1]);
+
+   for (; end - start >= (long)(len + 31); start += 32) {
+      __m256i a = _mm256_loadu_si256((const __m256i*)start);
+      __m256i b = _mm256_loadu_si256((const __m256i*)(start + len - 1));
+      uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(
+          _mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+      for (; mask != 0; mask &= mask - 1) {
+         int k = lowest_bit(mask);
+         if (memcmp(start + k, needle, len) == 0)
+            return start + k;
+      }
+   }
+   return find_scalar(start, end, needle, len);
+}
+
+#endif /* SIMD_X86 */
+
+const char* find_substring(const char* start, const char* end,
+                           const char* needle, size_t len)
+/**
+ * @brief Returns the first occurrence of the len bytes of needle that starts
+ * and ends within [start, end), or NULL.
+ */
+{
+   if (len == 0)
+      return find_scalar(start, end, needle, len);
+   return get_simd_kernels()->find(start, end, needle, len);
+}
+
+/*
+    @section Dispatch
+*/
+
+/* Kernels of each level, indexed by level. AVX-512 searches with the AVX2
+ * kernel, as byte compares need AVX512BW on top of AVX512F. */
+static const simd_kernels_t simd_variants[] = {
+    {SIMD_SCALAR, 0, NULL, NULL, NULL, NULL, find_scalar},
+#ifdef SIMD_X86
+    {SIMD_SSE2, 4, quantize_sse2_32f, quantize_sse2_64d, log2_sse2_32f,
+     log2_sse2_64d, find_sse2},
+    {SIMD_AVX2, 8, quantize_avx2_32f, quantize_avx2_64d, log2_avx2_32f,
+     log2_avx2_64d, find_avx2},
+    {SIMD_AVX512, 16, quantize_avx512_32f, quantize_avx512_64d,
+     log2_avx512_32f, log2_avx512_64d, find_avx2},
+#endif
+};
+
+// Level -1 until set_simd_level() selects the kernels.
+static simd_kernels_t simd_kernels = {-1, 0, NULL, NULL, NULL, NULL, NULL};
+
+int set_simd_level(int level)
+/**
+ * @brief Selects the kernels of an instruction set (SIMD_SCALAR, SIMD_SSE2,
+ * SIMD_AVX2 or SIMD_AVX512), or SIMD_AUTO for the best one the CPU supports.
+ * A level the CPU lacks falls back to the best supported one. Must be called
+ * before worker threads start.
+ *
+ * @return The level in use.
+ */
+{
+   int max = detect_simd_level();
+
+   if (level > max) {
+      warning("set_simd_level: %s is not supported by this CPU, using %s.\n",
+              get_simd_level_name(level), get_simd_level_name(max));
+      level = max;
+   } else if (level < SIMD_SCALAR)
+      level = max;
+
+   simd_kernels = simd_variants[level];
+   return level;
+}
+
+static const simd_kernels_t* get_simd_kernels() {
+   if (simd_kernels.level < 0)
+      set_simd_level(SIMD_AUTO);
+   return &simd_kernels;
+}
+
+int get_simd_level()
+/**
+ * @brief Returns the instruction set of the kernels in use, selecting the
+ * best one the CPU supports unless set_simd_level() was called. The first
+ * call should happen before worker threads start (see
+ * set_compress_runtime_variables()).
+ */
+{
+   return get_simd_kernels()->level;
+}
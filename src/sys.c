@@ -127,7 +127,9 @@ int print(const char* format, ...)
    if (verbose) {
       va_list args;
       va_start(args, format);
-      ret = vprintf(format, args);
+      // Keep stdout clean when it is the output file.
+      ret = vfprintf(fds[1] == fileno(stdout) ? stderr : stdout, format,
+                     args);
       va_end(args);
    }
    return ret;
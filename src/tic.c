@@ -0,0 +1,589 @@
+/**
+ * @file tic.c
+ * @author Chris Grams (chrisagrams@gmail.com)
+ * @brief Total ion current (TIC) and base peak chromatograms (BPC) of mzML and
+ * msz files. Values recorded in the file (TIC and base peak intensity cvParams
+ * of the mzML, metadata columns of the msz) are used as is; the remaining
+ * spectra have their intensity array decoded by worker threads and reduced to
+ * its sum and maximum, and are flagged in tic_t.computed. An msz written
+ * without metadata columns therefore reports computed values where its mzML
+ * reports recorded ones.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright
+ *
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mscompress.h"
+
+typedef struct {
+   long n;            // Spectra to reduce.
+   long* indices;     // Spectrum index of each (msz source).
+   uint64_t* starts;  // Intensity <binary> contents of each (mzML source).
+   uint64_t* ends;
+   double* tic;
+   double* bpc;
+
+   msz_reader_t* reader;  // NULL for an mzML source.
+   char* input_map;
+   decode_fun decode;
+   uint32_t fmt;  // Intensity data format.
+
+   long next;  // Next spectrum to reduce.
+   int failed;
+#ifdef _WIN32
+   CRITICAL_SECTION lock;
+#else
+   pthread_mutex_t lock;
+#endif
+} tic_job_t;
+
+static void reduce_f32(const float* arr, long n, double* sum, double* max) {
+   // Four partial sums and maxima break the loop-carried dependency.
+   double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+   float m0 = 0, m1 = 0, m2 = 0, m3 = 0;
+   long i = 0;
+
+   for (; i + 4 <= n; i += 4) {
+      s0 += arr[i];
+      s1 += arr[i + 1];
+      s2 += arr[i + 2];
+      s3 += arr[i + 3];
+      m0 = arr[i] > m0 ? arr[i] : m0;
+      m1 = arr[i + 1] > m1 ? arr[i + 1] : m1;
+      m2 = arr[i + 2] > m2 ? arr[i + 2] : m2;
+      m3 = arr[i + 3] > m3 ? arr[i + 3] : m3;
+   }
+   for (; i < n; i++) {
+      s0 += arr[i];
+      m0 = arr[i] > m0 ? arr[i] : m0;
+   }
+   m0 = m1 > m0 ? m1 : m0;
+   m2 = m3 > m2 ? m3 : m2;
+   *sum = (s0 + s1) + (s2 + s3);
+   *max = m2 > m0 ? m2 : m0;
+}
+
+static void reduce_f64(const double* arr, long n, double* sum, double* max) {
+   double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+   double m0 = 0, m1 = 0, m2 = 0, m3 = 0;
+   long i = 0;
+
+   for (; i + 4 <= n; i += 4) {
+      s0 += arr[i];
+      s1 += arr[i + 1];
+      s2 += arr[i + 2];
+      s3 += arr[i + 3];
+      m0 = arr[i] > m0 ? arr[i] : m0;
+      m1 = arr[i + 1] > m1 ? arr[i + 1] : m1;
+      m2 = arr[i + 2] > m2 ? arr[i + 2] : m2;
+      m3 = arr[i + 3] > m3 ? arr[i + 3] : m3;
+   }
+   for (; i < n; i++) {
+      s0 += arr[i];
+      m0 = arr[i] > m0 ? arr[i] : m0;
+   }
+   m0 = m1 > m0 ? m1 : m0;
+   m2 = m3 > m2 ? m3 : m2;
+   *sum = (s0 + s1) + (s2 + s3);
+   *max = m2 > m0 ? m2 : m0;
+}
+
+static void reduce(const char* arr, size_t len, uint32_t fmt, double* sum,
+                   double* max) {
+   if (fmt == _64d_)
+      reduce_f64((const double*)arr, len / sizeof(double), sum, max);
+   else
+      reduce_f32((const float*)arr, len / sizeof(float), sum, max);
+}
+
+static int tic_spectrum(tic_job_t* job, long i, z_stream* z,
+                        data_block_t* tmp) {
+   size_t len = 0;
+   char* arr = NULL;
+
+   job->tic[i] = 0;
+   job->bpc[i] = 0;
+
+   if (job->reader != NULL) {
+      arr = msz_reader_get_binary(job->reader, _intensity_, job->indices[i],
+                                  &len);
+      if (arr == NULL)
+         return -1;
+      reduce(arr, len, job->fmt, &job->tic[i], &job->bpc[i]);
+      free(arr);
+      return 0;
+   }
+
+   if (job->ends[i] <= job->starts[i])  // Empty spectrum.
+      return 0;
+   tmp->size = 0;
+   if (job->decode(z, job->input_map + job->starts[i],
+                   job->ends[i] - job->starts[i], tmp, &len) != 0 ||
+       len < ZLIB_SIZE_OFFSET)
+      return -1;
+   reduce(tmp->mem + ZLIB_SIZE_OFFSET, len - ZLIB_SIZE_OFFSET, job->fmt,
+          &job->tic[i], &job->bpc[i]);
+   return 0;
+}
+
+static void* tic_worker(void* args) {
+   tic_job_t* job = args;
+   z_stream* z = NULL;
+   data_block_t* tmp = NULL;
+   int ok = 1;
+   long i;
+
+   if (job->reader == NULL) {
+      z = alloc_z_stream(NULL);
+      tmp = alloc_data_block(1 << 20);  // Grown by the decoder if needed.
+      ok = z != NULL && tmp != NULL;
+   }
+
+   while (ok) {
+#ifdef _WIN32
+      EnterCriticalSection(&job->lock);
+#else
+      pthread_mutex_lock(&job->lock);
+#endif
+      i = job->failed ? job->n : job->next++;
+#ifdef _WIN32
+      LeaveCriticalSection(&job->lock);
+#else
+      pthread_mutex_unlock(&job->lock);
+#endif
+      if (i >= job->n)
+         break;
+
+      if (tic_spectrum(job, i, z, tmp) != 0) {
+         error("tic_worker: Failed to decode intensity array %ld.\n", i);
+         ok = 0;
+      }
+   }
+
+   if (!ok) {
+#ifdef _WIN32
+      EnterCriticalSection(&job->lock);
+      job->failed = 1;
+      LeaveCriticalSection(&job->lock);
+#else
+      pthread_mutex_lock(&job->lock);
+      job->failed = 1;
+      pthread_mutex_unlock(&job->lock);
+#endif
+   }
+
+   if (z != NULL)
+      dealloc_z_stream(z);
+   if (tmp != NULL)
+      dealloc_data_block(tmp);
+   return NULL;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI tic_worker_win(LPVOID args) {
+   tic_worker(args);
+   return 0;
+}
+#endif
+
+static int run_tic_job(tic_job_t* job, int threads)
+/**
+ * @brief Reduces the job->n intensity arrays of job over threads worker
+ * threads.
+ *
+ * @return 0 on success, 1 on error.
+ */
+{
+   if (job->n == 0)
+      return 0;
+
+   job->tic = malloc(job->n * sizeof(double));
+   job->bpc = malloc(job->n * sizeof(double));
+   if (job->tic == NULL || job->bpc == NULL) {
+      error("run_tic_job: malloc failure.\n");
+      return 1;
+   }
+
+   if (threads < 1)
+      threads = 1;
+   if (threads > job->n)
+      threads = job->n;
+
+#ifdef _WIN32
+   InitializeCriticalSection(&job->lock);
+   HANDLE* ptid = malloc(threads * sizeof(HANDLE));
+#else
+   pthread_mutex_init(&job->lock, NULL);
+   pthread_t* ptid = malloc(threads * sizeof(pthread_t));
+#endif
+   if (ptid == NULL) {
+      error("run_tic_job: malloc failure.\n");
+      job->failed = 1;
+      threads = 0;
+   }
+
+   int t;
+   for (t = 0; t < threads; t++) {
+#ifdef _WIN32
+      ptid[t] = CreateThread(NULL, 0, tic_worker_win, job, 0, NULL);
+      if (ptid[t] == NULL) {
+         error("run_tic_job: Failed to create thread.\n");
+         break;
+      }
+#else
+      if (pthread_create(&ptid[t], NULL, tic_worker, job) != 0) {
+         error("run_tic_job: Failed to create thread.\n");
+         break;
+      }
+#endif
+   }
+   threads = t;
+   // Workers share the job, so the threads that started finish it. Without
+   // any, run it on the calling thread.
+   if (threads == 0 && !job->failed)
+      tic_worker(job);
+#ifdef _WIN32
+   if (threads > 0)
+      WaitForMultipleObjects(threads, ptid, TRUE, INFINITE);
+   DeleteCriticalSection(&job->lock);
+#else
+   for (t = 0; t < threads; t++) pthread_join(ptid[t], NULL);
+   pthread_mutex_destroy(&job->lock);
+#endif
+   free(ptid);
+
+   return job->failed;
+}
+
+static void dealloc_tic_job(tic_job_t* job) {
+   free(job->indices);
+   free(job->starts);
+   free(job->ends);
+   free(job->tic);
+   free(job->bpc);
+}
+
+static tic_t* alloc_tic(long* indices, long n_spectra) {
+   tic_t* r;
+
+   r = calloc(1, sizeof(tic_t));
+   if (r == NULL) {
+      error("alloc_tic: malloc failure.\n");
+      free(indices);
+      return NULL;
+   }
+   r->n_spectra = n_spectra;
+   r->indices = indices;
+   r->ret_times = malloc((n_spectra + 1) * sizeof(float));
+   r->tic = malloc((n_spectra + 1) * sizeof(double));
+   r->bpc = malloc((n_spectra + 1) * sizeof(double));
+   r->computed = calloc(n_spectra + 1, sizeof(uint8_t));
+   if (r->ret_times == NULL || r->tic == NULL || r->bpc == NULL ||
+       r->computed == NULL) {
+      error("alloc_tic: malloc failure.\n");
+      dealloc_tic(r);
+      return NULL;
+   }
+   return r;
+}
+
+static long* all_indices(long n) {
+   long* r = malloc((n + 1) * sizeof(long));
+   if (r == NULL) {
+      error("all_indices: malloc failure.\n");
+      return NULL;
+   }
+   for (long i = 0; i < n; i++) r[i] = i;
+   return r;
+}
+
+static int fill_tic(tic_t* r, float* tic_col, float* bpi_col, tic_job_t* job,
+                    data_positions_t* inten, int threads)
+/**
+ * @brief Fills r->tic and r->bpc from the recorded columns (NULL if not
+ * recorded), reducing the intensity arrays of the spectra missing either.
+ * Intensity arrays are read through job->reader, or from the positions in
+ * inten for an mzML source.
+ *
+ * @return 0 on success, 1 on error.
+ */
+{
+   long* rows = malloc((r->n_spectra + 1) * sizeof(long));
+   long i, k;
+   int ret;
+
+   job->indices = malloc((r->n_spectra + 1) * sizeof(long));
+   if (inten != NULL) {
+      job->starts = malloc((r->n_spectra + 1) * sizeof(uint64_t));
+      job->ends = malloc((r->n_spectra + 1) * sizeof(uint64_t));
+   }
+   if (rows == NULL || job->indices == NULL ||
+       (inten != NULL && (job->starts == NULL || job->ends == NULL))) {
+      error("fill_tic: malloc failure.\n");
+      free(rows);
+      dealloc_tic_job(job);
+      return 1;
+   }
+
+   for (i = 0; i < r->n_spectra; i++) {
+      k = r->indices[i];
+      r->tic[i] = tic_col != NULL ? tic_col[k] : NAN;
+      r->bpc[i] = bpi_col != NULL ? bpi_col[k] : NAN;
+      if (!isnan(r->tic[i]) && !isnan(r->bpc[i]))
+         continue;
+      rows[job->n] = i;
+      job->indices[job->n] = k;
+      if (inten != NULL) {
+         job->starts[job->n] = inten->start_positions[k];
+         job->ends[job->n] = inten->end_positions[k];
+      }
+      job->n++;
+   }
+
+   ret = run_tic_job(job, threads);
+   if (ret == 0) {
+      for (i = 0; i < job->n; i++) {
+         if (isnan(r->tic[rows[i]])) {
+            r->tic[rows[i]] = job->tic[i];
+            r->computed[rows[i]] |= TIC_COMPUTED;
+         }
+         if (isnan(r->bpc[rows[i]])) {
+            r->bpc[rows[i]] = job->bpc[i];
+            r->computed[rows[i]] |= BPC_COMPUTED;
+         }
+      }
+      print("Decoded %ld of %ld intensity arrays.\n", job->n, r->n_spectra);
+   }
+
+   free(rows);
+   dealloc_tic_job(job);
+   return ret;
+}
+
+tic_t* compute_tic_msz(msz_reader_t* reader, uint16_t ms_level, int threads)
+/**
+ * @brief Computes the TIC and BPC of an msz file. Spectra whose TIC and base
+ * peak intensity were stored as metadata columns are not decompressed.
+ *
+ * @param reader An open msz_reader_t.
+ *
+ * @param ms_level MS level of the spectra, 0 for every spectrum.
+ *
+ * @param threads Number of worker threads.
+ *
+ * @return A tic_t (to be freed with dealloc_tic()) on success, NULL on error.
+ */
+{
+   tic_job_t job = {0};
+   long* indices;
+   long n = 0;
+   tic_t* r;
+
+   if (ms_level == 0) {
+      n = msz_reader_num_spectra(reader);
+      indices = all_indices(n);
+   } else
+      indices = msz_reader_ms_level(reader, ms_level, &n);
+   if (indices == NULL && n > 0)
+      return NULL;
+
+   r = alloc_tic(indices, n);
+   if (r == NULL)
+      return NULL;
+
+   for (long i = 0; i < n; i++)
+      r->ret_times[i] = msz_reader_ret_time(reader, indices[i]);
+
+   job.reader = reader;
+   job.fmt = msz_reader_df(reader)->source_inten_fmt;
+   if (fill_tic(r, msz_reader_metadata_column(reader, METADATA_TIC),
+                msz_reader_metadata_column(reader,
+                                           METADATA_BASE_PEAK_INTENSITY),
+                &job, NULL, threads)) {
+      dealloc_tic(r);
+      return NULL;
+   }
+
+   return r;
+}
+
+tic_t* compute_tic_mzml(char* input_map, long input_filesize,
+                        uint16_t ms_level, int threads)
+/**
+ * @brief Computes the TIC and BPC of an mzML file. Spectra without TIC or
+ * base peak intensity cvParams have their intensity array decoded.
+ *
+ * @param input_map mmap'ed mzML file.
+ *
+ * @param input_filesize Size of the mzML file.
+ *
+ * @param ms_level MS level of the spectra, 0 for every spectrum.
+ *
+ * @param threads Number of worker threads.
+ *
+ * @return A tic_t (to be freed with dealloc_tic()) on success, NULL on error.
+ */
+{
+   tic_job_t job = {0};
+   data_format_t* df;
+   division_t* div;
+   long* indices;
+   long n = 0;
+   tic_t* r = NULL;
+
+   df = pattern_detect(input_map);
+   if (df == NULL)
+      return NULL;
+
+   div = scan_mzml(input_map, df, input_filesize,
+                   MSLEVEL | RETTIME | TIC | BASE_PEAK);
+   if (div == NULL) {
+      dealloc_df(df);
+      return NULL;
+   }
+
+   if (ms_level == 0) {
+      n = div->inten->total_spec;
+      indices = all_indices(n);
+   } else
+      indices = map_ms_level_to_index(ms_level, div, 0, &n);
+
+   if (indices != NULL || n == 0)
+      r = alloc_tic(indices, n);
+
+   if (r != NULL) {
+      for (long i = 0; i < n; i++) r->ret_times[i] = div->ret_times[indices[i]];
+
+      job.input_map = input_map;
+      job.fmt = df->source_inten_fmt;
+      job.decode =
+          set_decode_fun(df->source_compression, _lossless_, job.fmt);
+      if (job.decode == NULL ||
+          fill_tic(r, get_metadata_column(div->metadata, METADATA_TIC),
+                   get_metadata_column(div->metadata,
+                                       METADATA_BASE_PEAK_INTENSITY),
+                   &job, div->inten, threads)) {
+         dealloc_tic(r);
+         r = NULL;
+      }
+   }
+
+   dealloc_dp(div->spectra);
+   dealloc_dp(div->xml);
+   dealloc_dp(div->mz);
+   dealloc_dp(div->inten);
+   free(div->scans);
+   free(div->ms_levels);
+   free(div->ret_times);
+   dealloc_metadata(div->metadata);
+   free(div);
+   dealloc_df(df);
+
+   return r;
+}
+
+int complete_tic_metadata(char* input_map, data_format_t* df,
+                          divisions_t* divisions, int threads)
+/**
+ * @brief Computes the TIC and base peak intensity metadata of the spectra
+ * missing their cvParams, so chromatograms of the msz file never need the
+ * intensity arrays. Only columns selected for capture are completed.
+ *
+ * @return 0 on success, 1 on error.
+ */
+{
+   metadata_t* meta = divisions->metadata;
+   tic_job_t job = {0};
+   float *tic_col, *bpi_col;
+   long i, j, k, n = 0;
+   int ret;
+
+   if (meta == NULL || !(meta->flags & (TIC | BASE_PEAK)))
+      return 0;
+   tic_col = meta->columns[METADATA_TIC];
+   bpi_col = meta->columns[METADATA_BASE_PEAK_INTENSITY];
+
+   for (i = 0; i < divisions->n_divisions; i++)
+      n += divisions->divisions[i]->inten->total_spec;
+   if (n > meta->n_spectra)
+      n = meta->n_spectra;
+
+   job.indices = malloc((n + 1) * sizeof(long));
+   job.starts = malloc((n + 1) * sizeof(uint64_t));
+   job.ends = malloc((n + 1) * sizeof(uint64_t));
+   if (job.indices == NULL || job.starts == NULL || job.ends == NULL) {
+      error("complete_tic_metadata: malloc failure.\n");
+      dealloc_tic_job(&job);
+      return 1;
+   }
+
+   for (i = 0, k = 0; i < divisions->n_divisions && k < n; i++) {
+      data_positions_t* inten = divisions->divisions[i]->inten;
+      for (j = 0; j < inten->total_spec && k < n; j++, k++) {
+         if ((tic_col == NULL || !isnan(tic_col[k])) &&
+             (bpi_col == NULL || !isnan(bpi_col[k])))
+            continue;
+         job.indices[job.n] = k;
+         job.starts[job.n] = inten->start_positions[j];
+         job.ends[job.n] = inten->end_positions[j];
+         job.n++;
+      }
+   }
+
+   job.input_map = input_map;
+   job.fmt = df->source_inten_fmt;
+   job.decode = set_decode_fun(df->source_compression, _lossless_, job.fmt);
+   ret = job.decode == NULL || run_tic_job(&job, threads);
+
+   if (ret == 0 && job.n > 0) {
+      for (i = 0; i < job.n; i++) {
+         k = job.indices[i];
+         if (tic_col != NULL && isnan(tic_col[k]))
+            tic_col[k] = (float)job.tic[i];
+         if (bpi_col != NULL && isnan(bpi_col[k]))
+            bpi_col[k] = (float)job.bpc[i];
+      }
+      print("\tComputed TIC/base peak of %ld spectra.\n", job.n);
+   }
+
+   dealloc_tic_job(&job);
+   return ret;
+}
+
+void dealloc_tic(tic_t* tic) {
+   if (tic == NULL)
+      return;
+   free(tic->indices);
+   free(tic->ret_times);
+   free(tic->tic);
+   free(tic->bpc);
+   free(tic->computed);
+   free(tic);
+}
+
+void print_tic_csv(tic_t* tic)
+/**
+ * @brief Prints a TIC to stdout in CSV format, one row per spectrum: index,
+ * retention time, total ion current, base peak intensity and the source of
+ * each ("recorded" in the file or "computed" from the intensity array).
+ */
+{
+   printf("index,rt,tic,bpc,tic_source,bpc_source\n");
+   for (long i = 0; i < tic->n_spectra; i++)
+      printf("%ld,%g,%.10g,%.10g,%s,%s\n", tic->indices[i], tic->ret_times[i],
+             tic->tic[i], tic->bpc[i],
+             tic->computed[i] & TIC_COMPUTED ? "computed" : "recorded",
+             tic->computed[i] & BPC_COMPUTED ? "computed" : "recorded");
+}
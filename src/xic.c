@@ -0,0 +1,355 @@
+/**
+ * @file xic.c
+ * @author Chris Grams (chrisagrams@gmail.com)
+ * @brief Extracted-ion chromatograms (XIC) over msz files. Only MS1 spectra
+ * are decoded: worker threads share a msz_reader_t, decode the m/z and
+ * intensity arrays of one scan at a time, and sum the intensities falling in
+ * every target window with a single forward pass over the sorted m/z array.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright
+ *
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mscompress.h"
+
+typedef struct {
+   double lo;
+   double hi;
+   long target;  // Row of the window in xic_t.intensities.
+} xic_window_t;
+
+typedef struct {
+   msz_reader_t* reader;
+   xic_t* xic;
+   xic_window_t* windows;  // Sorted by lower bound.
+   long n_windows;
+
+   long next;  // Next scan to process.
+   int failed;
+#ifdef _WIN32
+   CRITICAL_SECTION lock;
+#else
+   pthread_mutex_t lock;
+#endif
+} xic_job_t;
+
+static int cmp_window(const void* a, const void* b) {
+   const xic_window_t* x = a;
+   const xic_window_t* y = b;
+   return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+static double* to_double(char* arr, size_t len, uint32_t fmt, long* n) {
+   double* r;
+
+   if (fmt == _64d_) {
+      *n = len / sizeof(double);
+      return (double*)arr;
+   }
+
+   *n = len / sizeof(float);
+   r = malloc((*n > 0 ? *n : 1) * sizeof(double));
+   if (r == NULL) {
+      error("to_double: malloc failure.\n");
+      free(arr);
+      return NULL;
+   }
+   for (long i = 0; i < *n; i++) r[i] = ((float*)arr)[i];
+   free(arr);
+   return r;
+}
+
+static long lower_bound(const double* arr, long start, long n, double value) {
+   long lo = start, hi = n;
+   while (lo < hi) {
+      long mid = lo + (hi - lo) / 2;
+      if (arr[mid] < value)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return lo;
+}
+
+static double sum_range(const double* arr, long start, long end) {
+   // Independent accumulators let the compiler keep the sum in vector
+   // registers.
+   double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+   long i = start;
+
+   for (; i + 4 <= end; i += 4) {
+      s0 += arr[i];
+      s1 += arr[i + 1];
+      s2 += arr[i + 2];
+      s3 += arr[i + 3];
+   }
+   for (; i < end; i++) s0 += arr[i];
+   return (s0 + s1) + (s2 + s3);
+}
+
+static void sum_windows(xic_window_t* windows, long n_windows,
+                        const double* mz, const double* inten, long n,
+                        double* out, long column, long n_scans)
+/**
+ * @brief Sums inten over every m/z window of a scan. Windows are sorted by
+ * lower bound, so the search for each window starts where the previous one
+ * ended.
+ */
+{
+   long start = 0, end;
+
+   for (long w = 0; w < n_windows; w++) {
+      start = lower_bound(mz, start, n, windows[w].lo);
+      end = lower_bound(mz, start, n, nextafter(windows[w].hi, INFINITY));
+      out[windows[w].target * n_scans + column] = sum_range(inten, start, end);
+   }
+}
+
+static int xic_scan(xic_job_t* job, long column) {
+   msz_reader_t* reader = job->reader;
+   data_format_t* df = msz_reader_df(reader);
+   long index = job->xic->indices[column];
+   size_t mz_len = 0, inten_len = 0;
+   long n_mz, n_inten;
+   double *mz, *inten;
+   char* arr;
+
+   arr = msz_reader_get_binary(reader, _mass_, index, &mz_len);
+   if (arr == NULL)
+      return -1;
+   mz = to_double(arr, mz_len, df->source_mz_fmt, &n_mz);
+   if (mz == NULL)
+      return -1;
+
+   arr = msz_reader_get_binary(reader, _intensity_, index, &inten_len);
+   if (arr == NULL) {
+      free(mz);
+      return -1;
+   }
+   inten = to_double(arr, inten_len, df->source_inten_fmt, &n_inten);
+   if (inten == NULL) {
+      free(mz);
+      return -1;
+   }
+
+   if (n_mz != n_inten) {
+      warning("xic_scan: spectrum %ld has %ld m/z and %ld intensities.\n",
+              index, n_mz, n_inten);
+      if (n_inten < n_mz)
+         n_mz = n_inten;
+   }
+
+   sum_windows(job->windows, job->n_windows, mz, inten, n_mz,
+               job->xic->intensities, column, job->xic->n_scans);
+
+   free(mz);
+   free(inten);
+   return 0;
+}
+
+static void* xic_worker(void* args) {
+   xic_job_t* job = args;
+   long column;
+
+   while (1) {
+#ifdef _WIN32
+      EnterCriticalSection(&job->lock);
+#else
+      pthread_mutex_lock(&job->lock);
+#endif
+      column = job->failed ? job->xic->n_scans : job->next++;
+#ifdef _WIN32
+      LeaveCriticalSection(&job->lock);
+#else
+      pthread_mutex_unlock(&job->lock);
+#endif
+      if (column >= job->xic->n_scans)
+         break;
+
+      if (xic_scan(job, column) != 0) {
+         error("xic_worker: Failed to decode spectrum %ld.\n",
+               job->xic->indices[column]);
+#ifdef _WIN32
+         EnterCriticalSection(&job->lock);
+         job->failed = 1;
+         LeaveCriticalSection(&job->lock);
+#else
+         pthread_mutex_lock(&job->lock);
+         job->failed = 1;
+         pthread_mutex_unlock(&job->lock);
+#endif
+      }
+   }
+   return NULL;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI xic_worker_win(LPVOID args) {
+   xic_worker(args);
+   return 0;
+}
+#endif
+
+xic_t* extract_xic(msz_reader_t* reader, double* mz, long n_targets,
+                   double ppm, int threads)
+/**
+ * @brief Computes the extracted-ion chromatogram of every target m/z over
+ * the MS1 spectra of an msz file.
+ *
+ * @param reader An open msz_reader_t.
+ *
+ * @param mz Target m/z values.
+ *
+ * @param n_targets Number of targets.
+ *
+ * @param ppm Half width of each window, in parts per million of its m/z.
+ *
+ * @param threads Number of worker threads.
+ *
+ * @return A xic_t (to be freed with dealloc_xic()) on success, NULL on error.
+ */
+{
+   xic_job_t job = {0};
+   xic_t* r;
+
+   if (n_targets <= 0 || ppm < 0) {
+      error("extract_xic: invalid targets.\n");
+      return NULL;
+   }
+   if (threads < 1)
+      threads = 1;
+
+   r = calloc(1, sizeof(xic_t));
+   if (r == NULL) {
+      error("extract_xic: malloc failure.\n");
+      return NULL;
+   }
+   r->n_targets = n_targets;
+
+   r->indices = msz_reader_ms_level(reader, 1, &r->n_scans);
+   r->mz = malloc(n_targets * sizeof(double));
+   r->ret_times = malloc((r->n_scans + 1) * sizeof(float));
+   r->intensities = calloc(n_targets * r->n_scans + 1, sizeof(double));
+   job.windows = malloc(n_targets * sizeof(xic_window_t));
+   if (r->mz == NULL || r->ret_times == NULL || r->intensities == NULL ||
+       job.windows == NULL) {
+      error("extract_xic: malloc failure.\n");
+      free(job.windows);
+      dealloc_xic(r);
+      return NULL;
+   }
+
+   memcpy(r->mz, mz, n_targets * sizeof(double));
+   for (long i = 0; i < r->n_scans; i++)
+      r->ret_times[i] = msz_reader_ret_time(reader, r->indices[i]);
+
+   for (long i = 0; i < n_targets; i++) {
+      double tolerance = mz[i] * ppm * 1e-6;
+      job.windows[i].lo = mz[i] - tolerance;
+      job.windows[i].hi = mz[i] + tolerance;
+      job.windows[i].target = i;
+   }
+   qsort(job.windows, n_targets, sizeof(xic_window_t), cmp_window);
+
+   job.reader = reader;
+   job.xic = r;
+   job.n_windows = n_targets;
+
+   if (threads > r->n_scans)
+      threads = r->n_scans > 0 ? r->n_scans : 1;
+
+#ifdef _WIN32
+   InitializeCriticalSection(&job.lock);
+   HANDLE* ptid = malloc(threads * sizeof(HANDLE));
+#else
+   pthread_mutex_init(&job.lock, NULL);
+   pthread_t* ptid = malloc(threads * sizeof(pthread_t));
+#endif
+   if (ptid == NULL) {
+      error("extract_xic: malloc failure.\n");
+      job.failed = 1;
+      threads = 0;
+   }
+
+   int t;
+   for (t = 0; t < threads; t++) {
+#ifdef _WIN32
+      ptid[t] = CreateThread(NULL, 0, xic_worker_win, &job, 0, NULL);
+      if (ptid[t] == NULL) {
+         error("extract_xic: Failed to create thread.\n");
+         break;
+      }
+#else
+      if (pthread_create(&ptid[t], NULL, xic_worker, &job) != 0) {
+         error("extract_xic: Failed to create thread.\n");
+         break;
+      }
+#endif
+   }
+   threads = t;
+   // Workers share the job, so the threads that started finish it. Without
+   // any, run it on the calling thread.
+   if (threads == 0 && !job.failed)
+      xic_worker(&job);
+#ifdef _WIN32
+   if (threads > 0)
+      WaitForMultipleObjects(threads, ptid, TRUE, INFINITE);
+   DeleteCriticalSection(&job.lock);
+#else
+   for (t = 0; t < threads; t++) pthread_join(ptid[t], NULL);
+   pthread_mutex_destroy(&job.lock);
+#endif
+   free(ptid);
+   free(job.windows);
+
+   if (job.failed) {
+      dealloc_xic(r);
+      return NULL;
+   }
+
+   print("Extracted %ld traces over %ld MS1 spectra.\n", n_targets,
+         r->n_scans);
+   return r;
+}
+
+void dealloc_xic(xic_t* xic) {
+   if (xic == NULL)
+      return;
+   free(xic->mz);
+   free(xic->indices);
+   free(xic->ret_times);
+   free(xic->intensities);
+   free(xic);
+}
+
+void print_xic_csv(xic_t* xic)
+/**
+ * @brief Prints an XIC to stdout in CSV format, one row per MS1 spectrum:
+ * index, retention time, then the summed intensity of each target.
+ */
+{
+   long i, t;
+
+   printf("index,rt");
+   for (t = 0; t < xic->n_targets; t++) printf(",%.10g", xic->mz[t]);
+   printf("\n");
+
+   for (i = 0; i < xic->n_scans; i++) {
+      printf("%ld,%g", xic->indices[i], xic->ret_times[i]);
+      for (t = 0; t < xic->n_targets; t++)
+         printf(",%g", xic->intensities[t * xic->n_scans + i]);
+      printf("\n");
+   }
+}
@@ -6,6 +6,45 @@
 #include "../vendor/zlib/zlib.h"
 #include "mscompress.h"
 
+/**
+ * @brief Per-thread zlib state. alloc_z_stream() hands out a pointer to
+ * `z`, which must stay the first member so zlib_deflate() and
+ * zlib_inflate_stream() can recover the engine from the z_stream passed
+ * through the encode and decode functions.
+ */
+typedef struct {
+   z_stream z;
+   int backend;         // DEFLATE_ONESHOT or DEFLATE_STREAM.
+   Bytef* out;          // DEFLATE_ONESHOT output buffer, grown to deflateBound.
+   size_t out_len;
+   zlib_block_t* blk;   // DEFLATE_STREAM output of the last call.
+   z_stream inf;        // Inflate stream, initialized on first use.
+   int inf_init;
+} deflate_engine_t;
+
+/**
+ * @brief Selects the deflate backend and level used to re-encode zlib
+ * compressed binary data of df. z_streams allocated for df afterwards (see
+ * alloc_z_stream()) use them.
+ * @param backend DEFLATE_ONESHOT or DEFLATE_STREAM.
+ * @param level zlib compression level (-1 for Z_DEFAULT_COMPRESSION, 0-9).
+ * Anything but the default will not reproduce the original mzML byte for byte.
+ * @return 0 on success, 1 on error.
+ */
+int set_deflate_backend(data_format_t* df, int backend, int level) {
+   if (backend != DEFLATE_ONESHOT && backend != DEFLATE_STREAM) {
+      error("set_deflate_backend: unknown backend %d\n", backend);
+      return 1;
+   }
+   if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION) {
+      error("set_deflate_backend: invalid level %d\n", level);
+      return 1;
+   }
+   df->zlib_engine = backend;
+   df->zlib_level = level;
+   return 0;
+}
+
 
 /**
  * @brief Allocates a `zlib_block_t` struct with the specified offset and initializes its fields.
@@ -98,24 +137,29 @@ void* zlib_pop_header(zlib_block_t* blk) {
 }
 
 /**
-* @brief Compresses a buffer using zlib and returns the compressed buffer on success, NULL on error.
-* @return A pointer to the compressed buffer on success. NULL on error.
+* @brief Allocates the zlib state of a thread.
+* @param df Selects the deflate backend and level (see set_deflate_backend()).
+* NULL for the defaults, e.g. if the z_stream only decodes.
+* @return A pointer to the z_stream on success. NULL on error.
 */
-z_stream* alloc_z_stream() {
-   z_stream* z;
+z_stream* alloc_z_stream(data_format_t* df) {
+   deflate_engine_t* e;
+   int level = df != NULL ? df->zlib_level : Z_DEFAULT_COMPRESSION;
 
-   z = calloc(1, sizeof(z_stream));
+   e = calloc(1, sizeof(deflate_engine_t));
 
-   if (z == NULL) {
+   if (e == NULL) {
       error("alloc_z_stream: calloc error\n");
       return NULL;
    }
-   if (deflateInit(z, Z_DEFAULT_COMPRESSION) != Z_OK) {
+   e->backend = df != NULL ? df->zlib_engine : DEFLATE_ONESHOT;
+   if (deflateInit(&e->z, level) != Z_OK) {
       error("alloc_z_stream: deflateInit error\n");
+      free(e);
       return NULL;
    }
 
-   return z;
+   return &e->z;
 }
 
 /**
@@ -123,9 +167,14 @@ z_stream* alloc_z_stream() {
  * @param z A pointer to the `z_stream` struct to be deallocated.
  */
 void dealloc_z_stream(z_stream* z) {
-   if (z) {
-      deflateEnd(z);
-      free(z);
+   deflate_engine_t* e = (deflate_engine_t*)z;
+   if (e) {
+      deflateEnd(&e->z);
+      if (e->inf_init)
+         inflateEnd(&e->inf);
+      free(e->out);
+      zlib_dealloc(e->blk);
+      free(e);
    }
 }
 
@@ -249,3 +298,104 @@ uInt zlib_decompress(z_stream* z, Bytef* input, zlib_block_t* output,
 
    return r;
 }
+
+/**
+ * @brief Returns the inflate stream of a z_stream allocated by
+ * alloc_z_stream(), ready to inflate a new zlib stream. The stream is
+ * initialized once and reset on later calls, so inflating an array does not
+ * allocate.
+ * @param z A z_stream allocated by alloc_z_stream().
+ * @return The inflate stream on success, NULL on error.
+ */
+z_stream* zlib_inflate_stream(z_stream* z) {
+   deflate_engine_t* e = (deflate_engine_t*)z;
+
+   if (e == NULL) {
+      error("zlib_inflate_stream: z_stream is NULL\n");
+      return NULL;
+   }
+
+   if (e->inf_init)
+      inflateReset(&e->inf);
+   else if (inflateInit(&e->inf) == Z_OK)
+      e->inf_init = 1;
+   else {
+      error("zlib_inflate_stream: inflateInit error\n");
+      return NULL;
+   }
+
+   return &e->inf;
+}
+
+/**
+ * @brief One-shot deflate: a single deflate(Z_FINISH) call into a buffer of
+ * deflateBound() bytes kept by the engine, so no allocation happens once the
+ * buffer has grown to the largest array seen.
+ * @return The size of the compressed output on success, 0 on error.
+ */
+static uInt deflate_oneshot(deflate_engine_t* e, Bytef* input,
+                            uInt input_len) {
+   uLong bound = deflateBound(&e->z, input_len);
+   uInt r;
+
+   if (bound > e->out_len) {
+      Bytef* tmp = realloc(e->out, bound);
+      if (tmp == NULL) {
+         error("deflate_oneshot: realloc error\n");
+         return 0;
+      }
+      e->out = tmp;
+      e->out_len = bound;
+   }
+
+   e->z.next_in = input;
+   e->z.avail_in = input_len;
+   e->z.next_out = e->out;
+   e->z.avail_out = (uInt)bound;
+
+   if (deflate(&e->z, Z_FINISH) != Z_STREAM_END) {
+      error("deflate_oneshot: deflate error\n");
+      deflateReset(&e->z);
+      return 0;
+   }
+
+   r = e->z.total_out;
+
+   deflateReset(&e->z);
+
+   return r;
+}
+
+/**
+ * @brief Compresses input with the deflate backend of z (see
+ * alloc_z_stream()).
+ * @param z A z_stream allocated by alloc_z_stream().
+ * @param input The buffer to compress.
+ * @param input_len The length of input.
+ * @param output Set to the compressed data. Owned by z and valid until the
+ * next call.
+ * @return The size of the compressed output on success, 0 on error.
+ */
+uInt zlib_deflate(z_stream* z, Bytef* input, uInt input_len, Bytef** output) {
+   deflate_engine_t* e = (deflate_engine_t*)z;
+   uInt r;
+
+   if (e == NULL) {
+      error("zlib_deflate: z_stream is NULL\n");
+      return 0;
+   }
+
+   if (e->backend == DEFLATE_ONESHOT) {
+      r = deflate_oneshot(e, input, input_len);
+      *output = e->out;
+      return r;
+   }
+
+   zlib_dealloc(e->blk);
+   e->blk = zlib_alloc(0);
+   if (e->blk == NULL)
+      return 0;
+   r = zlib_compress(&e->z, input, e->blk, input_len);
+   *output = e->blk->buff;
+   return r;
+}